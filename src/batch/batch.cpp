@@ -0,0 +1,251 @@
+//
+//  batch.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "batch/batch.hpp"
+
+#include "utils/linereader.hpp"
+#include "utils/parallel.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <set>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 只能写在命令行上（进程级）或只能由清单给出的选项
+static const std::set<std::string> batch_line_forbidden = {
+    "--gwas-summary", "--out", "--batch", "--io-jobs",
+    "--threads", "--log", "--memory-limit", "--dry-run", "--help"
+};
+
+struct BatchJob {
+    size_t line = 0;                     // 清单行号（1-based）
+    std::string gwas, out;
+    uint64_t bytes = 0;                  // 输入文件大小：大文件先发
+    std::function<void()> run;
+
+    bool ok = false;
+    std::string error;
+    double sec = 0;
+};
+
+static std::vector<std::string> split_tab(const std::string& s)
+{
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t t = s.find('\t', start);
+        if (t == std::string::npos) t = s.size();
+        out.emplace_back(s, start, t - start);
+        start = t + 1;
+    }
+    return out;
+}
+
+static std::string fmt_sec(double s)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f s", s);
+    return buf;
+}
+
+static void batch_fail(const std::string& msg)
+{
+    LOG_ERROR(msg);
+    die(1);
+}
+
+bool batch_requested(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--batch") return true;
+    return false;
+}
+
+// 调度状态：order 为发出顺序（大文件先），next 为下一个待发的位置
+struct BatchRun {
+    std::vector<BatchJob>* jobs = nullptr;
+    std::vector<size_t> order;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> finished{0};
+};
+
+static void run_job(BatchRun* R, BatchJob& J);
+
+// 发下一个文件的 task。初始发 --io-jobs 个；之后每个文件读完（或结束）时再发一个，
+// 因此同时读盘的文件不超过 --io-jobs，而排队的文件还不是 task、不占线程
+static void spawn_next(BatchRun* R)
+{
+    const size_t q = R->next++;
+    if (q >= R->order.size()) return;
+    BatchJob* J = &(*R->jobs)[R->order[q]];
+    #pragma omp task firstprivate(R, J)
+    run_job(R, *J);
+}
+
+// 在 g_exit_throws 下运行 fn，把 die / 异常转成错误信息；成功返回空串
+static std::string catch_error(const std::function<void()>& fn)
+{
+    std::string err;
+    try {
+        fn();
+    } catch (const GwasExit& e) {
+        if (e.code != 0) err = g_last_error.empty() ? "failed" : g_last_error;
+    } catch (const std::exception& e) {
+        err = e.what();
+    }
+    g_last_error.clear();
+    return err;
+}
+
+static void run_job(BatchRun* R, BatchJob& J)
+{
+    IoTurn turn([R] { spawn_next(R); });
+    auto s0 = std::chrono::steady_clock::now();
+    J.error = catch_error(J.run);
+    J.ok  = J.error.empty();
+    J.sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - s0).count();
+    J.run = nullptr;                     // 释放该行的参数
+
+    const size_t total = R->jobs->size();
+    const std::string n = std::to_string(++R->finished) + "/" + std::to_string(total);
+    if (J.ok) LOG_INFO("[" + n + "] " + J.gwas + " -> " + J.out + " (" + fmt_sec(J.sec) + ")");
+    else      LOG_WARN("[" + n + "] " + J.gwas + " failed: " + J.error);
+}
+
+int run_batch(const std::string& cmd, int argc, char* argv[], const BatchPrepare& prepare)
+{
+    // ---------------- 命令行：--batch / --io-jobs + 公共选项 ----------------
+    std::string manifest;
+    int io = 0;
+    std::vector<std::string> base;
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "--batch" || key == "--io-jobs") {
+            if (i + 1 >= argc) batch_fail("Missing value for " + key);
+            std::string v = argv[++i];
+            if (key == "--batch") { manifest = v; continue; }
+            try { io = std::stoi(v); } catch (...) { io = 0; }
+            if (io < 1) batch_fail("Invalid --io-jobs: " + v + " (expected a positive integer)");
+            continue;
+        }
+        if (key == "--gwas-summary" || key == "--out")
+            batch_fail(key + " is given per line in the --batch manifest.");
+        if (key == "--dry-run")
+            batch_fail("--dry-run sizes one file; run it on a single manifest line.");
+        base.push_back(key);
+    }
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (io == 0) io = std::min(threads, 4);
+
+    // ---------------- 清单：逐行拼参数并解析；先全部校验 ----------------
+    std::vector<BatchJob> jobs;
+    std::set<std::string> outs;
+    size_t bad = 0;
+
+    if (manifest.empty() || ::access(manifest.c_str(), R_OK) != 0)
+        batch_fail("Cannot read --batch manifest: " + manifest);
+    LineReader reader(manifest);
+    const bool throws = g_exit_throws;
+    g_exit_throws = true;
+
+    std::string line;
+    size_t ln = 0;
+    while (reader.getline(line)) {
+        ++ln;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        const std::string where = manifest + ":" + std::to_string(ln);
+        std::vector<std::string> tok = split_tab(line);
+        std::string err;
+        if (tok.size() < 2 || tok[0].empty() || tok[1].empty()) {
+            err = "expected GWAS<TAB>OUT[<TAB>--opt<TAB>val ...]";
+        } else if (tok[0] == "-" || tok[1] == "-") {
+            err = "--batch takes file paths, not - (stdin/stdout)";
+        } else if (!outs.insert(tok[1]).second) {
+            err = "output " + tok[1] + " is written by an earlier line";
+        } else {
+            for (size_t k = 2; k < tok.size() && err.empty(); ++k)
+                if (batch_line_forbidden.count(tok[k]))
+                    err = "option not allowed in a manifest line: " + tok[k];
+        }
+
+        BatchJob J;
+        J.line = ln;
+        J.gwas = tok[0];
+        J.out  = tok.size() > 1 ? tok[1] : "";
+        if (err.empty()) {
+            std::vector<std::string> words;
+            words.push_back(cmd);
+            words.insert(words.end(), base.begin(), base.end());
+            words.insert(words.end(), {"--gwas-summary", J.gwas, "--out", J.out});
+            words.insert(words.end(), tok.begin() + 2, tok.end());
+            std::vector<char*> av;
+            for (auto& w : words) av.push_back(&w[0]);
+            av.push_back(nullptr);
+
+            err = catch_error([&] { J.run = prepare((int)words.size(), av.data()); });
+        }
+        if (!err.empty()) {
+            LOG_ERROR(where + ": " + err);
+            ++bad;
+            continue;
+        }
+
+        struct stat st;
+        if (::stat(J.gwas.c_str(), &st) == 0) J.bytes = (uint64_t)st.st_size;
+        jobs.push_back(std::move(J));
+    }
+
+    g_exit_throws = throws;
+    if (bad) batch_fail(std::to_string(bad) + " invalid line(s) in " + manifest + "; nothing was run.");
+    if (jobs.empty()) batch_fail("No GWAS files in " + manifest);
+
+    // ---------------- 调度 ----------------
+    BatchRun R;
+    R.jobs = &jobs;
+    R.order.resize(jobs.size());
+    for (size_t k = 0; k < R.order.size(); ++k) R.order[k] = k;
+    std::stable_sort(R.order.begin(), R.order.end(),
+                     [&](size_t a, size_t b) { return jobs[a].bytes > jobs[b].bytes; });
+
+    LOG_INFO(cmd + " --batch: " + std::to_string(jobs.size()) + " files, " + std::to_string(threads) +
+             " threads, --io-jobs " + std::to_string(io) + ".");
+
+    g_exit_throws = true;
+    const auto t0 = std::chrono::steady_clock::now();
+
+    #pragma omp parallel num_threads(threads)
+    #pragma omp single
+    for (int k = 0; k < io; ++k) spawn_next(&R);
+
+    g_exit_throws = throws;
+
+    // ---------------- 汇总 ----------------
+    size_t failed = 0;
+    for (const auto& J : jobs) {
+        if (J.ok) continue;
+        ++failed;
+        LOG_ERROR(manifest + ":" + std::to_string(J.line) + ": " + J.gwas + ": " + J.error);
+    }
+    const double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    LOG_INFO(cmd + " --batch finished: " + std::to_string(jobs.size() - failed) + " succeeded, " +
+             std::to_string(failed) + " failed (" + fmt_sec(sec) + ").");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+//
+//  batch.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef GWASTOOLKIT_BATCH_HPP
+#define GWASTOOLKIT_BATCH_HPP
+
+#include <functional>
+#include <string>
+
+// =======================================================
+// [BATCH] --batch manifest.tsv：一个进程处理一批 GWAS 文件
+//   清单每行：GWAS<TAB>OUT[<TAB>--opt<TAB>val ...]（与 serve 的 FILE 请求同一写法）；
+//   行内选项覆盖命令行上的选项，空行与 # 开头的行跳过
+//   调度：--threads 个线程组成一个 OpenMP 线程池，每个文件一个 task（大文件先发）；
+//         文件内的块（BGZF 压缩、pipeline 分段、多格式写出）经 par_for 以 taskloop
+//         进入同一个池，空闲线程随时取走已发出的文件或块
+//   --io-jobs N：同时处于读盘 / 解压阶段的文件数上限（默认 min(threads, 4)）。
+//         先发 N 个文件；每个文件读完再发下一个（IoTurn），等待的文件不占线程
+//   单个文件失败不影响其他文件；全部结束后汇总，有失败则返回 1
+// =======================================================
+
+bool batch_requested(int argc, char* argv[]);
+
+// prepare(argc, argv)：解析一行拼出的参数（argv[0] 为命令名），返回该文件的执行函数。
+// 所有行先解析完，任何一行有错则不开始处理
+using BatchPrepare = std::function<std::function<void()>(int argc, char* argv[])>;
+
+int run_batch(const std::string& cmd, int argc, char* argv[], const BatchPrepare& prepare);
+
+#endif
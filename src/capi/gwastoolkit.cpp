@@ -0,0 +1,412 @@
+//
+//  gwastoolkit.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "capi/gwastoolkit.h"
+
+#include "rsidImpu/rsidImpu.hpp"
+#include "convert/convert.hpp"
+#include "or2beta/or2beta.hpp"
+#include "computeNeff/computeNeff.hpp"
+#include "pipeline/pipeline.hpp"
+#include "utils/args.hpp"
+#include "utils/log.hpp"
+#include "utils/util.hpp"
+#include "utils/gwasQC.hpp"
+#include "utils/FormatEngine.hpp"
+#include "utils/linereader.hpp"
+#include "utils/memio.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// =======================================================
+// [CAPI] 子命令照原样运行，只是 --gwas-summary / --out 指向 mem:// 缓冲：
+//   gt_table → tab 文本 → memio_put → 子命令（LineReader / Writer 读写内存）
+//   → 输出缓冲 → LineReader（arrow 同样还原为文本）→ gt_table
+// 参数解析、QC、错误检查与命令行完全一致；致命错误经 die() 抛 GwasExit 回到这里
+// =======================================================
+
+struct gt_table {
+    std::vector<std::string> header;
+    std::vector<std::string> lines;     // tab 分隔数据行（与各子命令的数据模型一致）
+};
+
+struct gt_result {
+    std::vector<std::string> names;
+    std::vector<gt_table> tables;
+};
+
+static std::mutex g_api_mutex;          // 全局状态（日志、mem:// 名字、OpenMP 线程数）：一次只跑一个命令
+static unsigned long g_call_id = 0;
+
+[[maybe_unused]] static bool g_api_init = [] {
+    g_exit_throws    = true;            // 库内 die() 不退出宿主进程
+    g_log_to_console = false;
+    return true;
+}();
+
+static int fail(int code, const std::string& msg)
+{
+    std::lock_guard<std::mutex> lock(g_log_mutex);
+    g_last_error = msg;
+    return code;
+}
+
+// 子命令 / LineReader 的错误统一转成返回码
+static int guarded(const std::function<void()>& fn)
+{
+    try {
+        fn();
+        return GT_OK;
+    } catch (const GwasExit& e) {
+        if (e.code == 0) return GT_OK;  // --help
+        return GT_ERROR;                // 信息已由 LOG_ERROR 记入 g_last_error
+    } catch (const std::exception& e) {
+        return fail(GT_ERROR, e.what());
+    } catch (...) {
+        return fail(GT_ERROR, "unknown error");
+    }
+}
+
+// ---------------- 单元格 ----------------
+static inline bool cell_span(std::string_view line, size_t col, std::string_view& out)
+{
+    size_t start = 0;
+    for (size_t c = 0; c < col; ++c) {
+        size_t tab = line.find('\t', start);
+        if (tab == std::string_view::npos) return false;
+        start = tab + 1;
+    }
+    size_t end = line.find('\t', start);
+    out = line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+    while (!out.empty() && (out.front() == ' ' || out.front() == '\r')) out.remove_prefix(1);
+    while (!out.empty() && (out.back()  == ' ' || out.back()  == '\r')) out.remove_suffix(1);
+    return true;
+}
+
+static int add_column(gt_table* t, const char* name, size_t n, const std::function<void(size_t, std::string&)>& put)
+{
+    if (!t || !name || !*name) return fail(GT_EINVAL, "gt_table_add: null table or empty column name");
+    if (strpbrk(name, "\t\n ")) return fail(GT_EINVAL, std::string("gt_table_add: bad column name: ") + name);
+    const bool first = t->header.empty();
+    if (first) t->lines.assign(n, std::string());
+    else if (n != t->lines.size())
+        return fail(GT_EINVAL, "gt_table_add: column " + std::string(name) + " has " + std::to_string(n) +
+                               " rows, table has " + std::to_string(t->lines.size()));
+    for (size_t i = 0; i < n; ++i) {
+        if (!first) t->lines[i].push_back('\t');
+        put(i, t->lines[i]);
+    }
+    t->header.push_back(name);
+    return GT_OK;
+}
+
+static std::string table_text(const gt_table& t)
+{
+    size_t bytes = 1;
+    for (const auto& h : t.header) bytes += h.size() + 1;
+    for (const auto& l : t.lines)  bytes += l.size() + 1;
+
+    std::string s;
+    s.reserve(bytes);
+    for (size_t j = 0; j < t.header.size(); ++j) {
+        if (j) s.push_back('\t');
+        s += t.header[j];
+    }
+    s.push_back('\n');
+    for (const auto& l : t.lines) { s += l; s.push_back('\n'); }
+    return s;
+}
+
+// header_from：无 header 的输出（.unmatch 为原始输入行）沿用该 header
+static void read_table(const std::string& path, gt_table& t, const gt_table* header_from = nullptr)
+{
+    LineReader reader(path);
+    std::string line;
+    if (header_from) t.header = header_from->header;
+    else if (reader.getline(line)) t.header = split(line);
+    while (reader.getline(line)) {
+        if (line.empty()) continue;
+        t.lines.push_back(std::move(line));
+    }
+}
+
+// ---------------- 命令 ----------------
+static void dispatch(const std::string& cmd, int argc, char** argv)
+{
+    if      (cmd == "rsidImpu")    process_rsidImpu(parse_args_rsidimpu(argc, argv));
+    else if (cmd == "convert")     run_convert(parse_args_convert(argc, argv));
+    else if (cmd == "or2beta")     run_or2beta(parse_args_or2beta(argc, argv));
+    else if (cmd == "computeNeff") run_computeNeff(parse_args_calneff(argc, argv));
+    else                           run_pipeline(parse_args_pipeline(argc, argv));
+}
+
+static int run_command(const char* cmd, const gt_table* in, const char* const* options, gt_result** out)
+{
+    if (out) *out = nullptr;
+    if (!in || !out) return fail(GT_EINVAL, std::string(cmd) + ": null table or result pointer");
+
+    std::lock_guard<std::mutex> lock(g_api_mutex);
+    g_last_error.clear();
+
+    const std::string base     = "mem://gt" + std::to_string(++g_call_id) + "/";
+    const std::string in_path  = base + "in";
+    const std::string out_path = base + "out";
+
+    std::vector<std::string> args = {cmd, "--gwas-summary", in_path, "--out", out_path};
+    std::string log_file;
+    for (const char* const* o = options; o && *o; ++o) {
+        args.push_back(*o);
+        if ((args.back() == "--gwas-summary" || args.back() == "--out" || args.back() == "--gwas-list"))
+            return fail(GT_EINVAL, std::string(cmd) + ": " + args.back() + " is supplied by the library");
+    }
+    for (size_t i = 5; i + 1 < args.size(); ++i) {
+        if (args[i] == "--log") log_file = args[i + 1];
+#ifdef _OPENMP
+        if (args[i] == "--threads") omp_set_num_threads(std::max(1, atoi(args[i + 1].c_str())));
+#endif
+    }
+
+    std::vector<char*> argv;
+    for (auto& a : args) argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+
+    memio_put(in_path, table_text(*in));
+
+    std::ofstream log_ofs;
+    if (!log_file.empty()) {
+        log_ofs.open(log_file);
+        if (log_ofs) g_log = &log_ofs;
+    }
+
+    int rc = guarded([&] { dispatch(cmd, (int)args.size(), argv.data()); });
+
+    gt_result* r = nullptr;
+    if (rc == GT_OK) {
+        r = new gt_result;
+        rc = guarded([&] {
+            for (const auto& path : memio_list(out_path)) {
+                std::string name = path == out_path ? "out" : path.substr(out_path.size() + 1);
+                bool unmatch = name.size() >= 7 && name.compare(name.size() - 7, 7, "unmatch") == 0;
+                r->names.push_back(name);
+                r->tables.emplace_back();
+                read_table(path, r->tables.back(), unmatch ? in : nullptr);
+            }
+        });
+        if (rc != GT_OK) { delete r; r = nullptr; }
+    }
+
+    memio_erase_prefix(base);
+    if (g_log == &log_ofs) g_log = nullptr;
+
+    *out = r;
+    return rc;
+}
+
+// =======================================================
+// C API
+// =======================================================
+extern "C" {
+
+int gt_api_version(void) { return GT_API_VERSION; }
+
+const char* gt_last_error(void) { return g_last_error.c_str(); }
+
+void gt_set_threads(int n)
+{
+#ifdef _OPENMP
+    if (n > 0) omp_set_num_threads(n);
+#else
+    (void)n;
+#endif
+}
+
+void gt_set_verbose(int on) { g_log_to_console = on != 0; }
+
+// ---------------- tables ----------------
+gt_table* gt_table_new(void) { return new gt_table; }
+
+gt_table* gt_table_read(const char* path)
+{
+    if (!path) { fail(GT_EINVAL, "gt_table_read: null path"); return nullptr; }
+    gt_table* t = new gt_table;
+    if (guarded([&] { read_table(path, *t); }) != GT_OK) { delete t; return nullptr; }
+    return t;
+}
+
+void gt_table_free(gt_table* t) { delete t; }
+
+int gt_table_add_f64(gt_table* t, const char* name, const double* v, size_t n)
+{
+    if (n && !v) return fail(GT_EINVAL, "gt_table_add_f64: null data");
+    return add_column(t, name, n, [&](size_t i, std::string& s) {
+        if (!std::isfinite(v[i])) { s += std::isnan(v[i]) ? "NA" : (v[i] > 0 ? "inf" : "-inf"); return; }
+        char buf[32];
+        auto res = std::to_chars(buf, buf + sizeof buf, v[i]);   // 最短可还原表示
+        s.append(buf, res.ptr);
+    });
+}
+
+int gt_table_add_i64(gt_table* t, const char* name, const int64_t* v, size_t n)
+{
+    if (n && !v) return fail(GT_EINVAL, "gt_table_add_i64: null data");
+    return add_column(t, name, n, [&](size_t i, std::string& s) {
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof buf, v[i]);
+        s.append(buf, res.ptr);
+    });
+}
+
+int gt_table_add_str(gt_table* t, const char* name, const char* const* v, size_t n)
+{
+    if (n && !v) return fail(GT_EINVAL, "gt_table_add_str: null data");
+    for (size_t i = 0; i < n; ++i)
+        if (v[i] && strpbrk(v[i], "\t\n"))
+            return fail(GT_EINVAL, "gt_table_add_str: tab or newline in column " + std::string(name ? name : "") +
+                                   ", row " + std::to_string(i));
+    return add_column(t, name, n, [&](size_t i, std::string& s) { s += v[i] ? v[i] : "NA"; });
+}
+
+size_t gt_table_nrows(const gt_table* t) { return t ? t->lines.size() : 0; }
+size_t gt_table_ncols(const gt_table* t) { return t ? t->header.size() : 0; }
+
+const char* gt_table_colname(const gt_table* t, size_t col)
+{
+    return (t && col < t->header.size()) ? t->header[col].c_str() : nullptr;
+}
+
+int gt_table_find(const gt_table* t, const char* name)
+{
+    return (t && name) ? find_col(t->header, name) : -1;
+}
+
+int gt_table_get_f64(const gt_table* t, size_t col, double* out)
+{
+    if (!t || !out) return fail(GT_EINVAL, "gt_table_get_f64: null table or output");
+    if (col >= t->header.size()) return fail(GT_EINVAL, "gt_table_get_f64: column out of range");
+    for (size_t i = 0; i < t->lines.size(); ++i) {
+        std::string_view c;
+        double x = NAN;
+        if (cell_span(t->lines[i], col, c)) {
+            auto res = std::from_chars(c.data(), c.data() + c.size(), x);
+            if (res.ec != std::errc() || res.ptr != c.data() + c.size()) x = NAN;
+        }
+        out[i] = x;
+    }
+    return GT_OK;
+}
+
+const char* gt_table_get_str(const gt_table* t, size_t row, size_t col, size_t* len)
+{
+    if (len) *len = 0;
+    if (!t || row >= t->lines.size() || col >= t->header.size()) return nullptr;
+    std::string_view c;
+    if (!cell_span(t->lines[row], col, c)) return nullptr;
+    if (len) *len = c.size();
+    return c.data();
+}
+
+// ---------------- commands ----------------
+int gt_rsid_impu(const gt_table* g, const char* const* o, gt_result** r)    { return run_command("rsidImpu", g, o, r); }
+int gt_convert(const gt_table* g, const char* const* o, gt_result** r)      { return run_command("convert", g, o, r); }
+int gt_or2beta(const gt_table* g, const char* const* o, gt_result** r)      { return run_command("or2beta", g, o, r); }
+int gt_compute_neff(const gt_table* g, const char* const* o, gt_result** r) { return run_command("computeNeff", g, o, r); }
+int gt_pipeline(const gt_table* g, const char* const* o, gt_result** r)     { return run_command("pipeline", g, o, r); }
+
+size_t gt_result_count(const gt_result* r) { return r ? r->tables.size() : 0; }
+
+const char* gt_result_name(const gt_result* r, size_t i)
+{
+    return (r && i < r->names.size()) ? r->names[i].c_str() : nullptr;
+}
+
+const gt_table* gt_result_table(const gt_result* r, size_t i)
+{
+    return (r && i < r->tables.size()) ? &r->tables[i] : nullptr;
+}
+
+const gt_table* gt_result_get(const gt_result* r, const char* name)
+{
+    if (!r || !name) return nullptr;
+    for (size_t i = 0; i < r->names.size(); ++i)
+        if (r->names[i] == name) return &r->tables[i];
+    return nullptr;
+}
+
+void gt_result_free(gt_result* r) { delete r; }
+
+// ---------------- QC / formats ----------------
+int gt_basic_qc(const gt_table* t, const char* beta, const char* se, const char* freq,
+                const char* p, const char* n, double maf, uint8_t* keep)
+{
+    if (!t || !keep) return fail(GT_EINVAL, "gt_basic_qc: null table or keep");
+    auto idx = [&](const char* c) { return c ? find_col(t->header, c) : -1; };
+    std::lock_guard<std::mutex> lock(g_api_mutex);
+    return guarded([&] {
+        std::vector<bool> k(t->lines.size(), true);
+        // gwas_basic_qc 只读 lines（签名沿用可变引用）
+        gwas_basic_qc(const_cast<std::vector<std::string>&>(t->lines), t->header,
+                      idx(beta), idx(se), idx(freq), idx(p), idx(n), k, maf);
+        for (size_t i = 0; i < k.size(); ++i) keep[i] = k[i];
+    });
+}
+
+int gt_remove_dup(const gt_table* t, const char* snp, const char* p, uint8_t* keep)
+{
+    if (!t || !snp || !keep) return fail(GT_EINVAL, "gt_remove_dup: null table, SNP column or keep");
+    int idx_snp = find_col(t->header, snp);
+    if (idx_snp < 0) return fail(GT_ERROR, std::string("gt_remove_dup: no column ") + snp);
+    int idx_p = p ? find_col(t->header, p) : -1;
+
+    std::lock_guard<std::mutex> lock(g_api_mutex);
+    return guarded([&] {
+        const size_t n = t->lines.size();
+        std::vector<bool> k(n);
+        std::vector<std::string> snp_vec(n);
+        for (size_t i = 0; i < n; ++i) {
+            k[i] = keep[i] != 0;
+            std::string_view c;
+            if (k[i] && cell_span(t->lines[i], (size_t)idx_snp, c)) snp_vec[i].assign(c.data(), c.size());
+        }
+        gwas_remove_dup(const_cast<std::vector<std::string>&>(t->lines), t->header, idx_p, snp_vec, k);
+        for (size_t i = 0; i < n; ++i) keep[i] = k[i];
+    });
+}
+
+const char* gt_format_columns(const char* format)
+{
+    static thread_local std::string cols;
+    if (!format) return nullptr;
+    FormatEngine FE;
+    try {
+        FormatSpec spec = FE.get_format(format);
+        cols.clear();
+        for (size_t j = 0; j < spec.cols.size(); ++j) {
+            if (j) cols.push_back('\t');
+            cols += spec.cols[j];
+        }
+        return cols.c_str();
+    } catch (const std::exception& e) {
+        fail(GT_EINVAL, e.what());
+        return nullptr;
+    }
+}
+
+}   // extern "C"
@@ -0,0 +1,107 @@
+/*
+ *  gwastoolkit.h
+ *  GWAStoolkit
+ *  Created by Lulu Shi on 18/10/2026.
+ *  Copyright © 2026 Lulu Shi. All rights reserved.
+ *
+ *  C API of libgwastoolkit.so: run rsidImpu / convert / or2beta / computeNeff /
+ *  pipeline in-process on in-memory tables (no temporary files, no process start).
+ *
+ *  - A gt_table is a GWAS table: column names + rows. Build one from column
+ *    buffers (gt_table_add_*) or read one from disk (gt_table_read).
+ *  - Commands take the same options as the command line, as a NULL-terminated
+ *    array of strings ({"--format", "cojo", "--maf", "0.05", NULL}).
+ *    --gwas-summary and --out are supplied by the library.
+ *  - Every output file the command would write becomes a named table in the
+ *    gt_result: "out" (main output), "unmatch" (rsidImpu), or the format name
+ *    when --format lists several ("cojo", "smr", ...).
+ *  - Functions returning int return GT_OK (0) on success; on failure
+ *    gt_last_error() describes the problem. The process is never terminated.
+ *  - Calls are serialized internally (one command runs at a time); each command
+ *    itself is multi-threaded (gt_set_threads / --threads).
+ */
+
+#ifndef GWASTOOLKIT_H
+#define GWASTOOLKIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define GT_API __attribute__((visibility("default")))
+#else
+#define GT_API
+#endif
+
+#define GT_API_VERSION 1
+
+enum {
+    GT_OK     = 0,
+    GT_ERROR  = 1,   /* command failed (bad input / options / I/O) */
+    GT_EINVAL = 2    /* bad argument to the C API itself */
+};
+
+typedef struct gt_table  gt_table;
+typedef struct gt_result gt_result;
+
+/* ---------------- library ---------------- */
+GT_API int         gt_api_version(void);
+GT_API const char* gt_last_error(void);          /* valid until the next call */
+GT_API void        gt_set_threads(int n);        /* OpenMP threads, default: all */
+GT_API void        gt_set_verbose(int on);       /* [INFO]/[WARN] to stdout; default off */
+
+/* ---------------- tables ---------------- */
+GT_API gt_table* gt_table_new(void);
+GT_API gt_table* gt_table_read(const char* path);           /* txt / gz / zst / arrow; NULL on error */
+GT_API void      gt_table_free(gt_table* t);
+
+/* Append a column. The first column fixes the row count; later ones must match.
+ * NaN (f64) and NULL (str) are written as NA. */
+GT_API int gt_table_add_f64(gt_table* t, const char* name, const double* v, size_t n);
+GT_API int gt_table_add_i64(gt_table* t, const char* name, const int64_t* v, size_t n);
+GT_API int gt_table_add_str(gt_table* t, const char* name, const char* const* v, size_t n);
+
+GT_API size_t      gt_table_nrows(const gt_table* t);
+GT_API size_t      gt_table_ncols(const gt_table* t);
+GT_API const char* gt_table_colname(const gt_table* t, size_t col);
+GT_API int         gt_table_find(const gt_table* t, const char* name);   /* -1 if absent */
+
+/* Whole column as doubles (out has nrows slots); NA / non-numeric -> NaN */
+GT_API int gt_table_get_f64(const gt_table* t, size_t col, double* out);
+/* One cell; not NUL-terminated, *len receives the length. NULL if out of range. */
+GT_API const char* gt_table_get_str(const gt_table* t, size_t row, size_t col, size_t* len);
+
+/* ---------------- commands ---------------- */
+GT_API int gt_rsid_impu   (const gt_table* gwas, const char* const* options, gt_result** out);
+GT_API int gt_convert     (const gt_table* gwas, const char* const* options, gt_result** out);
+GT_API int gt_or2beta     (const gt_table* gwas, const char* const* options, gt_result** out);
+GT_API int gt_compute_neff(const gt_table* gwas, const char* const* options, gt_result** out);
+GT_API int gt_pipeline    (const gt_table* gwas, const char* const* options, gt_result** out);
+
+GT_API size_t          gt_result_count(const gt_result* r);
+GT_API const char*     gt_result_name(const gt_result* r, size_t i);
+GT_API const gt_table* gt_result_table(const gt_result* r, size_t i);
+GT_API const gt_table* gt_result_get(const gt_result* r, const char* name);   /* NULL if absent */
+GT_API void            gt_result_free(gt_result* r);
+
+/* ---------------- QC / formats ---------------- */
+/* Basic QC (same rules as every command): keep[i] = 1 if row i passes.
+ * Column names may be NULL to skip that check. */
+GT_API int gt_basic_qc(const gt_table* t, const char* beta, const char* se, const char* freq,
+                       const char* p, const char* n, double maf, uint8_t* keep);
+/* Duplicate SNPs: clears keep[i] for all but the smallest-P row of each SNP
+ * (p may be NULL: keep the first). Rows with keep[i] == 0 are ignored. */
+GT_API int gt_remove_dup(const gt_table* t, const char* snp, const char* p, uint8_t* keep);
+
+/* Column names of an output format, tab-separated ("SNP\tA1\tA2..."); NULL if unknown */
+GT_API const char* gt_format_columns(const char* format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,9 +2,18 @@
 #include "utils/log.hpp"
 #include "utils/gadgets.hpp"
 #include "computeNeff/computeNeff.hpp"
+#include "batch/batch.hpp"
 
 int cmd_computeNeff(int argc, char* argv[])
 {
+    if (batch_requested(argc, argv)) {
+        LOG_INFO("Running computeNeff --batch ...");
+        return run_batch("computeNeff", argc, argv, [](int ac, char* av[]) -> std::function<void()> {
+            Args_CalNeff P = parse_args_calneff(ac, av);
+            return [P] { run_computeNeff(P); };
+        });
+    }
+
     Args_CalNeff P = parse_args_calneff(argc, argv);
 
     Gadget::Timer timer;
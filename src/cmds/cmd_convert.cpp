@@ -2,8 +2,17 @@
 #include "utils/log.hpp"
 #include "utils/gadgets.hpp"
 #include "convert/convert.hpp"
+#include "batch/batch.hpp"
 
 int cmd_convert(int argc, char* argv[]){
+    if (batch_requested(argc, argv)) {
+        LOG_INFO("Running convert --batch ...");
+        return run_batch("convert", argc, argv, [](int ac, char* av[]) -> std::function<void()> {
+            Args_Convert P = parse_args_convert(ac, av);
+            return [P] { run_convert(P); };
+        });
+    }
+
     Args_Convert P = parse_args_convert(argc, argv);
 
     Gadget::Timer timer;
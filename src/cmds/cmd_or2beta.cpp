@@ -2,9 +2,18 @@
 #include "utils/log.hpp"
 #include "utils/gadgets.hpp"
 #include "or2beta/or2beta.hpp"
+#include "batch/batch.hpp"
 
 int cmd_or2beta(int argc, char* argv[]) {
 
+    if (batch_requested(argc, argv)) {
+        LOG_INFO("Running or2beta --batch ...");
+        return run_batch("or2beta", argc, argv, [](int ac, char* av[]) -> std::function<void()> {
+            Args_Or2Beta P = parse_args_or2beta(ac, av);
+            return [P] { run_or2beta(P); };
+        });
+    }
+
     Args_Or2Beta P = parse_args_or2beta(argc, argv);
 
     Gadget::Timer timer;
@@ -0,0 +1,27 @@
+#include "utils/args.hpp"
+#include "utils/log.hpp"
+#include "utils/gadgets.hpp"
+#include "pipeline/pipeline.hpp"
+#include "batch/batch.hpp"
+
+int cmd_pipeline(int argc, char* argv[])
+{
+    if (batch_requested(argc, argv)) {
+        LOG_INFO("Running pipeline --batch ...");
+        return run_batch("pipeline", argc, argv, [](int ac, char* av[]) -> std::function<void()> {
+            Args_Pipeline P = parse_args_pipeline(ac, av);
+            return [P] { run_pipeline(P); };
+        });
+    }
+
+    Args_Pipeline P = parse_args_pipeline(argc, argv);
+
+    Gadget::Timer timer;
+    timer.setTime();
+
+    LOG_INFO("Running pipeline ...");
+    run_pipeline(P);
+    LOG_INFO("pipeline finished.");
+
+    return 0;
+}
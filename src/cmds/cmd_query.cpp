@@ -0,0 +1,15 @@
+#include "utils/args.hpp"
+#include "utils/log.hpp"
+#include "utils/gadgets.hpp"
+#include "query/query.hpp"
+
+int cmd_query(int argc, char* argv[])
+{
+    Args_Query P = parse_args_query(argc, argv);
+
+    LOG_INFO("Running query ...");
+    run_query(P);
+    LOG_INFO("query finished.");
+
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include "utils/args.hpp"
+#include "utils/log.hpp"
+#include "utils/gadgets.hpp"
+#include "serve/serve.hpp"
+
+int cmd_serve(int argc, char* argv[])
+{
+    Args_Serve P = parse_args_serve(argc, argv);
+
+    LOG_INFO("Running serve ...");
+    run_serve(P);
+    LOG_INFO("serve stopped.");
+
+    return 0;
+}
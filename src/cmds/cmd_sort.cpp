@@ -0,0 +1,15 @@
+#include "utils/args.hpp"
+#include "utils/log.hpp"
+#include "utils/gadgets.hpp"
+#include "sort/sort.hpp"
+
+int cmd_sort(int argc, char* argv[])
+{
+    Args_Sort P = parse_args_sort(argc, argv);
+
+    LOG_INFO("Running sort ...");
+    run_sort(P);
+    LOG_INFO("sort finished.");
+
+    return 0;
+}
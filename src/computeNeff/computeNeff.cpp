@@ -7,6 +7,10 @@
 #include "utils/FormatEngine.hpp"
 #include "utils/gadgets.hpp"
 #include "utils/gwasQC.hpp"
+#include "utils/gwascache.hpp"
+#include "utils/dryrun.hpp"
+#include "utils/rowfilter.hpp"
+#include "utils/rowtransform.hpp"
 
 #include <vector>
 #include <string>
@@ -17,8 +21,6 @@
 #include <deque>
 #include <string_view>
 #include <limits>
-#include <cstdlib>   // strtod
-#include <cerrno>    // errno
 
 using namespace std;
 // =======================================================
@@ -68,22 +70,6 @@ static inline int scan_to_stop_col(
     return col;
 }
 
-// [OPT-SHARED-2] 严格 double 解析（不抛异常，比 stod 稳；并做“整串消费”校验）
-static inline bool parse_double_strict(std::string_view sv, double &out){
-    sv = trim_ws(sv);
-    if (sv.empty()) return false;
-
-    errno = 0;
-    char *end = nullptr;
-    out = std::strtod(sv.data(), &end);
-
-    if (end == sv.data()) return false; // 无法解析
-    if ((const char*)end != sv.data() + sv.size()) return false; // [FIX] 必须整串消费，避免 "1abc"
-    if (errno == ERANGE) return false;
-    if (!std::isfinite(out)) return false;
-    return true;
-}
-
 // [OPT-SHARED-3] 预计算某列的 [start,len]（用于原地替换，不 split）
 // 成功返回 true；失败返回 false（行列不够）
 static inline bool get_col_span(std::string_view line, int col_idx, uint32_t &st, uint32_t &len){
@@ -102,37 +88,19 @@ static inline bool get_col_span(std::string_view line, int col_idx, uint32_t &st
 }
 
 
-// Neff
-static inline double calc_neff(double cs, double ct){
-    double s = cs + ct;
-    if (s <= 0) return 0;
-    return 4.0 * cs * ct / s;
-}
-
-// standardization of beta and se
-static inline bool std_effect(
-    double freq, double beta_old, double se_old, double Neff,
-    double &beta_new, double &se_new
-) {
-    if (freq <= 0.0 || freq >= 1.0) return false;
-    if (se_old <= 0.0) return false;
-    if (!std::isfinite(Neff) || Neff <= 0.0) return false;
-
-    double z = beta_old / se_old;
-    double denom = 2.0 * freq * (1.0-freq) * (Neff + z*z);
-    if (denom <= 0.0) return false;
-
-    se_new   = 1.0 / sqrt(denom);
-    beta_new = z * se_new;
-    return true;
-}
-
 void run_computeNeff(const Args_CalNeff& P)
 {
+    if (P.dry_run) {
+        dry_run_table(P, "computeNeff", [](const Args_CalNeff& Q){ run_computeNeff(Q); });
+        return;
+    }
+
+    RowFilter rf(P);
 
     FormatEngine FE;
     FormatSpec spec = FE.get_format(P.format);
-    Writer fout(P.out_file, P.format);
+    Writer fout(P.out_file, P.format, P.split_by_chr);
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
 
     if (!fout.good()){
         LOG_ERROR("Cannot open output: " + P.out_file);
@@ -140,13 +108,13 @@ void run_computeNeff(const Args_CalNeff& P)
     }
 
     // header
-    LineReader reader(P.gwas_file);
+    // 读入 header + 全部数据行（--cache-dir 命中时直接还原快照）
     std::string line;
-    if (!reader.getline(line)) {
+    std::vector<std::string> lines;
+    if (!read_gwas_table(P.gwas_file, P.cache_dir, line, lines)) {
         LOG_ERROR("Empty GWAS file: " + P.gwas_file);
-        exit(1);
+        die(1);
     }
-    strip_cr_inplace(line);
     auto header = split(line);
 
     bool has_N = false;
@@ -188,27 +156,19 @@ void run_computeNeff(const Args_CalNeff& P)
     int idx_case    = -1;
     int idx_control = -1;
 
-    // 读入所有数据行
-    std::vector<std::string> lines;
-    lines.reserve(1 << 20);
-    std::vector<std::pair<uint32_t,uint32_t>> n_span;
-
-    if (P.format == "gwas" && has_N) n_span.reserve(1 << 20);
-
-    while (reader.getline(line)){
-        if (line.empty()) continue;
-        strip_cr_inplace(line);
-        lines.push_back(line);
+    size_t n = lines.size();
 
-        // 预计算 N 列 span（避免后面 split 重建整行）
-        if (P.format == "gwas" && has_N) {
+    // 预计算 N 列 span（避免后面 split 重建整行）
+    std::vector<std::pair<uint32_t,uint32_t>> n_span;
+    if (P.format == "gwas" && has_N) {
+        n_span.reserve(n);
+        for (const auto& l : lines) {
             uint32_t st=0, len=0;
-            bool ok = get_col_span(std::string_view(lines.back()), idx_N, st, len);
+            bool ok = get_col_span(std::string_view(l), idx_N, st, len);
             if (!ok) { st = std::numeric_limits<uint32_t>::max(); len = 0; }
             n_span.emplace_back(st, len);
         }
     }
-    size_t n = lines.size();
     LOG_INFO("Loaded " + to_string(n) + " GWAS lines for computeNeff.");
 
     // -------------------------
@@ -219,11 +179,11 @@ void run_computeNeff(const Args_CalNeff& P)
         idx_control = find_col(header, P.control_col);
         if (idx_case < 0) {
             LOG_ERROR("Cannot find case column: " + P.case_col);
-            exit(1);
+            die(1);
         }
         if (idx_control < 0) {
             LOG_ERROR("Cannot find control column: " + P.control_col);
-            exit(1);
+            die(1);
         }
     }
 
@@ -232,25 +192,27 @@ void run_computeNeff(const Args_CalNeff& P)
     // -------------------------
     double Neff_fixed = std::numeric_limits<double>::quiet_NaN();
     if (P.is_single){
-        Neff_fixed = calc_neff(P.case_n, P.control_n);
+        Neff_fixed = RowTransform::calc_neff(P.case_n, P.control_n);
         if (!std::isfinite(Neff_fixed) || Neff_fixed <= 0.0){
             LOG_ERROR("Invalid fixed case/control: " + 
                 std::to_string(P.case_n) + "," + std::to_string(P.control_n));
-            exit(1);
+            die(1);
         }
         LOG_INFO("Fixed-mode Neff = " + std::to_string(Neff_fixed));
 
     }
 
-    //================ QC + 去重 (按 SNP) ================
+    //================ 行过滤 + QC + 去重 (按 SNP) ================
     std::vector<bool> keep(n, true);
+    rf.bind(header, P);
+    rf.apply(lines, keep);
     
     bool can_qc = (idx_beta>=0 || idx_se>=0 || idx_freq>=0 || idx_p>=0);
     if (can_qc){
         int idx_n_safe = (has_N ? idx_N : -1); 
         
         LOG_INFO("QC applied in partial-column mode.");
-        gwas_basic_qc(lines, header,
+        gwas_basic_qc_cached(P.gwas_file, P.cache_dir, lines, header,
                     idx_beta, idx_se, idx_freq, idx_p, idx_n_safe,
                     keep, P.maf_threshold);
     } else {
@@ -306,6 +268,14 @@ void run_computeNeff(const Args_CalNeff& P)
     int stop_full = std::max({idx_snp, idx_A1, idx_A2, idx_freq, idx_beta, idx_se, idx_p});
     if (P.is_column) stop_full = std::max({stop_full, idx_case, idx_control});
 
+    // arrow 输出带 CHR/POS：只在需要时扫描；--split-by-chr 按 CHR 分发
+    int idx_chr = spec.needs_chrpos || P.split_by_chr ? find_col(header, P.g_chr) : -1;
+    int idx_pos = spec.needs_chrpos ? find_col(header, P.g_pos) : -1;
+    require(!P.split_by_chr || idx_chr >= 0, "--split-by-chr needs the CHR column [" + P.g_chr + "].");
+    stop_full = std::max({stop_full, idx_chr, idx_pos});
+    std::vector<int> chr2slot(P.split_by_chr ? idx_chr + 1 : 0, -1);
+    if (P.split_by_chr) chr2slot[idx_chr] = 0;
+
     // 为两种 stop 准备 col2slot（减少每行构造开销）
     // --- minimal slots: SNP, CASE, CONTROL ---
     std::vector<int> col2slot_min(stop_min + 1, -1);
@@ -316,9 +286,9 @@ void run_computeNeff(const Args_CalNeff& P)
         col2slot_min[idx_control] = 2;
     }
 
-    // --- full slots: SNP,A1,A2,freq,beta,se,p,CASE,CONTROL ---
+    // --- full slots: SNP,A1,A2,freq,beta,se,p,CASE,CONTROL,CHR,POS ---
     std::vector<int> col2slot_full(stop_full + 1, -1);
-    // slot: 0=SNP,1=A1,2=A2,3=freq,4=beta,5=se,6=p,7=CASE,8=CONTROL
+    // slot: 0=SNP,1=A1,2=A2,3=freq,4=beta,5=se,6=p,7=CASE,8=CONTROL,9=CHR,10=POS
     col2slot_full[idx_snp]  = 0;
     col2slot_full[idx_A1]   = 1;
     col2slot_full[idx_A2]   = 2;
@@ -330,6 +300,8 @@ void run_computeNeff(const Args_CalNeff& P)
         col2slot_full[idx_case] = 7;
         col2slot_full[idx_control] = 8;
     }
+    if (idx_chr >= 0) col2slot_full[idx_chr] = 9;
+    if (idx_pos >= 0) col2slot_full[idx_pos] = 10;
 
     for (size_t i=0; i<n; i++){
         if (!keep[i]) continue;
@@ -345,13 +317,16 @@ void run_computeNeff(const Args_CalNeff& P)
             int cols = scan_to_stop_col(std::string_view(ln), stop_min, col2slot_min, outs_min, 3);
             if (cols < stop_min + 1) continue;
 
-            double cs=0.0, ct=0.0;
-            if (!parse_double_strict(outs_min[1], cs)) continue;
-            if (!parse_double_strict(outs_min[2], ct)) continue;
-            Neff = calc_neff(cs, ct);
+            Neff = RowTransform::neff_from_counts(outs_min[1], outs_min[2]);
         }
 
         if (!std::isfinite(Neff) || Neff <= 0.0) continue;
+
+        if (P.split_by_chr) {
+            std::string_view c[1] = {};
+            scan_to_stop_col(std::string_view(ln), idx_chr, chr2slot, c, 1);
+            fout.select_chr(canonical_chr_code_sv(trim_ws(c[0])));
+        }
         
         // ----------- gwas 输出：原地替换/追加 N（不 split） -----------
         if (P.format == "gwas"){
@@ -380,29 +355,18 @@ void run_computeNeff(const Args_CalNeff& P)
         }
 
         // ----------- 非 gwas 输出：需要更多字段（SNP/A1/A2/freq/beta/se/p） -----------
-        std::string_view outs[9] = {};
-        int cols = scan_to_stop_col(std::string_view(ln), stop_full, col2slot_full, outs, 9);
+        std::string_view outs[11] = {};
+        int cols = scan_to_stop_col(std::string_view(ln), stop_full, col2slot_full, outs, 11);
         if (cols < stop_full + 1) continue;
 
         auto vSNP = trim_ws(outs[0]);
         if (vSNP.empty()) continue;
 
-        // 标准化 beta/se（若失败则保留旧值）
-        double freq_old=0, beta_old=0, se_old=0;
-        if (!parse_double_strict(outs[3], freq_old)) continue;
-        if (!parse_double_strict(outs[4], beta_old)) continue;
-        if (!parse_double_strict(outs[5], se_old))   continue;
-
-        std::string beta_str, se_str, neff_str;
-        neff_str = std::to_string(Neff);
-
-        double beta_new=0, se_new=0;
-        bool ok_std = std_effect(freq_old, beta_old, se_old, Neff, beta_new, se_new);
-
-        if (ok_std){
-            beta_str = std::to_string(beta_new);
-            se_str   = std::to_string(se_new);
-        }
+        // 标准化 beta/se（若失败则保留旧值；与 pipeline 共用 RowTransform）
+        std::string beta_str, se_str;
+        if (!RowTransform::neff_std(outs[3], outs[4], outs[5], Neff, beta_str, se_str)) continue;
+        bool ok_std = !beta_str.empty();
+        std::string neff_str = std::to_string(Neff);
 
         FormatEngine::RowView row;                       // 新版 FormatEngine
         row.SNP  = {vSNP, true};
@@ -420,7 +384,12 @@ void run_computeNeff(const Args_CalNeff& P)
 
         row.p = {trim_ws(outs[6]), true};
         row.N = {std::string_view(neff_str), true};
+        row.CHR = {trim_ws(outs[9]),  spec.needs_chrpos && idx_chr >= 0};
+        row.POS = {trim_ws(outs[10]), idx_pos >= 0};
 
-        fout.write_line(FE.format_line_fast(spec, row));  // fast path
+        char zbuf[32];
+        if (spec.needs_z) FormatEngine::fill_z(row, zbuf, sizeof zbuf);   // ldsc
+        FE.append_line_fast(spec, row, fout.buffer());   // fast path：直接进 Writer 缓冲
+        fout.flush_if_full();
     }
 }
\ No newline at end of file
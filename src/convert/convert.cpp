@@ -5,7 +5,12 @@
 #include "utils/util.hpp"
 #include "utils/log.hpp"
 #include "utils/gwasQC.hpp"
+#include "utils/gwascache.hpp"
+#include "utils/dryrun.hpp"
+#include "utils/rowfilter.hpp"
+#include "utils/parallel.hpp"
 #include "utils/FormatEngine.hpp"
+#include "utils/StatFunc.hpp"
 
 #include <unordered_map>
 #include <string>
@@ -17,6 +22,7 @@
 #include <cerrno>    // errno
 #include <cmath>     // isfinite, log, fabs
 #include <limits>
+#include <memory>
 
 using namespace std;
 
@@ -102,15 +108,20 @@ static inline bool get_col_span(std::string_view line, int col_idx, uint32_t &st
 
 
 void run_convert(const Args_Convert& P){
-    LineReader lr(P.gwas_file);
-    string line;
+    if (P.dry_run) {
+        dry_run_table(P, "convert", [](const Args_Convert& Q){ run_convert(Q); });
+        return;
+    }
 
-    // read header
-    if (!lr.getline(line)){
+    RowFilter rf(P);
+
+    // 读入 header + 全部数据行（--cache-dir 命中时直接还原快照）
+    string line;
+    std::vector<std::string> lines;
+    if (!read_gwas_table(P.gwas_file, P.cache_dir, line, lines)){
         LOG_ERROR("Empty GWAS summary file in convert.");
-        exit(1);
+        die(1);
     }
-    strip_cr_inplace(line);     //读入时就去 '\r'
     auto header = split(line);
     
     // header check
@@ -138,25 +149,21 @@ void run_convert(const Args_Convert& P){
     int idx_n    = find_col(header, P.col_n);
     require(idx_n >= 0, "GWAS missing required column [" + P.col_n + "] for convert.");
 
-    // read all line
-    std::vector<std::string> lines;
-    line.reserve(1 << 20);           // 减少扩容
-    while (lr.getline(line)) {
-        if (line.empty()) continue;
-        strip_cr_inplace(line);    // 读入时去 '\r'
-        lines.push_back(line);
-    }
     size_t n = lines.size();
     LOG_INFO("Loaded GWAS lines for convert: " + to_string(n));
 
-    // QC, default maf = 0.01
+    // 行过滤（--extract / --region）先于 QC：被拒的行后面全部跳过
     std::vector<bool> keep(n, true);
+    rf.bind(header, P);
+    rf.apply(lines, keep);
+
+    // QC, default maf = 0.01
 
     // 如果列都存在，就执行QC，否则给warning
     bool can_qc = (idx_beta>=0 || idx_se>=0 || idx_freq>=0 || idx_p>=0 || idx_n>=0);
     if (can_qc) {
         LOG_INFO("QC applied in partial-column mode.");
-        gwas_basic_qc(lines, header,
+        gwas_basic_qc_cached(P.gwas_file, P.cache_dir, lines, header,
                     idx_beta, idx_se, idx_freq, idx_p, idx_n,
                     keep, P.maf_threshold);
     } else {
@@ -182,48 +189,62 @@ void run_convert(const Args_Convert& P){
         gwas_remove_dup(lines, header, idx_p, snp_vec, keep);
     }
 
-    // out format
+    // out format：--format 可为列表，每行只解析一次，按各自 spec 渲染到各自的 Writer
     FormatEngine FE;
-    FormatSpec spec = FE.get_format(P.format);
-    Writer fout(P.out_file, P.format);
-
-    if (!fout.good()){
-        LOG_ERROR("Cannot open output file: " + P.out_file);
-        exit(1);
-    }
-
-    // writer header
-    if (P.format == "gwas") {
-        // raw header
-        std::string h;
-        for (size_t i=0; i<header.size(); i++){
-            if (i) h += "\t";
-            h += header[i];
+    const bool multi = P.formats.size() > 1;
+
+    struct FormatOut {
+        std::string fmt;
+        FormatSpec spec;
+        std::unique_ptr<Writer> w;
+        std::string buf;                // 当前块的输出（已含 '\n'，整块交给 Writer）
+    };
+    std::vector<FormatOut> outs;
+    bool need_fields = false;
+    bool need_z      = false;   // ldsc：整块批量算 Z
+    bool need_chrpos = false;   // arrow：带上 CHR/POS（输入有这两列时）
+
+    for (const auto& fmt : P.formats) {
+        FormatOut o;
+        o.fmt  = fmt;
+        o.spec = FE.get_format(fmt);
+        std::string path = multi ? format_out_path(P.out_file, fmt) : P.out_file;
+        o.w.reset(new Writer(path, fmt, P.split_by_chr));
+        if (P.build_index && fmt == "gwas") o.w->enable_index(P.g_chr, P.g_pos);
+        if (!o.w->good()){
+            LOG_ERROR("Cannot open output file: " + path);
+            die(1);
         }
-        fout.write_line(h);
-    } else {
-        string h;
-        for (size_t i=0; i<spec.cols.size(); i++){
-            if (i) h += "\t";
-            h += spec.cols[i];
-        }
-        fout.write_line(h);
-    }
 
-    // write context
-    if (P.format == "gwas") {
-        // gwas 格式直接写原行（不 split）
-        for (size_t i=0; i<n; i++){
-            if (!keep[i]) continue;
-            fout.write_line(lines[i]);
+        // writer header
+        string h;
+        if (fmt == "gwas") {
+            // raw header
+            for (size_t i=0; i<header.size(); i++){
+                if (i) h += "\t";
+                h += header[i];
+            }
+        } else {
+            for (size_t i=0; i<o.spec.cols.size(); i++){
+                if (i) h += "\t";
+                h += o.spec.cols[i];
+            }
+            need_fields = true;
+            need_z = need_z || o.spec.needs_z;
+            need_chrpos = need_chrpos || o.spec.needs_chrpos;
         }
-        LOG_INFO("convert finished (format=" + P.format + ").");
-        return;
+        o.w->write_line(h);
+        if (multi) LOG_INFO("convert output [" + fmt + "]: " + path);
+        outs.push_back(std::move(o));
     }
 
     // 非 gwas：单次扫描取必需列 + FormatEngine fast path
     int stop = std::max({idx_snp, idx_A1, idx_A2, idx_freq, idx_beta, idx_se, idx_p, idx_n});
 
+    int idx_chr = need_chrpos ? find_col(header, P.g_chr) : -1;
+    int idx_pos = need_chrpos ? find_col(header, P.g_pos) : -1;
+    stop = std::max({stop, idx_chr, idx_pos});
+
     std::vector<int> col2slot(stop + 1, -1);
     col2slot[idx_snp]  = 0;
     col2slot[idx_A1]   = 1;
@@ -233,32 +254,109 @@ void run_convert(const Args_Convert& P){
     col2slot[idx_se]   = 5;
     col2slot[idx_p]    = 6;
     col2slot[idx_n]    = 7;
+    if (idx_chr >= 0) col2slot[idx_chr] = 8;
+    if (idx_pos >= 0) col2slot[idx_pos] = 9;
+
+    // --split-by-chr：渲染时顺带取各行 CHR，gwas 输出（原行）与其他格式（row_ok 行）各一张路由表
+    int idx_split = -1;
+    std::vector<int> split2slot;
+    std::vector<int8_t> chr_all, chr_ok;
+    if (P.split_by_chr) {
+        idx_split = find_col(header, P.g_chr);
+        require(idx_split >= 0, "--split-by-chr needs the CHR column [" + P.g_chr + "].");
+        split2slot.assign(idx_split + 1, -1);
+        split2slot[idx_split] = 0;
+    }
 
-    for (size_t i=0; i<n; i++){
-        if (!keep[i]) continue;
-
-        std::string_view outs[8] = {};
-        int cols = scan_to_stop_col(std::string_view(lines[i]), stop, col2slot, outs, 8);
+    // 分块：先解析一块（RowView 只引用 lines），ldsc 时整列批量算 Z，再渲染；
+    // 最后各 Writer 并行写出（gz 压缩各在一个线程）
+    const size_t BLOCK = 1 << 16;
+    const size_t ZW    = 32;                     // 每行 Z 文本的槽宽
+    std::vector<FormatEngine::RowView> rows(need_fields ? BLOCK : 0);
+    std::vector<char> row_ok(BLOCK);
+    std::vector<double> zb, zs, zp, zv;          // 块内 beta / se / p / Z
+    std::vector<char> ztxt;
+    if (need_z) {
+        zb.resize(BLOCK); zs.resize(BLOCK); zp.resize(BLOCK); zv.resize(BLOCK);
+        ztxt.resize(BLOCK * ZW);
+    }
 
-        // 不再用 f.size()==header.size()（会导致多列/少列全丢）
-        // 只要“至少有我们需要的列”即可；行截断则跳过，避免错位风险。
-        if (cols < stop + 1) continue;
+    for (size_t b0 = 0; b0 < n; b0 += BLOCK) {
+        size_t b1 = std::min(n, b0 + BLOCK);
+        for (auto& o : outs) o.buf.clear();
+        chr_all.clear();
+        chr_ok.clear();
+
+        // ---- pass 1：解析 ----
+        if (need_fields) {
+            for (size_t i=b0; i<b1; i++){
+                const size_t r = i - b0;
+                row_ok[r] = 0;
+                if (!keep[i]) continue;
+
+                // 不再用 f.size()==header.size()（会导致多列/少列全丢）
+                // 只要“至少有我们需要的列”即可；行截断则跳过，避免错位风险。
+                std::string_view f[10] = {};
+                int cols = scan_to_stop_col(std::string_view(lines[i]), stop, col2slot, f, 10);
+                auto vSNP = trim_ws(f[0]);
+                row_ok[r] = (cols >= stop + 1) && !vSNP.empty();
+
+                FormatEngine::RowView& row = rows[r];        // 新版 FormatEngine
+                row.SNP  = {vSNP, true};
+                row.A1   = {trim_ws(f[1]), true};
+                row.A2   = {trim_ws(f[2]), true};
+                row.freq = {trim_ws(f[3]), true};
+                row.beta = {trim_ws(f[4]), true};
+                row.se   = {trim_ws(f[5]), true};
+                row.p    = {trim_ws(f[6]), true};
+                row.N    = {trim_ws(f[7]), true};
+                row.CHR  = {trim_ws(f[8]), idx_chr >= 0};
+                row.POS  = {trim_ws(f[9]), idx_pos >= 0};
+            }
+        }
 
-        auto vSNP = trim_ws(outs[0]);
-        if (vSNP.empty()) continue;
+        // ---- pass 2：整列 Z = beta/se（或 p + sign(beta)），StatFunc 批量计算 ----
+        if (need_z) {
+            const size_t m = b1 - b0;
+            for (size_t r = 0; r < m; ++r) {
+                if (!row_ok[r]) { zb[r] = zs[r] = zp[r] = NAN; continue; }
+                if (!parse_double_strict(rows[r].beta.v, zb[r])) zb[r] = NAN;
+                if (!parse_double_strict(rows[r].se.v,   zs[r])) zs[r] = NAN;
+                if (!parse_double_strict(rows[r].p.v,    zp[r])) zp[r] = NAN;
+            }
+            StatFunc::z_score_batch(zb.data(), zs.data(), zp.data(), zv.data(), m);
+            for (size_t r = 0; r < m; ++r) {
+                if (!row_ok[r]) continue;
+                rows[r].Z = {FormatEngine::format_z(zv[r], &ztxt[r * ZW], ZW), true};
+            }
+        }
 
-        FormatEngine::RowView row;                      // 新版 FormatEngine
-        row.SNP  = {vSNP, true};
-        row.A1   = {trim_ws(outs[1]), true};
-        row.A2   = {trim_ws(outs[2]), true};
-        row.freq = {trim_ws(outs[3]), true};
-        row.beta = {trim_ws(outs[4]), true};
-        row.se   = {trim_ws(outs[5]), true};
-        row.p    = {trim_ws(outs[6]), true};
-        row.N    = {trim_ws(outs[7]), true};
+        // ---- pass 3：渲染 ----
+        for (size_t i=b0; i<b1; i++){
+            if (!keep[i]) continue;
+            const size_t r = i - b0;
+            if (idx_split >= 0) {
+                std::string_view f[1] = {};
+                scan_to_stop_col(std::string_view(lines[i]), idx_split, split2slot, f, 1);
+                const int8_t code = (int8_t)canonical_chr_code_sv(trim_ws(f[0]));
+                chr_all.push_back(code);
+                if (need_fields && row_ok[r]) chr_ok.push_back(code);
+            }
+            for (auto& o : outs) {
+                if (o.fmt == "gwas") {                            // gwas 格式直接写原行（不 split）
+                    o.buf.append(lines[i]);
+                    o.buf.push_back('\n');
+                }
+                else if (row_ok[r]) FE.append_line_fast(o.spec, rows[r], o.buf); // fast path，零分配
+            }
+        }
 
-        fout.write_line(FE.format_line_fast(spec, row)); // fast path
+        par_for(outs.size(), [&](size_t k) {
+            outs[k].w->write_block(outs[k].buf, outs[k].fmt == "gwas" ? chr_all : chr_ok);
+        });
     }
 
-    LOG_INFO("convert finished (format=" + P.format + ").");
+    std::string fmt_list;
+    for (const auto& f : P.formats) fmt_list += (fmt_list.empty() ? "" : ",") + f;
+    LOG_INFO("convert finished (format=" + fmt_list + ").");
 }
\ No newline at end of file
@@ -15,24 +15,39 @@ int cmd_rsidImpu(int argc, char* argv[]);
 int cmd_convert(int argc, char* argv[]);
 int cmd_or2beta(int argc, char* argv[]);
 int cmd_computeNeff(int argc, char* argv[]);
+int cmd_pipeline(int argc, char* argv[]);
+int cmd_serve(int argc, char* argv[]);
+int cmd_sort(int argc, char* argv[]);
+int cmd_query(int argc, char* argv[]);
 
 void print_main_help() {
     cerr << "Available commands:\n"
         << "   rsidImpu       Annotate GWAS sumstats with rsid\n"
         << "   convert        Convert GWAS format (GWAS, COJO, SMR, LDSC, MR-MEGA)\n"
         << "   or2beta        Convert OR to beta and SE\n"
-        << "   computeNeff    Compute effect sample size for binary traits\n\n"
+        << "   computeNeff    Compute effect sample size for binary traits\n"
+        << "   pipeline       Chain or2beta / computeNeff / convert in one pass\n"
+        << "   serve          Keep dbSNP loaded and annotate over a Unix socket\n"
+        << "   sort           Sort by CHR/POS (external memory); .gz = BGZF + tabix index\n"
+        << "   query          Extract a CHR:BEG-END region from an indexed .gz\n\n"
         << "Example:\n"
         << "  GWAStoolkit <command> [options]\n\n";
 }
 
 int main(int argc, char* argv[]) {
-    cout << "************************************************\n";
-    cout << "* GWAStoolkit                                  *\n";
-    cout << "* A tool to treat GWAS summary statistics      *\n";
-    cout << "* Authors: Loren Shi                           *\n";
-    cout << "* MIT License                                  *\n";
-    cout << "************************************************\n\n";
+    // --out - ：stdout 承载数据，banner 与 INFO/WARN 全部改走 stderr
+    for (int i=2; i+1<argc; i++){
+        if (std::string(argv[i]) == "--out" && std::string(argv[i+1]) == "-")
+            g_console = &std::cerr;
+    }
+    ostream& con = *g_console;
+
+    con << "************************************************\n";
+    con << "* GWAStoolkit                                  *\n";
+    con << "* A tool to treat GWAS summary statistics      *\n";
+    con << "* Authors: Loren Shi                           *\n";
+    con << "* MIT License                                  *\n";
+    con << "************************************************\n\n";
     
     if (argc < 2 || 
         std::string(argv[1]) == "--help" ||
@@ -57,7 +72,7 @@ int main(int argc, char* argv[]) {
 #ifdef _OPENMP
     if (threads > 0){
         omp_set_num_threads(threads);
-        std::cout << "[INFO] Using threads = " << threads << "\n";
+        con << "[INFO] Using threads = " << threads << "\n";
     }
 #endif
 
@@ -92,6 +107,18 @@ int main(int argc, char* argv[]) {
     else if (cmd == "computeNeff") {
         ret = cmd_computeNeff(argc-1, argv+1);
     }
+    else if (cmd == "pipeline") {
+        ret = cmd_pipeline(argc-1, argv+1);
+    }
+    else if (cmd == "serve") {
+        ret = cmd_serve(argc-1, argv+1);
+    }
+    else if (cmd == "sort") {
+        ret = cmd_sort(argc-1, argv+1);
+    }
+    else if (cmd == "query") {
+        ret = cmd_query(argc-1, argv+1);
+    }
     else {
         LOG_ERROR("Unknown command: " + cmd);
         return 1;
@@ -5,16 +5,16 @@
 #include "utils/util.hpp"
 #include "utils/log.hpp"
 #include "utils/gwasQC.hpp"
+#include "utils/gwascache.hpp"
+#include "utils/dryrun.hpp"
+#include "utils/rowfilter.hpp"
 #include "utils/FormatEngine.hpp"
-#include "utils/StatFunc.hpp"
+#include "utils/rowtransform.hpp"
 
 #include <algorithm>
 #include <unordered_map>
-#include <cmath>
 #include <string_view>
 #include <vector>
-#include <cstdlib>   // strtod
-#include <cerrno>    // errno
 #include <limits>
 
 using namespace std;
@@ -66,22 +66,6 @@ static inline int scan_to_stop_col(
     return col;
 }
 
-// [OPT-SHARED-2] 严格 double 解析（不抛异常，比 stod 稳；并做“整串消费”校验）
-static inline bool parse_double_strict(std::string_view sv, double &out){
-    sv = trim_ws(sv);
-    if (sv.empty()) return false;
-
-    errno = 0;
-    char *end = nullptr;
-    out = std::strtod(sv.data(), &end);
-
-    if (end == sv.data()) return false; // 无法解析
-    if ((const char*)end != sv.data() + sv.size()) return false; // [FIX] 必须整串消费，避免 "1abc"
-    if (errno == ERANGE) return false;
-    if (!std::isfinite(out)) return false;
-    return true;
-}
-
 // [OPT-SHARED-3] 预计算某列的 [start,len]（用于原地替换，不 split）
 // 成功返回 true；失败返回 false（行列不够）
 static inline bool get_col_span(std::string_view line, int col_idx, uint32_t &st, uint32_t &len){
@@ -101,14 +85,20 @@ static inline bool get_col_span(std::string_view line, int col_idx, uint32_t &st
 
 
 void run_or2beta(const Args_Or2Beta& P){
-    LineReader lr(P.gwas_file);
-    string line;
+    if (P.dry_run) {
+        dry_run_table(P, "or2beta", [](const Args_Or2Beta& Q){ run_or2beta(Q); });
+        return;
+    }
+
+    RowFilter rf(P);
 
-    if (!lr.getline(line)) {
+    // 读入 header + 全部数据行（--cache-dir 命中时直接还原快照）
+    string line;
+    std::vector<std::string> lines;
+    if (!read_gwas_table(P.gwas_file, P.cache_dir, line, lines)) {
         LOG_ERROR("Empty GWAS summary file in or2beta.");
-        exit(1);
+        die(1);
     }
-    strip_cr_inplace(line);   
     auto header = split(line);
 
     // header check
@@ -135,26 +125,20 @@ void run_or2beta(const Args_Or2Beta& P){
 
     int idx_n    = find_col(header, P.col_n);
 
-    // ---------- read lines ----------
-    std::vector<std::string> lines;
-    lines.reserve(1 << 20);
-
-    while (lr.getline(line)){
-        if (line.empty()) continue;
-        strip_cr_inplace(line); 
-        lines.push_back(line);
-    }
-
     size_t n = lines.size();
     LOG_INFO("Loaded " + to_string(n) + " GWAS lines for or2beta.");
 
-    // ======================= QC =======================
+    // ======================= 行过滤 + QC =======================
     std::vector<bool> keep(n, true);
+    rf.bind(header, P);
+    rf.apply(lines, keep);
 
     bool can_qc = (idx_freq>=0 || idx_p>=0 || idx_n>=0);
     if (can_qc) {
         LOG_INFO("QC applied in partial-column mode.");
-        gwas_basic_qc(
+        gwas_basic_qc_cached(
+            P.gwas_file,
+            P.cache_dir,
             lines,
             header,
             -1,        // 不 QC beta
@@ -191,11 +175,12 @@ void run_or2beta(const Args_Or2Beta& P){
 
     FormatEngine FE;
     FormatSpec spec = FE.get_format(P.format);
-    Writer fout(P.out_file, P.format);
+    Writer fout(P.out_file, P.format, P.split_by_chr);
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
 
     if (!fout.good()) {
         LOG_ERROR("Cannot open output file: " + P.out_file);
-        exit(1);
+        die(1);
     }
 
     // writer header
@@ -226,7 +211,13 @@ void run_or2beta(const Args_Or2Beta& P){
     if (idx_p  >= 0) stop = std::max(stop, idx_p);
     if (idx_n  >= 0) stop = std::max(stop, idx_n);
 
-    // slot: 0=SNP,1=A1,2=A2,3=OR,4=FREQ,5=SE,6=P,7=N
+    // arrow 输出带 CHR/POS：只在需要时扫描；--split-by-chr 按 CHR 分发
+    int idx_chr = spec.needs_chrpos || P.split_by_chr ? find_col(header, P.g_chr) : -1;
+    int idx_pos = spec.needs_chrpos ? find_col(header, P.g_pos) : -1;
+    require(!P.split_by_chr || idx_chr >= 0, "--split-by-chr needs the CHR column [" + P.g_chr + "].");
+    stop = std::max({stop, idx_chr, idx_pos});
+
+    // slot: 0=SNP,1=A1,2=A2,3=OR,4=FREQ,5=SE,6=P,7=N,8=CHR,9=POS
     std::vector<int> col2slot(stop + 1, -1);
     col2slot[idx_snp]  = 0;
     col2slot[idx_A1]   = 1;
@@ -236,6 +227,8 @@ void run_or2beta(const Args_Or2Beta& P){
     if (idx_se >= 0) col2slot[idx_se] = 5;
     if (idx_p  >= 0) col2slot[idx_p]  = 6;
     if (idx_n  >= 0) col2slot[idx_n]  = 7;
+    if (idx_chr >= 0) col2slot[idx_chr] = 8;
+    if (idx_pos >= 0) col2slot[idx_pos] = 9;
 
 
     // process lines
@@ -244,14 +237,15 @@ void run_or2beta(const Args_Or2Beta& P){
 
         const std::string &ln = lines[i];
 
-        std::string_view outs[8] = {};
-        int cols = scan_to_stop_col(std::string_view(ln), stop, col2slot, outs, 8);
+        std::string_view outs[10] = {};
+        int cols = scan_to_stop_col(std::string_view(ln), stop, col2slot, outs, 10);
 
         //不再要求 f.size()==header.size()；只要关键列存在即可，避免不必要丢行
         if (cols < stop + 1) continue;
 
         auto vSNP = trim_ws(outs[0]);
         if (vSNP.empty()) continue;
+        if (P.split_by_chr) fout.select_chr(canonical_chr_code_sv(trim_ws(outs[8])));
 
         if (P.format == "gwas"){
             // 与原逻辑一致：gwas 模式不改行内容（仅过滤不合法行）
@@ -259,37 +253,11 @@ void run_or2beta(const Args_Or2Beta& P){
             continue;
         }
 
-        // OR -> beta
-        double ORv = NAN;
-        if (!parse_double_strict(outs[3], ORv)) continue;   // 用 strtod strict 替代 stod
-        if (!(ORv > 0.0) || !std::isfinite(ORv)) continue;
-
-        double beta = std::log(ORv);
-        // 计算 se
-        double se = NAN;
-        if (idx_se >= 0){
-            double sev = NAN;
-            if (parse_double_strict(outs[5], sev) && sev > 0.0) {
-                se = sev;
-            }
-        }
-
-        if (!std::isfinite(se)) {
-            if (idx_p >= 0) {
-                double pval = NAN;
-                if (parse_double_strict(outs[6], pval) && pval > 0.0 && pval <= 1.0) {
-                    double z = StatFunc::p2z_two_tailed(pval);
-                    se = (z > 0 ? std::fabs(beta) / z : 999.0);
-                } else {
-                    se = 999.0;
-                }
-            } else {
-                se = 999.0;
-            }
-        }
-
-        std::string beta_str = std::to_string(beta);
-        std::string se_str   = std::to_string(se);
+        // OR -> beta / se（与 pipeline 共用 RowTransform）
+        std::string beta_str, se_str;
+        if (!RowTransform::or2beta(outs[3], idx_se >= 0 ? outs[5] : std::string_view{},
+                                   idx_p >= 0 ? outs[6] : std::string_view{}, beta_str, se_str))
+            continue;
 
         FormatEngine::RowView row;                     // FormatEngine
         row.SNP  = {vSNP, true};
@@ -305,9 +273,15 @@ void run_or2beta(const Args_Or2Beta& P){
         if (idx_p >= 0) row.p = {trim_ws(outs[6]), true};
         else           row.p = {{}, false};
 
+        row.CHR = {trim_ws(outs[8]), spec.needs_chrpos && idx_chr >= 0};
+        row.POS = {trim_ws(outs[9]), idx_pos >= 0};
+
         row.beta = {std::string_view(beta_str), true};
         row.se   = {std::string_view(se_str),   true};
 
-        fout.write_line(FE.format_line_fast(spec, row)); // fast path
+        char zbuf[32];
+        if (spec.needs_z) FormatEngine::fill_z(row, zbuf, sizeof zbuf);   // ldsc
+        FE.append_line_fast(spec, row, fout.buffer());   // fast path：直接进 Writer 缓冲
+        fout.flush_if_full();
     }
 }
\ No newline at end of file
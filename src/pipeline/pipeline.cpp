@@ -0,0 +1,393 @@
+#include "pipeline/pipeline.hpp"
+
+#include "utils/writer.hpp"
+#include "utils/util.hpp"
+#include "utils/log.hpp"
+#include "utils/gwasQC.hpp"
+#include "utils/gwascache.hpp"
+#include "utils/dryrun.hpp"
+#include "utils/rowfilter.hpp"
+#include "utils/parallel.hpp"
+#include "utils/FormatEngine.hpp"
+#include "utils/rowtransform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+
+// =======================================================
+// [PIPELINE] or2beta -> computeNeff -> convert 在同一进程、同一次解析中逐行串联
+// 每一步的 QC / 变换 / 丢行规则与单独运行对应子命令（中间结果用 --format cojo）一致：
+// 步骤之间传递的是该子命令会写出的字符串（std::to_string），下一步再按原规则解析，
+// 因此输出与串联运行逐字节相同，只是省掉了中间文件的压缩、写出和重新读入
+// =======================================================
+
+static inline std::string_view trim_ws(std::string_view sv){
+    while (!sv.empty() && (sv.front()==' ' || sv.front()=='\t')) sv.remove_prefix(1);
+    while (!sv.empty() && (sv.back() ==' ' || sv.back() =='\t' || sv.back()=='\r')) sv.remove_suffix(1);
+    return sv;
+}
+
+// 扫描到 stop_col（包含），col2slot 映射目标列；返回扫描到的列数
+static inline int scan_to_stop_col(
+    std::string_view line, int stop_col,
+    const std::vector<int> &col2slot, std::string_view *outs
+){
+    size_t start = 0;
+    int col = 0;
+    for (size_t j = 0; j <= line.size(); ++j){
+        if (j == line.size() || line[j] == '\t'){
+            int slot = col2slot[col];
+            if (slot >= 0) outs[slot] = std::string_view(line.data() + start, j - start);
+            ++col;
+            start = j + 1;
+            if (col - 1 == stop_col) break;
+        }
+    }
+    return col;
+}
+
+// 输入列槽位
+enum Slot { S_SNP, S_A1, S_A2, S_FREQ, S_BETA, S_SE, S_P, S_N, S_OR, S_CASE, S_CTRL, S_CHR, S_POS, S_COUNT };
+
+// 一行在各步骤之间的状态：字段视图 + 本行计算出的字符串
+struct PipeRow {
+    FormatEngine::RowView r;
+    std::string_view vOR, vCase, vCtrl;
+    std::string beta_buf, se_buf, n_buf;
+};
+
+enum class StepId { OR2BETA, NEFF, CONVERT };
+
+struct PipeStep {
+    StepId id;
+    GwasLineQC qc;      // 本步读入时的 QC（第一步由整表 QC 代替）
+};
+
+static const char* step_name(StepId id)
+{
+    switch (id) {
+        case StepId::OR2BETA: return "or2beta";
+        case StepId::NEFF:    return "computeNeff";
+        default:              return "convert";
+    }
+}
+
+// ---------------- 单步变换：返回 false = 该行在这一步被丢弃 ----------------
+static bool step_or2beta(PipeRow& x)
+{
+    if (trim_ws(x.r.SNP.v).empty()) return false;
+
+    if (!RowTransform::or2beta(x.vOR, x.r.se.present ? x.r.se.v : std::string_view{},
+                               x.r.p.present ? x.r.p.v : std::string_view{}, x.beta_buf, x.se_buf))
+        return false;
+    x.r.beta = {std::string_view(x.beta_buf), true};
+    x.r.se   = {std::string_view(x.se_buf),   true};
+    return true;
+}
+
+static bool step_neff(PipeRow& x, const Args_Pipeline& P, double Neff_fixed)
+{
+    double Neff = P.is_single ? Neff_fixed : RowTransform::neff_from_counts(x.vCase, x.vCtrl);
+    if (!std::isfinite(Neff) || Neff <= 0.0) return false;
+
+    if (trim_ws(x.r.SNP.v).empty()) return false;
+
+    std::string beta_str, se_str;
+    if (!RowTransform::neff_std(x.r.freq.v, x.r.beta.v, x.r.se.v, Neff, beta_str, se_str)) return false;
+    if (!beta_str.empty()) {
+        x.beta_buf = std::move(beta_str);
+        x.se_buf   = std::move(se_str);
+        x.r.beta = {std::string_view(x.beta_buf), true};
+        x.r.se   = {std::string_view(x.se_buf),   true};
+    }
+
+    x.n_buf = std::to_string(Neff);
+    x.r.N = {std::string_view(x.n_buf), true};
+    return true;
+}
+
+static bool step_convert(PipeRow& x)
+{
+    return !trim_ws(x.r.SNP.v).empty();
+}
+
+void run_pipeline(const Args_Pipeline& P)
+{
+    if (P.dry_run) {
+        dry_run_table(P, "pipeline", [](const Args_Pipeline& Q){ run_pipeline(Q); });
+        return;
+    }
+
+    RowFilter rf(P);
+
+    //================ 1. 读入（可走 --cache-dir 快照） =================
+    string line;
+    std::vector<std::string> lines;
+    if (!read_gwas_table(P.gwas_file, P.cache_dir, line, lines)) {
+        LOG_ERROR("Empty GWAS summary file in pipeline.");
+        die(1);
+    }
+    auto header = split(line);
+    size_t n = lines.size();
+    LOG_INFO("Loaded " + to_string(n) + " GWAS lines for pipeline.");
+
+    int idx[S_COUNT];
+    idx[S_SNP]  = find_col(header, P.col_SNP);
+    idx[S_A1]   = find_col(header, P.g_A1);
+    idx[S_A2]   = find_col(header, P.g_A2);
+    idx[S_FREQ] = find_col(header, P.col_freq);
+    idx[S_BETA] = find_col(header, P.col_beta);
+    idx[S_SE]   = find_col(header, P.col_se);
+    idx[S_P]    = find_col(header, P.g_p);
+    idx[S_N]    = find_col(header, P.col_n);
+    idx[S_OR]   = find_col(header, P.col_or);
+    idx[S_CASE] = P.is_column ? find_col(header, P.case_col)    : -1;
+    idx[S_CTRL] = P.is_column ? find_col(header, P.control_col) : -1;
+    idx[S_CHR]  = -1;   // 仅 arrow 输出需要，见下
+    idx[S_POS]  = -1;
+
+    require(idx[S_SNP] >= 0, "GWAS missing required column [" + P.col_SNP + "] for pipeline.");
+    require(idx[S_A1]  >= 0, "GWAS missing required column [" + P.g_A1 + "] for pipeline.");
+    require(idx[S_A2]  >= 0, "GWAS missing required column [" + P.g_A2 + "] for pipeline.");
+
+    //================ 2. 逐步检查所需列，记录每步的 QC 列 =================
+    // avail：当前步骤之前已有的字段（输入列 + 前面步骤算出的列）
+    bool avail[S_COUNT];
+    for (int s = 0; s < S_COUNT; ++s) avail[s] = idx[s] >= 0;
+
+    auto need = [&](int s, const std::string& col, StepId id){
+        require(avail[s], "GWAS missing required column [" + col + "] for pipeline step " +
+                          step_name(id) + ".");
+    };
+    // 后续步骤的 QC 只用 pass_fields：参数只表示该字段是否参与（0 = 参与，-1 = 忽略）
+    auto make_qc = [&](bool beta, bool se, bool freq, bool p, bool nn){
+        return GwasLineQC(beta && avail[S_BETA] ? 0 : -1,
+                          se   && avail[S_SE]   ? 0 : -1,
+                          freq && avail[S_FREQ] ? 0 : -1,
+                          p    && avail[S_P]    ? 0 : -1,
+                          nn   && avail[S_N]    ? 0 : -1,
+                          P.maf_threshold);
+    };
+
+    std::vector<PipeStep> steps;
+    for (const auto& name : P.steps) {
+        if (name == "or2beta") {
+            need(S_OR,   P.col_or,   StepId::OR2BETA);
+            need(S_FREQ, P.col_freq, StepId::OR2BETA);
+            require(avail[S_SE] || avail[S_P],
+                    "pipeline step or2beta requires either SE column [" + P.col_se +
+                    "] or P column [" + P.g_p + "].");
+            steps.push_back({StepId::OR2BETA, make_qc(false, true, true, true, true)});
+            avail[S_BETA] = avail[S_SE] = true;
+        } else if (name == "computeNeff") {
+            need(S_FREQ, P.col_freq, StepId::NEFF);
+            need(S_BETA, P.col_beta, StepId::NEFF);
+            need(S_SE,   P.col_se,   StepId::NEFF);
+            need(S_P,    P.g_p,      StepId::NEFF);
+            if (P.is_column) {
+                require(idx[S_CASE] >= 0, "Cannot find case column: " + P.case_col);
+                require(idx[S_CTRL] >= 0, "Cannot find control column: " + P.control_col);
+            }
+            steps.push_back({StepId::NEFF, make_qc(true, true, true, true, true)});
+            avail[S_N] = true;
+        } else {
+            need(S_FREQ, P.col_freq, StepId::CONVERT);
+            need(S_BETA, P.col_beta, StepId::CONVERT);
+            need(S_SE,   P.col_se,   StepId::CONVERT);
+            need(S_P,    P.g_p,      StepId::CONVERT);
+            need(S_N,    P.col_n,    StepId::CONVERT);
+            steps.push_back({StepId::CONVERT, make_qc(true, true, true, true, true)});
+        }
+    }
+
+    FormatEngine FE;
+    std::vector<FormatSpec> specs;
+    for (const auto& fmt : P.formats) {
+        FormatSpec spec = FE.get_format(fmt);
+        for (size_t j = 0; j < spec.cols.size(); ++j) {
+            const std::string& c = spec.cols[j];
+            int s = -1;
+            switch (spec.field_ids[j]) {
+                case FieldId::FREQ: s = S_FREQ; break;
+                case FieldId::BETA: s = S_BETA; break;
+                case FieldId::SE:   s = S_SE;   break;
+                case FieldId::P:    s = S_P;    break;
+                case FieldId::N:    s = S_N;    break;
+                default: break;
+            }
+            require(s < 0 || avail[s],
+                    "--format " + fmt + " needs column [" + c + "], which neither the input nor any step provides.");
+        }
+        specs.push_back(std::move(spec));
+    }
+    const size_t nfmt = specs.size();
+
+    // arrow 带 CHR/POS 列：只在需要时才扫这两列（缺列写 null）
+    bool need_chrpos = false;
+    for (const auto& sp : specs) need_chrpos = need_chrpos || sp.needs_chrpos;
+    if (need_chrpos) {
+        idx[S_CHR] = find_col(header, P.g_chr);
+        idx[S_POS] = find_col(header, P.g_pos);
+    }
+    if (P.split_by_chr) {
+        idx[S_CHR] = find_col(header, P.g_chr);
+        require(idx[S_CHR] >= 0, "--split-by-chr needs the CHR column [" + P.g_chr + "].");
+    }
+
+    //================ 3. 行过滤，第一步的 QC 整表做（可走缓存），再按 SNP 去重 =================
+    std::vector<bool> keep(n, true);
+    rf.bind(header, P);
+    rf.apply(lines, keep);
+    {
+        // 第一步读的是原始文件：只用原始列
+        bool first_or = (steps.front().id == StepId::OR2BETA);
+        gwas_basic_qc_cached(P.gwas_file, P.cache_dir, lines, header,
+                             first_or ? -1 : idx[S_BETA], idx[S_SE], idx[S_FREQ], idx[S_P], idx[S_N],
+                             keep, P.maf_threshold);
+    }
+
+    int stop = -1;
+    for (int s = 0; s < S_COUNT; ++s) stop = std::max(stop, idx[s]);
+    std::vector<int> col2slot(stop + 2, -1);
+    for (int s = 0; s < S_COUNT; ++s) if (idx[s] >= 0) col2slot[idx[s]] = s;
+
+    if (P.remove_dup_snp) {
+        std::vector<std::string> snp_vec(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (!keep[i]) continue;
+            std::string_view outs[S_COUNT] = {};
+            if (scan_to_stop_col(lines[i], idx[S_SNP], col2slot, outs) < idx[S_SNP] + 1) continue;
+            auto v = trim_ws(outs[S_SNP]);
+            if (!v.empty()) snp_vec[i].assign(v.data(), v.size());
+        }
+        gwas_remove_dup(lines, header, idx[S_P], snp_vec, keep);
+    }
+
+    double Neff_fixed = std::numeric_limits<double>::quiet_NaN();
+    if (P.is_single) {
+        Neff_fixed = RowTransform::calc_neff(P.case_n, P.control_n);
+        require(std::isfinite(Neff_fixed) && Neff_fixed > 0.0,
+                "Invalid fixed case/control: " + std::to_string(P.case_n) + "," +
+                std::to_string(P.control_n));
+        LOG_INFO("Fixed-mode Neff = " + std::to_string(Neff_fixed));
+    }
+
+    std::string step_list;
+    for (const auto& st : steps) step_list += std::string(step_list.empty() ? "" : " -> ") + step_name(st.id);
+    std::string fmt_list;
+    for (const auto& f : P.formats) fmt_list += (fmt_list.empty() ? "" : ",") + f;
+    LOG_INFO("Pipeline steps: " + step_list + " (format=" + fmt_list + ")");
+
+    //================ 4. 逐行串联各步骤，分块并行，按行序写出 =================
+    // --format 列表：每个格式一个 Writer（out.cojo / out.popcorn ...），各自并行压缩
+    std::vector<std::unique_ptr<Writer>> fouts;
+    for (size_t k = 0; k < nfmt; ++k) {
+        std::string path = nfmt > 1 ? format_out_path(P.out_file, P.formats[k]) : P.out_file;
+        fouts.emplace_back(new Writer(path, P.formats[k], P.split_by_chr));
+        if (!fouts.back()->good()) {
+            LOG_ERROR("Cannot open output file: " + path);
+            die(1);
+        }
+        if (nfmt > 1) LOG_INFO("pipeline output [" + P.formats[k] + "]: " + path);
+
+        std::string h;
+        for (size_t j = 0; j < specs[k].cols.size(); ++j) {
+            if (j) h += "\t";
+            h += specs[k].cols[j];
+        }
+        fouts.back()->write_line(h);
+    }
+
+    bool need_z = false;
+    for (const auto& sp : specs) need_z = need_z || sp.needs_z;
+
+    const size_t BLOCK = 1 << 16;
+    int nth = 1;
+#ifdef _OPENMP
+    nth = omp_get_max_threads();
+#endif
+    // [OPT-FE-2] out[t][k]：块内第 t 段连续行、第 k 个格式的输出缓冲。
+    // 各段按段序拼接即为原行序；缓冲跨块复用，不再逐行分配 string
+    std::vector<std::vector<std::string>> out(nth, std::vector<std::string>(nfmt));
+    std::vector<size_t> seg_written(nth, 0);
+    std::vector<std::vector<int8_t>> seg_chr(nth);   // --split-by-chr：段内各输出行的染色体
+
+    for (size_t b0 = 0; b0 < n; b0 += BLOCK) {
+        size_t b1 = std::min(n, b0 + BLOCK);
+        for (auto& v : out) for (auto& o : v) o.clear();
+        for (auto& c : seg_chr) c.clear();
+
+        // 段作为 par_for 的块：--batch 下由共享线程池里空闲的线程取走
+        par_for((size_t)nth, [&](size_t tid) {
+        std::vector<std::string>& tout = out[tid];
+        const size_t per = (b1 - b0 + nth - 1) / nth;
+        const size_t lo  = std::min(b1, b0 + per * tid);
+        const size_t hi  = std::min(b1, lo + per);
+
+        for (size_t i = lo; i < hi; ++i) {
+            if (!keep[i]) continue;
+
+            std::string_view outs[S_COUNT] = {};
+            if (scan_to_stop_col(lines[i], stop, col2slot, outs) < stop + 1) continue;
+
+            PipeRow x;
+            x.r.SNP  = {trim_ws(outs[S_SNP]),  true};
+            x.r.A1   = {trim_ws(outs[S_A1]),   true};
+            x.r.A2   = {trim_ws(outs[S_A2]),   true};
+            x.r.freq = {trim_ws(outs[S_FREQ]), idx[S_FREQ] >= 0};
+            x.r.beta = {trim_ws(outs[S_BETA]), idx[S_BETA] >= 0};
+            x.r.se   = {trim_ws(outs[S_SE]),   idx[S_SE]   >= 0};
+            x.r.p    = {trim_ws(outs[S_P]),    idx[S_P]    >= 0};
+            x.r.N    = {trim_ws(outs[S_N]),    idx[S_N]    >= 0};
+            x.r.CHR  = {trim_ws(outs[S_CHR]),  idx[S_CHR]  >= 0};
+            x.r.POS  = {trim_ws(outs[S_POS]),  idx[S_POS]  >= 0};
+            x.vOR   = outs[S_OR];
+            x.vCase = outs[S_CASE];
+            x.vCtrl = outs[S_CTRL];
+
+            bool ok = true;
+            for (size_t k = 0; k < steps.size() && ok; ++k) {
+                const PipeStep& st = steps[k];
+
+                // 后续步骤读的是上一步的输出：先按该步规则 QC
+                if (k > 0) {
+                    std::string_view f[5] = {x.r.beta.v, x.r.se.v, x.r.freq.v, x.r.p.v, x.r.N.v};
+                    if (!st.qc.pass_fields(f)) { ok = false; break; }
+                }
+
+                switch (st.id) {
+                    case StepId::OR2BETA: ok = step_or2beta(x); break;
+                    case StepId::NEFF:    ok = step_neff(x, P, Neff_fixed); break;
+                    case StepId::CONVERT: ok = step_convert(x); break;
+                }
+            }
+            if (!ok) continue;
+            char zbuf[32];
+            if (need_z) FormatEngine::fill_z(x.r, zbuf, sizeof zbuf);   // ldsc
+            for (size_t k = 0; k < nfmt; ++k) FE.append_line_fast(specs[k], x.r, tout[k]);
+            if (P.split_by_chr) seg_chr[tid].push_back((int8_t)canonical_chr_code_sv(x.r.CHR.v));
+            ++seg_written[tid];
+        }
+        });
+
+        par_for(nfmt, [&](size_t k) {
+            for (int t = 0; t < nth; ++t) fouts[k]->write_block(out[t][k], seg_chr[t]);
+        });
+    }
+
+    size_t written = 0;
+    for (size_t w : seg_written) written += w;
+
+    LOG_INFO("pipeline wrote " + std::to_string(written) + " / " + std::to_string(n) + " rows.");
+}
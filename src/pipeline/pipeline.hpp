@@ -0,0 +1,8 @@
+#ifndef GWASTOOLKIT_PIPELINE_HPP
+#define GWASTOOLKIT_PIPELINE_HPP
+
+#include "utils/args.hpp"
+
+void run_pipeline(const Args_Pipeline& P);
+
+#endif
@@ -0,0 +1,133 @@
+//
+//  query.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "query/query.hpp"
+
+#include "utils/bgzf.hpp"
+#include "utils/writer.hpp"
+#include "utils/util.hpp"
+#include "utils/log.hpp"
+
+#include <charconv>
+#include <string>
+#include <string_view>
+
+// =======================================================
+// [QUERY] 按 .tbi 只解压与区间重叠的 BGZF 块
+//   区间：CHR | CHR:POS | CHR:BEG-END（1-based 闭区间，数字可带千分位逗号）
+// =======================================================
+
+struct Region {
+    std::string chr;
+    int64_t beg = 1;
+    int64_t end = int64_t(1) << 29;
+};
+
+static bool parse_pos(std::string s, int64_t& v)
+{
+    std::string t;
+    for (char c : s) if (c != ',') t.push_back(c);
+    auto r = std::from_chars(t.data(), t.data() + t.size(), v);
+    return !t.empty() && r.ec == std::errc() && r.ptr == t.data() + t.size() && v > 0;
+}
+
+static Region parse_region(const std::string& s)
+{
+    Region R;
+    size_t colon = s.rfind(':');
+    R.chr = s.substr(0, colon);
+    bool ok = !R.chr.empty();
+    if (ok && colon != std::string::npos) {
+        std::string range = s.substr(colon + 1);
+        size_t dash = range.find('-');
+        if (dash == std::string::npos) {
+            ok = parse_pos(range, R.beg);
+            R.end = R.beg;
+        } else {
+            ok = parse_pos(range.substr(0, dash), R.beg) &&
+                 (dash + 1 == range.size() || parse_pos(range.substr(dash + 1), R.end));
+        }
+    }
+    if (!ok || R.end < R.beg) {
+        LOG_ERROR("Invalid --region: " + s + " (expected CHR, CHR:POS or CHR:BEG-END)");
+        die(1);
+    }
+    return R;
+}
+
+static inline bool tab_field(std::string_view line, int col, std::string_view& out)
+{
+    size_t start = 0;
+    for (int c = 0; c < col; ++c) {
+        size_t t = line.find('\t', start);
+        if (t == std::string_view::npos) return false;
+        start = t + 1;
+    }
+    size_t end = line.find('\t', start);
+    if (end == std::string_view::npos) end = line.size();
+    out = line.substr(start, end - start);
+    return true;
+}
+
+void run_query(const Args_Query& P)
+{
+    Region R = parse_region(P.region);
+
+    const std::string tbi_path = P.gwas_file + ".tbi";
+    TabixReader T(tbi_path);
+    if (!T.good()) {
+        LOG_ERROR(T.error() + " (create it with `GWAStoolkit sort --out FILE.gz` or --index)");
+        die(1);
+    }
+
+    BgzfReader in(P.gwas_file);
+    if (!in.good()) die(1);
+
+    Writer out(P.out_file);
+    if (!out.good()) die(1);
+
+    // 表头：文件开头 skip 行
+    std::string line;
+    in.seek(0);
+    for (int i = 0; i < T.skip() && in.getline(line); ++i) out.write_line(line);
+
+    int ref = T.ref_id(R.chr);
+    if (ref < 0) {
+        LOG_WARN("Chromosome " + R.chr + " is not in " + P.gwas_file + ".");
+        return;
+    }
+    const std::string& name = T.names()[ref];
+    const int ichr = T.col_seq(), ipos = T.col_pos();
+    const int64_t shift = T.zero_based() ? 1 : 0;
+
+    size_t nrows = 0, nblocks_rows = 0;
+    bool past = false;
+    for (const auto& ch : T.chunks(ref, R.beg, R.end)) {
+        if (past) break;
+        if (!in.seek(ch.first)) break;
+        while (in.tell() < ch.second && in.getline(line)) {
+            ++nblocks_rows;
+            std::string_view vc, vp;
+            if (!tab_field(line, ichr, vc) || !tab_field(line, ipos, vp)) continue;
+            if (vc != name && canonical_chr_code_sv(vc) != canonical_chr_code_sv(name)) continue;
+            int64_t pos = 0;
+            auto r = std::from_chars(vp.data(), vp.data() + vp.size(), pos);
+            if (r.ec != std::errc()) continue;
+            pos += shift;
+            if (pos > R.end) { past = true; break; }    // 行按位置排序：之后不会再命中
+            if (pos < R.beg) continue;
+            std::string& b = out.buffer();
+            b.append(line);
+            b.push_back('\n');
+            out.flush_if_full();
+            ++nrows;
+        }
+    }
+
+    LOG_INFO("Region " + name + ":" + std::to_string(R.beg) + "-" + std::to_string(R.end) + ": " +
+             std::to_string(nrows) + " rows (" + std::to_string(nblocks_rows) + " rows scanned).");
+}
@@ -0,0 +1,8 @@
+#ifndef GWASTOOLKIT_QUERY_HPP
+#define GWASTOOLKIT_QUERY_HPP
+
+#include "utils/args.hpp"
+
+void run_query(const Args_Query& P);
+
+#endif
@@ -116,4 +116,55 @@ inline AlleleKey make_allele_key(std::string_view a1,
 
     // OTHER (rare, ignored in matching)
     return {2, 0};
-}
\ No newline at end of file
+}
+
+// =======================================================
+// [MULTI-ALT] dbSNP 一行的等位基因：ALT 可为逗号分隔的多个等位基因
+// （VCF 多等位位点，如 REF=A ALT=C,G）。不拆分字符串、不分配内存：
+// 逐个 ALT 与 REF 组成 AlleleKey 比较；单 ALT 走原来的快路径
+// =======================================================
+
+// 对每个合法的 (ref, alt_i) key 调用 f(key)；f 返回 true 则提前结束
+template <class F>
+inline void for_each_alt_key(std::string_view ref, std::string_view alts, F&& f)
+{
+    size_t start = 0;
+    while (true) {
+        size_t comma = alts.find(',', start);
+        std::string_view alt = (comma == std::string_view::npos)
+                             ? alts.substr(start)
+                             : alts.substr(start, comma - start);
+
+        AlleleKey k = make_allele_key(ref, alt);
+        if (k.type != 2 && f(k)) return;
+
+        if (comma == std::string_view::npos) return;
+        start = comma + 1;
+    }
+}
+
+struct DbAlleles {
+    std::string_view ref;
+    std::string_view alts;
+    bool      multi = false;    // ALT 含逗号
+    AlleleKey first{2, 0};      // 单 ALT 时的 key
+
+    DbAlleles(std::string_view r, std::string_view a) : ref(r), alts(a) {
+        multi = alts.find(',') != std::string_view::npos;
+        if (!multi) first = make_allele_key(ref, alts);
+    }
+
+    // 没有任何可匹配的 ALT（单 ALT 且为 OTHER 类型）
+    inline bool empty() const { return !multi && first.type == 2; }
+
+    inline bool matches(const AlleleKey& g) const {
+        if (!multi) return first.type != 2 && first == g;
+
+        bool hit = false;
+        for_each_alt_key(ref, alts, [&](const AlleleKey& k){
+            hit = (k == g);
+            return hit;
+        });
+        return hit;
+    }
+};
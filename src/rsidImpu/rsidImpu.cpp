@@ -10,15 +10,25 @@
 #include "utils/log.hpp"
 #include "utils/util.hpp"
 #include "utils/gwasQC.hpp" // basic QC
+#include "utils/gwascache.hpp"
+#include "utils/gwasparts.hpp"
+#include "utils/rowfilter.hpp"
+#include "utils/spill.hpp"
+#include "utils/dryrun.hpp"
 #include "utils/FormatEngine.hpp"
+#include "utils/mmapfile.hpp"
 #include "rsidImpu/rsidImpu.hpp"
 #include "rsidImpu/allele.hpp"
 
 #include <algorithm>
 #include <cctype>
+#include <climits>
+#include <cstring>
 // #include <charconv>             //  from_chars
 #include <cstdint>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <string_view>
@@ -26,6 +36,12 @@
 #include <vector>
 #include <string>
 
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using namespace std;
 
 // =======================================================
@@ -35,6 +51,7 @@ using namespace std;
 struct GWASRecord {
     size_t    index;     // original line index
     int       chr;       // chr_code
+    uint32_t  file;      // [BATCH] --gwas-list 中的文件序号（单文件为 0）
     int64_t   pos;
     AlleleKey allele;
 };
@@ -125,14 +142,6 @@ static inline bool parse_i64(std::string_view sv, int64_t &out) {
 }
 
 
-static inline bool starts_with_ci(std::string_view s, std::string_view p){
-    if (s.size() < p.size()) return false;
-    for (size_t i=0;i<p.size();++i){
-        if (low(s[i]) != low(p[i])) return false;
-    }
-    return true;
-}
-
 static inline bool eq_ci(std::string_view a, std::string_view b){
     if (a.size() != b.size()) return false;
     for (size_t i=0;i<a.size();++i){
@@ -141,61 +150,6 @@ static inline bool eq_ci(std::string_view a, std::string_view b){
     return true;
 }
 
-// 严格整数解析：必须整串都是数字（不允许 "1.11" 这种）
-static inline bool parse_int_strict(std::string_view sv, int &out) {
-    int64_t v = 0;
-    if (!parse_i64(sv, v)) return false;
-    if (v < INT_MIN || v > INT_MAX) return false;
-    out = (int)v;
-    return true;
-}
-
-//[OPT-1] 用string_view 快速 canonical_chr （避免 string 分配）
-static inline int canonical_chr_code_sv(std::string_view sv) {
-    sv = trim_ws(sv);
-    if (sv.empty()) return -1;
-
-    // 去掉 CHR 前缀（大小写不敏感）
-    if (starts_with_ci(sv, "CHR")) {
-        sv.remove_prefix(3);
-        sv = trim_ws(sv);
-        if (sv.empty()) return -1;
-    }
-
-    // RefSeq: NC_000001.11 -> 1; NC_000023.11 -> 23; NC_012920.1 -> 25(MT)
-    if (starts_with_ci(sv, "NC_")) {
-        sv.remove_prefix(3);
-        sv = trim_ws(sv);
-
-        // 至少需要 6 位数字
-        if (sv.size() < 6) return -1;
-
-        std::string_view num6 = sv.substr(0, 6);
-
-        int v = 0;
-        // ✅ 必须解析 num6，而不是 sv（sv 里会有 ".11"）
-        if (!parse_int_strict(num6, v)) return -1;
-
-        // ✅ 注意：这里不能先限制 v<=25，因为 12920 需要映射到 MT
-        if (1 <= v && v <= 22) return v;
-        if (v == 23) return 23;
-        if (v == 24) return 24;
-        if (v == 12920) return 25; // NC_012920.* -> MT
-        return -1;
-    }
-
-    // 常用别名：M / MT / MTDNA
-    if (eq_ci(sv, "X")) return 23;
-    if (eq_ci(sv, "Y")) return 24;
-    if (eq_ci(sv, "M") || eq_ci(sv, "MT") || eq_ci(sv, "MTDNA")) return 25;
-
-    // 数字染色体（严格）
-    int v = 0;
-    if (!parse_int_strict(sv, v)) return -1;
-    if (v <= 0 || v > 25) return -1;
-    return v;
-}
-
 static inline void replace_nth_column_inplace(
     std::string &line,
     int col_idx,
@@ -301,100 +255,245 @@ static inline void scan_upto_col7(
     st.i = line.size();
 }
 
-void process_rsidImpu(const Args_RsidImpu& P)
-{    
-    //================ 1. 读取 GWAS header =================
-    LineReader reader(P.gwas_file);
+// =======================================================
+// [BATCH] 单个 GWAS 输入的全部状态（批量模式下每个文件一份）
+// =======================================================
+struct GwasInput {
+    std::string gwas_file;
+    std::string out_file;
+
+    std::vector<std::string> header;
+    bool has_SNP = false;
+    int  idx_SNP = -1;
+
+    int gCHR = -1, gPOS = -1, gA1 = -1, gA2 = -1;
+    int idx_beta = -1, idx_se = -1, idx_freq = -1, idx_pv = -1, idx_n = -1;
+
+    std::vector<std::string> gwas_lines;
+    std::vector<std::pair<uint32_t, uint32_t>> snp_span;
+
+    std::vector<uint8_t> keep_rf_u8;     // 行过滤通过（空 = 未给 --extract / --region 等）
+    std::vector<uint8_t> keep_qc_u8;     // QC 通过
+    std::vector<uint8_t> keep_u8;        // 是否最终进入主输出
+    std::vector<std::string> rsid_vec;   // 匹配到的 rsID
+};
+
+// manifest：每行 GWAS_FILE<TAB/空格>OUT_FILE，空行与 # 开头的行忽略
+static std::vector<GwasInput> read_gwas_list(const std::string& list_file)
+{
+    LineReader lr(list_file);
     std::string line;
-    if (!reader.getline(line)) {
-        LOG_ERROR("Empty GWAS summary file.");
-        exit(1);
+    std::vector<GwasInput> inputs;
+
+    while (lr.getline(line)) {
+        strip_cr_inplace(line);
+        auto f = split(line);
+        if (f.empty() || f[0][0] == '#') continue;
+
+        require(f.size() >= 2,
+                "Invalid line in --gwas-list (need GWAS_FILE and OUT_FILE): " + line);
+
+        GwasInput G;
+        G.gwas_file = f[0];
+        G.out_file  = f[1];
+        inputs.push_back(std::move(G));
     }
-    strip_cr_inplace(line);
 
-    auto header = split_tab(line);
+    require(!inputs.empty(), "No GWAS files listed in " + list_file);
+    return inputs;
+}
 
-    // chech exist of SNP col
-    bool has_SNP = false;
-    int  idx_SNP = -1;
+//================ 解析 GWAS header，定位列 =================
+static void set_gwas_header(const Args_RsidImpu& P, GwasInput& G, const std::string& line)
+{
+    G.header = split_tab(line);
+    const auto& header = G.header;
 
+    // chech exist of SNP col
     for (size_t i = 0; i < header.size(); i++){
         string hlow = header[i];
         std::transform(hlow.begin(), hlow.end(), hlow.begin(), ::tolower);
 
         if (hlow == "snp"){
-            has_SNP = true;
-            idx_SNP = i;
+            G.has_SNP = true;
+            G.idx_SNP = i;
             break;
         }
     }
     
     // find the col, CHR, POS, A1, A2, P
-    int gCHR     = find_col(header, P.g_chr); 
-    require(gCHR >= 0, "GWAS missing required column [" + P.g_chr + "] for rsidImpu.");
+    G.gCHR = find_col(header, P.g_chr); 
+    require(G.gCHR >= 0, "GWAS missing required column [" + P.g_chr + "] for rsidImpu.");
     
-    int gPOS     = find_col(header, P.g_pos);
-    require(gPOS >= 0, "GWAS missing required column [" + P.g_pos + "] for rsidImpu.");
+    G.gPOS = find_col(header, P.g_pos);
+    require(G.gPOS >= 0, "GWAS missing required column [" + P.g_pos + "] for rsidImpu.");
 
-    int gA1      = find_col(header, P.g_A1);
-    require(gA1 >= 0, "GWAS missing required column [" + P.g_A1 + "] for rsidImpu.");
+    G.gA1  = find_col(header, P.g_A1);
+    require(G.gA1 >= 0, "GWAS missing required column [" + P.g_A1 + "] for rsidImpu.");
 
-    int gA2 = find_col(header, P.g_A2);
-    require(gA2 >= 0, "GWAS missing required column [" + P.g_A2 + "] for rsidImpu.");
+    G.gA2  = find_col(header, P.g_A2);
+    require(G.gA2 >= 0, "GWAS missing required column [" + P.g_A2 + "] for rsidImpu.");
 
-    int idx_beta = find_col(header, P.col_beta);
-    int idx_se   = find_col(header, P.col_se);
-    int idx_freq = find_col(header, P.col_freq);
-    int idx_pv   = find_col(header, P.g_p);
-    int idx_n    = find_col(header, P.col_n);
+    G.idx_beta = find_col(header, P.col_beta);
+    G.idx_se   = find_col(header, P.col_se);
+    G.idx_freq = find_col(header, P.col_freq);
+    G.idx_pv   = find_col(header, P.g_p);
+    G.idx_n    = find_col(header, P.col_n);
+}
 
-    //================ 2. 读入 GWAS 数据行 =================
-    std::vector<std::string> gwas_lines;
-    gwas_lines.reserve(1 << 20); // 可调：减少扩容次数（不影响逻辑）
+static void read_gwas_header(const Args_RsidImpu& P, GwasInput& G, GwasPartsReader& reader)
+{
+    std::string line;
+    if (!reader.getline(line)) {
+        LOG_ERROR("Empty GWAS summary file: " + G.gwas_file);
+        die(1);
+    }
+    strip_cr_inplace(line);
+    set_gwas_header(P, G, line);
+}
 
-    // 读 GWAS 时直接构建 gwas_vec，避免第二次 split
-    std::vector<GWASRecord> gwas_vec;
-    gwas_vec.reserve(1 << 20);
+// 解析一行 GWAS 的 chr/pos/allele；无法参与匹配（chr/pos/allele 非法）返回 false
+static inline bool parse_gwas_key(
+    const GwasInput& G, std::string_view lv,
+    int& chr, int64_t& pos, AlleleKey& ak
+){
+    std::string_view vCHR, vPOS, vA1, vA2, vDummy;
+    TabState st{0,0};
 
-    // 如果需要覆盖 SNP 列，预计算每行 span
-    std::vector<std::pair<uint32_t, uint32_t>> snp_span;
-    if (P.format == "gwas" && has_SNP) snp_span.reserve(1 << 20);
+    int stop = std::max(std::max(G.gCHR, G.gPOS), std::max(G.gA1, G.gA2));
+    scan_upto_col(lv, stop, G.gCHR, G.gPOS, G.gA1, G.gA2, -1, vCHR, vPOS, vA1, vA2, vDummy, st);
+
+    chr = canonical_chr_code_sv(vCHR);
+    if (chr < 0) return false;
+
+    if (!parse_i64(trim_ws(vPOS), pos) || pos <= 0) return false;
 
-    while (reader.getline(line)){
+    ak = make_allele_key(trim_ws(vA1), trim_ws(vA2));
+    return ak.type != 2;
+}
+
+// [SPILL] 内存版每行的驻留估算（行文本之外）：gwas_lines / rsid_vec 的 string、
+// gwas_vec 及 stable_sort 缓冲、snp_span、keep 标记
+static const uint64_t GWAS_ROW_BYTES =
+    sizeof(std::string) * 2 + sizeof(GWASRecord) * 2 + sizeof(std::pair<uint32_t, uint32_t>) + 4;
+
+//================ --memory-limit：按预算读 GWAS =================
+// 估算的驻留字节超出余量时，已读的行连同剩余部分顺序写入临时文件并返回 false
+// （之后由 process_rsidImpu_spill 处理）；放得下则记账到 resident 并返回 true
+static bool read_gwas_budgeted(const Args_RsidImpu& P, GwasInput& G, MemCharge& resident,
+                               SpillFile& spill)
+{
+    GwasPartsReader reader(G.gwas_file);
+    read_gwas_header(P, G, reader);
+
+    auto& lines = G.gwas_lines;
+    uint64_t est = 0;
+    FILE* fp = nullptr;
+    std::vector<char> vbuf;
+    std::string line;
+
+    auto put = [&](const std::string& l){
+        spill_write(fp, l.data(), l.size(), spill.path());
+        spill_write(fp, "\n", 1, spill.path());
+    };
+
+    // 与 read_gwas_table 相同：跳过空行，去掉 \r
+    while (reader.getline(line)) {
         if (line.empty()) continue;
         strip_cr_inplace(line);
+        if (fp) { put(line); continue; }
+
+        const uint64_t cost = line.size() + GWAS_ROW_BYTES;
+        if (est + cost <= mem_available()) {
+            est += cost;
+            lines.push_back(line);
+            continue;
+        }
+
+        require(P.join_mode != "hash",
+                "GWAS " + G.gwas_file + " does not fit in --memory-limit; spilling needs --join merge "
+                "(position-sorted dbSNP).");
+        spill.set(spill_prefix(P.tmp_dir, G.out_file, "rsidimpu") + "lines.tmp");
+        fp = spill_open(spill.path(), "wb");
+        vbuf.resize(1u << 22);
+        setvbuf(fp, vbuf.data(), _IOFBF, vbuf.size());
+        for (const auto& l : lines) put(l);
+        std::vector<std::string>().swap(lines);
+        put(line);
+        LOG_INFO("GWAS " + G.gwas_file + " exceeds --memory-limit; spilling lines to " + spill.path());
+    }
+
+    if (fp) {
+        if (std::fclose(fp) != 0) {
+            LOG_ERROR("Error writing temporary file: " + spill.path() + " (disk full?)");
+            die(1);
+        }
+        return false;
+    }
+    resident.add(est);
+    return true;
+}
+
+//================ 读取 GWAS + QC，并把可匹配的行追加到 gwas_vec =================
+static void load_gwas_input(
+    const Args_RsidImpu& P,
+    const RowFilter& rf,
+    GwasInput& G,
+    uint32_t fid,
+    std::vector<GWASRecord>& gwas_vec
+){
+    //================ 1. 读取 GWAS header + 数据行（--cache-dir 命中时直接还原快照） =================
+    // header 非空：已由 read_gwas_budgeted 读入
+    auto& gwas_lines = G.gwas_lines;
+    if (G.header.empty()) {
+        std::string line;
+        if (!read_gwas_table(G.gwas_file, P.cache_dir, line, gwas_lines)) {
+            LOG_ERROR("Empty GWAS summary file: " + G.gwas_file);
+            die(1);
+        }
+        set_gwas_header(P, G, line);
+    }
+    const auto& header = G.header;
+
+    //================ 1.5 行过滤：被拒的行不匹配、不 QC、两个输出都不写 =================
+    std::vector<bool> keep_rf(gwas_lines.size(), true);
+    if (rf.active()) {
+        RowFilter frf = rf;            // 列位置按本文件 header
+        frf.bind(header, P);
+        frf.apply(gwas_lines, keep_rf);
+        G.keep_rf_u8.assign(keep_rf.begin(), keep_rf.end());
+    }
+
+    //================ 2. 逐行预计算 SNP span、构建 gwas_vec =================
+    // 如果需要覆盖 SNP 列，预计算每行 span
+    bool need_span = (P.format == "gwas" && G.has_SNP);
+    if (need_span) G.snp_span.reserve(gwas_lines.size());
+
+    // 一次扫描直接构建 gwas_vec，避免第二次 split
+    size_t first_rec = gwas_vec.size();
 
-        size_t idx = gwas_lines.size();
-        gwas_lines.push_back(line);
+    for (size_t idx = 0; idx < gwas_lines.size(); ++idx){
+        std::string_view lv(gwas_lines[idx]);
 
         // 预存 SNP 列位置
-        if (P.format == "gwas" && has_SNP) {
+        if (need_span) {
             uint32_t st=std::numeric_limits<uint32_t>::max(), len=0;
-            bool ok = get_col_span(std::string_view(gwas_lines.back()), idx_SNP, st, len);
+            bool ok = get_col_span(lv, G.idx_SNP, st, len);
             if (!ok) st = std::numeric_limits<uint32_t>::max();
-            snp_span.emplace_back(st, len);
+            G.snp_span.emplace_back(st, len);
         }
+        if (!keep_rf[idx]) continue;
 
         // 快解析 gCHR/gPOS/gA1/gA2 构建 gwas_vec（零拷贝 string_view
-        std::string_view lv(gwas_lines.back());
-        std::string_view vCHR, vPOS, vA1, vA2, vDummy;
-        TabState st{0,0};
-
-        int stop = std::max(std::max(gCHR, gPOS), std::max(gA1, gA2));
-        scan_upto_col(lv, stop, gCHR, gPOS, gA1, gA2, -1, vCHR, vPOS, vA1, vA2, vDummy, st);
-
-        int chr = canonical_chr_code_sv(vCHR);
-        if (chr < 0) continue;
-
+        int chr = -1;
         int64_t pos = 0;
-        if (!parse_i64(trim_ws(vPOS), pos) || pos <= 0) continue;
-
-        AlleleKey ak = make_allele_key(trim_ws(vA1), trim_ws(vA2));
-        if (ak.type == 2) continue;
+        AlleleKey ak{2, 0};
+        if (!parse_gwas_key(G, lv, chr, pos, ak)) continue;
 
         GWASRecord rec;
         rec.index  = idx;
         rec.chr    = chr;
+        rec.file   = fid;
         rec.pos    = pos;
         rec.allele = ak;
 
@@ -402,78 +501,137 @@ void process_rsidImpu(const Args_RsidImpu& P)
     }
     
     size_t n = gwas_lines.size();
-    LOG_INFO("Loaded GWAS lines (data): " + std::to_string(n));
+    LOG_INFO("Loaded GWAS lines (data): " + std::to_string(n) + " from " + G.gwas_file);
 
     //================ 基础 QC：过滤无效 N/beta/se/freq/P =================
-    double maf   = P.maf_threshold;
-
-    bool can_qc =  (idx_beta >= 0 ||
-                    idx_se   >= 0 ||
-                    idx_freq >= 0 ||
-                    idx_pv   >= 0 ||
-                    idx_n    >= 0);
-
+    bool can_qc =  (G.idx_beta >= 0 ||
+                    G.idx_se   >= 0 ||
+                    G.idx_freq >= 0 ||
+                    G.idx_pv   >= 0 ||
+                    G.idx_n    >= 0);
 
     // 内部匹配循环用 uint8_t 更快；但 QC/dup 可能还用 vector<bool> -> 做一次性转换
-    std::vector<bool> keep_qc_bool(n, true);
-    std::vector<uint8_t> keep_qc_u8(n, 1);
+    G.keep_qc_u8.assign(keep_rf.begin(), keep_rf.end());
 
     if (can_qc) {
+        std::vector<bool> keep_qc_bool = keep_rf;
         LOG_INFO("QC applied in partial-column mode.");
-        gwas_basic_qc(gwas_lines, header, idx_beta, idx_se, idx_freq, idx_pv, idx_n, keep_qc_bool, maf);
-        for (size_t i=0; i<n; ++i) keep_qc_u8[i] = keep_qc_bool[i] ? 1 : 0;
+        gwas_basic_qc_cached(G.gwas_file, P.cache_dir, gwas_lines, header,
+                      G.idx_beta, G.idx_se, G.idx_freq, G.idx_pv, G.idx_n,
+                      keep_qc_bool, P.maf_threshold);
+        for (size_t i=0; i<n; ++i) G.keep_qc_u8[i] = keep_qc_bool[i] ? 1 : 0;
     } else {
         LOG_WARN("Cannot perform full QC in rsidImpu (missing beta/se/freq/N/p columns).");
     }
 
-    //================ 构建排序用的 GWASRecord 向量 =================
-    // 按 chr, pos 排序（稳定排序）
-    std::stable_sort(gwas_vec.begin(), gwas_vec.end(),
-        [](const GWASRecord& a, const GWASRecord& b){
-            if (a.chr != b.chr) return a.chr < b.chr;
-            return a.pos < b.pos;
-        }
-    );
-
-    LOG_INFO("GWAS records sorted by CHR:POS for two-pointer matching.");
+    // QC 未通过的行不做 rsID 匹配（之后输出到 unmatch），直接不进入 merge
+    size_t w = first_rec;
+    for (size_t r = first_rec; r < gwas_vec.size(); ++r) {
+        if (G.keep_qc_u8[gwas_vec[r].index]) gwas_vec[w++] = gwas_vec[r];
+    }
+    gwas_vec.resize(w);
 
     //================ 准备匹配结果容器 =================
-    // vector<uint8_t> 替代 vector<bool>
-    std::vector<uint8_t> keep_u8(n, 0); // 是否最终进入主输出
-    std::vector<std::string> rsid_vec(n); // 匹配到的 rsID
+    G.keep_u8.assign(n, 0);
+    G.rsid_vec.assign(n, std::string());
+}
 
-    //================ 单通扫描 dbSNP（Two-pointer merge） =================
-    LineReader dbr(P.dbsnp_file);
-    std::string dline;
+// =======================================================
+// dbSNP 列定位（header 表格 / .bim 固定列）
+// =======================================================
+struct DbCols {
+    int chr = -1, pos = -1, a1 = -1, a2 = -1, rs = -1;
+};
+
+static bool dbsnp_is_bim(const Args_RsidImpu& P)
+{
+    return ends_with(P.dbsnp_file, ".bim") || ends_with(P.dbsnp_file, ".bim.gz") ||
+           ends_with(P.dbsnp_file, ".bim.zst");
+}
+
+// [VCF] "##" 开头的 meta 行，header 之前全部跳过
+static inline bool is_vcf_meta(std::string_view l)
+{
+    return l.size() >= 2 && l[0] == '#' && l[1] == '#';
+}
 
-    bool is_bim = ends_with(P.dbsnp_file, ".bim") || ends_with(P.dbsnp_file, ".bim.gz");
+// 表格格式：从 header 行定位列
+// [VCF] "#CHROM POS ID REF ALT ..." header：固定用 CHROM/POS/ID/REF/ALT，
+//       stop 列止于 ALT，INFO 列完全不扫描
+static DbCols dbsnp_columns_from_header(const Args_RsidImpu& P, const std::string& hline)
+{
+    DbCols D;
+    auto dhdr = split_tab(hline);
+
+    if (!dhdr.empty() && dhdr[0] == "#CHROM") {
+        dhdr[0] = "CHROM";
+        D.chr = find_col(dhdr, "CHROM");
+        D.pos = find_col(dhdr, "POS");
+        D.a1  = find_col(dhdr, "REF");
+        D.a2  = find_col(dhdr, "ALT");
+        D.rs  = find_col(dhdr, "ID");
+        if (D.chr<0 || D.pos<0 || D.a1<0 || D.a2<0 || D.rs<0){
+            LOG_ERROR("dbSNP VCF header incomplete (need #CHROM POS ID REF ALT).");
+            die(1);
+        }
+        LOG_INFO("dbSNP is VCF: using #CHROM/POS/ID/REF/ALT, multi-allelic ALT split on the fly.");
+        return D;
+    }
+
+    D.chr = find_col(dhdr, P.d_chr);
+    D.pos = find_col(dhdr, P.d_pos);
+    D.a1  = find_col(dhdr, P.d_A1);
+    D.a2  = find_col(dhdr, P.d_A2);
+    D.rs  = find_col(dhdr, P.d_rsid);
+
+    if (D.chr<0 || D.pos<0 || D.a1<0 || D.a2<0 || D.rs<0){
+        LOG_ERROR("dbSNP header incomplete.");
+        die(1);
+    }
+    return D;
+}
+
+// .bim / .bim.gz 格式：CHR RSID CM POS A1 A2
+static DbCols dbsnp_columns_bim()
+{
+    DbCols D;
+    D.chr = 0; D.rs = 1; D.pos = 3; D.a1 = 4; D.a2 = 5;
+    return D;
+}
 
-    int dCHR, dPOS, dA1, dA2, dRS;
-    std::vector<std::string> dhdr;
+static DbCols open_dbsnp_columns(const Args_RsidImpu& P, LineReader& dbr)
+{
+    if (dbsnp_is_bim(P)) return dbsnp_columns_bim();
 
-    if (!is_bim) {
-        // 有 header 的一般表格格式
+    // 有 header 的一般表格格式 / VCF（先跳过 ## meta 行）
+    std::string dline;
+    do {
         if (!dbr.getline(dline)) {
             LOG_ERROR("Empty dbSNP file.");
-            exit(1);
+            die(1);
         }
-        strip_cr_inplace(dline);
+    } while (is_vcf_meta(dline));
+    strip_cr_inplace(dline);
+    return dbsnp_columns_from_header(P, dline);
+}
+
+static std::string chrpos_str(int chr, int64_t pos)
+{
+    return std::to_string(chr) + ":" + std::to_string(pos);
+}
 
-        dhdr = split_tab(dline);
-        dCHR = find_col(dhdr, P.d_chr);
-        dPOS = find_col(dhdr, P.d_pos);
-        dA1  = find_col(dhdr, P.d_A1);
-        dA2  = find_col(dhdr, P.d_A2);
-        dRS  = find_col(dhdr, P.d_rsid);
+//================ 单通扫描 dbSNP（Two-pointer merge） =================
+// gwas_vec 已按 chr,pos 排序；命中结果写回 inputs[rec.file]
+static void scan_dbsnp_merge(
+    const Args_RsidImpu& P,
+    const std::vector<GWASRecord>& gwas_vec,
+    std::vector<GwasInput>& inputs
+){
+    LineReader dbr(P.dbsnp_file);
+    std::string dline;
 
-        if (dCHR<0 || dPOS<0 || dA1<0 || dA2<0 || dRS<0){
-            LOG_ERROR("dbSNP header incomplete.");
-            exit(1);
-        }
-    } else {
-        // .bim / .bim.gz 格式：CHR RSID CM POS A1 A2
-        dCHR = 0; dRS = 1; dPOS = 3; dA1 = 4; dA2 = 5;
-    }
+    DbCols D = open_dbsnp_columns(P, dbr);
+    int dCHR = D.chr, dPOS = D.pos, dA1 = D.a1, dA2 = D.a2, dRS = D.rs;
 
     LOG_INFO("Start two-pointer merge between GWAS and dbSNP.");
 
@@ -487,6 +645,9 @@ void process_rsidImpu(const Args_RsidImpu& P)
     int stop_min = std::max(dCHR, dPOS);
     int stop_all = std::max({dCHR, dPOS, dA1, dA2, dRS});
 
+    int     prev_chr = 0;
+    int64_t prev_pos = 0;
+
     while (dbr.getline(dline)){
         if (dline.empty()) continue;
         strip_cr_inplace(dline);
@@ -508,6 +669,17 @@ void process_rsidImpu(const Args_RsidImpu& P)
 
         ++scanned_valid_chrpos;
 
+        // [ORDER-CHECK] two-pointer 依赖 dbSNP 按 (chr_code, pos) 数值升序；
+        // 字典序（1,10,11,...,2）或按 rsID 排序的文件会静默漏配，这里直接报错
+        if (dchr < prev_chr || (dchr == prev_chr && dpos < prev_pos)) {
+            LOG_ERROR("dbSNP is not sorted by CHR:POS (line " + std::to_string(scanned_total) +
+                      ": " + chrpos_str(dchr, dpos) + " after " + chrpos_str(prev_chr, prev_pos) +
+                      "). Sort it numerically (chr 1..22,X,Y,MT then POS) or use --join hash.");
+            die(1);
+        }
+        prev_chr = dchr;
+        prev_pos = dpos;
+
         // two-pointer 推进
 
         while (gi < Gn &&
@@ -534,27 +706,25 @@ void process_rsidImpu(const Args_RsidImpu& P)
             scan_upto_col(lv, stop_all, dCHR, dPOS, dA1, dA2, dRS, vCHR, vPOS, vA1, vA2, vRS, st);
         }
 
-        // 等位基因规范化
-        AlleleKey db_allele = make_allele_key(trim_ws(vA1), trim_ws(vA2));
-        if (db_allele.type == 2) continue;
+        // 等位基因规范化（ALT 可为逗号分隔的多个等位基因）
+        DbAlleles db_allele(trim_ws(vA1), trim_ws(vA2));
+        if (db_allele.empty()) continue;
 
         // 可能有多个 GWAS 行在同一 chr:pos（或者多个 dbSNP 行同一 chr:pos）
-        // 对所有该位置的 GWAS 进行尝试匹配
+        // 对所有该位置的 GWAS 进行尝试匹配（批量模式下可能来自不同文件）
         size_t gj = gi;
         while (gj < Gn && 
             gwas_vec[gj].chr == dchr &&
             gwas_vec[gj].pos == dpos) {
 
-            size_t orig_idx = gwas_vec[gj].index;
-            // QC 未通过的行不做 rsID 匹配，但仍保留为 keep=false（之后输出到 unmatch）
-            if (keep_qc_u8[orig_idx] &&
-                gwas_vec[gj].allele.type == db_allele.type &&
-                gwas_vec[gj].allele.key  == db_allele.key) {
+            const GWASRecord& g = gwas_vec[gj];
+            if (db_allele.matches(g.allele)) {
 
                 // 正向匹配 || 反向匹配
-                keep_u8[orig_idx]     = 1;
+                GwasInput& G = inputs[g.file];
+                G.keep_u8[g.index] = 1;
                 // rsID 只在命中时拷贝
-                rsid_vec[orig_idx].assign(vRS.data(), vRS.size());
+                G.rsid_vec[g.index].assign(vRS.data(), vRS.size());
             }
             ++gj;
         }
@@ -566,127 +736,2093 @@ void process_rsidImpu(const Args_RsidImpu& P)
 
     LOG_INFO("Two-pointer merge finished. dbSNP lines scanned: " + std::to_string(scanned_total) +
             ", valid CHR/POS lines: " + std::to_string(scanned_valid_chrpos));
+}
 
-    //================ 去重（按 rsID / P 值） =================
-    if (P.remove_dup_snp) {
-        std::vector<bool> keep_bool(n, false);
-        for(size_t i=0; i<n; ++i) keep_bool[i] = (keep_u8[i] != 0);
+// =======================================================
+// [RANGE-SCAN] 未压缩 dbSNP：mmap 后按换行对齐切成多段，各段并行 two-pointer
+// 每段用第一条合法行的 (chr,pos) 在 gwas_vec 中二分定位起点；
+// 命中先存在段内，最后按段序回写（与单线程“后者覆盖”语义一致）
+// =======================================================
+struct RangeHit {
+    uint32_t rec;           // gwas_vec 下标
+    std::string_view rs;    // 指向 mmap 区域
+};
 
-        gwas_remove_dup(
-            gwas_lines,
-            header,
-            idx_pv,
-            rsid_vec,
-            keep_bool
-        );
-        for (size_t i=0;i<n;++i) keep_u8[i] = keep_bool[i] ? 1 : 0;
+struct RangeResult {
+    std::vector<RangeHit> hits;
+    uint64_t lines = 0;
+    uint64_t valid = 0;
+    uint64_t skipped_bytes = 0;   // [GALLOP] 未解析直接跳过的字节数
+
+    // 段内首/末合法行（用于段间顺序校验）
+    bool    any = false;
+    int     first_chr = 0, last_chr = 0;
+    int64_t first_pos = 0, last_pos = 0;
+
+    // 段内顺序错误（第一处）
+    bool    unsorted = false;
+    int     bad_chr = 0, prev_chr = 0;
+    int64_t bad_pos = 0, prev_pos = 0;
+};
+
+static inline bool key_less(int c1, int64_t p1, int c2, int64_t p2)
+{
+    return c1 < c2 || (c1 == c2 && p1 < p2);
+}
+
+// 解析一行 dbSNP 的 CHR/POS（只扫到 stop_min）；非法行返回 false
+static inline bool parse_db_chrpos(std::string_view lv, const DbCols& D, int stop_min,
+                                   int& dchr, int64_t& dpos)
+{
+    std::string_view vCHR, vPOS, vA1, vA2, vRS;
+    TabState st{0,0};
+    scan_upto_col(lv, stop_min, D.chr, D.pos, D.a1, D.a2, D.rs, vCHR, vPOS, vA1, vA2, vRS, st);
+
+    dchr = canonical_chr_code_sv(vCHR);
+    if (dchr < 0) return false;
+    dpos = 0;
+    return parse_i64(trim_ws(vPOS), dpos) && dpos > 0;
+}
+
+// =======================================================
+// [GALLOP] 稀疏 GWAS：下一个 GWAS 位置远在后面时，不逐行解析，
+// 而是在字节偏移上指数 + 二分查找第一条 key >= target 的行
+// =======================================================
+struct GallopProbe {
+    const char* beg;     // 段起点（行首）
+    const char* end;     // 段终点
+    const DbCols& D;
+    int stop_min;
+
+    // q 之后（含 q）的第一个行首
+    inline const char* line_start_at(const char* q) const {
+        if (q <= beg) return beg;
+        if (q >= end) return end;
+        if (q[-1] == '\n') return q;
+        const char* nl = static_cast<const char*>(memchr(q, '\n', (size_t)(end - q)));
+        return nl ? nl + 1 : end;
     }
-    
-    //================ Writer（自动 txt / gz） =================
-    bool out_is_gz = ends_with(P.out_file, ".gz");
 
-    std::string out_main    = P.out_file;
-    std::string base        = P.out_file;
-    if (out_is_gz && base.size() > 3) {
-        base.erase(base.size() - 3);  // 去掉 ".gz"
+    inline const char* next_line(const char* ls) const {
+        const char* nl = static_cast<const char*>(memchr(ls, '\n', (size_t)(end - ls)));
+        return nl ? nl + 1 : end;
     }
-    std::string out_unmatch = out_is_gz ? (base + ".unmatch.gz") : (P.out_file + ".unmatch");
-    
-    Writer fout(out_main, P.format);
-    Writer funm(out_unmatch, P.format);
 
-    if (!fout.good() || !funm.good()) {
-        LOG_ERROR("Error opening output file.");
-        exit(1);
+    // 从行首 ls 起找第一条 CHR/POS 合法的行（不超过 limit）；
+    // 返回该行行首，并给出 key；没有则返回 limit
+    inline const char* first_valid(const char* ls, const char* limit, int& c, int64_t& pos) const {
+        while (ls < limit) {
+            const char* nx = next_line(ls);
+            std::string_view lv(ls, (size_t)(nx - ls));
+            if (!lv.empty() && lv.back() == '\n') lv.remove_suffix(1);
+            if (!lv.empty() && lv.back() == '\r') lv.remove_suffix(1);
+            if (!lv.empty() && parse_db_chrpos(lv, D, stop_min, c, pos)) return ls;
+            ls = nx;
+        }
+        return limit;
     }
-    
-    FormatEngine FE;
-    FormatSpec spec = FE.get_format(P.format);
 
-    // header
-    if (P.format == "gwas") {
-        // 原始 header + SNP
-        std::string h;
-        for (size_t j=0; j<header.size(); j++) {
-            if (j) h += "\t";
-            h += header[j];
+    // 已知 lo 之前的行 key 都 < target；返回第一条 key >= target 的行首（或 end）
+    const char* seek(const char* lo, int tchr, int64_t tpos) const {
+        // 1) 指数探测上界
+        size_t step = 4096;
+        const char* hi = end;
+        while (true) {
+            const char* q = (size_t)(end - lo) > step ? lo + step : end;
+            const char* ls = line_start_at(q);
+            int c = 0; int64_t pos = 0;
+            const char* v = first_valid(ls, end, c, pos);
+            if (v >= end) { hi = end; break; }
+            if (key_less(c, pos, tchr, tpos)) {
+                lo = next_line(v);
+                step <<= 1;
+            } else {
+                hi = v;
+                break;
+            }
         }
-        if (!has_SNP) h += "\tSNP";
-        fout.write_line(h);
-    } else {
-        // 格式化 header
-        std::string h;
-        for (size_t j=0; j<spec.cols.size(); j++) {
-            if (j) h += "\t";
-            h += spec.cols[j];
+
+        // 2) [lo, hi) 内二分；区间很小时交回逐行扫描
+        while ((size_t)(hi - lo) > 1024) {
+            const char* ls = line_start_at(lo + (hi - lo) / 2);
+            if (ls >= hi) break;
+            int c = 0; int64_t pos = 0;
+            const char* v = first_valid(ls, hi, c, pos);
+            if (v >= hi) { hi = ls; continue; }   // [ls, hi) 全是非法行
+            if (key_less(c, pos, tchr, tpos)) lo = next_line(v);
+            else                               hi = v;
         }
-        fout.write_line(h);
+        return lo;
     }
+};
 
-    // ================= 9) 输出 =================
-    // 不再每行建 unordered_map；使用 FormatEngine fast path
+static void scan_range(
+    const char* beg, const char* end,
+    const DbCols& D,
+    const std::vector<GWASRecord>& gwas_vec,
+    RangeResult& R
+){
+    const int stop_min = std::max(D.chr, D.pos);
+    const int stop_all = std::max({D.chr, D.pos, D.a1, D.a2, D.rs});
+    const size_t Gn = gwas_vec.size();
+    size_t gi = 0;
 
-    // 计算扫描 stop_col（只在 format != gwas 时用）
-    int stop_out = gA1;
-    stop_out = std::max(stop_out, gA2);
-    stop_out = std::max(stop_out, idx_freq);
-    stop_out = std::max(stop_out, idx_beta);
-    stop_out = std::max(stop_out, idx_se);
-    stop_out = std::max(stop_out, idx_pv);
-    stop_out = std::max(stop_out, idx_n);
-    
-    for(size_t i=0; i<n; i++){
-        if (!keep_u8[i]){
-            funm.write_line(gwas_lines[i]);
-            continue;
+    // 连续 GALLOP_AFTER 行未命中才开始跳跃：稠密 GWAS 基本不触发，几乎无额外开销
+    const int GALLOP_AFTER = 16;
+    int misses = 0;
+    GallopProbe gp{beg, end, D, stop_min};
+
+    const char* p = beg;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', (size_t)(end - p)));
+        const char* le = nl ? nl : end;
+
+        std::string_view lv(p, (size_t)(le - p));
+        p = nl ? nl + 1 : end;
+
+        if (!lv.empty() && lv.back() == '\r') lv.remove_suffix(1);
+        if (lv.empty()) continue;
+        ++R.lines;
+
+        std::string_view vCHR, vPOS, vA1, vA2, vRS;
+        TabState st{0,0};
+        scan_upto_col(lv, stop_min, D.chr, D.pos, D.a1, D.a2, D.rs, vCHR, vPOS, vA1, vA2, vRS, st);
+
+        int dchr = canonical_chr_code_sv(vCHR);
+        if (dchr < 0) continue;
+
+        int64_t dpos = 0;
+        if (!parse_i64(trim_ws(vPOS), dpos) || dpos <= 0) continue;
+        ++R.valid;
+
+        if (!R.any) {
+            R.any = true;
+            R.first_chr = dchr;
+            R.first_pos = dpos;
+
+            // 二分定位本段在 gwas_vec 中的起点
+            gi = std::lower_bound(gwas_vec.begin(), gwas_vec.end(), std::make_pair(dchr, dpos),
+                    [](const GWASRecord& g, const std::pair<int, int64_t>& k){
+                        return key_less(g.chr, g.pos, k.first, k.second);
+                    }) - gwas_vec.begin();
+        } else if (key_less(dchr, dpos, R.last_chr, R.last_pos)) {
+            R.unsorted = true;
+            R.bad_chr  = dchr;      R.bad_pos  = dpos;
+            R.prev_chr = R.last_chr; R.prev_pos = R.last_pos;
+            return;
         }
+        R.last_chr = dchr;
+        R.last_pos = dpos;
 
-        if (P.format == "gwas"){
-            if (has_SNP) {
-                // 直接用 span 替换 SNP 列（避免每次 find tab）
-                if (P.format == "gwas" && has_SNP && i < snp_span.size()) {
-                    auto [st, len] = snp_span[i];
-                    if (st != std::numeric_limits<uint32_t>::max()) {
-                        gwas_lines[i].replace((size_t)st, (size_t)len, rsid_vec[i]);
-                    } else {
-                        // ✅ 兜底：再算一次 span（防止预计算失败）
-                        uint32_t st2=0, len2=0;
-                        if (get_col_span(std::string_view(gwas_lines[i]), idx_SNP, st2, len2)) {
-                            gwas_lines[i].replace((size_t)st2, (size_t)len2, rsid_vec[i]);
-                        } else {
-                            // ✅ 最终兜底：慢一点但不会错
-                            replace_nth_column_inplace(gwas_lines[i], idx_SNP, rsid_vec[i]);
-                        }
-                    }
-                }
-                fout.write_line(gwas_lines[i]);
-            } else {
-                fout.write_line(gwas_lines[i] + "\t" + rsid_vec[i]);
+        // two-pointer 推进
+        while (gi < Gn && key_less(gwas_vec[gi].chr, gwas_vec[gi].pos, dchr, dpos)) ++gi;
+        if (gi >= Gn) return;   // 本段之后不可能再命中
+
+        if (gwas_vec[gi].chr != dchr || gwas_vec[gi].pos != dpos) {
+            // [GALLOP] 直接跳到第一条 key >= 下一个 GWAS 位置的行
+            if (++misses >= GALLOP_AFTER) {
+                misses = 0;
+                const char* q = gp.seek(p, gwas_vec[gi].chr, gwas_vec[gi].pos);
+                R.skipped_bytes += (uint64_t)(q - p);
+                p = q;
             }
             continue;
         }
+        misses = 0;
 
-        // format != gwas: 快解析需要的列
-        std::string_view lv(gwas_lines[i]);
-        std::string_view vA1, vA2, vFreq, vBeta, vSe, vP, vN;
-        TabState st{0,0};
+        // 命中候选：再解析剩余列（A1/A2/RS）
+        if (stop_all > stop_min){
+            scan_upto_col(lv, stop_all, D.chr, D.pos, D.a1, D.a2, D.rs, vCHR, vPOS, vA1, vA2, vRS, st);
+        }
+
+        DbAlleles db_allele(trim_ws(vA1), trim_ws(vA2));
+        if (db_allele.empty()) continue;
+
+        for (size_t gj = gi;
+             gj < Gn && gwas_vec[gj].chr == dchr && gwas_vec[gj].pos == dpos; ++gj) {
+            if (db_allele.matches(gwas_vec[gj].allele)) {
+                R.hits.push_back({(uint32_t)gj, vRS});
+            }
+        }
+    }
+}
+
+static void scan_dbsnp_ranges(
+    const Args_RsidImpu& P,
+    const std::vector<GWASRecord>& gwas_vec,
+    std::vector<GwasInput>& inputs
+){
+    require(gwas_vec.size() < std::numeric_limits<uint32_t>::max(),
+            "Too many GWAS records for range-parallel scan.");
+
+    MappedFile mf(P.dbsnp_file);
+    const char* data = mf.data();
+    const char* fend = data + mf.size();
+
+    // header（.bim 无 header）
+    DbCols D;
+    const char* body = data;
+    if (dbsnp_is_bim(P)) {
+        D = dbsnp_columns_bim();
+    } else {
+        // 跳过 VCF ## meta 行，定位 header 行
+        const char* h = data;
+        const char* nl = nullptr;
+        while (true) {
+            if (!h || h >= fend) {
+                LOG_ERROR("Empty dbSNP file.");
+                die(1);
+            }
+            nl = static_cast<const char*>(memchr(h, '\n', (size_t)(fend - h)));
+            std::string_view hv(h, nl ? (size_t)(nl - h) : (size_t)(fend - h));
+            if (!is_vcf_meta(hv)) break;
+            h = nl ? nl + 1 : fend;
+        }
+        std::string hline(h, nl ? (size_t)(nl - h) : (size_t)(fend - h));
+        strip_cr_inplace(hline);
+        D = dbsnp_columns_from_header(P, hline);
+        body = nl ? nl + 1 : fend;
+    }
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = std::max(1, omp_get_max_threads());
+#endif
+    // 段数多于线程数 + dynamic 调度：GWAS 在基因组上分布不均时负载更平衡
+    size_t nranges = (nthreads > 1) ? (size_t)nthreads * 4 : 1;
+    size_t body_len = (size_t)(fend - body);
+    if (body_len < nranges * 4096) nranges = std::max<size_t>(1, body_len / 4096);
+
+    // 段边界：对齐到下一行行首
+    std::vector<const char*> cut(nranges + 1);
+    cut[0] = body;
+    cut[nranges] = fend;
+    for (size_t k = 1; k < nranges; ++k) {
+        const char* q = body + body_len / nranges * k;
+        if (q < cut[k-1]) q = cut[k-1];
+        const char* nl = static_cast<const char*>(memchr(q, '\n', (size_t)(fend - q)));
+        cut[k] = nl ? nl + 1 : fend;
+    }
+
+    LOG_INFO("Start mmap two-pointer merge on uncompressed dbSNP (" +
+             std::to_string(nranges) + " ranges, " + std::to_string(nthreads) + " threads).");
+
+    std::vector<RangeResult> res(nranges);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t k = 0; k < nranges; ++k) {
+        scan_range(cut[k], cut[k+1], D, gwas_vec, res[k]);
+    }
+
+    // 顺序校验：段内 + 相邻段边界
+    const RangeResult* prev = nullptr;
+    for (const auto& R : res) {
+        if (R.unsorted) {
+            LOG_ERROR("dbSNP is not sorted by CHR:POS (" + chrpos_str(R.bad_chr, R.bad_pos) +
+                      " after " + chrpos_str(R.prev_chr, R.prev_pos) +
+                      "). Sort it numerically (chr 1..22,X,Y,MT then POS) or use --join hash.");
+            die(1);
+        }
+        if (!R.any) continue;
+        if (prev && key_less(R.first_chr, R.first_pos, prev->last_chr, prev->last_pos)) {
+            LOG_ERROR("dbSNP is not sorted by CHR:POS (" + chrpos_str(R.first_chr, R.first_pos) +
+                      " after " + chrpos_str(prev->last_chr, prev->last_pos) +
+                      "). Sort it numerically (chr 1..22,X,Y,MT then POS) or use --join hash.");
+            die(1);
+        }
+        prev = &R;
+    }
+
+    // 按段序回写
+    uint64_t scanned_total = 0, scanned_valid_chrpos = 0, skipped = 0;
+    for (const auto& R : res) {
+        scanned_total += R.lines;
+        scanned_valid_chrpos += R.valid;
+        skipped += R.skipped_bytes;
+        for (const auto& h : R.hits) {
+            const GWASRecord& g = gwas_vec[h.rec];
+            GwasInput& G = inputs[g.file];
+            G.keep_u8[g.index] = 1;
+            G.rsid_vec[g.index].assign(h.rs.data(), h.rs.size());
+        }
+    }
+
+    LOG_INFO("mmap merge finished. dbSNP lines parsed: " + std::to_string(scanned_total) +
+            ", valid CHR/POS lines: " + std::to_string(scanned_valid_chrpos) +
+            ", skipped without parsing: " + std::to_string(skipped >> 20) + " MB of " +
+            std::to_string(body_len >> 20) + " MB.");
+}
+
+// =======================================================
+// [HASH-JOIN] (chr,pos) -> gwas_vec 区间 的开放寻址哈希表
+// gwas_vec 已排序，同一位置的记录连续：只存 [start, start+cnt)
+// =======================================================
+struct PosHashTable {
+    struct Slot {
+        uint64_t key   = 0;   // 0 = 空槽（chr_code >= 1，合法 key 不会为 0）
+        uint32_t start = 0;
+        uint32_t cnt   = 0;
+    };
+
+    std::vector<Slot> slots;
+    uint64_t mask = 0;
+
+    static inline uint64_t make_key(int chr, int64_t pos){
+        return (uint64_t(chr) << 40) | uint64_t(pos);
+    }
+
+    static inline uint64_t mix(uint64_t k){
+        k ^= k >> 33;
+        k *= 0xff51afd7ed558ccdULL;
+        k ^= k >> 33;
+        return k;
+    }
+
+    void build(const std::vector<GWASRecord>& v){
+        require(v.size() < std::numeric_limits<uint32_t>::max(),
+                "Too many GWAS records for --join hash.");
+
+        size_t uniq = 0;
+        for (size_t i = 0; i < v.size(); ++i) {
+            if (i == 0 || v[i].chr != v[i-1].chr || v[i].pos != v[i-1].pos) ++uniq;
+        }
+
+        size_t cap = 16;
+        while (cap < uniq * 2) cap <<= 1;   // 负载 <= 0.5，线性探测足够短
+        slots.assign(cap, Slot{});
+        mask = cap - 1;
+
+        for (size_t i = 0; i < v.size(); ) {
+            size_t j = i;
+            while (j < v.size() && v[j].chr == v[i].chr && v[j].pos == v[i].pos) ++j;
 
-        scan_upto_col7(lv, stop_out,
-                       gA1, gA2, idx_freq, idx_beta, idx_se, idx_pv, idx_n,
-                       vA1, vA2, vFreq, vBeta, vSe, vP, vN, st);
-
-        // 使用 FormatEngine fast path
-        FormatEngine::RowView row;
-        row.SNP  = {std::string_view(rsid_vec[i]), true};
-        row.A1   = {trim_ws(vA1), true};
-        row.A2   = {trim_ws(vA2), true};
-
-        row.freq = {trim_ws(vFreq), idx_freq >= 0};
-        row.beta = {trim_ws(vBeta), idx_beta >= 0};
-        row.se   = {trim_ws(vSe),   idx_se   >= 0};
-        row.p    = {trim_ws(vP),    idx_pv   >= 0};
-        row.N    = {trim_ws(vN),    idx_n    >= 0};
-        
-        fout.write_line(FE.format_line_fast(spec, row)); 
-    }
-}
\ No newline at end of file
+            if (v[i].pos < (int64_t(1) << 40)) {
+                uint64_t key = make_key(v[i].chr, v[i].pos);
+                size_t h = mix(key) & mask;
+                while (slots[h].key != 0) h = (h + 1) & mask;
+                slots[h] = {key, (uint32_t)i, (uint32_t)(j - i)};
+            }
+            i = j;
+        }
+    }
+
+    inline const Slot* find(int chr, int64_t pos) const {
+        if (pos >= (int64_t(1) << 40)) return nullptr;
+        uint64_t key = make_key(chr, pos);
+        size_t h = mix(key) & mask;
+        while (true) {
+            const Slot& s = slots[h];
+            if (s.key == key) return &s;
+            if (s.key == 0)   return nullptr;
+            h = (h + 1) & mask;
+        }
+    }
+};
+
+//================ 哈希连接扫描 dbSNP（任意顺序） =================
+// 主线程按块读 dbSNP（后台预读下一块），OpenMP 并行解析 + 探测哈希表；
+// 命中按 dbSNP 行序回写，结果与 two-pointer 完全一致（同一行被多次命中时后者覆盖）
+static void scan_dbsnp_hash(
+    const Args_RsidImpu& P,
+    const std::vector<GWASRecord>& gwas_vec,
+    std::vector<GwasInput>& inputs
+){
+    PosHashTable H;
+    H.build(gwas_vec);
+
+    LineReader dbr(P.dbsnp_file);
+    DbCols D = open_dbsnp_columns(P, dbr);
+    int dCHR = D.chr, dPOS = D.pos, dA1 = D.a1, dA2 = D.a2, dRS = D.rs;
+
+    int stop_min = std::max(dCHR, dPOS);
+    int stop_all = std::max({dCHR, dPOS, dA1, dA2, dRS});
+
+    LOG_INFO("Start hash join between GWAS and dbSNP (dbSNP may be in any order).");
+
+    // 行字符串跨块复用，避免反复分配
+    const size_t BLOCK = 1 << 16;
+    std::vector<std::string> cur(BLOCK), next(BLOCK);
+
+    auto read_block = [&dbr, BLOCK](std::vector<std::string>& blk) -> size_t {
+        size_t k = 0;
+        while (k < BLOCK && dbr.getline(blk[k])) {
+            if (blk[k].empty()) continue;
+            strip_cr_inplace(blk[k]);
+            ++k;
+        }
+        return k;
+    };
+
+    struct HashHit {
+        uint32_t rec;           // gwas_vec 下标
+        std::string_view rs;    // 指向当前块的行
+    };
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = std::max(1, omp_get_max_threads());
+#endif
+    std::vector<std::vector<HashHit>> hits(nthreads);
+
+    uint64_t scanned_total = 0;
+    uint64_t scanned_valid_chrpos = 0;
+    uint64_t next_report = 1000000ULL;
+
+    size_t ncur = read_block(cur);
+    while (ncur > 0) {
+        // 后台预读下一块（LineReader 仅被该线程使用）
+        auto fut = std::async(std::launch::async, [&]{ return read_block(next); });
+
+        for (auto& h : hits) h.clear();
+        uint64_t valid = 0;
+
+        #pragma omp parallel reduction(+:valid)
+        {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            auto& my_hits = hits[tid];
+
+            // schedule(static)：线程 t 处理第 t 段连续行，按线程序拼接即为行序
+            #pragma omp for schedule(static)
+            for (size_t k = 0; k < ncur; ++k) {
+                std::string_view lv(cur[k]);
+                std::string_view vCHR, vPOS, vA1, vA2, vRS;
+                TabState st{0,0};
+
+                scan_upto_col(lv, stop_min, dCHR, dPOS, dA1, dA2, dRS, vCHR, vPOS, vA1, vA2, vRS, st);
+
+                int dchr = canonical_chr_code_sv(vCHR);
+                if (dchr < 0) continue;
+
+                int64_t dpos = 0;
+                if (!parse_i64(trim_ws(vPOS), dpos) || dpos <= 0) continue;
+                ++valid;
+
+                const PosHashTable::Slot* slot = H.find(dchr, dpos);
+                if (!slot) continue;
+
+                if (stop_all > stop_min){
+                    scan_upto_col(lv, stop_all, dCHR, dPOS, dA1, dA2, dRS, vCHR, vPOS, vA1, vA2, vRS, st);
+                }
+
+                DbAlleles db_allele(trim_ws(vA1), trim_ws(vA2));
+                if (db_allele.empty()) continue;
+
+                for (uint32_t r = slot->start; r < slot->start + slot->cnt; ++r) {
+                    const GWASRecord& g = gwas_vec[r];
+                    if (db_allele.matches(g.allele)) {
+                        my_hits.push_back({r, vRS});
+                    }
+                }
+            }
+        }
+
+        // 按行序回写（单线程，无竞争）
+        for (const auto& th : hits) {
+            for (const auto& h : th) {
+                const GWASRecord& g = gwas_vec[h.rec];
+                GwasInput& G = inputs[g.file];
+                G.keep_u8[g.index] = 1;
+                G.rsid_vec[g.index].assign(h.rs.data(), h.rs.size());
+            }
+        }
+
+        scanned_total += ncur;
+        scanned_valid_chrpos += valid;
+        if (scanned_total >= next_report) {
+            LOG_INFO("[dbSNP hash join] scanned " + std::to_string(scanned_total/1000000ULL) + "M lines.");
+            next_report = (scanned_total / 1000000ULL + 1) * 1000000ULL;
+        }
+
+        ncur = fut.get();
+        std::swap(cur, next);
+    }
+
+    LOG_INFO("Hash join finished. dbSNP lines scanned: " + std::to_string(scanned_total) +
+            ", valid CHR/POS lines: " + std::to_string(scanned_valid_chrpos));
+}
+
+// out.txt -> out.txt.unmatch；out.txt.gz -> out.txt.unmatch.gz（.zst 同理）
+static std::string unmatch_path(const std::string& out_file)
+{
+    if (out_file == "-") return "/dev/null";   // --out -：stdout 只放主输出，未匹配行丢弃
+    std::string_view z = compress_suffix(out_file);
+    if (!z.empty() && out_file.size() > z.size()) {
+        return out_file.substr(0, out_file.size() - z.size()) + ".unmatch" + std::string(z);
+    }
+    return out_file + ".unmatch";
+}
+
+//================ 主输出 header =================
+static void write_output_header(
+    const Args_RsidImpu& P, const GwasInput& G, const FormatSpec& spec, Writer& fout)
+{
+    std::string h;
+    if (P.format == "gwas") {
+        // 原始 header + SNP
+        for (size_t j=0; j<G.header.size(); j++) {
+            if (j) h += "\t";
+            h += G.header[j];
+        }
+        if (!G.has_SNP) h += "\tSNP";
+    } else {
+        // 格式化 header
+        for (size_t j=0; j<spec.cols.size(); j++) {
+            if (j) h += "\t";
+            h += spec.cols[j];
+        }
+    }
+    fout.write_line(h);
+}
+
+//================ 写一条命中行（gwas: 替换/追加 SNP 列；其他: FormatEngine） =================
+// span 为预计算的 SNP 列位置（可为 nullptr，此时现算）；gwas 格式会原地改写 line
+static void write_matched_row(
+    const Args_RsidImpu& P,
+    const GwasInput& G,
+    const FormatEngine& FE,
+    const FormatSpec& spec,
+    Writer& fout,
+    std::string& line,
+    const std::string& rsid,
+    const std::pair<uint32_t, uint32_t>* span,
+    std::string_view chr_fill = {},
+    std::string_view pos_fill = {}
+){
+    if (fout.is_split()) {                         // --split-by-chr：按本行 CHR 分发（先于改写 SNP 列）
+        uint32_t cs = 0, cl = 0;
+        std::string_view c = chr_fill;
+        if (c.empty() && get_col_span(std::string_view(line), G.gCHR, cs, cl))
+            c = std::string_view(line).substr(cs, cl);
+        fout.select_chr(canonical_chr_code_sv(trim_ws(c)));
+    }
+
+    if (P.format == "gwas"){
+        if (G.has_SNP) {
+            // 直接用 span 替换 SNP 列（避免每次 find tab）
+            if (span && span->first != std::numeric_limits<uint32_t>::max()) {
+                line.replace((size_t)span->first, (size_t)span->second, rsid);
+            } else {
+                // ✅ 兜底：再算一次 span（防止预计算失败）
+                uint32_t st2=0, len2=0;
+                if (get_col_span(std::string_view(line), G.idx_SNP, st2, len2)) {
+                    line.replace((size_t)st2, (size_t)len2, rsid);
+                } else {
+                    // ✅ 最终兜底：慢一点但不会错
+                    replace_nth_column_inplace(line, G.idx_SNP, rsid);
+                }
+            }
+            fout.write_line(line);
+        } else {
+            fout.write_line(line + "\t" + rsid);
+        }
+        return;
+    }
+
+    // 计算扫描 stop_col（只在 format != gwas 时用）
+    int stop_out = G.gA1;
+    stop_out = std::max(stop_out, G.gA2);
+    stop_out = std::max(stop_out, G.idx_freq);
+    stop_out = std::max(stop_out, G.idx_beta);
+    stop_out = std::max(stop_out, G.idx_se);
+    stop_out = std::max(stop_out, G.idx_pv);
+    stop_out = std::max(stop_out, G.idx_n);
+
+    // format != gwas: 快解析需要的列
+    std::string_view lv(line);
+    std::string_view vA1, vA2, vFreq, vBeta, vSe, vP, vN;
+    TabState st{0,0};
+
+    scan_upto_col7(lv, stop_out,
+                   G.gA1, G.gA2, G.idx_freq, G.idx_beta, G.idx_se, G.idx_pv, G.idx_n,
+                   vA1, vA2, vFreq, vBeta, vSe, vP, vN, st);
+
+    // 使用 FormatEngine fast path（不再每行建 unordered_map）
+    FormatEngine::RowView row;
+    row.SNP  = {std::string_view(rsid), true};
+    row.A1   = {trim_ws(vA1), true};
+    row.A2   = {trim_ws(vA2), true};
+
+    row.freq = {trim_ws(vFreq), G.idx_freq >= 0};
+    row.beta = {trim_ws(vBeta), G.idx_beta >= 0};
+    row.se   = {trim_ws(vSe),   G.idx_se   >= 0};
+    row.p    = {trim_ws(vP),    G.idx_pv   >= 0};
+    row.N    = {trim_ws(vN),    G.idx_n    >= 0};
+    
+    if (spec.needs_chrpos) {   // arrow：CHR/POS 取调用方给的值（reverse），否则取原列
+        uint32_t cs = 0, cl = 0;
+        if (!chr_fill.empty())                              row.CHR = {chr_fill, true};
+        else if (get_col_span(lv, G.gCHR, cs, cl))          row.CHR = {trim_ws(lv.substr(cs, cl)), true};
+        if (!pos_fill.empty())                              row.POS = {pos_fill, true};
+        else if (get_col_span(lv, G.gPOS, cs, cl))          row.POS = {trim_ws(lv.substr(cs, cl)), true};
+    }
+
+    char zbuf[32];
+    if (spec.needs_z) FormatEngine::fill_z(row, zbuf, sizeof zbuf);   // ldsc
+    FE.append_line_fast(spec, row, fout.buffer());   // fast path：直接进 Writer 缓冲
+    fout.flush_if_full();
+}
+
+//================ 去重 + 写出一个 GWAS 的 matched / unmatched =================
+static void write_gwas_outputs(const Args_RsidImpu& P, GwasInput& G)
+{
+    const size_t n = G.gwas_lines.size();
+    auto& gwas_lines = G.gwas_lines;
+    auto& keep_u8    = G.keep_u8;
+    auto& rsid_vec   = G.rsid_vec;
+    const auto& header = G.header;
+
+    size_t matched = 0;
+    for (size_t i=0; i<n; ++i) matched += keep_u8[i];
+    LOG_INFO("Matched rsID: " + std::to_string(matched) + " / " + std::to_string(n) +
+             " (" + G.gwas_file + ")");
+
+    //================ 去重（按 rsID / P 值） =================
+    if (P.remove_dup_snp) {
+        std::vector<bool> keep_bool(n, false);
+        for(size_t i=0; i<n; ++i) keep_bool[i] = (keep_u8[i] != 0);
+
+        gwas_remove_dup(
+            gwas_lines,
+            header,
+            G.idx_pv,
+            rsid_vec,
+            keep_bool
+        );
+        for (size_t i=0;i<n;++i) keep_u8[i] = keep_bool[i] ? 1 : 0;
+    }
+    
+    //================ Writer（自动 txt / gz） =================
+    std::string out_main    = G.out_file;
+    std::string out_unmatch = unmatch_path(G.out_file);
+    
+    Writer fout(out_main, P.format, P.split_by_chr);
+    Writer funm(out_unmatch, "gwas");          // 未匹配行：原始文本
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
+
+    if (!fout.good() || !funm.good()) {
+        LOG_ERROR("Error opening output file.");
+        die(1);
+    }
+    
+    FormatEngine FE;
+    FormatSpec spec = FE.get_format(P.format);
+
+    write_output_header(P, G, spec, fout);
+
+    // ================= 9) 输出 =================
+    for(size_t i=0; i<n; i++){
+        if (!G.keep_rf_u8.empty() && !G.keep_rf_u8[i]) continue;
+        if (!keep_u8[i]){
+            funm.write_line(gwas_lines[i]);
+            continue;
+        }
+
+        const std::pair<uint32_t, uint32_t>* span = (i < G.snp_span.size()) ? &G.snp_span[i] : nullptr;
+        write_matched_row(P, G, FE, spec, fout, gwas_lines[i], rsid_vec[i], span);
+    }
+}
+
+// =======================================================
+// [STREAM] GWAS 已按 CHR:POS 排序：GWAS 与 dbSNP 同步流式 merge join
+// 只缓存 dbSNP 当前位置的一组行，内存与 GWAS 大小无关
+// =======================================================
+struct DbGroupEntry {
+    AlleleKey   allele;
+    std::string rsid;
+};
+
+class DbSnpStream {
+public:
+    // mode：哪种用法要求 dbSNP 按位置排序（出现在排序错误信息里）
+    DbSnpStream(const Args_RsidImpu& P, std::string mode) : dbr_(P.dbsnp_file), mode_(std::move(mode)) {
+        D_ = open_dbsnp_columns(P, dbr_);
+        stop_min_ = std::max(D_.chr, D_.pos);
+        stop_all_ = std::max({D_.chr, D_.pos, D_.a1, D_.a2, D_.rs});
+        advance();
+    }
+
+    // 返回 (chr,pos) 处的全部 dbSNP 行；调用须按 (chr,pos) 非降序
+    const std::vector<DbGroupEntry>& group_at(int chr, int64_t pos) {
+        if (group_valid_ && group_chr_ == chr && group_pos_ == pos) return group_;
+
+        group_.clear();
+        group_valid_ = true;
+        group_chr_   = chr;
+        group_pos_   = pos;
+
+        while (has_pending_ &&
+               (pend_chr_ < chr || (pend_chr_ == chr && pend_pos_ < pos))) {
+            advance();
+        }
+
+        while (has_pending_ && pend_chr_ == chr && pend_pos_ == pos) {
+            // 命中候选：再解析剩余列（A1/A2/RS）
+            if (stop_all_ > stop_min_){
+                scan_upto_col(std::string_view(pline_), stop_all_, D_.chr, D_.pos, D_.a1, D_.a2, D_.rs,
+                              vCHR_, vPOS_, vA1_, vA2_, vRS_, st_);
+            }
+            // 多等位位点：每个 ALT 一条（同一 rsID）
+            for_each_alt_key(trim_ws(vA1_), trim_ws(vA2_), [&](const AlleleKey& k){
+                group_.push_back({k, std::string(vRS_)});
+                return false;
+            });
+            advance();
+        }
+        return group_;
+    }
+
+    uint64_t scanned() const { return scanned_total_; }
+
+    // 排序校验失败、die 之前调用（调用方借此删除已写出的部分输出）
+    void on_abort(std::function<void()> f) { on_abort_ = std::move(f); }
+
+private:
+    // 读下一条 CHR/POS 合法的 dbSNP 行到 pending（只解析到 stop_min）
+    void advance() {
+        has_pending_ = false;
+        while (dbr_.getline(pline_)) {
+            if (pline_.empty()) continue;
+            strip_cr_inplace(pline_);
+            ++scanned_total_;
+
+            vCHR_ = vPOS_ = vA1_ = vA2_ = vRS_ = std::string_view();
+            st_ = TabState{0,0};
+            scan_upto_col(std::string_view(pline_), stop_min_, D_.chr, D_.pos, D_.a1, D_.a2, D_.rs,
+                          vCHR_, vPOS_, vA1_, vA2_, vRS_, st_);
+
+            int dchr = canonical_chr_code_sv(vCHR_);
+            if (dchr < 0) continue;
+
+            int64_t dpos = 0;
+            if (!parse_i64(trim_ws(vPOS_), dpos) || dpos <= 0) continue;
+
+            // [ORDER-CHECK] 同 two-pointer
+            if (dchr < pend_chr_ || (dchr == pend_chr_ && dpos < pend_pos_)) {
+                LOG_ERROR("dbSNP is not sorted by CHR:POS (line " + std::to_string(scanned_total_) +
+                          ": " + chrpos_str(dchr, dpos) + " after " + chrpos_str(pend_chr_, pend_pos_) +
+                          "). " + mode_ + " requires a position-sorted dbSNP.");
+                if (on_abort_) on_abort_();
+                die(1);
+            }
+
+            pend_chr_ = dchr;
+            pend_pos_ = dpos;
+            has_pending_ = true;
+
+            if (scanned_total_ % 1000000ULL == 0) {
+                LOG_INFO("[dbSNP stream] scanned " + std::to_string(scanned_total_/1000000ULL) + "M lines.");
+            }
+            return;
+        }
+    }
+
+    LineReader dbr_;
+    DbCols D_;
+    int stop_min_ = 0, stop_all_ = 0;
+
+    std::string pline_;
+    std::string_view vCHR_, vPOS_, vA1_, vA2_, vRS_;
+    TabState st_;
+    bool    has_pending_ = false;
+    int     pend_chr_ = 0;
+    int64_t pend_pos_ = 0;
+
+    std::vector<DbGroupEntry> group_;
+    bool    group_valid_ = false;
+    int     group_chr_ = 0;
+    int64_t group_pos_ = 0;
+
+    uint64_t scanned_total_ = 0;
+    std::string mode_;
+    std::function<void()> on_abort_;
+};
+
+static void process_rsidImpu_stream(const Args_RsidImpu& P)
+{
+    GwasInput G;
+    G.gwas_file = P.gwas_file;
+    G.out_file  = P.out_file;
+
+    RowFilter rf(P);
+    GwasPartsReader reader(G.gwas_file);
+    read_gwas_header(P, G, reader);
+    rf.bind(G.header, P);
+
+    GwasLineQC qc(G.idx_beta, G.idx_se, G.idx_freq, G.idx_pv, G.idx_n, P.maf_threshold);
+    if (qc.active()) {
+        LOG_INFO("QC applied in partial-column mode.");
+    } else {
+        LOG_WARN("Cannot perform full QC in rsidImpu (missing beta/se/freq/N/p columns).");
+    }
+
+    Writer fout(G.out_file, P.format, P.split_by_chr);
+    Writer funm(unmatch_path(G.out_file), "gwas");
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
+
+    if (!fout.good() || !funm.good()) {
+        LOG_ERROR("Error opening output file.");
+        die(1);
+    }
+
+    FormatEngine FE;
+    FormatSpec spec = FE.get_format(P.format);
+    write_output_header(P, G, spec, fout);
+
+    // 任一输入未排好序时中止：OUT / OUT.unmatch 只写了一部分，删掉而不是留下截断的结果
+    auto discard_outputs = [&]{ fout.discard(); funm.discard(); };
+    DbSnpStream db(P, "Streaming mode (--gwas-sorted)");
+    db.on_abort(discard_outputs);
+    LOG_INFO("Start streaming merge join (GWAS sorted by CHR:POS).");
+
+    std::string line;
+    uint64_t n = 0, rf_dropped = 0, qc_dropped = 0, matched = 0;
+    int     prev_chr = 0;
+    int64_t prev_pos = 0;
+
+    while (reader.getline(line)) {
+        if (line.empty()) continue;
+        strip_cr_inplace(line);
+        ++n;
+
+        // 行过滤先于一切：被拒的行不做排序校验 / QC / 匹配，也不进 unmatch
+        if (!rf.pass(std::string_view(line))) {
+            ++rf_dropped;
+            continue;
+        }
+
+        int chr = -1;
+        int64_t pos = 0;
+        AlleleKey ak{2, 0};
+        bool ok = parse_gwas_key(G, std::string_view(line), chr, pos, ak);
+
+        // 排序校验：只看 CHR/POS 合法的行
+        if (chr >= 0 && pos > 0) {
+            if (chr < prev_chr || (chr == prev_chr && pos < prev_pos)) {
+                LOG_ERROR("GWAS is not sorted by CHR:POS (data line " + std::to_string(n) + ": " +
+                          chrpos_str(chr, pos) + " after " + chrpos_str(prev_chr, prev_pos) +
+                          "). Partial outputs removed; rerun without --gwas-sorted.");
+                discard_outputs();
+                die(1);
+            }
+            prev_chr = chr;
+            prev_pos = pos;
+        }
+
+        if (ok && !qc.pass(std::string_view(line))) {
+            ++qc_dropped;
+            ok = false;
+        }
+
+        // 同一位置多条 dbSNP：取文件中最后一条命中（与 two-pointer 覆盖语义一致）
+        const std::string* rsid = nullptr;
+        if (ok) {
+            const auto& grp = db.group_at(chr, pos);
+            for (auto it = grp.rbegin(); it != grp.rend(); ++it) {
+                if (it->allele == ak) { rsid = &it->rsid; break; }
+            }
+        }
+
+        if (!rsid) {
+            funm.write_line(line);
+            continue;
+        }
+
+        ++matched;
+        write_matched_row(P, G, FE, spec, fout, line, *rsid, nullptr);
+    }
+
+    if (rf.active())
+        LOG_INFO("Row filter done: " + std::to_string(n - rf_dropped) + " passed, " +
+                 std::to_string(rf_dropped) + " removed.");
+    LOG_INFO("Basic QC done: " + std::to_string(n - rf_dropped - qc_dropped) + " passed, " +
+             std::to_string(qc_dropped) + " removed.");
+    LOG_INFO("Streaming merge finished. GWAS lines: " + std::to_string(n) +
+             ", matched rsID: " + std::to_string(matched) +
+             ", dbSNP lines scanned: " + std::to_string(db.scanned()));
+}
+
+// =======================================================
+// [SPILL] --memory-limit 装不下的 GWAS：外存版 rsidImpu（结果与内存版逐字节相同）
+//   1) 落盘的 GWAS 行顺序读：行过滤 / QC / 解析键 → 按 (CHR, POS, 行号) 外排序
+//   2) 与位置排序的 dbSNP 流式 merge join（同 --gwas-sorted）；命中的 rsID 追加到 heap 文件
+//   3) --remove-dup-snp：按 (rsID 哈希, 行号) 外排序，同组内按行序取最小 P（同内存版）
+//   4) 命中按行号外排序，与 GWAS 行顺序归并输出 OUT / OUT.unmatch
+// 驻留内存只有排序缓冲（预算的 1/3）与 dbSNP 当前位置的一组行
+// =======================================================
+struct SpillKey {
+    uint64_t index;         // 行号（全序的最后一键）
+    int64_t  pos;
+    uint64_t allele_key;
+    double   p;             // 去重用 P 值（p_ok = 0 表示去重时删除）
+    int32_t  chr;
+    uint8_t  allele_type;
+    uint8_t  p_ok;
+};
+
+struct SpillKeyLess {
+    bool operator()(const SpillKey& a, const SpillKey& b) const {
+        if (a.chr != b.chr) return a.chr < b.chr;
+        if (a.pos != b.pos) return a.pos < b.pos;
+        return a.index < b.index;
+    }
+};
+
+struct SpillHit {
+    uint64_t index;
+    uint64_t hash;          // rsID 哈希：去重分组
+    uint64_t off;           // rsID 在 heap 文件中的位置
+    double   p;
+    uint32_t len;
+    uint8_t  p_ok;
+    uint8_t  drop;          // 去重删除 → 写 unmatch（同内存版）
+};
+
+struct SpillHitLess {
+    bool by_hash = false;
+    bool operator()(const SpillHit& a, const SpillHit& b) const {
+        if (by_hash && a.hash != b.hash) return a.hash < b.hash;
+        return a.index < b.index;
+    }
+};
+
+static std::string heap_read(FILE* heap, const SpillHit& h)
+{
+    std::string s(h.len, '\0');
+    if (h.len && ::pread(fileno(heap), &s[0], h.len, (off_t)h.off) != (ssize_t)h.len) {
+        LOG_ERROR("Error reading temporary rsID file.");
+        die(1);
+    }
+    return s;
+}
+
+// 一组同哈希的命中（已按行号）：按 rsID 文本细分后同 gwas_remove_dup 规则
+static void dedup_hash_group(std::vector<SpillHit>& grp, FILE* heap, size_t& dropped)
+{
+    std::unordered_map<std::string, size_t> best;
+    for (size_t k = 0; k < grp.size(); ++k) {
+        SpillHit& h = grp[k];
+        if (h.len == 0) continue;                      // 空 rsID 不参与去重
+        if (!h.p_ok) { h.drop = 1; ++dropped; continue; }
+        if (grp.size() == 1) break;
+
+        auto [it, inserted] = best.emplace(heap_read(heap, h), k);
+        if (inserted) continue;
+        SpillHit& old = grp[it->second];
+        if (h.p < old.p) {
+            old.drop = 1;
+            it->second = k;
+        } else {
+            h.drop = 1;
+        }
+        ++dropped;
+    }
+}
+
+static void process_rsidImpu_spill(const Args_RsidImpu& P, const RowFilter& rf,
+                                   GwasInput& G, const std::string& lines_path)
+{
+    const std::string prefix = spill_prefix(P.tmp_dir, G.out_file, "rsidimpu");
+
+    // 同时最多三个排序缓冲（键 / 命中 / 去重）各占余量的 1/3；每段至少 16 MiB，
+    // 否则 run 过多（每段一个句柄 + 读缓冲）。余量不够时如实提示会超出 --memory-limit
+    const uint64_t kMinRun = 16ull << 20;
+    const uint64_t avail = mem_available();
+    const uint64_t run_bytes = std::max<uint64_t>(avail / 3, kMinRun);
+    if (avail / 3 < kMinRun)
+        LOG_WARN("--memory-limit leaves " + std::to_string(avail >> 20) + " MiB for the spill path, which needs " +
+                 std::to_string(3 * kMinRun >> 20) + " MiB for its sort buffers; memory use will exceed the limit.");
+
+    RowFilter frf = rf;
+    frf.bind(G.header, P);
+    GwasLineQC qc(G.idx_beta, G.idx_se, G.idx_freq, G.idx_pv, G.idx_n, P.maf_threshold);
+
+    //================ 1. 行过滤 / QC / 解析键 → 外排序 =================
+    ExtSorter<SpillKey, SpillKeyLess> keys(run_bytes, prefix + "k");
+    uint64_t n = 0, n_rf = 0, n_qc = 0;
+    {
+        LineReader lr(lines_path);
+        std::string line;
+        for (; lr.getline(line); ++n) {
+            std::string_view lv(line);
+            if (!frf.pass(lv)) { ++n_rf; continue; }
+            if (!qc.pass(lv))  { ++n_qc; continue; }
+
+            SpillKey k{};
+            AlleleKey ak{2, 0};
+            int64_t pos = 0;
+            if (!parse_gwas_key(G, lv, k.chr, pos, ak)) continue;
+            k.index = n;
+            k.pos = pos;
+            k.allele_type = ak.type;
+            k.allele_key  = ak.key;
+            k.p_ok = 1;
+            if (P.remove_dup_snp && G.idx_pv >= 0) k.p_ok = gwas_dup_pvalue(lv, G.idx_pv, k.p) ? 1 : 0;
+            keys.push(k);
+        }
+    }
+    keys.finish();
+    if (frf.active())
+        LOG_INFO("Row filter done: " + std::to_string(n - n_rf) + " passed, " + std::to_string(n_rf) + " removed.");
+    LOG_INFO("Basic QC done: " + std::to_string(n - n_rf - n_qc) + " passed, " + std::to_string(n_qc) + " removed.");
+    LOG_INFO("Spilled GWAS: " + std::to_string(n) + " lines, key sort in " +
+             std::to_string(std::max<size_t>(keys.runs(), 1)) + " run(s).");
+
+    //================ 2. 流式 merge join：同一位置多条 dbSNP 取最后一条命中 =================
+    SpillFile heap_file(prefix + "rsid.tmp");
+    const std::string& heap_path = heap_file.path();
+    FILE* heap = spill_open(heap_path, "w+b");
+    uint64_t heap_off = 0, matched = 0;
+
+    auto hits = std::make_unique<ExtSorter<SpillHit, SpillHitLess>>(
+        run_bytes, prefix + "h", SpillHitLess{P.remove_dup_snp});
+    {
+        DbSnpStream db(P, "Spilling a GWAS that exceeds --memory-limit");
+        SpillKey k;
+        while (keys.next(k)) {
+            const AlleleKey ak{k.allele_type, k.allele_key};
+            const std::string* rsid = nullptr;
+            const auto& grp = db.group_at(k.chr, k.pos);
+            for (auto it = grp.rbegin(); it != grp.rend(); ++it) {
+                if (it->allele == ak) { rsid = &it->rsid; break; }
+            }
+            if (!rsid) continue;
+
+            SpillHit h{};
+            h.index = k.index;
+            h.hash  = std::hash<std::string>{}(*rsid);
+            h.off   = heap_off;
+            h.len   = (uint32_t)rsid->size();
+            h.p     = k.p;
+            h.p_ok  = k.p_ok;
+            spill_write(heap, rsid->data(), rsid->size(), heap_path);
+            heap_off += rsid->size();
+            hits->push(h);
+            ++matched;
+        }
+        LOG_INFO("Matched rsID: " + std::to_string(matched) + " / " + std::to_string(n) +
+                 " (" + G.gwas_file + "), dbSNP lines scanned: " + std::to_string(db.scanned()));
+    }
+    if (std::fflush(heap) != 0) {
+        LOG_ERROR("Error writing temporary file: " + heap_path + " (disk full?)");
+        die(1);
+    }
+    hits->finish();
+
+    //================ 3. 去重：按哈希分组，再按行号排回 =================
+    if (P.remove_dup_snp) {
+        auto by_index = std::make_unique<ExtSorter<SpillHit, SpillHitLess>>(
+            run_bytes, prefix + "d", SpillHitLess{false});
+        size_t dropped = 0;
+        std::vector<SpillHit> grp;
+        SpillHit h;
+        bool more = hits->next(h);
+        while (more) {
+            grp.clear();
+            const uint64_t hash = h.hash;
+            while (more && h.hash == hash) { grp.push_back(h); more = hits->next(h); }
+            dedup_hash_group(grp, heap, dropped);
+            for (const auto& g : grp) by_index->push(g);
+        }
+        by_index->finish();
+        hits = std::move(by_index);
+        LOG_INFO("Duplicate SNPs removal done. Removed = " + std::to_string(dropped));
+    }
+
+    //================ 4. 与 GWAS 行按行号归并输出 =================
+    Writer fout(G.out_file, P.format, P.split_by_chr);
+    Writer funm(unmatch_path(G.out_file), "gwas");
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
+    if (!fout.good() || !funm.good()) {
+        LOG_ERROR("Error opening output file.");
+        die(1);
+    }
+    FormatEngine FE;
+    FormatSpec spec = FE.get_format(P.format);
+    write_output_header(P, G, spec, fout);
+
+    {
+        LineReader lr(lines_path);
+        std::string line;
+        SpillHit h;
+        bool more = hits->next(h);
+        for (uint64_t i = 0; lr.getline(line); ++i) {
+            bool hit = more && h.index == i;
+            SpillHit cur = h;
+            if (hit) more = hits->next(h);
+
+            if (!frf.pass(std::string_view(line))) continue;
+            if (!hit || cur.drop) {
+                funm.write_line(line);
+                continue;
+            }
+            write_matched_row(P, G, FE, spec, fout, line, heap_read(heap, cur), nullptr);
+        }
+    }
+
+    std::fclose(heap);
+}
+
+// =======================================================
+// [REVERSE] rsID -> CHR/POS：由 dbSNP 构建紧凑 rsID 索引
+//   rs_  : 升序 uint32 rsID 数字（"rs123" -> 123），二分查找
+//   loc_ : 与 rs_ 平行的 {pos, allele 指纹}；chr_ 单独一个 uint8 数组
+//   每条 13 字节；同一 rsID 的多行（多等位 / 多位置）按 dbSNP 行序相邻
+// 可用 --rsid-index 持久化，之后直接加载，无需再扫 dbSNP
+// =======================================================
+
+// rsID 文本 -> 数字；非 "rs<数字>" 或超出 uint32 返回 false
+static inline bool parse_rs_number(std::string_view sv, uint32_t& out)
+{
+    sv = trim_ws(sv);
+    if (sv.size() < 3 || low(sv[0]) != 'r' || low(sv[1]) != 's') return false;
+    sv.remove_prefix(2);
+
+    uint64_t v = 0;
+    for (char c : sv) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + uint64_t(c - '0');
+        if (v > std::numeric_limits<uint32_t>::max()) return false;
+    }
+    out = (uint32_t)v;
+    return true;
+}
+
+// AlleleKey -> 32 位指纹（最低位为 type）；只在同一 rsID 的少数几行之间比较
+static const uint32_t RS_NO_ALLELE = 0xFFFFFFFFu;
+
+static inline uint32_t allele_fingerprint(const AlleleKey& k)
+{
+    if (k.type == 2) return RS_NO_ALLELE;
+    uint32_t h = (uint32_t)(k.key ^ (k.key >> 32));
+    return (h << 1) | (k.type & 1u);
+}
+
+static std::string chr_name(int code)
+{
+    if (code == 23) return "X";
+    if (code == 24) return "Y";
+    if (code == 25) return "MT";
+    return std::to_string(code);
+}
+
+class RsidIndex {
+public:
+    struct Loc {
+        uint32_t pos;
+        uint32_t allele_fp;
+    };
+
+    size_t size() const { return rs_.size(); }
+
+    void build(const Args_RsidImpu& P);
+    bool load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // 查找 rsID：gwas_fp 为 RS_NO_ALLELE 时取第一条；否则取第一条等位基因一致的
+    // 返回下标，未找到返回 -1
+    inline int64_t find(uint32_t rs, uint32_t gwas_fp) const {
+        auto lo = std::lower_bound(rs_.begin(), rs_.end(), rs);
+        for (auto it = lo; it != rs_.end() && *it == rs; ++it) {
+            size_t i = (size_t)(it - rs_.begin());
+            if (gwas_fp == RS_NO_ALLELE || loc_[i].allele_fp == gwas_fp) return (int64_t)i;
+        }
+        return -1;
+    }
+
+    inline int chr(size_t i) const { return chr_[i]; }
+    inline uint32_t pos(size_t i) const { return loc_[i].pos; }
+
+private:
+    static constexpr char MAGIC[8] = {'G','T','K','R','S','I','X','1'};
+
+    std::vector<uint32_t> rs_;
+    std::vector<Loc>      loc_;
+    std::vector<uint8_t>  chr_;
+};
+
+constexpr char RsidIndex::MAGIC[8];
+
+void RsidIndex::build(const Args_RsidImpu& P)
+{
+    LineReader dbr(P.dbsnp_file);
+    DbCols D = open_dbsnp_columns(P, dbr);
+    int dCHR = D.chr, dPOS = D.pos, dA1 = D.a1, dA2 = D.a2, dRS = D.rs;
+    int stop_all = std::max({dCHR, dPOS, dA1, dA2, dRS});
+
+    LOG_INFO("Building rsID index from dbSNP: " + P.dbsnp_file);
+
+    struct Entry {
+        uint32_t rs;
+        uint32_t pos;
+        uint32_t allele_fp;
+        uint8_t  chr;
+    };
+
+    const size_t BLOCK = 1 << 16;
+    std::vector<std::string> cur(BLOCK), next(BLOCK);
+
+    auto read_block = [&dbr, BLOCK](std::vector<std::string>& blk) -> size_t {
+        size_t k = 0;
+        while (k < BLOCK && dbr.getline(blk[k])) {
+            if (blk[k].empty()) continue;
+            strip_cr_inplace(blk[k]);
+            ++k;
+        }
+        return k;
+    };
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = std::max(1, omp_get_max_threads());
+#endif
+    std::vector<std::vector<Entry>> part(nthreads);
+    std::vector<Entry> all;
+
+    uint64_t scanned_total = 0;
+    size_t ncur = read_block(cur);
+    while (ncur > 0) {
+        auto fut = std::async(std::launch::async, [&]{ return read_block(next); });
+
+        for (auto& v : part) v.clear();
+
+        #pragma omp parallel
+        {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            auto& mine = part[tid];
+
+            // schedule(static)：按线程序拼接即为 dbSNP 行序
+            #pragma omp for schedule(static)
+            for (size_t k = 0; k < ncur; ++k) {
+                std::string_view lv(cur[k]);
+                std::string_view vCHR, vPOS, vA1, vA2, vRS;
+                TabState st{0,0};
+                scan_upto_col(lv, stop_all, dCHR, dPOS, dA1, dA2, dRS, vCHR, vPOS, vA1, vA2, vRS, st);
+
+                uint32_t rs = 0;
+                if (!parse_rs_number(vRS, rs)) continue;
+
+                int dchr = canonical_chr_code_sv(vCHR);
+                if (dchr < 0) continue;
+
+                int64_t dpos = 0;
+                if (!parse_i64(trim_ws(vPOS), dpos) || dpos <= 0 ||
+                    dpos > (int64_t)std::numeric_limits<uint32_t>::max()) continue;
+
+                // 多等位位点：每个 ALT 一条；等位基因无法识别时保留位置（只供无 A1/A2 的查询）
+                bool any = false;
+                for_each_alt_key(trim_ws(vA1), trim_ws(vA2), [&](const AlleleKey& k){
+                    mine.push_back({rs, (uint32_t)dpos, allele_fingerprint(k), (uint8_t)dchr});
+                    any = true;
+                    return false;
+                });
+                if (!any) mine.push_back({rs, (uint32_t)dpos, RS_NO_ALLELE, (uint8_t)dchr});
+            }
+        }
+
+        for (const auto& v : part) all.insert(all.end(), v.begin(), v.end());
+
+        scanned_total += ncur;
+        ncur = fut.get();
+        std::swap(cur, next);
+    }
+
+    // 稳定排序：同一 rsID 保持 dbSNP 行序（查询时"第一条一致者"可复现）
+    std::stable_sort(all.begin(), all.end(),
+        [](const Entry& a, const Entry& b){ return a.rs < b.rs; });
+
+    // 去掉完全重复的条目（多次出现的同一 rs/位置/等位基因）
+    size_t w = 0;
+    for (size_t r = 0; r < all.size(); ++r) {
+        if (w > 0) {
+            const Entry& p = all[w-1];
+            const Entry& e = all[r];
+            if (p.rs == e.rs && p.chr == e.chr && p.pos == e.pos && p.allele_fp == e.allele_fp) continue;
+        }
+        all[w++] = all[r];
+    }
+    all.resize(w);
+
+    rs_.resize(w);
+    loc_.resize(w);
+    chr_.resize(w);
+    for (size_t i = 0; i < w; ++i) {
+        rs_[i]  = all[i].rs;
+        loc_[i] = {all[i].pos, all[i].allele_fp};
+        chr_[i] = all[i].chr;
+    }
+
+    LOG_INFO("rsID index built: " + std::to_string(w) + " entries from " +
+             std::to_string(scanned_total) + " dbSNP lines.");
+}
+
+// 文件格式：MAGIC(8) | n(uint64) | rs[n] | loc[n] | chr[n]（本机字节序）
+void RsidIndex::save(const std::string& path) const
+{
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs) {
+        LOG_ERROR("Cannot write rsID index: " + path);
+        die(1);
+    }
+    uint64_t n = rs_.size();
+    ofs.write(MAGIC, sizeof(MAGIC));
+    ofs.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    ofs.write(reinterpret_cast<const char*>(rs_.data()),  n * sizeof(uint32_t));
+    ofs.write(reinterpret_cast<const char*>(loc_.data()), n * sizeof(Loc));
+    ofs.write(reinterpret_cast<const char*>(chr_.data()), n * sizeof(uint8_t));
+    if (!ofs) {
+        LOG_ERROR("Error writing rsID index: " + path);
+        die(1);
+    }
+    LOG_INFO("rsID index saved to " + path);
+}
+
+bool RsidIndex::load(const std::string& path)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs) return false;
+
+    char magic[8];
+    uint64_t n = 0;
+    ifs.read(magic, sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&n), sizeof(n));
+    if (!ifs || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) {
+        LOG_ERROR("Not a GWAStoolkit rsID index: " + path);
+        die(1);
+    }
+
+    rs_.resize(n);
+    loc_.resize(n);
+    chr_.resize(n);
+    ifs.read(reinterpret_cast<char*>(rs_.data()),  n * sizeof(uint32_t));
+    ifs.read(reinterpret_cast<char*>(loc_.data()), n * sizeof(Loc));
+    ifs.read(reinterpret_cast<char*>(chr_.data()), n * sizeof(uint8_t));
+    if (!ifs) {
+        LOG_ERROR("Truncated rsID index: " + path);
+        die(1);
+    }
+
+    LOG_INFO("rsID index loaded: " + std::to_string(n) + " entries from " + path);
+    return true;
+}
+
+static void process_rsidImpu_reverse(const Args_RsidImpu& P)
+{
+    //================ 1. 读 GWAS：SNP 列必需，A1/A2 可选（用于区分同一 rsID 的多条） =================
+    GwasInput G;
+    G.gwas_file = P.gwas_file;
+    G.out_file  = P.out_file;
+    RowFilter rf(P);
+
+    std::string line;
+    auto& gwas_lines = G.gwas_lines;
+    if (!read_gwas_table(G.gwas_file, P.cache_dir, line, gwas_lines)) {
+        LOG_ERROR("Empty GWAS summary file: " + G.gwas_file);
+        die(1);
+    }
+    G.header = split_tab(line);
+    const auto& header = G.header;
+
+    G.idx_SNP = find_col(header, P.col_SNP);
+    if (G.idx_SNP < 0) {
+        for (size_t i = 0; i < header.size(); ++i) {
+            if (eq_ci(header[i], "snp")) { G.idx_SNP = (int)i; break; }
+        }
+    }
+    require(G.idx_SNP >= 0, "GWAS missing required column [" + P.col_SNP + "] for rsidImpu --reverse.");
+    G.has_SNP = true;
+
+    G.gCHR = find_col(header, P.g_chr);
+    G.gPOS = find_col(header, P.g_pos);
+    G.gA1  = find_col(header, P.g_A1);
+    G.gA2  = find_col(header, P.g_A2);
+    G.idx_beta = find_col(header, P.col_beta);
+    G.idx_se   = find_col(header, P.col_se);
+    G.idx_freq = find_col(header, P.col_freq);
+    G.idx_pv   = find_col(header, P.g_p);
+    G.idx_n    = find_col(header, P.col_n);
+
+    bool use_allele = (G.gA1 >= 0 && G.gA2 >= 0);
+    if (!use_allele) {
+        require(P.format == "gwas", "--format " + P.format + " needs A1/A2 columns.");
+        LOG_WARN("No A1/A2 columns: each rsID takes its first dbSNP position.");
+    }
+
+    const size_t n = gwas_lines.size();
+    LOG_INFO("Loaded GWAS lines (data): " + std::to_string(n) + " from " + G.gwas_file);
+
+    std::vector<bool> keep_rf(n, true);
+    if (rf.active()) {
+        rf.bind(header, P);
+        rf.apply(gwas_lines, keep_rf);
+        G.keep_rf_u8.assign(keep_rf.begin(), keep_rf.end());
+    }
+
+    G.keep_qc_u8.assign(keep_rf.begin(), keep_rf.end());
+    if (G.idx_beta >= 0 || G.idx_se >= 0 || G.idx_freq >= 0 || G.idx_pv >= 0 || G.idx_n >= 0) {
+        std::vector<bool> keep_qc_bool = keep_rf;
+        LOG_INFO("QC applied in partial-column mode.");
+        gwas_basic_qc_cached(G.gwas_file, P.cache_dir, gwas_lines, header,
+                      G.idx_beta, G.idx_se, G.idx_freq, G.idx_pv, G.idx_n,
+                      keep_qc_bool, P.maf_threshold);
+        for (size_t i=0; i<n; ++i) G.keep_qc_u8[i] = keep_qc_bool[i] ? 1 : 0;
+    } else {
+        LOG_WARN("Cannot perform full QC in rsidImpu (missing beta/se/freq/N/p columns).");
+    }
+
+    //================ 2. rsID 索引：加载 或 由 dbSNP 构建（并保存） =================
+    RsidIndex IX;
+    bool loaded = !P.rsid_index.empty() && IX.load(P.rsid_index);
+    if (!loaded) {
+        require(!P.dbsnp_file.empty(),
+                "rsID index not found (" + P.rsid_index + ") and no --dbsnp to build it from.");
+        IX.build(P);
+        if (!P.rsid_index.empty()) IX.save(P.rsid_index);
+    }
+
+    //================ 3. 并行查索引（每行独立，二分查找） =================
+    std::vector<int64_t> hit(n, -1);
+    int stop = std::max({G.idx_SNP, G.gA1, G.gA2});
+
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i) {
+        if (!G.keep_qc_u8[i]) continue;
+
+        std::string_view lv(gwas_lines[i]);
+        std::string_view vSNP, vA1, vA2, vD1, vD2;
+        TabState st{0,0};
+        scan_upto_col(lv, stop, G.idx_SNP, -1, G.gA1, G.gA2, -1, vSNP, vD1, vA1, vA2, vD2, st);
+
+        uint32_t rs = 0;
+        if (!parse_rs_number(vSNP, rs)) continue;
+
+        uint32_t fp = RS_NO_ALLELE;
+        if (use_allele) {
+            AlleleKey ak = make_allele_key(trim_ws(vA1), trim_ws(vA2));
+            if (ak.type == 2) continue;
+            fp = allele_fingerprint(ak);
+        }
+        hit[i] = IX.find(rs, fp);
+    }
+
+    G.keep_u8.assign(n, 0);
+    size_t matched = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (hit[i] >= 0) { G.keep_u8[i] = 1; ++matched; }
+    }
+    LOG_INFO("Matched CHR/POS: " + std::to_string(matched) + " / " + std::to_string(n) +
+             " (" + G.gwas_file + ")");
+
+    //================ 4. 去重（按 SNP / P 值） =================
+    if (P.remove_dup_snp) {
+        G.rsid_vec.assign(n, std::string());
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t st = 0, len = 0;
+            if (G.keep_u8[i] && get_col_span(gwas_lines[i], G.idx_SNP, st, len))
+                G.rsid_vec[i] = gwas_lines[i].substr(st, len);
+        }
+        std::vector<bool> keep_bool(n, false);
+        for (size_t i=0; i<n; ++i) keep_bool[i] = (G.keep_u8[i] != 0);
+        gwas_remove_dup(gwas_lines, header, G.idx_pv, G.rsid_vec, keep_bool);
+        for (size_t i=0; i<n; ++i) G.keep_u8[i] = keep_bool[i] ? 1 : 0;
+    }
+
+    //================ 5. 输出：gwas 格式替换/追加 CHR、POS 列；其他格式走 FormatEngine =================
+    Writer fout(G.out_file, P.format);
+    Writer funm(unmatch_path(G.out_file), "gwas");
+    if (P.build_index) fout.enable_index(P.g_chr, P.g_pos);
+    if (!fout.good() || !funm.good()) {
+        LOG_ERROR("Error opening output file.");
+        die(1);
+    }
+
+    FormatEngine FE;
+    FormatSpec spec = FE.get_format(P.format);
+
+    if (P.format == "gwas") {
+        std::string h;
+        for (size_t j=0; j<header.size(); j++) {
+            if (j) h += "\t";
+            h += header[j];
+        }
+        if (G.gCHR < 0) h += "\t" + P.g_chr;
+        if (G.gPOS < 0) h += "\t" + P.g_pos;
+        fout.write_line(h);
+    } else {
+        write_output_header(P, G, spec, fout);
+    }
+
+    std::string snp;
+    for (size_t i = 0; i < n; ++i) {
+        std::string& l = gwas_lines[i];
+        if (!G.keep_rf_u8.empty() && !G.keep_rf_u8[i]) continue;
+        if (!G.keep_u8[i]) {
+            funm.write_line(l);
+            continue;
+        }
+
+        size_t k = (size_t)hit[i];
+        std::string c = chr_name(IX.chr(k));
+        std::string p = std::to_string(IX.pos(k));
+
+        if (P.format != "gwas") {
+            uint32_t st = 0, len = 0;
+            get_col_span(l, G.idx_SNP, st, len);
+            snp.assign(l, st, len);
+            write_matched_row(P, G, FE, spec, fout, l, snp, nullptr, c, p);
+            continue;
+        }
+
+        if (G.gCHR >= 0) replace_nth_column_inplace(l, G.gCHR, c);
+        else             l += "\t" + c;
+        if (G.gPOS >= 0) replace_nth_column_inplace(l, G.gPOS, p);
+        else             l += "\t" + p;
+        fout.write_line(l);
+    }
+}
+
+// =======================================================
+// [SERVE] DbsnpPosIndex：serve 子命令常驻内存（或 mmap）的 dbSNP 位置索引
+// 文件格式：MAGIC(8) | n(uint64) | chr_off[27](uint64) | PosEntry[n] | 补齐到 8
+//           | n_ids(uint64) | id_off[n_ids+1](uint64) | id 字符（本机字节序）
+//   PosEntry 按 (chr, pos) 排序，chr_off[c]..chr_off[c+1] 为染色体 c 的区间
+//   rs：规范的 "rs<数字>"（数字 < 2^31）直接存数字；其他 ID（非 rs、前导 0、大写 RS ……）
+//   原样存进 id 字符池，rs = RS_POOL | 池下标，输出与 rsidImpu 逐字相同
+// =======================================================
+struct PosEntry {
+    uint32_t pos;
+    uint32_t allele_fp;
+    uint32_t rs;
+};
+
+static const uint32_t RS_POOL = 0x80000000u;
+
+struct DbsnpPosIndex::Impl {
+    static constexpr char MAGIC[8] = {'G','T','K','P','O','S','X','2'};
+    static constexpr char MAGIC_V1[8] = {'G','T','K','P','O','S','X','1'};   // 无 id 池：非 rs ID 缺失
+    static constexpr int  NCHR = 26;             // chr code 1..25（0 不用）
+
+    std::vector<PosEntry> own;                   // 构建得到
+    std::vector<uint64_t> own_id_off{0};
+    std::string           own_ids;
+    MappedFile* mf = nullptr;                    // 或 mmap 加载
+    const PosEntry* e = nullptr;
+    uint64_t n = 0;
+    uint64_t chr_off[NCHR + 1] = {};
+    const uint64_t* id_off = nullptr;            // id 池：第 k 个 ID 为 ids[id_off[k], id_off[k+1])
+    const char*     ids = nullptr;
+    uint64_t n_ids = 0;
+
+    ~Impl() { delete mf; }
+
+    void build(const Args_RsidImpu& P);
+    bool load(const std::string& path);
+    void save(const std::string& path) const;
+
+    // 同一位点的条目很少：二分定位后线性比指纹
+    inline const PosEntry* find(int chr, int64_t pos, uint32_t fp) const {
+        if (chr < 1 || chr >= NCHR || pos <= 0 || pos > (int64_t)std::numeric_limits<uint32_t>::max())
+            return nullptr;
+        const PosEntry* lo = e + chr_off[chr];
+        const PosEntry* hi = e + chr_off[chr + 1];
+        const PosEntry* it = std::lower_bound(lo, hi, (uint32_t)pos,
+            [](const PosEntry& a, uint32_t p){ return a.pos < p; });
+        for (; it != hi && it->pos == (uint32_t)pos; ++it)
+            if (it->allele_fp == fp) return it;
+        return nullptr;
+    }
+
+    inline void rsid_of(const PosEntry& h, std::string& out) const {
+        if (h.rs & RS_POOL) {
+            const uint64_t k = h.rs & ~RS_POOL;
+            out.assign(ids + id_off[k], (size_t)(id_off[k + 1] - id_off[k]));
+        } else {
+            out.assign("rs");
+            out += std::to_string(h.rs);
+        }
+    }
+};
+
+constexpr char DbsnpPosIndex::Impl::MAGIC[8];
+constexpr char DbsnpPosIndex::Impl::MAGIC_V1[8];
+
+void DbsnpPosIndex::Impl::build(const Args_RsidImpu& P)
+{
+    LineReader dbr(P.dbsnp_file);
+    DbCols D = open_dbsnp_columns(P, dbr);
+    int dCHR = D.chr, dPOS = D.pos, dA1 = D.a1, dA2 = D.a2, dRS = D.rs;
+    int stop_all = std::max({dCHR, dPOS, dA1, dA2, dRS});
+
+    LOG_INFO("Building dbSNP position index from: " + P.dbsnp_file);
+
+    struct Entry {
+        uint32_t pos;
+        uint32_t allele_fp;
+        uint32_t rs;
+        uint8_t  chr;
+    };
+
+    const size_t BLOCK = 1 << 16;
+    std::vector<std::string> cur(BLOCK), next(BLOCK);
+
+    auto read_block = [&dbr, BLOCK](std::vector<std::string>& blk) -> size_t {
+        size_t k = 0;
+        while (k < BLOCK && dbr.getline(blk[k])) {
+            if (blk[k].empty()) continue;
+            strip_cr_inplace(blk[k]);
+            ++k;
+        }
+        return k;
+    };
+
+    int nthreads = 1;
+#ifdef _OPENMP
+    nthreads = std::max(1, omp_get_max_threads());
+#endif
+    std::vector<std::vector<Entry>> part(nthreads);
+    std::vector<std::vector<std::string_view>> part_ids(nthreads);   // 本块内进池的 ID（指向 cur）
+    std::vector<Entry> all;
+
+    uint64_t scanned_total = 0, pooled = 0;
+    size_t ncur = read_block(cur);
+    while (ncur > 0) {
+        auto fut = std::async(std::launch::async, [&]{ return read_block(next); });
+
+        for (auto& v : part) v.clear();
+        for (auto& v : part_ids) v.clear();
+
+        #pragma omp parallel
+        {
+            int tid = 0;
+#ifdef _OPENMP
+            tid = omp_get_thread_num();
+#endif
+            auto& mine = part[tid];
+            auto& mine_ids = part_ids[tid];
+
+            // schedule(static)：按线程序拼接即为 dbSNP 行序（"最后一条命中"依赖行序）
+            #pragma omp for schedule(static)
+            for (size_t k = 0; k < ncur; ++k) {
+                std::string_view lv(cur[k]);
+                std::string_view vCHR, vPOS, vA1, vA2, vRS;
+                TabState st{0,0};
+                scan_upto_col(lv, stop_all, dCHR, dPOS, dA1, dA2, dRS, vCHR, vPOS, vA1, vA2, vRS, st);
+
+                int dchr = canonical_chr_code_sv(vCHR);
+                if (dchr < 0) continue;
+
+                int64_t dpos = 0;
+                if (!parse_i64(trim_ws(vPOS), dpos) || dpos <= 0 ||
+                    dpos > (int64_t)std::numeric_limits<uint32_t>::max()) continue;
+
+                // rsidImpu 输出 dbSNP 的原始 ID：只有能原样还原的才存成数字，其余进池（先记线程内下标）
+                uint32_t rs = 0;
+                if (!parse_rs_number(vRS, rs) || rs >= RS_POOL || vRS != "rs" + std::to_string(rs)) {
+                    rs = RS_POOL | (uint32_t)mine_ids.size();
+                    mine_ids.push_back(vRS);
+                }
+
+                // 多等位位点：每个 ALT 一条；与 DbAlleles::matches 的"任一 ALT 相同"等价
+                for_each_alt_key(trim_ws(vA1), trim_ws(vA2), [&](const AlleleKey& k){
+                    mine.push_back({(uint32_t)dpos, allele_fingerprint(k), rs, (uint8_t)dchr});
+                    return false;
+                });
+            }
+        }
+
+        // 线程内池下标 → 全局池下标；ID 字符在 cur 被覆盖之前拷出
+        for (int t = 0; t < nthreads; ++t) {
+            const uint64_t base = own_id_off.size() - 1;
+            if (base + part_ids[t].size() >= RS_POOL) {
+                LOG_ERROR("Too many dbSNP IDs not of the form rs<number> for a position index.");
+                die(1);
+            }
+            for (auto& x : part[t])
+                if (x.rs & RS_POOL) x.rs = RS_POOL | (uint32_t)(base + (x.rs & ~RS_POOL));
+            for (auto id : part_ids[t]) {
+                own_ids.append(id.data(), id.size());
+                own_id_off.push_back(own_ids.size());
+            }
+            pooled += part_ids[t].size();
+            all.insert(all.end(), part[t].begin(), part[t].end());
+        }
+
+        scanned_total += ncur;
+        ncur = fut.get();
+        std::swap(cur, next);
+    }
+
+    // 稳定排序：同一 (chr, pos, 等位基因) 相邻且保持 dbSNP 行序
+    std::stable_sort(all.begin(), all.end(), [](const Entry& a, const Entry& b){
+        if (a.chr != b.chr) return a.chr < b.chr;
+        if (a.pos != b.pos) return a.pos < b.pos;
+        return a.allele_fp < b.allele_fp;
+    });
+
+    // 同一 (chr, pos, 等位基因) 只留最后一条：与扫描模式"后命中覆盖前命中"一致
+    size_t w = 0;
+    for (size_t r = 0; r < all.size(); ++r) {
+        if (w > 0) {
+            Entry& p = all[w-1];
+            const Entry& x = all[r];
+            if (p.chr == x.chr && p.pos == x.pos && p.allele_fp == x.allele_fp) { p = x; continue; }
+        }
+        all[w++] = all[r];
+    }
+    all.resize(w);
+
+    own.resize(w);
+    std::fill(std::begin(chr_off), std::end(chr_off), 0);
+    for (size_t i = 0; i < w; ++i) {
+        own[i] = {all[i].pos, all[i].allele_fp, all[i].rs};
+        chr_off[all[i].chr + 1]++;
+    }
+    for (int c = 1; c <= NCHR; ++c) chr_off[c] += chr_off[c-1];
+    e = own.data();
+    n = w;
+    id_off = own_id_off.data();
+    ids = own_ids.data();
+    n_ids = own_id_off.size() - 1;
+
+    LOG_INFO("dbSNP position index built: " + std::to_string(w) + " entries from " +
+             std::to_string(scanned_total) + " dbSNP lines.");
+    if (pooled > 0)
+        LOG_INFO(std::to_string(pooled) + " dbSNP IDs not of the form rs<number> are kept as written.");
+}
+
+void DbsnpPosIndex::Impl::save(const std::string& path) const
+{
+    std::ofstream ofs(path, std::ios::binary);
+    if (!ofs) {
+        LOG_ERROR("Cannot write dbSNP position index: " + path);
+        die(1);
+    }
+    ofs.write(MAGIC, sizeof(MAGIC));
+    ofs.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    ofs.write(reinterpret_cast<const char*>(chr_off), sizeof(chr_off));
+    ofs.write(reinterpret_cast<const char*>(e), n * sizeof(PosEntry));
+    const char pad[8] = {};
+    ofs.write(pad, (8 - n * sizeof(PosEntry) % 8) % 8);
+    ofs.write(reinterpret_cast<const char*>(&n_ids), sizeof(n_ids));
+    ofs.write(reinterpret_cast<const char*>(id_off), (n_ids + 1) * sizeof(uint64_t));
+    ofs.write(ids, (std::streamsize)id_off[n_ids]);
+    if (!ofs) {
+        LOG_ERROR("Error writing dbSNP position index: " + path);
+        die(1);
+    }
+    LOG_INFO("dbSNP position index saved to " + path);
+}
+
+bool DbsnpPosIndex::Impl::load(const std::string& path)
+{
+    if (!std::ifstream(path)) return false;
+
+    mf = new MappedFile(path);
+    const size_t head = sizeof(MAGIC) + sizeof(n) + sizeof(chr_off);
+    if (mf->size() >= sizeof(MAGIC_V1) && std::memcmp(mf->data(), MAGIC_V1, sizeof(MAGIC_V1)) == 0) {
+        LOG_ERROR("dbSNP position index " + path + " was built by an older version that skipped IDs "
+                  "not of the form rs<number>. Delete it and rebuild with --dbsnp.");
+        die(1);
+    }
+    if (mf->size() < head || std::memcmp(mf->data(), MAGIC, sizeof(MAGIC)) != 0) {
+        LOG_ERROR("Not a GWAStoolkit dbSNP position index: " + path);
+        die(1);
+    }
+    std::memcpy(&n, mf->data() + sizeof(MAGIC), sizeof(n));
+    std::memcpy(chr_off, mf->data() + sizeof(MAGIC) + sizeof(n), sizeof(chr_off));
+
+    // 各段长度逐一核对（n / n_ids 来自文件，先防乘法溢出）
+    auto truncated = [&]{
+        LOG_ERROR("Truncated dbSNP position index: " + path);
+        die(1);
+    };
+    const size_t size = mf->size();
+    if (chr_off[NCHR] != n || n > size / sizeof(PosEntry)) truncated();
+    size_t at = head + n * sizeof(PosEntry);
+    at += (8 - at % 8) % 8;
+    if (size < at + sizeof(n_ids)) truncated();
+    std::memcpy(&n_ids, mf->data() + at, sizeof(n_ids));
+    at += sizeof(n_ids);
+    if (n_ids >= RS_POOL || (size - at) / sizeof(uint64_t) < n_ids + 1) truncated();
+    id_off = reinterpret_cast<const uint64_t*>(mf->data() + at);   // 各段起点均为 8 的倍数
+    at += (n_ids + 1) * sizeof(uint64_t);
+    for (uint64_t k = 0; k < n_ids; ++k)
+        if (id_off[k] > id_off[k + 1]) truncated();
+    if (id_off[0] != 0 || size - at != id_off[n_ids]) truncated();
+    ids = reinterpret_cast<const char*>(mf->data() + at);
+    e = reinterpret_cast<const PosEntry*>(mf->data() + head);   // head 为 8 的倍数
+
+    LOG_INFO("dbSNP position index mapped: " + std::to_string(n) + " entries from " + path);
+    return true;
+}
+
+DbsnpPosIndex::DbsnpPosIndex(const Args_RsidImpu& P, const std::string& index_file)
+    : impl_(new Impl)
+{
+    if (!index_file.empty() && impl_->load(index_file)) return;
+    impl_->build(P);
+    if (!index_file.empty()) impl_->save(index_file);
+}
+
+DbsnpPosIndex::~DbsnpPosIndex() { delete impl_; }
+
+size_t DbsnpPosIndex::size() const { return impl_->n; }
+
+bool DbsnpPosIndex::lookup(std::string_view chr, std::string_view pos,
+                           std::string_view a1, std::string_view a2, std::string& rsid) const
+{
+    int c = canonical_chr_code_sv(chr);
+    int64_t p = 0;
+    if (c < 0 || !parse_i64(trim_ws(pos), p)) return false;
+
+    AlleleKey ak = make_allele_key(trim_ws(a1), trim_ws(a2));
+    if (ak.type == 2) return false;
+
+    const PosEntry* h = impl_->find(c, p, allele_fingerprint(ak));
+    if (!h) return false;
+    impl_->rsid_of(*h, rsid);
+    return true;
+}
+
+size_t DbsnpPosIndex::annotate(const Args_RsidImpu& P, size_t& total) const
+{
+    GwasInput G;
+    G.gwas_file = P.gwas_file;
+    G.out_file  = P.out_file;
+
+    std::vector<GWASRecord> recs;
+    load_gwas_input(P, RowFilter(P), G, 0, recs);
+
+    size_t matched = 0;
+    for (const auto& r : recs) {
+        const PosEntry* h = impl_->find(r.chr, r.pos, allele_fingerprint(r.allele));
+        if (!h) continue;
+        G.keep_u8[r.index] = 1;
+        impl_->rsid_of(*h, G.rsid_vec[r.index]);
+        ++matched;
+    }
+    total = G.gwas_lines.size();
+
+    write_gwas_outputs(P, G);
+    return matched;
+}
+
+//================ --dry-run =================
+// 试跑用的合成 dbSNP：样本里每个可解析的 GWAS 位点一条（rsK，按位置排序），
+// 试跑时几乎全部命中 → 格式化 / 输出按“全匹配”计时（偏保守）
+static std::string dry_synth_dbsnp(const Args_RsidImpu& P, const InputSample& S, bool bim)
+{
+    auto hdr = split_tab(S.header);
+    const int iC = find_col(hdr, P.g_chr), iP = find_col(hdr, P.g_pos);
+    const int i1 = find_col(hdr, P.g_A1),  i2 = find_col(hdr, P.g_A2);
+
+    struct Site { int code; int64_t pos; std::string chr, a1, a2; };
+    std::vector<Site> sites;
+    if (iC >= 0 && iP >= 0 && i1 >= 0 && i2 >= 0) {
+        const int need = std::max({iC, iP, i1, i2});
+        for (const auto& l : S.lines) {
+            auto f = split_tab(l);
+            if ((int)f.size() <= need) continue;
+            Site x;
+            x.code = canonical_chr_code_sv(trim_ws(f[iC]));
+            if (x.code < 0 || !parse_i64(f[iP], x.pos)) continue;
+            x.chr = f[iC]; x.a1 = f[i1]; x.a2 = f[i2];
+            sites.push_back(std::move(x));
+        }
+    }
+    std::stable_sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) {
+        return a.code != b.code ? a.code < b.code : a.pos < b.pos;
+    });
+
+    // .bim：CHR RSID CM POS A1 A2；其余统一写成最小 VCF（header 自动识别，与 --dbchr 等列名无关）
+    std::string text = bim ? "" : "#CHROM\tPOS\tID\tREF\tALT\n";
+    for (size_t k = 0; k < sites.size(); ++k) {
+        const Site& x = sites[k];
+        const std::string rs = "rs" + std::to_string(k + 1);
+        if (bim) text += x.chr + "\t" + rs + "\t0\t" + std::to_string(x.pos) + "\t" + x.a1 + "\t" + x.a2 + "\n";
+        else     text += x.chr + "\t" + std::to_string(x.pos) + "\t" + rs + "\t" + x.a1 + "\t" + x.a2 + "\n";
+    }
+    return text;
+}
+
+static void dry_run_rsidImpu(const Args_RsidImpu& P)
+{
+    std::vector<GwasInput> inputs;
+    if (!P.gwas_list.empty()) {
+        inputs = read_gwas_list(P.gwas_list);
+    } else {
+        GwasInput G;
+        G.gwas_file = P.gwas_file;
+        G.out_file  = P.out_file;
+        inputs.push_back(std::move(G));
+    }
+
+    DryRunReport R("rsidImpu");
+    const bool bim = dbsnp_is_bim(P);
+    InputSample D = dry_sample(P.dbsnp_file, !bim);
+    R.input("dbSNP", D);
+
+    double rows = 0, read_sec = 0, proc_sec = 0;
+    uint64_t line_heap = 0, line_vec = 0, max_dedup = 0, resident = 0;
+    std::vector<std::string> spill_files;
+    for (const auto& G : inputs) {
+        InputSample S = dry_sample(G.gwas_file);
+        R.input("GWAS", S);
+
+        Args_RsidImpu Q = P;
+        Q.gwas_list.clear();
+        Q.gwas_file  = dry_put("gwas", S);
+        Q.out_file   = dry_out_path(P, G.out_file);
+        Q.dbsnp_file = dry_put(bim ? "dbsnp.bim" : "dbsnp.vcf", dry_synth_dbsnp(P, S, bim));
+        Q.dry_run    = false;
+        Q.cache_dir.clear();
+        Q.build_index = false;
+        const double t = dry_trial([&] { process_rsidImpu(Q); });
+
+        const double k = S.scale(), n = S.est_rows();
+        rows     += n;
+        read_sec += S.read_sec * k;
+        proc_sec += t * k;
+
+        // 各文件的 gwas_lines（reserve 1<<20）+ rsid_vec；去重表逐文件建、写完即释放
+        line_heap += (uint64_t)(n * S.line_heap_per_row());
+        line_vec  += dry_vector_capacity((uint64_t)n, 1 << 20) * sizeof(std::string) +
+                     (uint64_t)n * sizeof(std::string);
+        if (P.remove_dup_snp) max_dedup = std::max(max_dedup, (uint64_t)(n * GWAS_DUP_ENTRY_BYTES));
+
+        // read_gwas_budgeted 的记账口径：行文本 + GWAS_ROW_BYTES
+        const uint64_t cost = (uint64_t)(S.text_bytes * k + n * GWAS_ROW_BYTES);
+        if (P.memory_limit > 0 && !P.gwas_sorted && resident + cost > P.memory_limit)
+            spill_files.push_back(G.gwas_file);
+        else
+            resident += cost;
+    }
+    R.rows(rows);
+
+    R.stage("GWAS read + decompress", read_sec);
+    R.stage("dbSNP scan", D.read_sec * D.scale());
+    R.stage("QC, sort, join, dedup, write", proc_sec);
+
+    if (P.gwas_sorted) {
+        R.note("--gwas-sorted streams both inputs; memory does not grow with GWAS size.");
+    } else {
+        R.memory("GWAS lines", line_heap + line_vec);
+        // gwas_vec（reserve 1<<20）+ stable_sort 的临时缓冲
+        R.memory("GWASRecord + sort buffer",
+                 (dry_vector_capacity((uint64_t)rows, 1 << 20) + (uint64_t)rows) * sizeof(GWASRecord));
+        if (P.join_mode == "hash") {
+            R.memory("position hash table", dry_vector_capacity((uint64_t)rows * 2, 16) * sizeof(PosHashTable::Slot));
+            R.memory("dbSNP line blocks", (uint64_t)(2.0 * (1 << 16) *
+                     (sizeof(std::string) + D.line_heap_per_row())));
+        }
+        if (max_dedup) R.memory("duplicate-SNP table", max_dedup);
+    }
+
+    if (!spill_files.empty()) {
+        R.note(std::to_string(spill_files.size()) + " GWAS file(s) exceed --memory-limit and will be spilled to " +
+               (P.tmp_dir.empty() ? std::string("the --out directory") : P.tmp_dir) +
+               " (external sort; memory stays near the limit, time above is for the in-memory path).");
+        if (P.join_mode == "hash") R.note("spilling needs --join merge; this run would stop with an error.");
+    }
+    R.print();
+}
+
+void process_rsidImpu(const Args_RsidImpu& P)
+{
+    if (P.dry_run) {
+        dry_run_rsidImpu(P);
+        return;
+    }
+
+    if (P.reverse) {
+        process_rsidImpu_reverse(P);
+        return;
+    }
+
+    if (P.gwas_sorted) {
+        process_rsidImpu_stream(P);
+        return;
+    }
+
+    //================ 0. 输入列表（单文件 / --gwas-list 批量） =================
+    std::vector<GwasInput> inputs;
+    if (!P.gwas_list.empty()) {
+        inputs = read_gwas_list(P.gwas_list);
+        LOG_INFO("Batch mode: " + std::to_string(inputs.size()) +
+                 " GWAS files share one dbSNP scan.");
+    } else {
+        GwasInput G;
+        G.gwas_file = P.gwas_file;
+        G.out_file  = P.out_file;
+        inputs.push_back(std::move(G));
+    }
+
+    //================ 1. 读入所有 GWAS，合并为一条位置流 =================
+    std::vector<GWASRecord> gwas_vec;
+    gwas_vec.reserve(1 << 20);
+
+    RowFilter rf(P);                   // 列表 / 区间只读一次，各文件共用
+
+    // --memory-limit：按预算读入；放不下的文件落盘，之后各自走外存路径（不进共享扫描）
+    MemCharge resident;
+    std::vector<SpillFile> spilled(inputs.size());
+    size_t n_mem = inputs.size();
+    if (mem_budget() > 0) {
+        for (size_t f = 0; f < inputs.size(); ++f) {
+            if (!read_gwas_budgeted(P, inputs[f], resident, spilled[f])) --n_mem;
+        }
+    }
+
+    for (size_t f = 0; f < inputs.size(); ++f) {
+        if (spilled[f].empty()) load_gwas_input(P, rf, inputs[f], (uint32_t)f, gwas_vec);
+    }
+
+    if (n_mem > 0) {
+        // 按 chr, pos 排序（稳定排序：同位置保持 文件序 + 行序）
+        std::stable_sort(gwas_vec.begin(), gwas_vec.end(),
+            [](const GWASRecord& a, const GWASRecord& b){
+                if (a.chr != b.chr) return a.chr < b.chr;
+                return a.pos < b.pos;
+            }
+        );
+
+        LOG_INFO("GWAS records sorted by CHR:POS for two-pointer matching.");
+
+        //================ 2. 单通扫描 dbSNP =================
+        // 未压缩 dbSNP：走 mmap merge（多线程分段并行；稀疏 GWAS 时跳跃前进）
+        bool dbsnp_plain = LineReader::is_plain_file(P.dbsnp_file);
+
+        if (P.join_mode == "hash") {
+            scan_dbsnp_hash(P, gwas_vec, inputs);
+        } else if (dbsnp_plain) {
+            scan_dbsnp_ranges(P, gwas_vec, inputs);
+        } else {
+            scan_dbsnp_merge(P, gwas_vec, inputs);
+        }
+
+        //================ 3. 每个文件各自去重 + 输出 =================
+        for (size_t f = 0; f < inputs.size(); ++f) {
+            GwasInput& G = inputs[f];
+            if (!spilled[f].empty()) continue;
+            write_gwas_outputs(P, G);
+
+            // 写完即释放，降低批量模式峰值内存
+            std::vector<std::string>().swap(G.gwas_lines);
+            std::vector<std::string>().swap(G.rsid_vec);
+        }
+    }
+
+    //================ 4. 落盘的文件：外存路径（内存版全部写完、释放之后） =================
+    std::vector<GWASRecord>().swap(gwas_vec);
+    resident.clear();
+    for (size_t f = 0; f < inputs.size(); ++f) {
+        if (spilled[f].empty()) continue;
+        process_rsidImpu_spill(P, rf, inputs[f], spilled[f].path());
+        spilled[f].reset();
+    }
+}
@@ -12,8 +12,39 @@
 
 #include <unordered_map>
 #include <string>
+#include <string_view>
 
 void process_rsidImpu(const Args_RsidImpu& P);
 
+// =======================================================
+// [SERVE] 常驻 dbSNP 位置索引：(CHR, POS, 等位基因指纹) -> rsID 数字
+// 匹配规则与 rsidImpu 相同：strand-invariant AlleleKey，多 ALT 逐个比，
+// 同一位点多条 dbSNP 命中时取文件中最后一条；ID 原样输出（非 "rs<数字>" 的 ID 存在字符池里）
+// index_file 非空：存在则 mmap 加载（不读 dbSNP），不存在则构建后保存
+// 构建 / 加载完成后只读，可被多个线程同时查询
+// =======================================================
+class DbsnpPosIndex {
+public:
+    DbsnpPosIndex(const Args_RsidImpu& P, const std::string& index_file);
+    ~DbsnpPosIndex();
+
+    DbsnpPosIndex(const DbsnpPosIndex&) = delete;
+    DbsnpPosIndex& operator=(const DbsnpPosIndex&) = delete;
+
+    size_t size() const;
+
+    // 单个位点；命中时写入 rsid 并返回 true
+    bool lookup(std::string_view chr, std::string_view pos,
+                std::string_view a1, std::string_view a2, std::string& rsid) const;
+
+    // 注释一个 GWAS 文件（P.gwas_file -> P.out_file）；QC / 去重 / --format / .unmatch 与 rsidImpu 相同
+    // 返回命中行数，total 为数据行数
+    size_t annotate(const Args_RsidImpu& P, size_t& total) const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
 #endif
 
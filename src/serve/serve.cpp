@@ -0,0 +1,261 @@
+//
+//  serve.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "serve/serve.hpp"
+
+#include "rsidImpu/rsidImpu.hpp"
+#include "utils/log.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// =======================================================
+// [SERVE] 常驻注释进程
+//   dbSNP 位置索引只建一次（或从 --pos-index mmap），之后每个连接一个请求：
+//     PING                         -> OK\t<entries>
+//     FILE\tGWAS\tOUT[\t--opt\tval]-> OK\t<matched>\t<lines> | ERR\t<msg>
+//     ROWS\n CHR POS A1 A2 ...\n\n -> 每行一个 rsID（未命中 NA）
+//   连接由 --threads 个 worker 处理；每个请求内部单线程，避免 OpenMP 与 worker 争核
+// =======================================================
+
+static std::atomic<bool> g_stop{false};
+
+static void on_signal(int){ g_stop = true; }
+
+// ---------------- socket I/O ----------------
+static bool send_all(int fd, std::string_view s)
+{
+    while (!s.empty()) {
+        ssize_t k = ::send(fd, s.data(), s.size(), MSG_NOSIGNAL);
+        if (k < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        s.remove_prefix((size_t)k);
+    }
+    return true;
+}
+
+// 按行读取；buf 保存已收到但未消费的字节
+static bool recv_line(int fd, std::string& buf, std::string& line)
+{
+    for (;;) {
+        size_t nl = buf.find('\n');
+        if (nl != std::string::npos) {
+            line.assign(buf, 0, nl);
+            buf.erase(0, nl + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+        char tmp[65536];
+        ssize_t k = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) {                      // EOF：最后一行可以不带换行
+            if (buf.empty()) return false;
+            line.swap(buf);
+            buf.clear();
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+        buf.append(tmp, (size_t)k);
+    }
+}
+
+static std::vector<std::string> split_tab(const std::string& s)
+{
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t t = s.find('\t', start);
+        if (t == std::string::npos) t = s.size();
+        out.emplace_back(s, start, t - start);
+        start = t + 1;
+    }
+    return out;
+}
+
+static std::string one_line(std::string msg)
+{
+    for (char& c : msg) if (c == '\n' || c == '\r' || c == '\t') c = ' ';
+    return msg;
+}
+
+// ---------------- 请求处理 ----------------
+static void handle_rows(int fd, std::string& buf, const DbsnpPosIndex& idx)
+{
+    // 先收完整批，再一次性回写：客户端可以先写完再读，不会互相阻塞
+    std::vector<std::string> rows;
+    std::string line;
+    while (recv_line(fd, buf, line) && !line.empty()) rows.push_back(std::move(line));
+
+    std::string out, rsid;
+    out.reserve(rows.size() * 12);
+    for (const auto& r : rows) {
+        // CHR POS A1 A2：tab 或空格分隔
+        std::string_view f[4];
+        size_t nf = 0, i = 0;
+        while (nf < 4 && i < r.size()) {
+            while (i < r.size() && (r[i] == '\t' || r[i] == ' ')) ++i;
+            size_t j = i;
+            while (j < r.size() && r[j] != '\t' && r[j] != ' ') ++j;
+            if (j > i) f[nf++] = std::string_view(r).substr(i, j - i);
+            i = j;
+        }
+        if (nf == 4 && idx.lookup(f[0], f[1], f[2], f[3], rsid)) out += rsid;
+        else out += "NA";
+        out += '\n';
+    }
+    send_all(fd, out);
+}
+
+static void handle_file(int fd, const std::vector<std::string>& req,
+                        const Args_Serve& base, const DbsnpPosIndex& idx)
+{
+    std::string reply;
+    try {
+        std::vector<std::string> tokens(req.begin() + 1, req.end());
+        Args_RsidImpu P = parse_serve_request(base, tokens);
+
+        size_t total = 0;
+        size_t matched = idx.annotate(P, total);
+        reply = "OK\t" + std::to_string(matched) + "\t" + std::to_string(total) + "\n";
+        LOG_INFO("serve: " + P.gwas_file + " -> " + P.out_file + " (" +
+                 std::to_string(matched) + "/" + std::to_string(total) + " matched)");
+    } catch (const GwasExit&) {
+        reply = "ERR\t" + one_line(g_last_error.empty() ? "request failed" : g_last_error) + "\n";
+    } catch (const std::exception& e) {
+        reply = "ERR\t" + one_line(e.what()) + "\n";
+        LOG_WARN(std::string("serve: ") + e.what());
+    }
+    g_last_error.clear();
+    send_all(fd, reply);
+}
+
+static void handle_conn(int fd, const Args_Serve& P, const DbsnpPosIndex& idx)
+{
+    std::string buf, line;
+    if (!recv_line(fd, buf, line)) return;
+
+    std::vector<std::string> req = split_tab(line);
+    const std::string& verb = req[0];
+
+    if (verb == "PING") {
+        send_all(fd, "OK\t" + std::to_string(idx.size()) + "\n");
+    } else if (verb == "ROWS") {
+        handle_rows(fd, buf, idx);
+    } else if (verb == "FILE") {
+        handle_file(fd, req, P, idx);
+    } else {
+        send_all(fd, "ERR\tunknown request: " + one_line(verb) + "\n");
+    }
+}
+
+// ---------------- 主循环 ----------------
+void run_serve(const Args_Serve& P)
+{
+    DbsnpPosIndex idx(P, P.pos_index);
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (P.socket_path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR("Socket path too long: " + P.socket_path);
+        die(1);
+    }
+    std::memcpy(addr.sun_path, P.socket_path.c_str(), P.socket_path.size() + 1);
+
+    int lfd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (lfd < 0) {
+        LOG_ERROR(std::string("socket(): ") + std::strerror(errno));
+        die(1);
+    }
+    ::unlink(P.socket_path.c_str());     // 上次异常退出遗留的 socket 文件
+    if (::bind(lfd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(lfd, 128) < 0) {
+        LOG_ERROR("Cannot listen on " + P.socket_path + ": " + std::strerror(errno));
+        ::close(lfd);
+        die(1);
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT,  on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    // 请求里的致命错误只结束该请求，不结束进程
+    g_exit_throws = true;
+
+    // ---------------- worker 池 ----------------
+    std::deque<int> queue;
+    std::mutex qm;
+    std::condition_variable qcv;
+
+    int nworkers = P.threads > 0 ? P.threads : 1;
+    std::vector<std::thread> workers;
+    for (int w = 0; w < nworkers; ++w) {
+        workers.emplace_back([&]{
+#ifdef _OPENMP
+            omp_set_num_threads(1);
+#endif
+            for (;;) {
+                int fd;
+                {
+                    std::unique_lock<std::mutex> lock(qm);
+                    qcv.wait(lock, [&]{ return g_stop || !queue.empty(); });
+                    if (queue.empty()) return;
+                    fd = queue.front();
+                    queue.pop_front();
+                }
+                handle_conn(fd, P, idx);
+                ::close(fd);
+            }
+        });
+    }
+
+    LOG_INFO("serve: listening on " + P.socket_path + " (" + std::to_string(idx.size()) +
+             " dbSNP entries, " + std::to_string(nworkers) + " workers)");
+
+    while (!g_stop) {
+        pollfd pfd{lfd, POLLIN, 0};
+        int r = ::poll(&pfd, 1, 500);    // 定时醒来检查 g_stop
+        if (r <= 0) continue;
+        int cfd = ::accept(lfd, nullptr, nullptr);
+        if (cfd < 0) continue;
+        timeval tv{60, 0};               // 不发送请求的客户端不能一直占住 worker
+        ::setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        {
+            std::lock_guard<std::mutex> lock(qm);
+            queue.push_back(cfd);
+        }
+        qcv.notify_one();
+    }
+
+    LOG_INFO("serve: shutting down ...");
+    qcv.notify_all();
+    for (auto& t : workers) t.join();   // 已接受的连接处理完再退出
+
+    ::close(lfd);
+    ::unlink(P.socket_path.c_str());
+    g_exit_throws = false;
+}
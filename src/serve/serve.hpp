@@ -0,0 +1,8 @@
+#ifndef GWASTOOLKIT_SERVE_HPP
+#define GWASTOOLKIT_SERVE_HPP
+
+#include "utils/args.hpp"
+
+void run_serve(const Args_Serve& P);
+
+#endif
@@ -0,0 +1,311 @@
+//
+//  sort.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "sort/sort.hpp"
+
+#include "utils/gwasparts.hpp"
+#include "utils/writer.hpp"
+#include "utils/spill.hpp"
+#include "utils/util.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// =======================================================
+// [SORT] 外排序：按 canonical chr（1..22, X, Y, MT）+ POS；
+//   其他 contig（GL000192.1、chrUn_* ...）排在 MT 之后，按名字再按 POS；
+//   CHR/POS 缺失或非法的行原样放在最后（输入顺序）——输出总是输入的一个排列
+//   1) 读入一段（--memory 的一半）→ OpenMP 并行排序 → 写临时 run；
+//      排序/落盘与读下一段重叠（两段各占一半预算）
+//   2) 多个 run 做 k 路归并；只有一段时直接输出，不落临时文件
+//   3) 输出 .gz 时写 BGZF，并同时生成 tabix 兼容的 .tbi（Writer::enable_index）
+//   同一位置保持输入行序（稳定）
+// =======================================================
+
+namespace {
+
+struct SortRec {
+    uint64_t key;      // chr << 32 | pos
+    uint64_t off;      // 在 arena 中的起点
+    uint32_t len;
+};
+
+struct Run {
+    std::string arena;
+    std::vector<SortRec> recs;
+
+    size_t bytes() const { return arena.size() + recs.size() * sizeof(SortRec); }
+    void clear() { arena.clear(); recs.clear(); }
+};
+
+inline std::string_view trim_ws(std::string_view sv){
+    while (!sv.empty() && (sv.front()==' ' || sv.front()=='\t')) sv.remove_prefix(1);
+    while (!sv.empty() && (sv.back() ==' ' || sv.back() =='\t' || sv.back()=='\r')) sv.remove_suffix(1);
+    return sv;
+}
+
+// 第 col 列（tab 分隔）；列数不足返回 false
+inline bool get_col(std::string_view line, int col, std::string_view& out){
+    size_t start = 0;
+    for (int c = 0; c < col; ++c) {
+        size_t p = line.find('\t', start);
+        if (p == std::string_view::npos) return false;
+        start = p + 1;
+    }
+    size_t end = line.find('\t', start);
+    if (end == std::string_view::npos) end = line.size();
+    out = line.substr(start, end - start);
+    return true;
+}
+
+// key 的高 32 位：1..25 = canonical chr，kContig = 其他 contig（同 key 时再比名字），kBadRow = 无法排序的行
+constexpr uint64_t kContig = 26;
+constexpr uint64_t kBadRow = 27;
+
+inline bool row_key(std::string_view line, int ichr, int ipos, uint64_t& key){
+    key = kBadRow << 32;
+    std::string_view vc, vp;
+    if (!get_col(line, ichr, vc) || !get_col(line, ipos, vp)) return false;
+    vc = trim_ws(vc);
+    if (vc.empty()) return false;
+    int chr = canonical_chr_code_sv(vc);
+    if (chr < 0) chr = (int)kContig;
+    vp = trim_ws(vp);
+    uint64_t pos = 0;
+    auto r = std::from_chars(vp.data(), vp.data() + vp.size(), pos);
+    if (r.ec != std::errc() || r.ptr != vp.data() + vp.size()) return false;
+    if (pos == 0 || pos > 0xffffffffull) return false;
+    key = ((uint64_t)chr << 32) | pos;
+    return true;
+}
+
+// 两行的 key 先比 chr；都是 kContig 时比 contig 名字（从行里现取：这类行通常很少，
+// 不必为它们维护一张跨 run / 跨线程的名字表），再比 POS
+inline int key_cmp(uint64_t ka, std::string_view la, uint64_t kb, std::string_view lb, int ichr){
+    if ((ka >> 32) != (kb >> 32)) return (ka >> 32) < (kb >> 32) ? -1 : 1;
+    if ((ka >> 32) == kContig) {
+        std::string_view ca, cb;
+        get_col(la, ichr, ca);
+        get_col(lb, ichr, cb);
+        int c = trim_ws(ca).compare(trim_ws(cb));
+        if (c != 0) return c;
+    }
+    return ka == kb ? 0 : (ka < kb ? -1 : 1);
+}
+
+struct RecLess {
+    const Run* R;
+    int ichr;
+    bool operator()(const SortRec& a, const SortRec& b) const {
+        int c = key_cmp(a.key, std::string_view(R->arena.data() + a.off, a.len),
+                        b.key, std::string_view(R->arena.data() + b.off, b.len), ichr);
+        // off 随输入单调递增：等 key 时按输入顺序（稳定）
+        return c != 0 ? c < 0 : a.off < b.off;
+    }
+};
+
+// 分块并行 std::sort，再逐层两两 inplace_merge
+void parallel_sort(Run& R, int ichr)
+{
+    std::vector<SortRec>& v = R.recs;
+    const RecLess rec_less{&R, ichr};
+    int T = 1;
+#ifdef _OPENMP
+    T = omp_get_max_threads();
+#endif
+    if (T <= 1 || v.size() < (1u << 16)) {
+        std::sort(v.begin(), v.end(), rec_less);
+        return;
+    }
+
+    std::vector<size_t> bound(T + 1);
+    for (int t = 0; t <= T; ++t) bound[t] = v.size() * (size_t)t / (size_t)T;
+
+    #pragma omp parallel for schedule(static)
+    for (int t = 0; t < T; ++t)
+        std::sort(v.begin() + bound[t], v.begin() + bound[t+1], rec_less);
+
+    for (int width = 1; width < T; width *= 2) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int t = 0; t < T; t += 2 * width) {
+            if (t + width >= T) continue;
+            int hi = std::min(t + 2 * width, T);
+            std::inplace_merge(v.begin() + bound[t], v.begin() + bound[t + width],
+                               v.begin() + bound[hi], rec_less);
+        }
+    }
+}
+
+// 临时 run 文件：每条记录 [key u64][len u32][bytes]
+void spill_run(const Run& R, const std::string& path)
+{
+    FILE* fp = std::fopen(path.c_str(), "wb");
+    if (!fp) {
+        LOG_ERROR("Cannot create temporary file: " + path + " (see --tmp-dir)");
+        die(1);
+    }
+    std::vector<char> vbuf(1u << 22);
+    setvbuf(fp, vbuf.data(), _IOFBF, vbuf.size());
+    bool ok = true;
+    for (const auto& r : R.recs) {
+        ok = ok && std::fwrite(&r.key, sizeof(r.key), 1, fp) == 1;
+        ok = ok && std::fwrite(&r.len, sizeof(r.len), 1, fp) == 1;
+        ok = ok && std::fwrite(R.arena.data() + r.off, 1, r.len, fp) == r.len;
+    }
+    if (std::fclose(fp) != 0 || !ok) {
+        LOG_ERROR("Error writing temporary file: " + path + " (disk full?)");
+        die(1);
+    }
+}
+
+struct RunReader {
+    FILE* fp = nullptr;
+    std::vector<char> vbuf;
+    uint64_t key = 0;
+    std::string line;
+
+    explicit RunReader(const std::string& path) : vbuf(1u << 20) {
+        fp = std::fopen(path.c_str(), "rb");
+        if (!fp) {
+            LOG_ERROR("Cannot read temporary file: " + path);
+            die(1);
+        }
+        setvbuf(fp, vbuf.data(), _IOFBF, vbuf.size());
+    }
+    ~RunReader() { if (fp) std::fclose(fp); }
+
+    bool next() {
+        uint32_t len = 0;
+        if (std::fread(&key, sizeof(key), 1, fp) != 1) return false;
+        if (std::fread(&len, sizeof(len), 1, fp) != 1) return false;
+        line.resize(len);
+        return len == 0 || std::fread(&line[0], 1, len, fp) == len;
+    }
+};
+
+} // namespace
+
+void run_sort(const Args_Sort& P)
+{
+    GwasPartsReader reader(P.gwas_file);
+
+    std::string header;
+    if (!reader.getline(header)) {
+        LOG_ERROR("Empty GWAS summary file in sort.");
+        die(1);
+    }
+    if (!header.empty() && header.back() == '\r') header.pop_back();
+    auto hdr = split(header);
+    int ichr = find_col(hdr, P.g_chr);
+    require(ichr >= 0, "GWAS missing required column [" + P.g_chr + "] for sort.");
+    int ipos = find_col(hdr, P.g_pos);
+    require(ipos >= 0, "GWAS missing required column [" + P.g_pos + "] for sort.");
+
+    // 两段交替：一段排序落盘时另一段继续读
+    const size_t run_budget = std::max<uint64_t>(P.memory_bytes / 2, 1u << 20);
+    const std::string tmp_prefix = spill_prefix(P.tmp_dir, P.out_file, "sort");
+
+    std::vector<SpillFile> run_files;                 // 析构 / die 时删除
+    std::future<void> pending;
+    std::unique_ptr<Run> cur(new Run), spare(new Run);
+
+    uint64_t nrows = 0, nbad = 0;
+    std::string line;
+    bool more = true;
+
+    while (more) {
+        Run& R = *cur;
+        while ((more = reader.getline(line))) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            uint64_t key;
+            if (!row_key(line, ichr, ipos, key)) ++nbad;        // 不丢：排在最后
+            R.recs.push_back({key, R.arena.size(), (uint32_t)line.size()});
+            R.arena.append(line);
+            ++nrows;
+            if (R.bytes() >= run_budget) break;
+        }
+
+        if (!more && run_files.empty()) break;    // 全部放得下：内存中排序后直接输出
+
+        if (pending.valid()) pending.get();
+        std::string path = tmp_prefix + std::to_string(run_files.size()) + ".tmp";
+        run_files.emplace_back(path);
+        std::swap(cur, spare);                    // spare 交给后台；cur 为上一轮已落盘的段
+        cur->clear();
+        Run* job = spare.get();
+        pending = std::async(std::launch::async, [job, path, ichr]{
+            parallel_sort(*job, ichr);
+            spill_run(*job, path);
+        });
+    }
+    if (pending.valid()) pending.get();
+
+    if (nbad > 0)
+        LOG_WARN(std::to_string(nbad) + " rows without a valid CHR/POS are kept at the end of the output, "
+                 "in input order" + (ends_with(P.out_file, ".gz") ? "; no index can cover them." : "."));
+
+    // .gz → BGZF，Writer 边写边建 .tbi
+    Writer out(P.out_file);
+    if (!out.good()) die(1);
+    if (ends_with(P.out_file, ".gz")) out.enable_index(P.g_chr, P.g_pos);
+    std::string& buf = out.buffer();
+    auto emit = [&](std::string_view row){
+        buf.append(row.data(), row.size());
+        buf.push_back('\n');
+        out.flush_if_full();
+    };
+    emit(header);
+
+    if (run_files.empty()) {
+        Run& R = *cur;
+        parallel_sort(R, ichr);
+        for (const auto& r : R.recs)
+            emit(std::string_view(R.arena.data() + r.off, r.len));
+        LOG_INFO("Sorted " + std::to_string(nrows) + " rows in memory.");
+    } else {
+        cur.reset();
+        spare.reset();
+
+        // k 路归并；等 key 时 run 编号小者优先（run 按输入顺序切分 → 稳定）
+        std::vector<std::unique_ptr<RunReader>> runs;
+        for (const auto& f : run_files) runs.emplace_back(new RunReader(f.path()));
+
+        // 堆顶为最小：greater 语义
+        auto after = [&](size_t a, size_t b) {
+            int c = key_cmp(runs[a]->key, runs[a]->line, runs[b]->key, runs[b]->line, ichr);
+            return c != 0 ? c > 0 : a > b;
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(after)> pq(after);
+        for (size_t i = 0; i < runs.size(); ++i)
+            if (runs[i]->next()) pq.push(i);
+
+        while (!pq.empty()) {
+            size_t i = pq.top();
+            pq.pop();
+            emit(runs[i]->line);
+            if (runs[i]->next()) pq.push(i);
+        }
+
+        runs.clear();
+        LOG_INFO("Sorted " + std::to_string(nrows) + " rows via " +
+                 std::to_string(run_files.size()) + " temporary runs.");
+        run_files.clear();
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef GWASTOOLKIT_SORT_HPP
+#define GWASTOOLKIT_SORT_HPP
+
+#include "utils/args.hpp"
+
+void run_sort(const Args_Sort& P);
+
+#endif
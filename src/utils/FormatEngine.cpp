@@ -1,6 +1,11 @@
 #include "utils/FormatEngine.hpp"
+#include "utils/StatFunc.hpp"
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 // 小工具：ASCII lower
 static inline char low(char c){ return (char)std::tolower((unsigned char)c); }
@@ -24,6 +29,9 @@ FieldId FormatEngine::col_to_field_id(std::string_view col)
     if (eq_ci(col, "se") || eq_ci(col, "SE")) return FieldId::SE;
     if (eq_ci(col, "p") || eq_ci(col, "P")) return FieldId::P;
     if (eq_ci(col, "n") || eq_ci(col, "N")) return FieldId::N;
+    if (eq_ci(col, "Z")) return FieldId::Z;
+    if (eq_ci(col, "CHR")) return FieldId::CHR;
+    if (eq_ci(col, "POS")) return FieldId::POS;
 
     return FieldId::UNKNOWN;
 }
@@ -40,10 +48,47 @@ std::string_view FormatEngine::key_of(FieldId id)
         case FieldId::SE:   return "se";
         case FieldId::P:    return "p";
         case FieldId::N:    return "N";
+        case FieldId::Z:    return "Z";
+        case FieldId::CHR:  return "CHR";
+        case FieldId::POS:  return "POS";
         default:            return "";
     }
 }
 
+const FormatEngine::CellView FormatEngine::RowView::* FormatEngine::member_of(FieldId id)
+{
+    switch(id){
+        case FieldId::SNP:  return &RowView::SNP;
+        case FieldId::A1:   return &RowView::A1;
+        case FieldId::A2:   return &RowView::A2;
+        case FieldId::FREQ: return &RowView::freq;
+        case FieldId::BETA: return &RowView::beta;
+        case FieldId::SE:   return &RowView::se;
+        case FieldId::P:    return &RowView::p;
+        case FieldId::N:    return &RowView::N;
+        case FieldId::Z:    return &RowView::Z;
+        case FieldId::CHR:  return &RowView::CHR;
+        case FieldId::POS:  return &RowView::POS;
+        default:            return nullptr;
+    }
+}
+
+// [OPT-FE-1/2] 预计算 field_ids 与成员指针表
+void FormatEngine::resolve(FormatSpec& spec)
+{
+    spec.field_ids.clear();
+    spec.cells.clear();
+    spec.field_ids.reserve(spec.cols.size());
+    spec.cells.reserve(spec.cols.size());
+    for (auto &c : spec.cols) {
+        FieldId id = col_to_field_id(c);
+        spec.field_ids.push_back(id);
+        spec.cells.push_back(member_of(id));
+        if (id == FieldId::Z) spec.needs_z = true;
+        if (id == FieldId::CHR || id == FieldId::POS) spec.needs_chrpos = true;
+    }
+}
+
 // string append 替代 ostringstream
 inline void FormatEngine::append_tabbed(std::string& out, bool& first, std::string_view sv)
 {
@@ -75,9 +120,7 @@ FormatEngine::FormatEngine() {
         spec.required_N    = true;
         spec.allow_missing = false;
 
-        // [OPT-FE-1] 预计算 field_ids
-        spec.field_ids.reserve(spec.cols.size());
-        for (auto &c : spec.cols) spec.field_ids.push_back(col_to_field_id(c));
+        resolve(spec);
 
         formats[spec.name] = spec;
     }
@@ -94,8 +137,7 @@ FormatEngine::FormatEngine() {
         spec.required_N    = true;
         spec.allow_missing = false;
 
-        spec.field_ids.reserve(spec.cols.size());
-        for (auto &c : spec.cols) spec.field_ids.push_back(col_to_field_id(c));
+        resolve(spec);
 
         formats[spec.name] = spec;
     }
@@ -112,8 +154,52 @@ FormatEngine::FormatEngine() {
         spec.required_N    = true;
         spec.allow_missing = false;
 
-        spec.field_ids.reserve(spec.cols.size());
-        for (auto &c : spec.cols) spec.field_ids.push_back(col_to_field_id(c));
+        resolve(spec);
+
+        formats[spec.name] = spec;
+    }
+
+    // ------- SMR (.ma)：与 COJO 同列，表头小写 n -------
+    {
+        FormatSpec spec;
+        spec.name          = "smr";
+        spec.cols          = {"SNP","A1","A2","freq","b","se","p","n"};
+        spec.required_rsid = true;
+        spec.required_beta = true;
+        spec.required_se   = true;
+        spec.required_freq = true;
+        spec.required_N    = true;
+        spec.allow_missing = false;
+
+        resolve(spec);
+
+        formats[spec.name] = spec;
+    }
+
+    // ------- LDSC (munge_sumstats 输出)：Z = beta/se，或由 p + sign(beta) 得到 -------
+    {
+        FormatSpec spec;
+        spec.name          = "ldsc";
+        spec.cols          = {"SNP","A1","A2","Z","N"};
+        spec.required_rsid = true;
+        spec.required_N    = true;
+        spec.allow_missing = false;
+
+        resolve(spec);
+
+        formats[spec.name] = spec;
+    }
+
+    // ------- Arrow IPC：列同 COJO + CHR/POS，由 Writer 写成带类型的列 -------
+    // 缺失单元格（如输入没有 CHR/POS）写 Arrow null
+    {
+        FormatSpec spec;
+        spec.name          = "arrow";
+        spec.cols          = {"SNP","CHR","POS","A1","A2","freq","b","se","p","N"};
+        spec.required_rsid = true;
+        spec.allow_missing = true;
+
+        resolve(spec);
 
         formats[spec.name] = spec;
     }
@@ -163,32 +249,55 @@ std::string FormatEngine::format_line_fast(const FormatSpec& spec, const RowView
 {
     std::string out;
     out.reserve(128);
-    bool first = true;
-
-    for (size_t i=0; i<spec.cols.size(); ++i){
-        FieldId id = spec.field_ids[i];
-
-        const CellView* cell = nullptr;
-        switch(id){
-            case FieldId::SNP:  cell = &row.SNP; break;
-            case FieldId::A1:   cell = &row.A1;  break;
-            case FieldId::A2:   cell = &row.A2;  break;
-            case FieldId::FREQ: cell = &row.freq;break;
-            case FieldId::BETA: cell = &row.beta;break;
-            case FieldId::SE:   cell = &row.se;  break;
-            case FieldId::P:    cell = &row.p;   break;
-            case FieldId::N:    cell = &row.N;   break;
-            default:            cell = nullptr;  break;
-        }
+    append_line_fast(spec, row, out);
+    out.pop_back();   // 去掉 '\n'
+    return out;
+}
 
-        if (cell && cell->present) {
-            append_tabbed(out, first, cell->v);
-        } else {
-            if (!spec.allow_missing) {
-                throw std::runtime_error("Missing required column [" + spec.cols[i] + "]");
-            }
-            append_tabbed(out, first, "");
+// [OPT-FE-2] 直接 append 进调用方缓冲：无临时 string、无逐列 switch
+void FormatEngine::append_line_fast(const FormatSpec& spec, const RowView& row, std::string& out) const
+{
+    const size_t n = spec.cells.size();
+    for (size_t i = 0; i < n; ++i) {
+        if (i) out.push_back('\t');
+        const auto m = spec.cells[i];
+        if (m && (row.*m).present) {
+            const std::string_view v = (row.*m).v;
+            out.append(v.data(), v.size());
+        } else if (!spec.allow_missing) {
+            throw std::runtime_error("Missing required column [" + spec.cols[i] + "]");
         }
     }
-    return out;
-}
\ No newline at end of file
+    out.push_back('\n');
+}
+
+// ---------------- Z 列（ldsc） ----------------
+static inline bool parse_num(std::string_view sv, double& out)
+{
+    if (sv.empty() || sv.size() >= 64) return false;
+    char tmp[64];
+    std::memcpy(tmp, sv.data(), sv.size());
+    tmp[sv.size()] = '\0';
+    char* end = nullptr;
+    out = std::strtod(tmp, &end);
+    return end == tmp + sv.size() && std::isfinite(out);
+}
+
+std::string_view FormatEngine::format_z(double z, char* buf, size_t cap)
+{
+    // beta/se/p 都不可用 → NA（ldsc 读入时 dropna，行数与其它格式保持一致）
+    if (!std::isfinite(z)) return "NA";
+    int len = std::snprintf(buf, cap, "%.6f", z);
+    if (len <= 0 || (size_t)len >= cap) return "NA";
+    return std::string_view(buf, (size_t)len);
+}
+
+void FormatEngine::fill_z(RowView& row, char* buf, size_t cap)
+{
+    double beta = NAN, se = NAN, p = NAN;
+    if (row.beta.present) parse_num(row.beta.v, beta);
+    if (row.se.present)   parse_num(row.se.v,   se);
+    if (row.p.present)    parse_num(row.p.v,    p);
+
+    row.Z = {format_z(StatFunc::z_score(beta, se, p), buf, cap), true};
+}
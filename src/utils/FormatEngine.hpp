@@ -6,7 +6,18 @@
 #include <cstdint>
 
 enum class FieldId : uint8_t {
-    SNP, A1, A2, FREQ, BETA, SE, P, N, UNKNOWN
+    SNP, A1, A2, FREQ, BETA, SE, P, N, Z, CHR, POS, UNKNOWN
+};
+
+// fast path 的行视图（放在 FormatSpec 之前，供其预先解析列 → 成员指针）
+struct FormatCellView {
+    std::string_view v;
+    bool present = false;
+};
+struct FormatRowView {
+    FormatCellView SNP, A1, A2, freq, beta, se, p, N;
+    FormatCellView Z;   // 派生列（ldsc）：由 beta/se 或 p 计算，调用方填入
+    FormatCellView CHR, POS;   // 可选（arrow）：GWAS 有 CHR/POS 列时填入
 };
 
 struct FormatSpec {
@@ -18,8 +29,14 @@ struct FormatSpec {
     bool required_freq = false;
     bool required_N    = false;
     bool allow_missing = false;
+    bool needs_z       = false;   // 含派生 Z 列（ldsc）
+    bool needs_chrpos  = false;   // 含 CHR/POS 列（arrow）
 
     std::vector<FieldId> field_ids;
+
+    // [OPT-FE-2] 列顺序在建 spec 时一次性解析为 RowView 成员指针，
+    // 逐行输出时不再 switch；UNKNOWN 列为 nullptr
+    std::vector<const FormatCellView FormatRowView::*> cells;
 };
 
 class FormatEngine {
@@ -33,21 +50,27 @@ public:
         const std::unordered_map<std::string,std::string>& row
     ) const;
     // fast path
-    struct CellView {
-        std::string_view v;
-        bool present = false;
-    };
-    struct RowView {
-        CellView SNP, A1, A2, freq, beta, se, p, N;
-    };
+    using CellView = FormatCellView;
+    using RowView  = FormatRowView;
 
     std::string format_line_fast(const FormatSpec& spec, const RowView& row) const;
 
+    // [OPT-FE-2] 零分配版本：把一行（含结尾 '\n'）直接追加到调用方的缓冲，
+    // 缓冲攒满后整块交给 Writer::write_block
+    void append_line_fast(const FormatSpec& spec, const RowView& row, std::string& out) const;
+
+    // 逐行路径的 Z：解析 row.beta/se/p → StatFunc::z_score → 写入 buf 并设置 row.Z。
+    // 整列场景（convert）请用 StatFunc::z_score_batch + format_z
+    static void fill_z(RowView& row, char* buf, size_t cap);
+    static std::string_view format_z(double z, char* buf, size_t cap);
+
 private:
     std::unordered_map<std::string, FormatSpec> formats;
 
     static FieldId col_to_field_id(std::string_view col);
     static std::string_view key_of(FieldId id);
+    static const CellView RowView::* member_of(FieldId id);
+    static void resolve(FormatSpec& spec);
 
     static inline void append_tabbed(std::string& out, bool& first, std::string_view sv);
 };
\ No newline at end of file
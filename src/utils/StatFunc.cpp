@@ -38,6 +38,57 @@ double qnorm(double p, bool upper) {
     return x;
 }
 
+// Wichura, M.J. (1988) Algorithm AS 241: The percentage points of the normal distribution.
+// Applied Statistics 37, 477-484.
+double qnorm_as241(double p) {
+    if (!(p > 0.0 && p < 1.0)) {
+        if (p == 0.0) return -INFINITY;
+        if (p == 1.0) return INFINITY;
+        return NAN;
+    }
+    const double q = p - 0.5;
+    if (std::fabs(q) <= 0.425) {
+        const double r = 0.180625 - q * q;
+        return q * (((((((r * 2509.0809287301226727 +
+                       33430.575583588128105) * r + 67265.770927008700853) * r +
+                     45921.953931549871457) * r + 13731.693765509461125) * r +
+                   1971.5909503065514427) * r + 133.14166789178437745) * r +
+                 3.387132872796366608) /
+               (((((((r * 5226.495278852545925 +
+                      28729.085735721942674) * r + 39307.89580009271061) * r +
+                    21213.794301586595867) * r + 5394.1960214247511077) * r +
+                  687.1870074920579083) * r + 42.313330701600911252) * r + 1.0);
+    }
+
+    double r = q < 0 ? p : 1.0 - p;
+    r = std::sqrt(-std::log(r));
+    double x;
+    if (r <= 5.0) {
+        r -= 1.6;
+        x = (((((((r * 7.7454501427834140764e-4 +
+                   0.0227238449892691845833) * r + 0.24178072517745061177) * r +
+                 1.27045825245236838258) * r + 3.64784832476320460504) * r +
+               5.7694972214606914055) * r + 4.6303378461565452959) * r +
+             1.42343711074968357734) /
+            (((((((r * 1.05075007164441684324e-9 + 5.475938084995344946e-4) * r +
+                  0.0151986665636164571966) * r + 0.14810397642748007459) * r +
+                0.68976733498510000455) * r + 1.6763848301838038494) * r +
+              2.05319162663775882187) * r + 1.0);
+    } else {
+        r -= 5.0;
+        x = (((((((r * 2.01033439929228813265e-7 +
+                   2.71155556874348757815e-5) * r + 0.0012426609473880784386) * r +
+                 0.026532189526576123093) * r + 0.29656057182850489123) * r +
+               1.7848265399172913358) * r + 5.4637849111641143699) * r +
+             6.6579046435011037772) /
+            (((((((r * 2.04426310338993978564e-15 + 1.4215117583164458887e-7) * r +
+                  1.8463183175100546818e-5) * r + 7.868691311456132591e-4) * r +
+                0.0148753612908506148525) * r + 0.13692988092273580531) * r +
+              0.59983220655588793769) * r + 1.0);
+    }
+    return q < 0 ? -x : x;
+}
+
 // =======================
 // p→z 转换（两侧）
 // =======================
@@ -62,4 +113,31 @@ double p2z_upper(double p) {
     return qnorm(p, true);
 }
 
+// =======================
+// Z 值（LDSC）
+// =======================
+// 显著位点的 p 常小到 1e-50 以下：用 AS241，而不是 p2z_two_tailed（qnorm 在 |z| ≈ 3.9 处就饱和）
+static inline double z_from_p(double beta, double p) {
+    if (!(p > 0 && p <= 1) || !std::isfinite(beta)) return NAN;
+    double z = std::fabs(qnorm_as241(p / 2.0));
+    return beta < 0 ? -z : z;
+}
+
+double z_score(double beta, double se, double p) {
+    if (std::isfinite(beta) && std::isfinite(se) && se > 0) return beta / se;
+    return z_from_p(beta, p);
+}
+
+void z_score_batch(const double* beta, const double* se, const double* p,
+                   double* z, size_t n) {
+    // 第一遍：纯算术，无分支外调用；se 非法时得到 inf/nan，留给第二遍
+    for (size_t i = 0; i < n; ++i) z[i] = beta[i] / se[i];
+
+    // 第二遍：只修补 se<=0 / 缺失的行
+    for (size_t i = 0; i < n; ++i) {
+        if (std::isfinite(z[i]) && se[i] > 0) continue;
+        z[i] = z_from_p(beta[i], p[i]);
+    }
+}
+
 }
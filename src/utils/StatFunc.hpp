@@ -2,6 +2,7 @@
 #define GWASTOOLKIT_statfunc_HPP
 
 #include <cmath>
+#include <cstddef>
 
 namespace StatFunc {
     // 标准正态概率密度 φ(x)
@@ -16,6 +17,10 @@ namespace StatFunc {
     // 反正态分布（lower-tail / upper-tail 都支持）
     double qnorm(double p, bool upper = false);
 
+    // 反正态分布（lower-tail），Wichura AS241 (PPND16)：相对误差约 1e-16，p 可小到 1e-300
+    // （上面的 qnorm 只做 4 步牛顿迭代，p < 1e-4 左右就不准了）
+    double qnorm_as241(double p);
+
     // 双尾 p → z（两侧）
     double p2z_two_tailed(double p);
 
@@ -24,6 +29,13 @@ namespace StatFunc {
 
     // 单尾 p → z（右尾 upper tail）
     double p2z_upper(double p);
+
+    // 有符号 Z：优先 beta/se；否则用双尾 p 与 beta 的符号；都不可用返回 NaN
+    double z_score(double beta, double se, double p);
+
+    // 整列批量 Z（LDSC 输出）：beta/se 一遍直算（可向量化），只对少数缺 se 的行回退到 p
+    void z_score_batch(const double* beta, const double* se, const double* p,
+                       double* z, size_t n);
 }
 
 #endif
\ No newline at end of file
@@ -8,15 +8,19 @@
 
 #include "utils/args.hpp"
 #include "utils/log.hpp"
+#include "utils/spill.hpp"
+#include "utils/gwasparts.hpp"
+#include "utils/memio.hpp"
 
 #include <iostream>
+#include <algorithm>
 #include <cstdlib>
 #include <set>
 
 using namespace std;
 
 static const set<string> supported_formats = {
-    "gwas", "cojo", "popcorn", "mrmega"
+    "gwas", "cojo", "popcorn", "mrmega", "smr", "ldsc", "arrow"
 };
 
 // ★ 所有合法的参数名（包括 flag 和带值项）
@@ -26,12 +30,16 @@ static const set<string> common_params = {
     "--freq", "--beta", "--se", "--n",
     "--format",
     "--maf", "--remove-dup-snp",
-    "--threads", "--log"
+    "--threads", "--log", "--cache-dir", "--index",
+    "--extract", "--exclude", "--region", "--region-file",
+    "--memory-limit", "--tmp-dir", "--dry-run", "--split-by-chr"
 };
 
 static const std::set<std::string> rsidimpu_params = {
     "--dbsnp", "--dbchr", "--dbpos", "--dbA1", "--dbA2", "--dbrsid",
-    "--chr", "--pos"
+    "--chr", "--pos",
+    "--gwas-list", "--join", "--gwas-sorted",
+    "--reverse", "--rsid-index"
 };
 static const std::set<std::string> convert_params = {};
 static const std::set<std::string> or2beta_params = {
@@ -41,30 +49,78 @@ static const set<string> calneff_params = {
     "--case", "--control",       // fixed-mode
     "--case-col", "--control-col" // per-SNP mode
 };
+static const set<string> serve_params = {
+    "--dbsnp", "--dbchr", "--dbpos", "--dbA1", "--dbA2", "--dbrsid",
+    "--chr", "--pos",
+    "--socket", "--pos-index"
+};
+// sort 只用到位置列，不接受 QC / 格式参数
+static const set<string> sort_params = {
+    "--gwas-summary", "--out", "--chr", "--pos",
+    "--memory", "--tmp-dir", "--threads", "--log"
+};
+static const set<string> query_params = {
+    "--gwas-summary", "--out", "--region", "--threads", "--log"
+};
+// serve 的单个请求可覆盖的选项（其余只能在启动时给）
+static const set<string> serve_request_params = {
+    "--SNP", "--chr", "--pos", "--A1", "--A2", "--pval",
+    "--freq", "--beta", "--se", "--n",
+    "--format", "--maf", "--remove-dup-snp", "--cache-dir", "--index",
+    "--extract", "--exclude", "--region", "--region-file"
+};
+static const set<string> pipeline_params = {
+    "--steps",
+    "--or",                       // or2beta
+    "--case", "--control",        // computeNeff fixed-mode
+    "--case-col", "--control-col" // computeNeff per-SNP mode
+};
 
 // =============== 通用错误检查 ===================
 static void require(bool cond, const string& msg){
     if (!cond) {
         LOG_ERROR(msg);
-        exit(1);
+        die(1);
     }
 }
 
 static void check_format(const string& fmt){
     if (!supported_formats.count(fmt)) {
         LOG_ERROR("Unsupported format: " + fmt + 
-        " (supported: gwas, cojo, popcorn, mrmega)");
-        exit(1);
+        " (supported: gwas, cojo, popcorn, mrmega, smr, ldsc, arrow)");
+        die(1);
     }
 }
 
+// "512M" / "4G" / "1.5G" / 纯字节数 → 字节
+static uint64_t parse_size_bytes(const string& key, const string& v){
+    size_t used = 0;
+    double x = 0;
+    try { x = stod(v, &used); } catch (...) { used = 0; }
+    string unit = v.substr(used);
+    for (auto& c : unit) c = (char)toupper((unsigned char)c);
+    if (!unit.empty() && unit.back() == 'B') unit.pop_back();
+    double mul = unit.empty() ? 1.0 :
+                 unit == "K" ? 1024.0 :
+                 unit == "M" ? 1024.0 * 1024 :
+                 unit == "G" ? 1024.0 * 1024 * 1024 :
+                 unit == "T" ? 1024.0 * 1024 * 1024 * 1024 : -1;
+    require(used > 0 && mul > 0 && x > 0, "Invalid size for " + key + ": " + v + " (e.g. 512M, 4G)");
+    return (uint64_t)(x * mul);
+}
+
 // ------------------------- 公共解析  ---------------------
-static void parse_common(CommonArgs& C, map<string,string>& args) {
-    require(args.count("--gwas-summary"), "Missing required: --gwas-summary");
-    require(args.count("--out"),          "Missing required: --out");
+// require_io = false：输入/输出由其他参数提供（如 rsidImpu --gwas-list）
+static void parse_common(CommonArgs& C, map<string,string>& args, bool require_io = true) {
+    if (require_io) {
+        require(args.count("--gwas-summary"), "Missing required: --gwas-summary");
+        require(args.count("--out"),          "Missing required: --out");
+    }
 
-    C.gwas_file = args["--gwas-summary"];
-    C.out_file  = args["--out"];
+    if (args.count("--gwas-summary")) C.gwas_file = args["--gwas-summary"];
+    // 多文件模式（chr{1..22} / chr*）在解析阶段展开一次：无匹配时尽早报错
+    if (is_gwas_pattern(C.gwas_file)) gwas_input_parts(C.gwas_file);
+    if (args.count("--out"))          C.out_file  = args["--out"];
 
     if (args.count("--threads"))
         C.threads = stoi(args["--threads"]);
@@ -74,6 +130,19 @@ static void parse_common(CommonArgs& C, map<string,string>& args) {
         C.log_file    = args["--log"];
     }
 
+    if (args.count("--cache-dir")) C.cache_dir = args["--cache-dir"];
+
+    if (args.count("--memory-limit"))
+        C.memory_limit = parse_size_bytes("--memory-limit", args["--memory-limit"]);
+    if (args.count("--tmp-dir")) C.tmp_dir = args["--tmp-dir"];
+    mem_budget_set(C.memory_limit);
+    C.dry_run = args.count("--dry-run") > 0;
+
+    if (args.count("--extract"))     C.extract_file = args["--extract"];
+    if (args.count("--exclude"))     C.exclude_file = args["--exclude"];
+    if (args.count("--region"))      C.regions      = args["--region"];
+    if (args.count("--region-file")) C.region_file  = args["--region-file"];
+
     if (args.count("--remove-dup-snp")){
         C.remove_dup_snp = true;
     }
@@ -113,11 +182,55 @@ static void parse_common(CommonArgs& C, map<string,string>& args) {
     if (args.count("--n"))     C.col_n    = args["--n"];
     if (C.col_n.empty())       C.col_n    = "N";
 
-    if (args.count("--format")) 
-        C.format = args["--format"];
-    else
-        C.format = "gwas";
-    check_format(C.format);
+    // 逗号分隔可给多个格式（仅 convert / pipeline 支持多个）
+    std::string fmt_list = args.count("--format") ? args["--format"] : "gwas";
+    C.formats.clear();
+    size_t start = 0;
+    while (start <= fmt_list.size()) {
+        size_t comma = fmt_list.find(',', start);
+        if (comma == string::npos) comma = fmt_list.size();
+        string f = fmt_list.substr(start, comma - start);
+        check_format(f);
+        require(std::find(C.formats.begin(), C.formats.end(), f) == C.formats.end(),
+                "Duplicate format in --format: " + f);
+        C.formats.push_back(f);
+        start = comma + 1;
+    }
+    C.format = C.formats[0];
+    require(!(C.out_file == "-" && C.formats.size() > 1),
+            "--out - (stdout) takes a single --format.");
+
+    if (args.count("--index")) {
+        C.build_index = true;
+        const string gz = ".gz";
+        require(C.out_file.empty() ||                     // serve 启动参数：各请求自带 --out
+                (C.out_file.size() >= gz.size() &&
+                 C.out_file.compare(C.out_file.size() - gz.size(), gz.size(), gz) == 0),
+                "--index needs a .gz --out (written as BGZF).");
+        require(std::find(C.formats.begin(), C.formats.end(), "gwas") != C.formats.end(),
+                "--index applies to --format gwas output (the text format that keeps CHR/POS).");
+    }
+
+    if (args.count("--split-by-chr")) {
+        C.split_by_chr = true;
+        require(C.out_file != "-" && !is_mem_path(C.out_file),
+                "--split-by-chr writes one file per chromosome; give a file path to --out.");
+    }
+}
+
+static void require_single_format(const CommonArgs& C, const string& cmd){
+    require(C.formats.size() == 1,
+            cmd + " writes one format per run; a --format list is supported by convert and pipeline.");
+}
+
+
+// dbSNP 列名（rsidImpu / serve 共用）
+static void parse_dbsnp_cols(Args_RsidImpu& P, map<string,string>& args){
+    if (args.count("--dbchr")) P.d_chr = args["--dbchr"]; else P.d_chr = "CHR";
+    if (args.count("--dbpos")) P.d_pos = args["--dbpos"]; else P.d_pos = "POS";
+    if (args.count("--dbA1"))  P.d_A1  = args["--dbA1"];  else P.d_A1  = "REF";
+    if (args.count("--dbA2"))  P.d_A2  = args["--dbA2"];  else P.d_A2  = "ALT";
+    if (args.count("--dbrsid"))P.d_rsid= args["--dbrsid"];else P.d_rsid= "ID";
 }
 
 // ======================================================
@@ -133,9 +246,12 @@ void print_rsidimpu_help() {
     "  Allele matching supports flips and strand complements.\n\n"
 
     "Required arguments:\n"
-    "  --gwas-summary FILE        Input GWAS summary statistics (txt / tsv / gz)\n"
-    "  --dbsnp FILE               dbSNP or PLINK .bim file (txt / gz)\n"
-    "  --out FILE                 Output file (txt or .gz)\n"
+    "  --gwas-summary FILE        Input GWAS summary statistics (txt / tsv / gz / zst; - = stdin)\n"
+    "                             or per-chromosome files: trait.chr{1..22}.txt.gz, trait.chr*.gz\n"
+    "  --dbsnp FILE               dbSNP table, dbSNP VCF or PLINK .bim file (txt / gz / zst)\n"
+    "  --out FILE                 Output file (txt, .gz or .zst; - = stdout)\n"
+    "  (or) --gwas-list FILE      Batch mode: one \"GWAS_FILE<TAB>OUT_FILE\" per line,\n"
+    "                             all files annotated in a single dbSNP pass\n\n"
 
     "Required dbSNP columns:\n"
     "  --dbchr  COL  Chromosome column      (default: CHR)\n"
@@ -151,7 +267,19 @@ void print_rsidimpu_help() {
     "  --A2   COL   Other allele           (default: A2)\n\n"
 
     "Optional output format:\n"
-    "  --format gwas|cojo|popcorn|mrmega   (default: gwas)\n\n"
+    "  --format gwas|cojo|popcorn|mrmega|smr|ldsc|arrow   (default: gwas)\n\n"
+
+    "dbSNP join:\n"
+    "  --join merge|hash    merge: two-pointer, dbSNP must be sorted by CHR:POS (default)\n"
+    "                       hash : dbSNP in any order, parsed in parallel (--threads)\n"
+    "  --gwas-sorted        GWAS is sorted by CHR:POS: stream GWAS and dbSNP together,\n"
+    "                       writing rows as they are matched (memory independent of GWAS size)\n\n"
+
+    "Reverse annotation (rsID -> CHR/POS):\n"
+    "  --reverse            Fill CHR/POS from the SNP column via a compact rsID index;\n"
+    "                       A1/A2 (if present) pick the matching dbSNP record\n"
+    "  --rsid-index FILE    Load the rsID index from FILE, or build it from --dbsnp and\n"
+    "                       save it there (later runs need no --dbsnp)\n\n"
 
     "Optional GWAS columns (required depending on --format):\n"
     "  --freq COL   Allele frequency       (default: freq)\n"
@@ -163,12 +291,108 @@ void print_rsidimpu_help() {
     "Quality Control options:\n"
     "  --maf VAL            MAF threshold (default: 0.01)\n"
     "  --remove-dup-snp     Keep only lowest-P SNP if duplicates exist\n\n"
+    "Row filters (applied before QC; combined with AND):\n"
+    "  --extract FILE       Keep only SNPs listed in FILE (one ID per line; .bim: column 2)\n"
+    "  --exclude FILE       Drop SNPs listed in FILE\n"
+    "  --region LIST        Keep rows in CHR[:BEG[-END]][,...] (1-based, inclusive)\n"
+    "  --region-file FILE   Keep rows in the intervals of a BED file\n\n"
 
     "Other options:\n"
+    "  --index              .gz output: BGZF + tabix index FILE.tbi (gwas format, sorted rows)\n"
+    "  --split-by-chr       One output per chromosome: OUT.chr1 ... OUT.chrMT (before .gz),\n"
+    "                       or {chr} in --out is replaced; the files compress concurrently\n"
     "  --threads N          Number of threads (default: 1)\n"
+    "  --log FILE           Write log output to FILE\n"
+    "  --cache-dir DIR      Reuse a binary snapshot of the parsed GWAS across runs\n"
+    "  --memory-limit SIZE  Memory budget, e.g. 512M, 8G: a GWAS that does not fit is\n"
+    "                       spilled and joined by external sort (needs --join merge)\n"
+    "  --tmp-dir DIR        Directory for spill files (default: next to --out)\n"
+    "  --dry-run            Sample the inputs and print estimated rows, time and peak\n"
+    "                       memory without processing the full files\n";
+}
+
+void print_serve_help() {
+    cerr <<
+    "Usage:\n"
+    "  GWAStoolkit serve --socket PATH (--dbsnp FILE | --pos-index FILE) [options]\n\n"
+
+    "Description:\n"
+    "  Keep a dbSNP position index in memory and annotate GWAS for local clients\n"
+    "  over a Unix domain socket (same allele matching as rsidImpu).\n"
+    "  Requests (one per connection, fields separated by TAB):\n"
+    "    PING                          -> OK<TAB>entries\n"
+    "    FILE GWAS OUT [OPTION VALUE]  -> OK<TAB>matched<TAB>lines, or ERR<TAB>message\n"
+    "    ROWS, then CHR POS A1 A2 rows,\n"
+    "    ended by an empty line or EOF  -> one rsID (or NA) per row\n\n"
+
+    "Required arguments:\n"
+    "  --socket PATH        Unix socket to listen on (a stale socket file is replaced)\n"
+    "  --dbsnp FILE         dbSNP table, dbSNP VCF or PLINK .bim file (txt / gz / zst / arrow)\n"
+    "  (or) --pos-index FILE  Position index: mmap it if it exists, otherwise build it\n"
+    "                       from --dbsnp and save it there\n\n"
+
+    "dbSNP columns:\n"
+    "  --dbchr / --dbpos / --dbrsid / --dbA1 / --dbA2   (defaults: CHR POS ID REF ALT)\n\n"
+
+    "Defaults for FILE requests (a request may override them):\n"
+    "  --chr --pos --A1 --A2 --SNP --freq --beta --se --pval --n   GWAS columns\n"
+    "  --format gwas|cojo|popcorn|mrmega|smr|ldsc|arrow   (default: gwas)\n"
+    "  --maf VAL            MAF threshold (default: 0.01)\n"
+    "  --remove-dup-snp     Keep only lowest-P SNP if duplicates exist\n"
+    "  --extract / --exclude / --region / --region-file   Row filters (see rsidImpu)\n"
+    "  --cache-dir DIR      Reuse a binary snapshot of the parsed GWAS across runs\n\n"
+
+    "Other options:\n"
+    "  --index              .gz output: BGZF + tabix index FILE.tbi (gwas format, sorted rows)\n"
+    "  --threads N          Worker threads = concurrent requests (default: 1)\n"
     "  --log FILE           Write log output to FILE\n";
 }
 
+void print_sort_help() {
+    cerr <<
+    "Usage:\n"
+    "  GWAStoolkit sort --gwas-summary FILE --out FILE [options]\n\n"
+
+    "Description:\n"
+    "  Sort GWAS rows by chromosome (1..22, X, Y, MT, then other contigs by name)\n"
+    "  and position, keeping all columns and all rows (unparsable CHR/POS last).\n"
+    "  Inputs larger than --memory are sorted in runs spilled to temporary files\n"
+    "  and merged. Rows at the same position keep input order.\n"
+    "  A .gz output is written as BGZF with a tabix index (FILE.tbi).\n\n"
+
+    "Required arguments:\n"
+    "  --gwas-summary FILE  Input GWAS (txt / gz / zst / arrow; - = stdin)\n"
+    "                       or per-chromosome files: trait.chr{1..22}.txt.gz, trait.chr*.gz\n"
+    "  --out FILE           Output (.gz = BGZF + .tbi; txt / .zst; - = stdout)\n\n"
+
+    "Options:\n"
+    "  --chr COL            Chromosome column (default: CHR)\n"
+    "  --pos COL            Position column (default: POS)\n"
+    "  --memory SIZE        Memory budget, e.g. 512M, 8G (default: 1G)\n"
+    "  --tmp-dir DIR        Directory for temporary runs (default: next to --out)\n"
+    "  --threads N          Threads for sorting and BGZF compression\n"
+    "  --log FILE\n";
+}
+
+void print_query_help() {
+    cerr <<
+    "Usage:\n"
+    "  GWAStoolkit query --gwas-summary FILE.gz --region CHR:BEG-END --out FILE\n\n"
+
+    "Description:\n"
+    "  Extract the rows of a region from a position-sorted BGZF file using its\n"
+    "  tabix index (FILE.gz.tbi, written by sort or --index; bgzip + tabix also work).\n"
+    "  Only the compressed blocks that overlap the region are read.\n\n"
+
+    "Required arguments:\n"
+    "  --gwas-summary FILE  BGZF-compressed GWAS with FILE.tbi next to it\n"
+    "  --region REGION      CHR, CHR:POS or CHR:BEG-END (1-based, inclusive; e.g. 1:1,000,000-2,000,000)\n"
+    "  --out FILE           Output with the header line (txt / .gz / .zst; - = stdout)\n\n"
+
+    "Other options:\n"
+    "  --log FILE\n";
+}
+
 void print_convert_help() {
     cerr <<
     "Usage:\n"
@@ -176,12 +400,14 @@ void print_convert_help() {
 
     "Description:\n"
     "  Convert GWAS summary statistics into specific downstream formats.\n"
-    "  Supported: gwas, cojo, popcorn, mrmega.\n\n"
+    "  Supported: gwas, cojo, popcorn, mrmega, smr (.ma), ldsc (SNP A1 A2 Z N),\n"
+    "  arrow (Arrow IPC / Feather v2 with typed columns).\n\n"
 
     "Required arguments:\n"
-    "  --gwas-summary FILE     Input GWAS summary statistics (txt / gz)\n"
-    "  --out FILE              Output file (txt or .gz)\n"
-    "  --format gwas|cojo|popcorn|mrmega\n"
+    "  --gwas-summary FILE     Input GWAS summary statistics (txt / gz / zst / arrow; - = stdin)\n"
+    "                          or per-chromosome files: trait.chr{1..22}.txt.gz, trait.chr*.gz\n"
+    "  --out FILE              Output file (txt, .gz or .zst; - = stdout)\n"
+    "  --format gwas|cojo|popcorn|mrmega|smr|ldsc|arrow  (or a comma list, e.g. cojo,smr,ldsc)\n"
     "  --SNP COL               SNP identifier column\n\n"
 
     "Required GWAS columns for conversion:\n"
@@ -197,10 +423,28 @@ void print_convert_help() {
     "Quality Control options:\n"
     "  --maf VAL            MAF threshold (default: 0.01)\n"
     "  --remove-dup-snp     Keep only lowest-P SNP if duplicates exist\n\n"
+    "Row filters (applied before QC; combined with AND):\n"
+    "  --extract FILE       Keep only SNPs listed in FILE (one ID per line; .bim: column 2)\n"
+    "  --exclude FILE       Drop SNPs listed in FILE\n"
+    "  --region LIST        Keep rows in CHR[:BEG[-END]][,...] (1-based, inclusive)\n"
+    "  --region-file FILE   Keep rows in the intervals of a BED file\n\n"
 
     "Other options:\n"
+    "  --index              .gz output: BGZF + tabix index FILE.tbi (gwas format, sorted rows)\n"
+    "  --split-by-chr       One output per chromosome: OUT.chr1 ... OUT.chrMT (before .gz),\n"
+    "                       or {chr} in --out is replaced; the files compress concurrently\n"
     "  --threads N\n"
-    "  --log FILE\n";
+    "  --log FILE\n"
+    "  --cache-dir DIR\n"
+    "  --memory-limit SIZE  Memory budget for --remove-dup-snp (hash partitions)\n"
+    "  --tmp-dir DIR\n"
+    "  --dry-run            Print estimated rows, time and peak memory from a sample\n\n"
+
+    "Batch mode (replaces --gwas-summary / --out):\n"
+    "  --batch FILE         Manifest, one GWAS<TAB>OUT[<TAB>--opt<TAB>val ...] per line;\n"
+    "                       line options override the command line. Files and their\n"
+    "                       compression blocks share one --threads pool\n"
+    "  --io-jobs N          Files reading / decompressing at once (default: min(threads, 4))\n";
 }
 
 void print_or2beta_help() {
@@ -213,8 +457,9 @@ void print_or2beta_help() {
     "  If SE missing, SE is inferred from p-value.\n\n"
 
     "Required arguments:\n"
-    "  --gwas-summary FILE    Input GWAS summary statistics (txt / gz)\n"
-    "  --out FILE             Output file (txt or .gz)\n"
+    "  --gwas-summary FILE    Input GWAS summary statistics (txt / gz / zst / arrow; - = stdin)\n"
+    "                         or per-chromosome files: trait.chr{1..22}.txt.gz, trait.chr*.gz\n"
+    "  --out FILE             Output file (txt, .gz or .zst; - = stdout)\n"
 
     "Required GWAS columns for or2beta:\n"
     "  --SNP  COL   Marker name          (default: SNP)\n"
@@ -227,13 +472,24 @@ void print_or2beta_help() {
     "Quality Control options:\n"
     "  --maf VAL\n"
     "  --remove-dup-snp\n\n"
+    "Row filters (applied before QC):\n"
+    "  --extract FILE / --exclude FILE / --region LIST / --region-file FILE\n\n"
 
     "Optional output format:\n"
-    "  --format gwas|cojo|popcorn|mrmega   (default: gwas)\n\n"
+    "  --format gwas|cojo|popcorn|mrmega|smr|ldsc|arrow   (default: gwas)\n\n"
 
     "Other options:\n"
+    "  --index              .gz output: BGZF + tabix index FILE.tbi (gwas format, sorted rows)\n"
+    "  --split-by-chr       One output per chromosome: OUT.chr1 ... OUT.chrMT (before .gz),\n"
+    "                       or {chr} in --out is replaced; the files compress concurrently\n"
     "  --threads N\n"
-    "  --log FILE\n";
+    "  --log FILE\n"
+    "  --cache-dir DIR\n"
+    "  --memory-limit SIZE  Memory budget for --remove-dup-snp (hash partitions)\n"
+    "  --tmp-dir DIR\n"
+    "  --dry-run            Print estimated rows, time and peak memory from a sample\n"
+    "  --batch FILE         Manifest of GWAS<TAB>OUT[<TAB>--opt<TAB>val ...] lines (see convert --help)\n"
+    "  --io-jobs N          --batch: files reading / decompressing at once (default: min(threads, 4))\n";
 }
 
 void print_calneff_help() {
@@ -264,33 +520,98 @@ void print_calneff_help() {
     "Quality Control options:\n"
     "  --maf VAL            MAF threshold (default: 0.01)\n"
     "  --remove-dup-snp     Keep only lowest-P SNP if duplicates exist\n\n"
+    "Row filters (applied before QC; combined with AND):\n"
+    "  --extract FILE       Keep only SNPs listed in FILE (one ID per line; .bim: column 2)\n"
+    "  --exclude FILE       Drop SNPs listed in FILE\n"
+    "  --region LIST        Keep rows in CHR[:BEG[-END]][,...] (1-based, inclusive)\n"
+    "  --region-file FILE   Keep rows in the intervals of a BED file\n\n"
 
     "Optional output format:\n"
-    "  --format gwas|cojo|popcorn|mrmega   (default: gwas)\n\n"
+    "  --format gwas|cojo|popcorn|mrmega|smr|ldsc|arrow   (default: gwas)\n\n"
 
     "Other options:\n"
+    "  --index              .gz output: BGZF + tabix index FILE.tbi (gwas format, sorted rows)\n"
+    "  --split-by-chr       One output per chromosome: OUT.chr1 ... OUT.chrMT (before .gz),\n"
+    "                       or {chr} in --out is replaced; the files compress concurrently\n"
     "  --threads N\n"
-    "  --log FILE\n";
+    "  --log FILE\n"
+    "  --cache-dir DIR\n"
+    "  --memory-limit SIZE  Memory budget for --remove-dup-snp (hash partitions)\n"
+    "  --tmp-dir DIR\n"
+    "  --dry-run            Print estimated rows, time and peak memory from a sample\n"
+    "  --batch FILE         Manifest of GWAS<TAB>OUT[<TAB>--opt<TAB>val ...] lines (see convert --help)\n"
+    "  --io-jobs N          --batch: files reading / decompressing at once (default: min(threads, 4))\n";
+}
+
+void print_pipeline_help() {
+    cerr <<
+    "Usage:\n"
+    "  GWAStoolkit pipeline --steps STEP[,STEP...] [options]\n\n"
+
+    "Description:\n"
+    "  Run or2beta / computeNeff / convert back to back on one parse of the input.\n"
+    "  Rows flow through the steps in memory; only the final output is written.\n"
+    "  Each step applies the same QC and rules as the standalone command.\n\n"
+
+    "Required arguments:\n"
+    "  --gwas-summary FILE    Input GWAS summary statistics (txt / gz / zst / arrow; - = stdin)\n"
+    "                         or per-chromosome files: trait.chr{1..22}.txt.gz, trait.chr*.gz\n"
+    "  --out FILE             Output file (txt, .gz or .zst; - = stdout)\n"
+    "  --steps LIST           Comma-separated, in order: or2beta, computeNeff, convert\n\n"
+
+    "Step options:\n"
+    "  --or COL                       or2beta: OR column (default: OR)\n"
+    "  --case INT --control INT       computeNeff: fixed case/control counts\n"
+    "  --case-col COL --control-col COL\n"
+    "                                 computeNeff: per-SNP case/control columns\n\n"
+
+    "GWAS columns:\n"
+    "  --SNP --A1 --A2 --freq --beta --se --pval --n   (defaults as in other commands)\n\n"
+
+    "Quality Control options:\n"
+    "  --maf VAL            MAF threshold (default: 0.01)\n"
+    "  --remove-dup-snp     Keep only lowest-P SNP if duplicates exist\n\n"
+    "Row filters (applied before QC; combined with AND):\n"
+    "  --extract FILE       Keep only SNPs listed in FILE (one ID per line; .bim: column 2)\n"
+    "  --exclude FILE       Drop SNPs listed in FILE\n"
+    "  --region LIST        Keep rows in CHR[:BEG[-END]][,...] (1-based, inclusive)\n"
+    "  --region-file FILE   Keep rows in the intervals of a BED file\n\n"
+
+    "Output format:\n"
+    "  --format cojo|popcorn|mrmega|smr|ldsc|arrow   (default: cojo; a comma list writes several)\n\n"
+
+    "Other options:\n"
+    "  --split-by-chr       One output per chromosome: OUT.chr1 ... OUT.chrMT (before .gz),\n"
+    "                       or {chr} in --out is replaced; the files compress concurrently\n"
+    "  --threads N\n"
+    "  --log FILE\n"
+    "  --cache-dir DIR\n"
+    "  --memory-limit SIZE  Memory budget for --remove-dup-snp (hash partitions)\n"
+    "  --tmp-dir DIR\n"
+    "  --dry-run            Print estimated rows, time and peak memory from a sample\n"
+    "  --batch FILE         Manifest of GWAS<TAB>OUT[<TAB>--opt<TAB>val ...] lines (see convert --help)\n"
+    "  --io-jobs N          --batch: files reading / decompressing at once (default: min(threads, 4))\n";
 }
 
 // ------------------------- 解析 rsid-impu -----------------------
 Args_RsidImpu parse_args_rsidimpu(int argc, char* argv[]) {
     map<string,string> args;
-    set<string> flags = {"--remove-dup-snp"};
+    set<string> flags = {"--remove-dup-snp", "--gwas-sorted", "--reverse", "--index", "--dry-run",
+                          "--split-by-chr"};
 
     for (int i=1; i<argc; ) {
         string key = argv[i];
 
         if (key == "--help") {
             print_rsidimpu_help();
-            exit(0);
+            die(0);
         }
 
         // ★ unknown parameter check
         if (!common_params.count(key) &&
             !rsidimpu_params.count(key)) {
             LOG_ERROR("Unknown parameter: " + key);
-            exit(1);
+            die(1);
         }
 
         // flags
@@ -300,7 +621,7 @@ Args_RsidImpu parse_args_rsidimpu(int argc, char* argv[]) {
 
         if (i+1 >= argc) {
             LOG_ERROR("Missing value for " + key);
-            exit(1);
+            die(1);
         }
 
         args[key] = argv[i+1];
@@ -308,17 +629,47 @@ Args_RsidImpu parse_args_rsidimpu(int argc, char* argv[]) {
     }
 
     Args_RsidImpu P;
-    parse_common(P, args);
+    bool batch = args.count("--gwas-list") > 0;
+    require(!(batch && args.count("--gwas-summary")),
+            "Cannot mix --gwas-list and --gwas-summary.");
+    require(!(batch && args.count("--out")),
+            "--out is given per file in --gwas-list; do not set --out.");
+    parse_common(P, args, !batch);
+    require_single_format(P, "rsidImpu");
+    if (batch) P.gwas_list = args["--gwas-list"];
+
+    // 反向模式：已有 --rsid-index 时可不给 --dbsnp
+    if (args.count("--reverse")) {
+        P.reverse = true;
+        require(!batch, "--reverse cannot be combined with --gwas-list.");
+        require(!args.count("--gwas-sorted"), "--reverse does not use --gwas-sorted.");
+        require(!P.dry_run, "--dry-run estimates position mode only (not --reverse).");
+        require(!P.split_by_chr, "--split-by-chr routes rows by the input CHR column; --reverse input has none.");
+    }
+    if (args.count("--rsid-index")) {
+        require(P.reverse, "--rsid-index is only used with --reverse.");
+        P.rsid_index = args["--rsid-index"];
+    }
 
     // Required for rsid-impu
-    require(args.count("--dbsnp"), "Missing required: --dbsnp");
-    P.dbsnp_file = args["--dbsnp"];
-
-    if (args.count("--dbchr")) P.d_chr = args["--dbchr"]; else P.d_chr = "CHR";
-    if (args.count("--dbpos")) P.d_pos = args["--dbpos"]; else P.d_pos = "POS";
-    if (args.count("--dbA1"))  P.d_A1  = args["--dbA1"];  else P.d_A1  = "REF";
-    if (args.count("--dbA2"))  P.d_A2  = args["--dbA2"];  else P.d_A2  = "ALT";
-    if (args.count("--dbrsid"))P.d_rsid= args["--dbrsid"];else P.d_rsid= "ID";
+    require(args.count("--dbsnp") || !P.rsid_index.empty(), "Missing required: --dbsnp");
+    if (args.count("--dbsnp")) P.dbsnp_file = args["--dbsnp"];
+    require(!(P.dbsnp_file == "-" && P.gwas_file == "-"),
+            "Only one of --dbsnp / --gwas-summary can read stdin (-).");
+
+    parse_dbsnp_cols(P, args);
+
+    if (args.count("--join")) P.join_mode = args["--join"];
+    require(P.join_mode == "merge" || P.join_mode == "hash",
+            "Unsupported --join: " + P.join_mode + " (supported: merge, hash)");
+
+    if (args.count("--gwas-sorted")) {
+        P.gwas_sorted = true;
+        require(!batch, "--gwas-sorted cannot be combined with --gwas-list.");
+        require(P.join_mode == "merge", "--gwas-sorted requires a sorted dbSNP (--join merge).");
+        require(!P.remove_dup_snp,
+                "--gwas-sorted streams rows out as they are matched; --remove-dup-snp needs all rows.");
+    }
 
     return P;
 }
@@ -326,21 +677,21 @@ Args_RsidImpu parse_args_rsidimpu(int argc, char* argv[]) {
 // ------------------------- 解析 convert ------------------------------
 Args_Convert parse_args_convert(int argc, char* argv[]) {
     map<string,string> args;
-    set<string> flags = {"--remove-dup-snp"};
+    set<string> flags = {"--remove-dup-snp", "--index", "--dry-run", "--split-by-chr"};
 
     for (int i=1; i<argc; ) {
         string key = argv[i];
 
         if (key == "--help") {
             print_convert_help();
-            exit(0);
+            die(0);
         }
 
         // ★ unknown parameter check
         if (!common_params.count(key) &&
             !convert_params.count(key)) {
             LOG_ERROR("Unknown parameter: " + key);
-            exit(1);
+            die(1);
         }
 
         // flags
@@ -350,7 +701,7 @@ Args_Convert parse_args_convert(int argc, char* argv[]) {
 
         if (i+1 >= argc) {
             LOG_ERROR("Missing value for " + key);
-            exit(1);
+            die(1);
         }
 
         args[key] = argv[i+1];
@@ -375,21 +726,21 @@ Args_Convert parse_args_convert(int argc, char* argv[]) {
 // ------------------------- 解析 or2beta ------------------------------
 Args_Or2Beta parse_args_or2beta(int argc, char* argv[]) {
     map<string,string> args;
-    set<string> flags = {"--remove-dup-snp"};
+    set<string> flags = {"--remove-dup-snp", "--index", "--dry-run", "--split-by-chr"};
 
     for (int i=1; i<argc; ) {
         string key = argv[i];
 
         if (key == "--help") {
             print_or2beta_help();
-            exit(0);
+            die(0);
         }
 
         // ★ unknown parameter check
         if (!common_params.count(key) &&
             !or2beta_params.count(key)) {
             LOG_ERROR("Unknown parameter: " + key);
-            exit(1);
+            die(1);
         }
 
         // flags
@@ -399,7 +750,7 @@ Args_Or2Beta parse_args_or2beta(int argc, char* argv[]) {
 
         if (i+1 >= argc) {
             LOG_ERROR("Missing value for " + key);
-            exit(1);
+            die(1);
         }
 
         args[key] = argv[i+1];
@@ -408,6 +759,7 @@ Args_Or2Beta parse_args_or2beta(int argc, char* argv[]) {
 
     Args_Or2Beta P;
     parse_common(P, args);
+    require_single_format(P, "or2beta");
 
     require(args.count("--or"), "Missing required: --or");
     P.col_or = args["--or"];
@@ -426,20 +778,20 @@ Args_Or2Beta parse_args_or2beta(int argc, char* argv[]) {
 Args_CalNeff parse_args_calneff(int argc, char* argv[])
 {
     map<string,string> args;
-    set<string> flags = {"--remove-dup-snp"};
+    set<string> flags = {"--remove-dup-snp", "--index", "--dry-run", "--split-by-chr"};
 
     for (int i=1; i<argc; ) {
         string key = argv[i];
 
         if (key == "--help") {
             print_calneff_help();
-            exit(0);
+            die(0);
         }
 
         if (!common_params.count(key) &&
             !calneff_params.count(key)) {
             LOG_ERROR("Unknown parameter: " + key);
-            exit(1);
+            die(1);
         }
 
         // flags
@@ -449,7 +801,7 @@ Args_CalNeff parse_args_calneff(int argc, char* argv[])
 
         if (i+1 >= argc) {
             LOG_ERROR("Missing value for " + key);
-            exit(1);
+            die(1);
         }
 
         args[key] = argv[i+1];
@@ -458,6 +810,7 @@ Args_CalNeff parse_args_calneff(int argc, char* argv[])
 
     Args_CalNeff P;
     parse_common(P, args);
+    require_single_format(P, "computeNeff");
 
     bool fixed = args.count("--case")      && args.count("--control");
     bool perSNP = args.count("--case-col") && args.count("--control-col");
@@ -487,4 +840,236 @@ Args_CalNeff parse_args_calneff(int argc, char* argv[])
     require(!P.col_n.empty(),    "computeNeff requires --n column.");
 
     return P;
-}
\ No newline at end of file
+}
+
+// ------------------------- 解析 pipeline ------------------------------
+Args_Pipeline parse_args_pipeline(int argc, char* argv[])
+{
+    map<string,string> args;
+    set<string> flags = {"--remove-dup-snp", "--index", "--dry-run", "--split-by-chr"};
+
+    for (int i=1; i<argc; ) {
+        string key = argv[i];
+
+        if (key == "--help") {
+            print_pipeline_help();
+            die(0);
+        }
+
+        if (!common_params.count(key) &&
+            !pipeline_params.count(key)) {
+            LOG_ERROR("Unknown parameter: " + key);
+            die(1);
+        }
+
+        // flags
+        if (flags.count(key)) {
+            args[key] = "1"; i++; continue;
+        }
+
+        if (i+1 >= argc) {
+            LOG_ERROR("Missing value for " + key);
+            die(1);
+        }
+
+        args[key] = argv[i+1];
+        i += 2;
+    }
+
+    Args_Pipeline P;
+    if (!args.count("--format")) args["--format"] = "cojo";
+    parse_common(P, args);
+    require(std::find(P.formats.begin(), P.formats.end(), "gwas") == P.formats.end(),
+            "pipeline writes downstream formats: use --format cojo|popcorn|mrmega|smr|ldsc|arrow (or a list).");
+
+    require(args.count("--steps"), "Missing required: --steps");
+    {
+        std::string list = args["--steps"];
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t comma = list.find(',', start);
+            if (comma == std::string::npos) comma = list.size();
+            std::string step = list.substr(start, comma - start);
+            step.erase(0, step.find_first_not_of(" \t"));
+            step.erase(step.find_last_not_of(" \t") + 1);
+            require(step == "or2beta" || step == "computeNeff" || step == "convert",
+                    "Unknown pipeline step: " + step + " (supported: or2beta, computeNeff, convert)");
+            P.steps.push_back(step);
+            start = comma + 1;
+        }
+    }
+
+    if (args.count("--or")) P.col_or = args["--or"];
+
+    bool uses_neff = std::find(P.steps.begin(), P.steps.end(), "computeNeff") != P.steps.end();
+    bool fixed  = args.count("--case")     && args.count("--control");
+    bool perSNP = args.count("--case-col") && args.count("--control-col");
+    if (uses_neff) {
+        require(fixed || perSNP,
+            "pipeline step computeNeff requires --case/--control OR --case-col/--control-col");
+        require(!(fixed && perSNP), "Cannot mix fixed and per-SNP modes.");
+    }
+
+    if (fixed) {
+        P.is_single = true;
+        P.case_n    = stoi(args["--case"]);
+        P.control_n = stoi(args["--control"]);
+    }
+    if (perSNP) {
+        P.is_column   = true;
+        P.case_col    = args["--case-col"];
+        P.control_col = args["--control-col"];
+    }
+
+    return P;
+}
+
+// ------------------------- 解析 serve ------------------------------
+Args_Serve parse_args_serve(int argc, char* argv[])
+{
+    map<string,string> args;
+    set<string> flags = {"--remove-dup-snp", "--index"};
+
+    for (int i=1; i<argc; ) {
+        string key = argv[i];
+
+        if (key == "--help") {
+            print_serve_help();
+            die(0);
+        }
+
+        if ((!common_params.count(key) && !serve_params.count(key)) ||
+            key == "--gwas-summary" || key == "--out" || key == "--dry-run" ||
+            key == "--split-by-chr") {
+            LOG_ERROR("Unknown parameter: " + key +
+                      (key == "--gwas-summary" || key == "--out" ? " (serve takes files per request)" : ""));
+            die(1);
+        }
+
+        if (flags.count(key)) {
+            args[key] = "1"; i++; continue;
+        }
+
+        if (i+1 >= argc) {
+            LOG_ERROR("Missing value for " + key);
+            die(1);
+        }
+
+        args[key] = argv[i+1];
+        i += 2;
+    }
+
+    Args_Serve P;
+    parse_common(P, args, false);
+    require_single_format(P, "serve");
+
+    require(args.count("--socket"), "Missing required: --socket");
+    P.socket_path = args["--socket"];
+
+    if (args.count("--pos-index")) P.pos_index = args["--pos-index"];
+    require(args.count("--dbsnp") || !P.pos_index.empty(), "Missing required: --dbsnp");
+    if (args.count("--dbsnp")) P.dbsnp_file = args["--dbsnp"];
+    parse_dbsnp_cols(P, args);
+
+    return P;
+}
+
+Args_RsidImpu parse_serve_request(const Args_Serve& base, const std::vector<std::string>& tokens)
+{
+    require(tokens.size() >= 2, "FILE request needs GWAS_FILE and OUT_FILE.");
+
+    map<string,string> args;
+    for (size_t i = 2; i < tokens.size(); ) {
+        const string& key = tokens[i];
+        require(serve_request_params.count(key),
+                "Option not allowed in a request: " + key + " (set it when starting serve)");
+        if (key == "--remove-dup-snp" || key == "--index") {
+            args[key] = "1"; i++; continue;
+        }
+        require(i + 1 < tokens.size(), "Missing value for " + key);
+        args[key] = tokens[i+1];
+        i += 2;
+    }
+    if (!args.count("--format")) args["--format"] = base.format;
+
+    Args_RsidImpu P = base;              // 列名 / maf / 去重 / dbSNP 列：默认沿用启动参数
+    args["--gwas-summary"] = tokens[0];
+    args["--out"]          = tokens[1];
+    parse_common(P, args);
+    require_single_format(P, "serve");
+    require(P.gwas_file != "-" && P.out_file != "-", "serve requests take file paths, not - (stdin/stdout).");
+    return P;
+}
+
+// ------------------------- 解析 sort ------------------------------
+Args_Sort parse_args_sort(int argc, char* argv[])
+{
+    map<string,string> args;
+
+    for (int i=1; i<argc; ) {
+        string key = argv[i];
+
+        if (key == "--help") {
+            print_sort_help();
+            die(0);
+        }
+
+        if (!sort_params.count(key)) {
+            LOG_ERROR("Unknown parameter: " + key);
+            die(1);
+        }
+
+        if (i+1 >= argc) {
+            LOG_ERROR("Missing value for " + key);
+            die(1);
+        }
+
+        args[key] = argv[i+1];
+        i += 2;
+    }
+
+    Args_Sort P;
+    parse_common(P, args);
+
+    if (args.count("--memory"))  P.memory_bytes = parse_size_bytes("--memory", args["--memory"]);
+
+    return P;
+}
+
+// ------------------------- 解析 query ------------------------------
+Args_Query parse_args_query(int argc, char* argv[])
+{
+    map<string,string> args;
+
+    for (int i=1; i<argc; ) {
+        string key = argv[i];
+
+        if (key == "--help") {
+            print_query_help();
+            die(0);
+        }
+
+        if (!query_params.count(key)) {
+            LOG_ERROR("Unknown parameter: " + key);
+            die(1);
+        }
+
+        if (i+1 >= argc) {
+            LOG_ERROR("Missing value for " + key);
+            die(1);
+        }
+
+        args[key] = argv[i+1];
+        i += 2;
+    }
+
+    Args_Query P;
+    parse_common(P, args);
+
+    require(!is_gwas_pattern(P.gwas_file), "query reads one indexed .gz; --gwas-summary patterns are not supported.");
+    require(args.count("--region"), "Missing required: --region");
+    P.region = args["--region"];
+    require(P.gwas_file != "-", "query needs a file (it seeks with the .tbi index), not stdin.");
+
+    return P;
+}
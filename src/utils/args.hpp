@@ -12,6 +12,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
 
 // ----------------------【公共字段】-------------------------
 struct CommonArgs {
@@ -31,6 +32,7 @@ struct CommonArgs {
     std::string col_n    = "N";
 
     std::string format   = "gwas";
+    std::vector<std::string> formats;   // --format a,b,c：一次解析写多个格式（formats[0] == format）
 
     bool remove_dup_snp  = false;
     double maf_threshold = 0.01;
@@ -38,6 +40,28 @@ struct CommonArgs {
     int threads          = 1;
     bool log_enabled     = false;
     std::string log_file;
+
+    // --cache-dir：已解析 GWAS 的二进制快照目录（为空 = 不缓存）
+    std::string cache_dir;
+
+    // --index：.gz 输出（BGZF）同时写 tabix 兼容的 .tbi（仅 --format gwas，行须按位置排序）
+    bool build_index = false;
+
+    // 早期行过滤（见 rowfilter.hpp）：QC 之前按 SNP / CHR:POS 去掉不需要的行
+    std::string extract_file;            // --extract：只保留列表中的 SNP（每行一个 ID；.bim 取第 2 列）
+    std::string exclude_file;            // --exclude：去掉列表中的 SNP
+    std::string regions;                 // --region：CHR[:BEG[-END]][,...]
+    std::string region_file;             // --region-file：BED 区间
+
+    // --memory-limit：内存预算（0 = 不限），超出时 rsidImpu 行存储 / 排序 / 去重改走外存（见 spill.hpp）
+    uint64_t memory_limit = 0;
+    std::string tmp_dir;                 // --tmp-dir：临时文件目录（默认输出文件所在目录）
+
+    // --split-by-chr：每条染色体一个输出文件（chr_out_path；Writer 内部分片，见 writer.hpp [SPLIT]）
+    bool split_by_chr = false;
+
+    // --dry-run：只读 header + 样本行，外推行数 / 分阶段耗时 / 峰值内存后退出（见 dryrun.hpp）
+    bool dry_run = false;
 };
 
 // ----------------------【rsid-impu 子命令专用】-------------------------
@@ -48,6 +72,19 @@ struct Args_RsidImpu : public CommonArgs {
     std::string d_A1;
     std::string d_A2;
     std::string d_rsid;
+
+    // 批量模式：manifest 每行 "GWAS_FILE<TAB>OUT_FILE"，共用一次 dbSNP 扫描
+    std::string gwas_list;
+
+    // dbSNP 连接方式：merge = two-pointer（要求 dbSNP 按 CHR:POS 排序）；hash = 任意顺序
+    std::string join_mode = "merge";
+
+    // GWAS 已按 CHR:POS 排序：流式 merge join，边匹配边输出（内存与 GWAS 大小无关）
+    bool gwas_sorted = false;
+
+    // 反向注释：rsID -> CHR/POS（由 dbSNP 构建紧凑 rsID 索引；--rsid-index 可持久化复用）
+    bool reverse = false;
+    std::string rsid_index;
 };
 
 // ----------------------【convert 子命令专用】-------------------------
@@ -71,15 +108,61 @@ struct Args_CalNeff : public CommonArgs {
     std::string control_col;
 };
 
+// ----------------------【pipeline 子命令专用】-------------------------
+// or2beta / computeNeff / convert 串联：一次读入，逐行处理，只写最终输出
+struct Args_Pipeline : public CommonArgs {
+    std::vector<std::string> steps;      // 按执行顺序
+
+    std::string col_or = "OR";           // or2beta
+
+    bool is_single = false;              // computeNeff
+    bool is_column = false;
+    int case_n = 0;
+    int control_n = 0;
+    std::string case_col;
+    std::string control_col;
+};
+
+// ----------------------【serve 子命令专用】-------------------------
+// 常驻进程：dbSNP 位置索引只加载一次，经 Unix socket 为多个客户端做 rsidImpu 注释
+struct Args_Serve : public Args_RsidImpu {
+    std::string socket_path;             // --socket
+    std::string pos_index;               // --pos-index：存在则 mmap 加载，否则由 --dbsnp 构建后保存
+};
+
+// ----------------------【sort 子命令专用】-------------------------
+// 外排序：按 CHR（canonical 顺序）+ POS；.gz 输出为 BGZF + .tbi
+struct Args_Sort : public CommonArgs {
+    uint64_t memory_bytes = 1ull << 30;  // --memory（默认 1G）；--tmp-dir 见 CommonArgs
+};
+
+// ----------------------【query 子命令专用】-------------------------
+// 按 tabix 索引取区间：--gwas-summary 为 BGZF .gz，旁边有 .tbi
+struct Args_Query : public CommonArgs {
+    std::string region;                  // --region CHR[:BEG[-END]]
+};
+
 // ----------------------【解析器接口】-------------------------
 void print_rsidimpu_help();
 void print_convert_help();
 void print_or2beta_help();
 void print_calneff_help();
+void print_pipeline_help();
+void print_serve_help();
+void print_sort_help();
+void print_query_help();
 
 Args_RsidImpu  parse_args_rsidimpu(int argc, char* argv[]);
 Args_Convert   parse_args_convert(int argc, char* argv[]);
 Args_Or2Beta   parse_args_or2beta(int argc, char* argv[]);
 Args_CalNeff  parse_args_calneff(int argc, char* argv[]);
+Args_Pipeline parse_args_pipeline(int argc, char* argv[]);
+Args_Serve    parse_args_serve(int argc, char* argv[]);
+Args_Sort     parse_args_sort(int argc, char* argv[]);
+Args_Query    parse_args_query(int argc, char* argv[]);
+
+// serve 的 FILE 请求：tokens = GWAS_FILE, OUT_FILE [, --format/列名/--maf/--remove-dup-snp ...]
+// 未给出的选项沿用 serve 启动时的参数
+Args_RsidImpu parse_serve_request(const Args_Serve& base, const std::vector<std::string>& tokens);
 
 #endif
@@ -0,0 +1,648 @@
+//
+//  arrowipc.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/arrowipc.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+// IPC 格式要点（https://arrow.apache.org/docs/format/Columnar.html#serialization-and-interprocess-communication-ipc）
+//   file    : "ARROW1\0\0" | stream | footer | int32 footer_size | "ARROW1"
+//   stream  : message* | EOS(0xFFFFFFFF 0x00000000)
+//   message : 0xFFFFFFFF | int32 meta_size | Message flatbuffer（补齐到 8）| body
+// 元数据是 flatbuffers；这里只用到 Message / Schema / Field / Int / FloatingPoint /
+// RecordBatch / Footer 几张表，手写 builder / reader 即可，不引入 flatbuffers 依赖
+
+namespace {
+
+// Schema.fbs / Message.fbs 中用到的枚举值
+enum : uint8_t { MH_SCHEMA = 1, MH_DICT = 2, MH_RECORD_BATCH = 3 };
+enum : uint8_t {
+    T_NULL = 1, T_INT = 2, T_FLOAT = 3, T_BINARY = 4, T_UTF8 = 5, T_BOOL = 6,
+    T_LARGE_BINARY = 19, T_LARGE_UTF8 = 20
+};
+const int16_t METADATA_V5 = 4;
+const int16_t PRECISION_DOUBLE = 2;
+const int64_t BATCH_ROWS = 1 << 16;
+
+// ---------------- flatbuffers：顺序 builder ----------------
+// 与官方 builder 从后往前写不同，这里从前往后写：表先占位，子对象写在后面再回填
+// uoffset（uoffset 只能指向更高地址，正好满足）。标量按自身大小对齐，表起点 8 对齐。
+struct Fb {
+    std::vector<uint8_t> b;
+
+    Fb() : b(4, 0) {}                                    // [0,4) root uoffset
+
+    void align(size_t a) { while (b.size() % a) b.push_back(0); }
+
+    template<class T> void put(size_t pos, T v) { std::memcpy(&b[pos], &v, sizeof v); }
+
+    template<class T> size_t push(T v) {
+        align(sizeof(T));
+        size_t p = b.size();
+        b.resize(p + sizeof v);
+        put(p, v);
+        return p;
+    }
+
+    void ref(size_t slot, size_t target) { put<uint32_t>(slot, (uint32_t)(target - slot)); }
+    void root(size_t t) { put<uint32_t>(0, (uint32_t)t); }
+
+    // sizes[i]：字段 i 的字节数（0 = 不写）；fpos[i] 返回字段的绝对位置
+    size_t table(std::initializer_list<uint8_t> sizes, size_t* fpos) {
+        const size_t n = sizes.size();
+        std::vector<uint16_t> rel(n, 0);
+        size_t off = 4, i = 0;
+        for (uint8_t sz : sizes) {
+            if (sz) {
+                off = (off + sz - 1) / sz * sz;
+                rel[i] = (uint16_t)off;
+                off += sz;
+            }
+            ++i;
+        }
+        align(2);
+        size_t vt = b.size();
+        push<uint16_t>((uint16_t)(4 + 2 * n));
+        push<uint16_t>((uint16_t)off);
+        for (uint16_t r : rel) push<uint16_t>(r);
+
+        align(8);
+        size_t t = b.size();
+        b.resize(t + off, 0);
+        put<int32_t>(t, (int32_t)(t - vt));
+        for (i = 0; i < n; ++i) fpos[i] = rel[i] ? t + rel[i] : 0;
+        return t;
+    }
+
+    size_t str(std::string_view s) {
+        size_t p = push<uint32_t>((uint32_t)s.size());
+        b.insert(b.end(), s.begin(), s.end());
+        b.push_back(0);
+        return p;
+    }
+
+    // 偏移向量：slots 为各元素槽位，之后 ref() 回填
+    size_t offsets(size_t n, std::vector<size_t>& slots) {
+        size_t p = push<uint32_t>((uint32_t)n);
+        slots.clear();
+        for (size_t i = 0; i < n; ++i) slots.push_back(push<uint32_t>(0));
+        return p;
+    }
+
+    // 结构体向量：长度字段落在 8k+4，元素 8 字节对齐
+    size_t structs(const void* data, size_t n, size_t elem) {
+        align(8);
+        b.resize(b.size() + 4, 0);
+        size_t p = push<uint32_t>((uint32_t)n);
+        const uint8_t* d = (const uint8_t*)data;
+        b.insert(b.end(), d, d + n * elem);
+        return p;
+    }
+};
+
+// ---------------- flatbuffers：只读视图（带越界检查） ----------------
+struct FbView {
+    const uint8_t* p;
+    size_t n;
+
+    void check(size_t pos, size_t len) const {
+        if (pos > n || len > n - pos) throw std::runtime_error("Corrupt Arrow IPC metadata.");
+    }
+    template<class T> T rd(size_t pos) const {
+        check(pos, sizeof(T));
+        T v;
+        std::memcpy(&v, p + pos, sizeof v);
+        return v;
+    }
+
+    size_t root() const { return rd<uint32_t>(0); }
+
+    size_t field(size_t t, int i) const {
+        int64_t vt = (int64_t)t - rd<int32_t>(t);
+        if (vt < 0) throw std::runtime_error("Corrupt Arrow IPC metadata.");
+        uint16_t vsz = rd<uint16_t>((size_t)vt);
+        if ((size_t)(4 + 2 * i + 2) > vsz) return 0;
+        uint16_t off = rd<uint16_t>((size_t)vt + 4 + 2 * i);
+        return off ? t + off : 0;
+    }
+    template<class T> T scalar(size_t t, int i, T def) const {
+        size_t f = field(t, i);
+        return f ? rd<T>(f) : def;
+    }
+    size_t deref(size_t t, int i) const {
+        size_t f = field(t, i);
+        return f ? f + rd<uint32_t>(f) : 0;
+    }
+    size_t elem_ref(size_t vec, size_t k) const {
+        size_t s = vec + 4 + 4 * k;
+        return s + rd<uint32_t>(s);
+    }
+    std::string str(size_t s) const {
+        uint32_t len = rd<uint32_t>(s);
+        check(s + 4, len);
+        return std::string((const char*)p + s + 4, len);
+    }
+};
+
+struct FieldNode { int64_t length; int64_t null_count; };
+struct BufferSpec { int64_t offset; int64_t length; };
+
+inline void set_valid(std::vector<uint8_t>& bm, int64_t r, bool ok)
+{
+    if ((r & 7) == 0) bm.push_back(0);
+    if (ok) bm.back() |= (uint8_t)(1u << (r & 7));
+}
+
+inline void pad8(std::string& body)
+{
+    while (body.size() % 8) body.push_back('\0');
+}
+
+// Schema 表（Message 与 Footer 共用）
+template<class Cols>
+size_t write_schema(Fb& f, const Cols& cols)
+{
+    size_t sf[2];
+    size_t s = f.table({2, 4}, sf);                      // endianness, fields
+    f.put<int16_t>(sf[0], 0);                            // Little
+    std::vector<size_t> slots;
+    f.ref(sf[1], f.offsets(cols.size(), slots));
+
+    for (size_t i = 0; i < cols.size(); ++i) {
+        size_t ff[6];                                    // name, nullable, type_type, type, dictionary, children
+        size_t t = f.table({4, 1, 1, 4, 0, 4}, ff);
+        f.ref(slots[i], t);
+        f.put<uint8_t>(ff[1], 1);
+
+        size_t tt, tf[2];
+        switch (cols[i].type) {
+            case ArrowType::UTF8:
+                f.put<uint8_t>(ff[2], T_UTF8);
+                tt = f.table({}, tf);
+                break;
+            case ArrowType::INT64:
+                f.put<uint8_t>(ff[2], T_INT);
+                tt = f.table({4, 1}, tf);                // bitWidth, is_signed
+                f.put<int32_t>(tf[0], 64);
+                f.put<uint8_t>(tf[1], 1);
+                break;
+            default:
+                f.put<uint8_t>(ff[2], T_FLOAT);
+                tt = f.table({2}, tf);                   // precision
+                f.put<int16_t>(tf[0], PRECISION_DOUBLE);
+                break;
+        }
+        f.ref(ff[3], tt);
+        f.ref(ff[0], f.str(cols[i].name));
+        std::vector<size_t> none;
+        f.ref(ff[5], f.offsets(0, none));
+    }
+    return s;
+}
+
+} // namespace
+
+// =====================================================================
+// Writer
+// =====================================================================
+ArrowIpcWriter::ArrowIpcWriter(Sink sink) : sink_(std::move(sink)) {}
+
+ArrowType ArrowIpcWriter::type_for(std::string_view col)
+{
+    if (col == "POS") return ArrowType::INT64;
+    if (col == "SNP" || col == "CHR" || col == "A1" || col == "A2") return ArrowType::UTF8;
+    return ArrowType::FLOAT64;
+}
+
+void ArrowIpcWriter::emit(const void* p, size_t n)
+{
+    if (!n) return;
+    sink_((const char*)p, n);
+    pos_ += (int64_t)n;
+}
+
+void ArrowIpcWriter::write_message(const std::vector<uint8_t>& meta, const std::string& body, int64_t* meta_len)
+{
+    static const char zeros[8] = {0};
+    const uint32_t cont = 0xFFFFFFFFu;
+    const size_t padded = (meta.size() + 7) / 8 * 8;     // 8 + padded 为 8 的倍数
+    const int32_t len = (int32_t)padded;
+
+    emit(&cont, 4);
+    emit(&len, 4);
+    emit(meta.data(), meta.size());
+    emit(zeros, padded - meta.size());
+    emit(body.data(), body.size());
+    if (meta_len) *meta_len = 8 + (int64_t)padded;
+}
+
+void ArrowIpcWriter::set_header(std::string_view header_line)
+{
+    cols_.clear();
+    size_t start = 0;
+    while (start <= header_line.size()) {
+        size_t tab = header_line.find('\t', start);
+        if (tab == std::string_view::npos) tab = header_line.size();
+        Column c;
+        c.name = std::string(header_line.substr(start, tab - start));
+        c.type = type_for(c.name);
+        if (c.type == ArrowType::UTF8) c.offsets.push_back(0);
+        cols_.push_back(std::move(c));
+        start = tab + 1;
+    }
+
+    static const char magic[8] = {'A','R','R','O','W','1',0,0};
+    emit(magic, 8);
+
+    Fb f;
+    size_t mf[4];
+    size_t m = f.table({2, 1, 4, 8}, mf);                // version, header_type, header, bodyLength
+    f.root(m);
+    f.put<int16_t>(mf[0], METADATA_V5);
+    f.put<uint8_t>(mf[1], MH_SCHEMA);
+    f.put<int64_t>(mf[3], 0);
+    f.ref(mf[2], write_schema(f, cols_));
+    write_message(f.b, std::string(), nullptr);
+}
+
+void ArrowIpcWriter::add_row(std::string_view line)
+{
+    size_t start = 0;
+    for (size_t c = 0; c < cols_.size(); ++c) {
+        std::string_view v;
+        if (start <= line.size()) {
+            size_t tab = line.find('\t', start);
+            if (tab == std::string_view::npos) tab = line.size();
+            v = line.substr(start, tab - start);
+            start = tab + 1;
+        }
+
+        Column& col = cols_[c];
+        bool ok = !v.empty() && v != "NA";
+        switch (col.type) {
+            case ArrowType::UTF8:
+                if (ok) col.chars.append(v.data(), v.size());
+                col.offsets.push_back((int32_t)col.chars.size());
+                break;
+            case ArrowType::INT64: {
+                int64_t x = 0;
+                auto r = std::from_chars(v.data(), v.data() + v.size(), x);
+                ok = ok && r.ec == std::errc() && r.ptr == v.data() + v.size();
+                col.i64.push_back(ok ? x : 0);
+                break;
+            }
+            case ArrowType::FLOAT64: {
+                double x = 0;
+                auto r = std::from_chars(v.data(), v.data() + v.size(), x);
+                ok = ok && r.ec == std::errc() && r.ptr == v.data() + v.size();
+                col.f64.push_back(ok ? x : 0.0);
+                break;
+            }
+        }
+        set_valid(col.valid, rows_, ok);
+        col.nulls += !ok;
+    }
+    if (++rows_ >= BATCH_ROWS) flush_batch();
+}
+
+void ArrowIpcWriter::flush_batch()
+{
+    if (rows_ == 0) return;
+
+    std::string body;
+    std::vector<FieldNode>  nodes;
+    std::vector<BufferSpec> bufs;
+    auto add_buf = [&](const void* p, size_t n) {
+        bufs.push_back({(int64_t)body.size(), (int64_t)n});
+        body.append((const char*)p, n);
+        pad8(body);
+    };
+
+    for (auto& c : cols_) {
+        nodes.push_back({rows_, c.nulls});
+        add_buf(c.valid.data(), c.valid.size());
+        switch (c.type) {
+            case ArrowType::UTF8:
+                add_buf(c.offsets.data(), c.offsets.size() * sizeof(int32_t));
+                add_buf(c.chars.data(), c.chars.size());
+                break;
+            case ArrowType::INT64:   add_buf(c.i64.data(), c.i64.size() * sizeof(int64_t)); break;
+            case ArrowType::FLOAT64: add_buf(c.f64.data(), c.f64.size() * sizeof(double));  break;
+        }
+    }
+
+    Fb f;
+    size_t mf[4];
+    size_t m = f.table({2, 1, 4, 8}, mf);
+    f.root(m);
+    f.put<int16_t>(mf[0], METADATA_V5);
+    f.put<uint8_t>(mf[1], MH_RECORD_BATCH);
+    f.put<int64_t>(mf[3], (int64_t)body.size());
+
+    size_t rf[3];
+    size_t rb = f.table({8, 4, 4}, rf);                  // length, nodes, buffers
+    f.ref(mf[2], rb);
+    f.put<int64_t>(rf[0], rows_);
+    f.ref(rf[1], f.structs(nodes.data(), nodes.size(), sizeof(FieldNode)));
+    f.ref(rf[2], f.structs(bufs.data(), bufs.size(), sizeof(BufferSpec)));
+
+    Block blk{pos_, 0, 0, (int64_t)body.size()};
+    int64_t meta_len = 0;
+    write_message(f.b, body, &meta_len);
+    blk.meta_len = (int32_t)meta_len;
+    blocks_.push_back(blk);
+
+    // 清空列缓冲，容量保留给下一批
+    for (auto& c : cols_) {
+        c.valid.clear();
+        c.nulls = 0;
+        c.chars.clear();
+        c.i64.clear();
+        c.f64.clear();
+        if (c.type == ArrowType::UTF8) c.offsets.assign(1, 0);
+    }
+    rows_ = 0;
+}
+
+void ArrowIpcWriter::finish()
+{
+    if (finished_) return;
+    finished_ = true;
+    flush_batch();
+
+    const uint32_t eos[2] = {0xFFFFFFFFu, 0};
+    emit(eos, 8);
+
+    Fb f;
+    size_t ff[4];
+    size_t ft = f.table({2, 4, 4, 4}, ff);               // version, schema, dictionaries, recordBatches
+    f.root(ft);
+    f.put<int16_t>(ff[0], METADATA_V5);
+    f.ref(ff[1], write_schema(f, cols_));
+    f.ref(ff[2], f.structs(nullptr, 0, sizeof(Block)));
+    f.ref(ff[3], f.structs(blocks_.data(), blocks_.size(), sizeof(Block)));
+
+    const int32_t flen = (int32_t)f.b.size();
+    emit(f.b.data(), f.b.size());
+    emit(&flen, 4);
+    emit("ARROW1", 6);
+}
+
+// =====================================================================
+// Decoder
+// =====================================================================
+ArrowIpcDecoder::ArrowIpcDecoder(Source src) : src_(std::move(src)) {}
+
+bool ArrowIpcDecoder::read_message(std::vector<uint8_t>& meta, std::vector<uint8_t>& body, int& header_type)
+{
+    uint8_t h[8];
+    if (have_prefix_) {
+        std::memcpy(h, prefix_, 8);
+        have_prefix_ = false;
+    } else if (!src_(h, 8)) {
+        return false;
+    }
+
+    uint32_t cont;
+    int32_t len;
+    std::memcpy(&cont, h, 4);
+    std::memcpy(&len, h + 4, 4);
+    if (cont != 0xFFFFFFFFu)
+        throw std::runtime_error("Unsupported Arrow IPC stream (pre-0.15 format without continuation marker).");
+    if (len == 0) return false;                          // EOS
+    if (len < 0) throw std::runtime_error("Corrupt Arrow IPC metadata.");
+
+    meta.resize((size_t)len);
+    if (!src_(meta.data(), meta.size())) throw std::runtime_error("Truncated Arrow IPC file.");
+
+    FbView v{meta.data(), meta.size()};
+    size_t m = v.root();
+    header_type = v.scalar<uint8_t>(m, 1, 0);
+    int64_t body_len = v.scalar<int64_t>(m, 3, 0);
+    if (body_len < 0) throw std::runtime_error("Corrupt Arrow IPC metadata.");
+
+    body.resize((size_t)body_len);
+    if (body_len && !src_(body.data(), body.size())) throw std::runtime_error("Truncated Arrow IPC file.");
+    return true;
+}
+
+void ArrowIpcDecoder::parse_schema(const std::vector<uint8_t>& meta, size_t schema)
+{
+    FbView v{meta.data(), meta.size()};
+    fields_.clear();
+    size_t vec = v.deref(schema, 1);
+    uint32_t n = vec ? v.rd<uint32_t>(vec) : 0;
+
+    for (uint32_t k = 0; k < n; ++k) {
+        size_t ft = v.elem_ref(vec, k);
+        Field f;
+        size_t nm = v.deref(ft, 0);
+        f.name = nm ? v.str(nm) : ("col" + std::to_string(k));
+        f.type = v.scalar<uint8_t>(ft, 2, 0);
+        f.bits = 0;
+        f.is_signed = true;
+
+        if (v.deref(ft, 4))
+            throw std::runtime_error("Arrow column [" + f.name + "] is dictionary-encoded; not supported.");
+        size_t ch = v.deref(ft, 5);
+        if (ch && v.rd<uint32_t>(ch) > 0)
+            throw std::runtime_error("Arrow column [" + f.name + "] is nested; not supported.");
+
+        size_t tt = v.deref(ft, 3);
+        switch (f.type) {
+            case T_INT:
+                f.bits = tt ? v.scalar<int32_t>(tt, 0, 0) : 0;
+                f.is_signed = tt ? v.scalar<uint8_t>(tt, 1, 0) != 0 : true;
+                if (f.bits != 8 && f.bits != 16 && f.bits != 32 && f.bits != 64)
+                    throw std::runtime_error("Arrow column [" + f.name + "]: bad integer width.");
+                break;
+            case T_FLOAT: {
+                int16_t prec = tt ? v.scalar<int16_t>(tt, 0, 0) : 0;
+                if (prec == 1) f.bits = 32;
+                else if (prec == 2) f.bits = 64;
+                else throw std::runtime_error("Arrow column [" + f.name + "]: half floats not supported.");
+                break;
+            }
+            case T_NULL: case T_BOOL:
+            case T_BINARY: case T_UTF8: case T_LARGE_BINARY: case T_LARGE_UTF8:
+                break;
+            default:
+                throw std::runtime_error("Arrow column [" + f.name + "] has an unsupported type (id " +
+                                         std::to_string(f.type) + ").");
+        }
+        fields_.push_back(std::move(f));
+    }
+}
+
+void ArrowIpcDecoder::render_batch(const std::vector<uint8_t>& meta, size_t rb,
+                                   const std::vector<uint8_t>& body, std::string& out) const
+{
+    FbView v{meta.data(), meta.size()};
+    if (v.deref(rb, 3))
+        throw std::runtime_error("Compressed Arrow record batches are not supported (write with compression='uncompressed').");
+
+    const int64_t length = v.scalar<int64_t>(rb, 0, 0);
+    size_t nodes = v.deref(rb, 1);
+    size_t bufs  = v.deref(rb, 2);
+    uint32_t n_nodes = nodes ? v.rd<uint32_t>(nodes) : 0;
+    uint32_t n_bufs  = bufs  ? v.rd<uint32_t>(bufs)  : 0;
+    if (n_nodes < fields_.size() || length < 0 || length > (int64_t{1} << 56))
+        throw std::runtime_error("Corrupt Arrow record batch.");
+    const uint64_t n = (uint64_t)length;
+
+    struct ColView { const uint8_t* valid; const uint8_t* off; const uint8_t* data; int64_t null_count; };
+    std::vector<ColView> cv(fields_.size());
+    uint32_t bi = 0;
+    // 取下一个 buffer：须落在 body 内且至少 need 字节
+    auto take = [&](const uint8_t*& dst, uint64_t need) -> uint64_t {
+        if (bi >= n_bufs) throw std::runtime_error("Corrupt Arrow record batch.");
+        int64_t off = v.rd<int64_t>(bufs + 4 + 16 * bi);
+        int64_t len = v.rd<int64_t>(bufs + 4 + 16 * bi + 8);
+        ++bi;
+        if (off < 0 || len < 0 || (uint64_t)off + (uint64_t)len > body.size() || (uint64_t)len < need)
+            throw std::runtime_error("Corrupt Arrow record batch.");
+        dst = len ? body.data() + off : nullptr;
+        return (uint64_t)len;
+    };
+
+    for (size_t c = 0; c < fields_.size(); ++c) {
+        const Field& f = fields_[c];
+        cv[c] = {nullptr, nullptr, nullptr, v.rd<int64_t>(nodes + 4 + 16 * c + 8)};
+        if (f.type == T_NULL) continue;
+
+        uint64_t vlen = take(cv[c].valid, 0);           // validity 可省略，否则须覆盖 length 位
+        if (vlen && vlen < (n + 7) / 8) throw std::runtime_error("Corrupt Arrow record batch.");
+        switch (f.type) {
+            case T_INT: case T_FLOAT:
+                take(cv[c].data, n * (uint64_t)(f.bits / 8));
+                break;
+            case T_BOOL:
+                take(cv[c].data, (n + 7) / 8);
+                break;
+            default: {                                   // utf8 / binary（含 large）
+                const bool large = f.type == T_LARGE_UTF8 || f.type == T_LARGE_BINARY;
+                const uint64_t w = large ? 8 : 4;
+                take(cv[c].off, n ? (n + 1) * w : 0);
+                uint64_t dlen = take(cv[c].data, 0);
+                // offsets 须单调不减且落在 data buffer 内，逐行渲染时才无需再查
+                int64_t prev = 0;
+                for (uint64_t r = 0; n && r <= n; ++r) {
+                    int64_t o;
+                    if (large) std::memcpy(&o, cv[c].off + r * 8, 8);
+                    else { int32_t t; std::memcpy(&t, cv[c].off + r * 4, 4); o = t; }
+                    if (o < prev || (uint64_t)o > dlen) throw std::runtime_error("Corrupt Arrow record batch.");
+                    prev = o;
+                }
+                break;
+            }
+        }
+    }
+
+    char num[64];
+    for (int64_t r = 0; r < length; ++r) {
+        for (size_t c = 0; c < fields_.size(); ++c) {
+            if (c) out.push_back('\t');
+            const Field& f = fields_[c];
+            const ColView& x = cv[c];
+            if (f.type == T_NULL || (x.valid && x.null_count && !((x.valid[r >> 3] >> (r & 7)) & 1))) {
+                out.append("NA");
+                continue;
+            }
+            std::to_chars_result res{num, std::errc()};
+            switch (f.type) {
+                case T_INT: {
+                    const uint8_t* p = x.data + r * (f.bits / 8);
+                    if (f.is_signed) {
+                        int64_t val = 0;
+                        if (f.bits == 8)       { int8_t  t; std::memcpy(&t, p, 1); val = t; }
+                        else if (f.bits == 16) { int16_t t; std::memcpy(&t, p, 2); val = t; }
+                        else if (f.bits == 32) { int32_t t; std::memcpy(&t, p, 4); val = t; }
+                        else                   { std::memcpy(&val, p, 8); }
+                        res = std::to_chars(num, num + sizeof num, val);
+                    } else {
+                        uint64_t val = 0;
+                        std::memcpy(&val, p, (size_t)(f.bits / 8));   // little-endian
+                        res = std::to_chars(num, num + sizeof num, val);
+                    }
+                    out.append(num, res.ptr);
+                    break;
+                }
+                case T_FLOAT:
+                    if (f.bits == 64) {
+                        double d; std::memcpy(&d, x.data + r * 8, 8);
+                        res = std::to_chars(num, num + sizeof num, d, std::chars_format::general);
+                    } else {
+                        float d; std::memcpy(&d, x.data + r * 4, 4);
+                        res = std::to_chars(num, num + sizeof num, d, std::chars_format::general);
+                    }
+                    out.append(num, res.ptr);
+                    break;
+                case T_BOOL:
+                    out.push_back(((x.data[r >> 3] >> (r & 7)) & 1) ? '1' : '0');
+                    break;
+                case T_LARGE_UTF8: case T_LARGE_BINARY: {
+                    int64_t a, b;
+                    std::memcpy(&a, x.off + r * 8, 8);
+                    std::memcpy(&b, x.off + r * 8 + 8, 8);
+                    if (b > a) out.append((const char*)x.data + a, (size_t)(b - a));
+                    break;
+                }
+                default: {
+                    int32_t a, b;
+                    std::memcpy(&a, x.off + r * 4, 4);
+                    std::memcpy(&b, x.off + r * 4 + 4, 4);
+                    if (b > a) out.append((const char*)x.data + a, (size_t)(b - a));
+                    break;
+                }
+            }
+        }
+        out.push_back('\n');
+    }
+}
+
+bool ArrowIpcDecoder::next_chunk(std::string& out)
+{
+    if (done_) return false;
+
+    if (!started_) {
+        started_ = true;
+        uint8_t m[8];
+        if (!src_(m, 8)) { done_ = true; return false; }
+        if (std::memcmp(m, "ARROW1", 6) != 0) {          // stream 格式：首 8 字节即第一条消息的前缀
+            std::memcpy(prefix_, m, 8);
+            have_prefix_ = true;
+        }
+    }
+
+    std::vector<uint8_t> meta, body;
+    while (true) {
+        int ht = 0;
+        if (!read_message(meta, body, ht)) { done_ = true; return false; }
+        FbView v{meta.data(), meta.size()};
+        size_t header = v.deref(v.root(), 2);
+        if (!header) throw std::runtime_error("Corrupt Arrow IPC metadata.");
+
+        if (ht == MH_SCHEMA) {
+            parse_schema(meta, header);
+            for (size_t c = 0; c < fields_.size(); ++c) {
+                if (c) out.push_back('\t');
+                out.append(fields_[c].name);
+            }
+            out.push_back('\n');
+            return true;
+        }
+        if (ht == MH_RECORD_BATCH) {
+            render_batch(meta, header, body, out);
+            return true;
+        }
+        if (ht == MH_DICT)
+            throw std::runtime_error("Arrow dictionary batches are not supported.");
+        // 其他消息（Tensor 等）跳过
+    }
+}
@@ -0,0 +1,91 @@
+//
+//  arrowipc.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_ARROWIPC_HPP
+#define TOOLKIT_ARROWIPC_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Apache Arrow IPC（Feather v2）最小实现，不依赖 libarrow：
+//   ArrowIpcWriter  : tab 分隔文本行 → 带类型的列，按 record batch 写 IPC file
+//   ArrowIpcDecoder : 顺序读 IPC file / stream（不 seek、不读 footer，可读 stdin），
+//                     逐批还原为 tab 分隔文本（header + 数据行），接到 LineReader 后面
+// 只处理未压缩、非字典编码的平铺列（pyarrow / polars 默认写出的即是这种）
+
+enum class ArrowType : uint8_t { UTF8, INT64, FLOAT64 };
+
+class ArrowIpcWriter {
+public:
+    using Sink = std::function<void(const char*, size_t)>;
+
+    explicit ArrowIpcWriter(Sink sink);
+
+    // 列类型按列名决定：SNP/CHR/A1/A2 → utf8（CHR 原样保留 X/Y/MT 与其他 contig 名），
+    // POS → int64，其余 → float64；无法解析的单元格写 null
+    static ArrowType type_for(std::string_view col);
+
+    void set_header(std::string_view header_line);
+    void add_row(std::string_view line);
+    void finish();                       // 写出剩余行、EOS 与 footer
+
+private:
+    struct Column {
+        std::string name;
+        ArrowType type;
+        std::vector<uint8_t> valid;      // validity bitmap
+        int64_t nulls = 0;
+        std::vector<int32_t> offsets;    // utf8
+        std::string chars;
+        std::vector<int64_t> i64;
+        std::vector<double>  f64;
+    };
+
+    void emit(const void* p, size_t n);
+    void write_message(const std::vector<uint8_t>& meta, const std::string& body, int64_t* meta_len);
+    void flush_batch();
+
+    Sink sink_;
+    std::vector<Column> cols_;
+    int64_t rows_ = 0;
+    int64_t pos_  = 0;                   // 已写字节数（footer 的 Block.offset）
+    bool finished_ = false;
+
+    struct Block { int64_t offset; int32_t meta_len; int32_t pad; int64_t body_len; };
+    std::vector<Block> blocks_;
+};
+
+class ArrowIpcDecoder {
+public:
+    // 精确读 n 字节；EOF 返回 false
+    using Source = std::function<bool(void*, size_t)>;
+
+    explicit ArrowIpcDecoder(Source src);
+
+    // 追加下一段文本（首次为 header 行，之后每次一个 record batch 的所有行）；结束返回 false
+    bool next_chunk(std::string& out);
+
+private:
+    struct Field { std::string name; int type; int bits; bool is_signed; };
+
+    bool read_message(std::vector<uint8_t>& meta, std::vector<uint8_t>& body, int& header_type);
+    void parse_schema(const std::vector<uint8_t>& meta, size_t schema);
+    void render_batch(const std::vector<uint8_t>& meta, size_t rb, const std::vector<uint8_t>& body,
+                      std::string& out) const;
+
+    Source src_;
+    std::vector<Field> fields_;
+    bool started_ = false;
+    bool done_ = false;
+    bool have_prefix_ = false;
+    uint8_t prefix_[8];                  // stream 格式时已读走的首 8 字节
+};
+
+#endif
@@ -0,0 +1,508 @@
+//
+//  bgzf.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/bgzf.hpp"
+#include "utils/log.hpp"
+#include "utils/parallel.hpp"
+#include "utils/util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+
+// 一批并行压缩的块数（64 × 0xff00 ≈ 4 MiB）
+static constexpr size_t kBatchBlocks = 64;
+
+// 标准 BGZF EOF 块（空 member）
+static const unsigned char kBgzfEof[28] = {
+    0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00, 0x42, 0x43,
+    0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+static inline void put_u16(unsigned char* p, uint32_t v){ p[0] = v & 0xff; p[1] = (v >> 8) & 0xff; }
+static inline void put_u32(unsigned char* p, uint32_t v){ for (int i = 0; i < 4; ++i) p[i] = (v >> (8*i)) & 0xff; }
+
+// 一块：18 字节头（含 BC 扩展字段）+ raw deflate + CRC32 + ISIZE
+static bool bgzf_compress_block(const char* src, size_t n, std::string& out)
+{
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return false;
+
+    size_t bound = deflateBound(&zs, (uLong)n);
+    out.resize(18 + bound + 8);
+    unsigned char* o = reinterpret_cast<unsigned char*>(&out[0]);
+
+    zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(src));
+    zs.avail_in  = (uInt)n;
+    zs.next_out  = o + 18;
+    zs.avail_out = (uInt)bound;
+    int rc = deflate(&zs, Z_FINISH);
+    size_t clen = zs.total_out;
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END) return false;
+
+    size_t bsize = 18 + clen + 8;
+    if (bsize > 65536) return false;     // 0xff00 的输入不会越界；防御
+
+    static const unsigned char hdr[16] = {
+        0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00
+    };
+    std::memcpy(o, hdr, 16);
+    put_u16(o + 16, (uint32_t)(bsize - 1));
+    put_u32(o + 18 + clen, (uint32_t)crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(src), (uInt)n));
+    put_u32(o + 18 + clen + 4, (uint32_t)n);
+    out.resize(bsize);
+    return true;
+}
+
+// =======================================================
+//                       BgzfWriter
+// =======================================================
+BgzfWriter::BgzfWriter(const std::string& path)
+{
+    fp_ = std::fopen(path.c_str(), "wb");
+    if (!fp_) {
+        LOG_ERROR("Error: cannot open BGZF file for writing: " + path);
+        return;
+    }
+    pending_.reserve(kBatchBlocks * kBlock);
+}
+
+BgzfWriter::~BgzfWriter()
+{
+    close();
+}
+
+void BgzfWriter::write(const char* p, size_t n)
+{
+    if (!fp_ || closed_) return;
+    written_u_ += n;
+    while (n > 0) {
+        size_t room = kBatchBlocks * kBlock - pending_.size();
+        size_t k = std::min(room, n);
+        pending_.append(p, k);
+        p += k;
+        n -= k;
+        if (pending_.size() == kBatchBlocks * kBlock) compress_pending(false);
+    }
+}
+
+void BgzfWriter::compress_pending(bool final)
+{
+    size_t nblk = final ? (pending_.size() + kBlock - 1) / kBlock
+                        : pending_.size() / kBlock;
+    if (nblk == 0) return;
+
+    std::vector<std::string> out(nblk);
+    std::vector<uint8_t> ok(nblk, 0);
+    par_for(nblk, [&](size_t i) {
+        size_t off = i * kBlock;
+        size_t n = std::min(kBlock, pending_.size() - off);
+        ok[i] = bgzf_compress_block(pending_.data() + off, n, out[i]) ? 1 : 0;
+    });
+    if (std::find(ok.begin(), ok.end(), 0) != ok.end()) {
+        LOG_ERROR("BGZF compression error.");
+        die(1);
+    }
+
+    for (const auto& b : out) {
+        coff_.push_back(written_c_);
+        if (std::fwrite(b.data(), 1, b.size(), fp_) != b.size()) {
+            LOG_ERROR("Error writing BGZF output.");
+            die(1);
+        }
+        written_c_ += b.size();
+    }
+    pending_.erase(0, std::min(pending_.size(), nblk * kBlock));
+}
+
+void BgzfWriter::close()
+{
+    if (!fp_ || closed_) return;
+    compress_pending(true);
+    coff_.push_back(written_c_);          // 恰好落在块边界的偏移指向 EOF 块
+    std::fwrite(kBgzfEof, 1, sizeof(kBgzfEof), fp_);
+    std::fclose(fp_);
+    fp_ = nullptr;
+    closed_ = true;
+}
+
+uint64_t BgzfWriter::voffset(uint64_t u) const
+{
+    size_t b = (size_t)(u / kBlock);
+    uint64_t w = u % kBlock;
+    if (b >= coff_.size()) { b = coff_.size() - 1; w = 0; }
+    return (coff_[b] << 16) | w;
+}
+
+// =======================================================
+//                       TabixIndex
+// =======================================================
+
+// UCSC binning（与 SAM/tabix 规范一致）；区间 [beg, end)，0-based
+static inline uint32_t reg2bin(int64_t beg, int64_t end)
+{
+    --end;
+    if (beg >> 14 == end >> 14) return (uint32_t)(((1 << 15) - 1) / 7 + (beg >> 14));
+    if (beg >> 17 == end >> 17) return (uint32_t)(((1 << 12) - 1) / 7 + (beg >> 17));
+    if (beg >> 20 == end >> 20) return (uint32_t)(((1 <<  9) - 1) / 7 + (beg >> 20));
+    if (beg >> 23 == end >> 23) return (uint32_t)(((1 <<  6) - 1) / 7 + (beg >> 23));
+    if (beg >> 26 == end >> 26) return (uint32_t)(((1 <<  3) - 1) / 7 + (beg >> 26));
+    return 0;
+}
+
+static constexpr uint32_t kNoBin = std::numeric_limits<uint32_t>::max();
+static constexpr uint64_t kNoOff = std::numeric_limits<uint64_t>::max();
+
+TabixIndex::TabixIndex(int col_seq, int col_pos, int skip)
+    : col_seq_(col_seq), col_pos_(col_pos), skip_(skip) {}
+
+bool TabixIndex::add(std::string_view chr, int64_t pos, uint64_t u_beg, uint64_t u_end)
+{
+    if (pos <= 0 || pos >= (int64_t(1) << 29)) {
+        err_ = "position out of range for a tabix index: " + std::to_string(pos);
+        return false;
+    }
+
+    if (names_.empty() || chr != names_.back()) {
+        if (!names_.empty()) close_chunk();
+        if (std::find(names_.begin(), names_.end(), chr) != names_.end()) {
+            err_ = "rows of chromosome " + std::string(chr) + " are not contiguous";
+            return false;
+        }
+        names_.emplace_back(chr);
+        refs_.emplace_back();
+        refs_.back().cur_bin = kNoBin;
+    }
+
+    Ref& r = refs_.back();
+    if (pos < r.last_pos) {
+        err_ = "rows are not sorted by position on chromosome " + std::string(chr);
+        return false;
+    }
+    r.last_pos = pos;
+
+    int64_t beg = pos - 1, end = pos;
+    size_t w = (size_t)(beg >> 14);
+    if (r.linear.size() <= w) r.linear.resize(w + 1, kNoOff);
+    if (r.linear[w] == kNoOff) r.linear[w] = u_beg;
+
+    uint32_t bin = reg2bin(beg, end);
+    if (bin != r.cur_bin) {
+        if (r.cur_bin != kNoBin) r.bins[r.cur_bin].push_back({r.chunk_beg, u_beg});
+        r.cur_bin = bin;
+        r.chunk_beg = u_beg;
+    }
+    r.last_end = u_end;
+    return true;
+}
+
+void TabixIndex::close_chunk()
+{
+    Ref& r = refs_.back();
+    if (r.cur_bin != kNoBin) {
+        r.bins[r.cur_bin].push_back({r.chunk_beg, r.last_end});
+        r.cur_bin = kNoBin;
+    }
+}
+
+template <class T>
+static inline void put_le(std::string& s, T v){
+    for (size_t i = 0; i < sizeof(T); ++i) s.push_back((char)((uint64_t)v >> (8*i) & 0xff));
+}
+
+bool TabixIndex::save(const std::string& path, const BgzfWriter& bw)
+{
+    if (!refs_.empty()) close_chunk();
+
+    std::string names;
+    for (const auto& n : names_) { names += n; names.push_back('\0'); }
+
+    std::string s;
+    s.append("TBI\1", 4);
+    put_le<int32_t>(s, (int32_t)names_.size());
+    put_le<int32_t>(s, 0);                       // format: generic, 1-based
+    put_le<int32_t>(s, col_seq_ + 1);
+    put_le<int32_t>(s, col_pos_ + 1);
+    put_le<int32_t>(s, col_pos_ + 1);            // end = POS（单碱基）
+    put_le<int32_t>(s, '#');
+    put_le<int32_t>(s, skip_);
+    put_le<int32_t>(s, (int32_t)names.size());
+    s += names;
+
+    for (const auto& r : refs_) {
+        put_le<int32_t>(s, (int32_t)r.bins.size());
+        for (const auto& kv : r.bins) {
+            // 换算成 virtual offset 后合并落在同一压缩块里的相邻 chunk
+            std::vector<Chunk> ch;
+            for (const auto& c : kv.second) ch.push_back({bw.voffset(c.beg), bw.voffset(c.end)});
+            std::sort(ch.begin(), ch.end(), [](const Chunk& a, const Chunk& b){ return a.beg < b.beg; });
+            std::vector<Chunk> merged;
+            for (const auto& c : ch) {
+                if (!merged.empty() && (c.beg <= merged.back().end || (c.beg >> 16) == (merged.back().end >> 16)))
+                    merged.back().end = std::max(merged.back().end, c.end);
+                else
+                    merged.push_back(c);
+            }
+            put_le<uint32_t>(s, kv.first);
+            put_le<int32_t>(s, (int32_t)merged.size());
+            for (const auto& c : merged) { put_le<uint64_t>(s, c.beg); put_le<uint64_t>(s, c.end); }
+        }
+
+        // 线性索引：空窗口取前一个窗口的值（开头的空窗口取第一条记录）
+        std::vector<uint64_t> lin = r.linear;
+        uint64_t first = kNoOff;
+        for (uint64_t v : lin) if (v != kNoOff) { first = v; break; }
+        uint64_t prev = first;
+        for (auto& v : lin) { if (v == kNoOff) v = prev; else prev = v; }
+        put_le<int32_t>(s, (int32_t)lin.size());
+        for (uint64_t v : lin) put_le<uint64_t>(s, bw.voffset(v));
+    }
+    put_le<uint64_t>(s, 0);                      // n_no_coor
+
+    BgzfWriter out(path);
+    if (!out.good()) return false;
+    out.write(s);
+    out.close();
+    return true;
+}
+
+// =======================================================
+//                       BgzfReader
+// =======================================================
+BgzfReader::BgzfReader(const std::string& path) : path_(path)
+{
+    fp_ = std::fopen(path.c_str(), "rb");
+    if (!fp_) LOG_ERROR("Error: cannot open BGZF file: " + path);
+}
+
+BgzfReader::~BgzfReader()
+{
+    if (fp_) std::fclose(fp_);
+}
+
+static inline uint32_t get_u16(const unsigned char* p){ return p[0] | (p[1] << 8); }
+static inline uint32_t get_u32(const unsigned char* p){ return get_u16(p) | (get_u16(p + 2) << 16); }
+
+bool BgzfReader::load_block(uint64_t coff)
+{
+    blk_.clear();
+    pos_ = 0;
+    coff_ = next_coff_ = coff;
+    if (fseeko(fp_, (off_t)coff, SEEK_SET) != 0) return false;
+
+    unsigned char h[18];
+    if (std::fread(h, 1, 18, fp_) != 18) return false;          // EOF
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || !(h[3] & 4)) {
+        LOG_ERROR("Not a BGZF file (bgzip / GWAStoolkit .gz output expected): " + path_);
+        die(1);
+    }
+
+    // BC 子字段给出块长；XLEN 可能含其他子字段
+    uint32_t xlen = get_u16(h + 10);
+    std::string extra(xlen, '\0');
+    std::memcpy(&extra[0], h + 12, 6);
+    if (xlen > 6 && std::fread(&extra[6], 1, xlen - 6, fp_) != xlen - 6) return false;
+    uint32_t bsize = 0;
+    for (size_t i = 0; i + 4 <= extra.size(); ) {
+        const unsigned char* q = reinterpret_cast<const unsigned char*>(extra.data()) + i;
+        uint32_t slen = get_u16(q + 2);
+        if (q[0] == 'B' && q[1] == 'C' && slen == 2) bsize = get_u16(q + 4) + 1;
+        i += 4 + slen;
+    }
+    size_t hlen = 12 + xlen;
+    if (bsize < hlen + 8) {
+        LOG_ERROR("Not a BGZF file (missing block size): " + path_);
+        die(1);
+    }
+
+    cbuf_.resize(bsize - hlen);
+    if (std::fread(&cbuf_[0], 1, cbuf_.size(), fp_) != cbuf_.size()) return false;
+    const unsigned char* tail = reinterpret_cast<const unsigned char*>(cbuf_.data()) + cbuf_.size() - 8;
+    uint32_t isize = get_u32(tail + 4);
+
+    blk_.resize(isize);
+    if (isize > 0) {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        inflateInit2(&zs, -15);
+        zs.next_in   = reinterpret_cast<Bytef*>(&cbuf_[0]);
+        zs.avail_in  = (uInt)(cbuf_.size() - 8);
+        zs.next_out  = reinterpret_cast<Bytef*>(&blk_[0]);
+        zs.avail_out = isize;
+        int rc = inflate(&zs, Z_FINISH);
+        inflateEnd(&zs);
+        if (rc != Z_STREAM_END || zs.total_out != isize) {
+            LOG_ERROR("Corrupted BGZF block in " + path_);
+            die(1);
+        }
+    }
+    next_coff_ = coff + bsize;
+    return true;
+}
+
+bool BgzfReader::seek(uint64_t voff)
+{
+    if (!fp_) return false;
+    if (!load_block(voff >> 16)) return false;
+    pos_ = (size_t)(voff & 0xffff);
+    return pos_ <= blk_.size();
+}
+
+uint64_t BgzfReader::tell() const
+{
+    return pos_ < blk_.size() ? (coff_ << 16) | pos_ : next_coff_ << 16;
+}
+
+bool BgzfReader::getline(std::string& line)
+{
+    line.clear();
+    bool any = false;
+    for (;;) {
+        if (pos_ >= blk_.size()) {
+            if (!load_block(next_coff_)) return any;
+            continue;                         // 空块（EOF 块）继续往后
+        }
+        any = true;
+        const char* b = blk_.data() + pos_;
+        const char* nl = static_cast<const char*>(memchr(b, '\n', blk_.size() - pos_));
+        if (nl) {
+            line.append(b, (size_t)(nl - b));
+            pos_ += (size_t)(nl - b) + 1;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            return true;
+        }
+        line.append(b, blk_.size() - pos_);
+        pos_ = blk_.size();
+    }
+}
+
+// =======================================================
+//                       TabixReader
+// =======================================================
+TabixReader::TabixReader(const std::string& tbi_path)
+{
+    gzFile gz = gzopen(tbi_path.c_str(), "rb");
+    if (!gz) {
+        err_ = "cannot open index " + tbi_path;
+        return;
+    }
+    std::string s;
+    char buf[1 << 16];
+    int k;
+    while ((k = gzread(gz, buf, sizeof(buf))) > 0) s.append(buf, (size_t)k);
+    gzclose(gz);
+
+    size_t o = 0;
+    bool bad = false;
+    auto need = [&](size_t n){ if (o + n > s.size()) bad = true; return !bad; };
+    auto i32 = [&]() -> int32_t {
+        if (!need(4)) return 0;
+        int32_t v = (int32_t)get_u32(reinterpret_cast<const unsigned char*>(s.data()) + o);
+        o += 4;
+        return v;
+    };
+    auto u64 = [&]() -> uint64_t {
+        if (!need(8)) return 0;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(s.data()) + o;
+        o += 8;
+        return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+    };
+
+    if (s.size() < 4 || s.compare(0, 4, "TBI\1", 4) != 0) {
+        err_ = "not a tabix index: " + tbi_path;
+        return;
+    }
+    o = 4;
+    int32_t n_ref = i32();
+    int32_t fmt   = i32();
+    col_seq_ = i32() - 1;
+    col_pos_ = i32() - 1;
+    i32();                                     // col_end
+    i32();                                     // meta
+    skip_ = i32();
+    int32_t l_nm = i32();
+    zero_based_ = (fmt & 0x10000) != 0;
+    if (bad || n_ref < 0 || l_nm < 0 || !need((size_t)l_nm)) {
+        err_ = "truncated tabix index: " + tbi_path;
+        return;
+    }
+    for (size_t i = o, start = o; i < o + (size_t)l_nm; ++i) {
+        if (s[i] == '\0') { names_.emplace_back(s, start, i - start); start = i + 1; }
+    }
+    o += (size_t)l_nm;
+
+    refs_.resize((size_t)n_ref);
+    for (int32_t r = 0; r < n_ref && !bad; ++r) {
+        int32_t n_bin = i32();
+        for (int32_t b = 0; b < n_bin && !bad; ++b) {
+            uint32_t bin = (uint32_t)i32();
+            int32_t n_chunk = i32();
+            auto& v = refs_[r].bins[bin];
+            for (int32_t c = 0; c < n_chunk && !bad; ++c) {
+                uint64_t beg = u64();
+                uint64_t end = u64();
+                v.push_back({beg, end});
+            }
+        }
+        int32_t n_intv = i32();
+        for (int32_t i = 0; i < n_intv && !bad; ++i) refs_[r].linear.push_back(u64());
+    }
+    if (bad || (int32_t)names_.size() != n_ref) err_ = "truncated tabix index: " + tbi_path;
+}
+
+int TabixReader::ref_id(std::string_view name) const
+{
+    for (size_t i = 0; i < names_.size(); ++i)
+        if (names_[i] == name) return (int)i;
+    int code = canonical_chr_code_sv(name);
+    if (code < 0) return -1;
+    for (size_t i = 0; i < names_.size(); ++i)
+        if (canonical_chr_code_sv(names_[i]) == code) return (int)i;
+    return -1;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> TabixReader::chunks(int ref, int64_t beg, int64_t end) const
+{
+    std::vector<std::pair<uint64_t, uint64_t>> out;
+    if (ref < 0 || ref >= (int)refs_.size() || end < beg) return out;
+    const Ref& R = refs_[ref];
+
+    int64_t b0 = std::max<int64_t>(beg - 1, 0);   // 0-based 半开区间 [b0, end)
+    int64_t e0 = std::min<int64_t>(end, int64_t(1) << 29);
+    if (b0 >= e0) return out;
+
+    // 线性索引：区间起点所在 16 kb 窗口之前的记录都可跳过
+    uint64_t min_off = 0;
+    if (!R.linear.empty())
+        min_off = R.linear[std::min<size_t>((size_t)(b0 >> 14), R.linear.size() - 1)];
+
+    // reg2bins：与区间重叠的所有 bin（6 层）
+    std::vector<Chunk> cand;
+    int64_t e1 = e0 - 1;
+    static const int shift[6]  = {29, 26, 23, 20, 17, 14};
+    static const int offset[6] = {0, 1, 9, 73, 585, 4681};
+    for (int l = 0; l < 6; ++l) {
+        for (int64_t k = offset[l] + (b0 >> shift[l]); k <= offset[l] + (e1 >> shift[l]); ++k) {
+            auto it = R.bins.find((uint32_t)k);
+            if (it == R.bins.end()) continue;
+            for (const auto& c : it->second)
+                if (c.end > min_off) cand.push_back({std::max(c.beg, min_off), c.end});
+        }
+    }
+
+    std::sort(cand.begin(), cand.end(), [](const Chunk& a, const Chunk& b){ return a.beg < b.beg; });
+    for (const auto& c : cand) {
+        if (!out.empty() && c.beg <= out.back().second) out.back().second = std::max(out.back().second, c.end);
+        else out.push_back({c.beg, c.end});
+    }
+    return out;
+}
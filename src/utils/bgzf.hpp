@@ -0,0 +1,162 @@
+//
+//  bgzf.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_BGZF_HPP
+#define TOOLKIT_BGZF_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// =======================================================
+// [BGZF] 分块 gzip（SAMtools/htslib 同款）：
+//   每块独立的 gzip member，未压缩 ≤ 0xff00 字节；zcat / gzread 照常读取，
+//   同时可按 virtual offset（块起点 << 16 | 块内偏移）随机访问。
+//   块彼此独立 → 攒满一批后 OpenMP 并行压缩，按序落盘。
+// =======================================================
+
+class BgzfWriter {
+public:
+    explicit BgzfWriter(const std::string& path);
+    ~BgzfWriter();
+
+    BgzfWriter(const BgzfWriter&) = delete;
+    BgzfWriter& operator=(const BgzfWriter&) = delete;
+
+    bool good() const { return fp_ != nullptr; }
+
+    void write(const char* p, size_t n);
+    void write(std::string_view s) { write(s.data(), s.size()); }
+
+    // 已写入的未压缩字节数；索引先按它记录，close() 之后再用 voffset() 换算
+    uint64_t tell() const { return written_u_; }
+
+    // 刷出剩余数据并写 EOF 块
+    void close();
+
+    // 未压缩偏移 → virtual offset（close() 之后可用）
+    uint64_t voffset(uint64_t u) const;
+
+    static constexpr size_t kBlock = 0xff00;
+
+private:
+    void compress_pending(bool final);
+
+    FILE* fp_ = nullptr;
+    std::string pending_;            // 待压缩的整块（最后一块可不满）
+    std::vector<uint64_t> coff_;     // 第 i 块在文件中的起始偏移（末尾多存一个：EOF 块起点）
+    uint64_t written_u_ = 0;
+    uint64_t written_c_ = 0;
+    bool closed_ = false;
+};
+
+// =======================================================
+// [TABIX] .tbi 索引（tabix -s CHR -b POS -e POS -S 1 兼容）
+//   记录需按染色体分组、组内 POS 不减；add() 发现乱序返回 false
+//   偏移先记未压缩字节数，save() 时经 BgzfWriter::voffset 换算
+// =======================================================
+
+class TabixIndex {
+public:
+    // col_seq / col_pos：0-based 列号；skip：文件开头跳过的行数（表头）
+    TabixIndex(int col_seq, int col_pos, int skip);
+
+    // 一行数据：[u_beg, u_end) 为其在未压缩流中的区间（含 '\n'）
+    bool add(std::string_view chr, int64_t pos, uint64_t u_beg, uint64_t u_end);
+
+    // 写 path（BGZF 压缩）；bw 必须已 close()
+    bool save(const std::string& path, const BgzfWriter& bw);
+
+    const std::string& error() const { return err_; }
+
+private:
+    struct Chunk { uint64_t beg, end; };
+    struct Ref {
+        std::map<uint32_t, std::vector<Chunk>> bins;
+        std::vector<uint64_t> linear;             // 16 kb 窗口的最小起始偏移
+        uint32_t cur_bin = 0;
+        uint64_t chunk_beg = 0, last_end = 0;
+        int64_t  last_pos = 0;
+    };
+    void close_chunk();
+
+    int col_seq_, col_pos_, skip_;
+    std::vector<std::string> names_;
+    std::vector<Ref> refs_;
+    std::string err_;
+};
+
+// =======================================================
+// [BGZF] 随机读取：seek 到 virtual offset 后逐行读（query 用）
+// =======================================================
+
+class BgzfReader {
+public:
+    explicit BgzfReader(const std::string& path);
+    ~BgzfReader();
+
+    BgzfReader(const BgzfReader&) = delete;
+    BgzfReader& operator=(const BgzfReader&) = delete;
+
+    bool good() const { return fp_ != nullptr; }
+
+    bool seek(uint64_t voff);
+    bool getline(std::string& line);      // 不含 '\n'
+    uint64_t tell() const;                // 下一个字节的 virtual offset
+
+private:
+    bool load_block(uint64_t coff);
+
+    FILE* fp_ = nullptr;
+    std::string path_;
+    std::string cbuf_;                    // 压缩块
+    std::string blk_;                     // 解压后
+    uint64_t coff_ = 0, next_coff_ = 0;
+    size_t pos_ = 0;
+};
+
+// =======================================================
+// [TABIX] 读 .tbi：区间 → 需要读取的 chunk（virtual offset 区间）
+// =======================================================
+
+class TabixReader {
+public:
+    explicit TabixReader(const std::string& tbi_path);
+
+    bool good() const { return err_.empty(); }
+    const std::string& error() const { return err_; }
+
+    int col_seq() const { return col_seq_; }      // 0-based
+    int col_pos() const { return col_pos_; }      // 0-based
+    int skip() const { return skip_; }
+    bool zero_based() const { return zero_based_; }
+    const std::vector<std::string>& names() const { return names_; }
+
+    // 精确匹配染色体名；不行再按 canonical 编号匹配（"chr1" 查 "1"）；无则 -1
+    int ref_id(std::string_view name) const;
+
+    // 与 [beg, end]（1-based，闭区间）重叠的 chunk：按文件顺序排好、合并
+    std::vector<std::pair<uint64_t, uint64_t>> chunks(int ref, int64_t beg, int64_t end) const;
+
+private:
+    struct Chunk { uint64_t beg, end; };
+    struct Ref {
+        std::map<uint32_t, std::vector<Chunk>> bins;
+        std::vector<uint64_t> linear;
+    };
+
+    int col_seq_ = 0, col_pos_ = 1, skip_ = 0;
+    bool zero_based_ = false;
+    std::vector<std::string> names_;
+    std::vector<Ref> refs_;
+    std::string err_;
+};
+
+#endif
@@ -0,0 +1,324 @@
+//
+//  dryrun.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/dryrun.hpp"
+#include "utils/linereader.hpp"
+#include "utils/gwasparts.hpp"
+#include "utils/memio.hpp"
+#include "utils/gwasQC.hpp"
+#include "utils/spill.hpp"
+#include "utils/util.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// 样本上限：行数或文本字节先到为止（gzip 输入一般 1~3 秒）
+static const size_t   DRY_SAMPLE_ROWS  = 200000;
+static const uint64_t DRY_SAMPLE_BYTES = 64ull << 20;
+
+// 进程本身（代码、stdio / 解压缓冲、线程栈）的粗略基线
+static const uint64_t DRY_BASELINE_BYTES = 16ull << 20;
+
+static const std::string DRY_PREFIX = "mem://dryrun/";
+
+static double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static std::string human_bytes(double b)
+{
+    const char* unit[] = {"B", "KB", "MB", "GB", "TB"};
+    int u = 0;
+    while (b >= 1024 && u < 4) { b /= 1024; ++u; }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), u == 0 ? "%.0f %s" : "%.1f %s", b, unit[u]);
+    return buf;
+}
+
+static std::string human_sec(double s)
+{
+    char buf[32];
+    if (s < 60)        std::snprintf(buf, sizeof(buf), "%.1f s", s);
+    else if (s < 3600) std::snprintf(buf, sizeof(buf), "%dm%02ds", (int)s / 60, (int)s % 60);
+    else               std::snprintf(buf, sizeof(buf), "%dh%02dm", (int)s / 3600, (int)s % 3600 / 60);
+    return buf;
+}
+
+static std::string human_count(double n)
+{
+    char buf[32];
+    if (n < 1e4)      std::snprintf(buf, sizeof(buf), "%.0f", n);
+    else if (n < 1e6) std::snprintf(buf, sizeof(buf), "%.1fK", n / 1e3);
+    else if (n < 1e9) std::snprintf(buf, sizeof(buf), "%.2fM", n / 1e6);
+    else              std::snprintf(buf, sizeof(buf), "%.2fG", n / 1e9);
+    return buf;
+}
+
+// =======================================================
+// InputSample
+// =======================================================
+double InputSample::scale() const
+{
+    if (complete || raw_bytes == 0 || file_bytes == 0) return 1.0;
+    return std::max(1.0, (double)file_bytes / (double)raw_bytes);
+}
+
+double InputSample::line_heap_per_row() const
+{
+    if (lines.empty()) return 0;
+    // glibc malloc：块 = max(32, 向上取整到 16 (len + 1 + 8))；<= 15 字节走 SSO
+    uint64_t sum = 0;
+    for (const auto& l : lines) {
+        if (l.size() <= 15) continue;
+        sum += std::max<uint64_t>(32, (l.size() + 1 + 8 + 15) & ~uint64_t(15));
+    }
+    return (double)sum / lines.size();
+}
+
+InputSample dry_sample(const std::string& path, bool has_header)
+{
+    require(path != "-" && !is_mem_path(path),
+            "--dry-run samples files on disk; cannot size " + (path == "-" ? std::string("stdin (-)") : path) + ".");
+
+    // 多文件模式：只采第一个文件，按全部文件的总字节外推
+    const std::vector<std::string> parts = gwas_input_parts(path);
+
+    InputSample S;
+    S.path = path;
+    struct stat st;
+    if (::stat(parts[0].c_str(), &st) == 0) S.file_bytes = (uint64_t)st.st_size;
+
+    auto t0 = std::chrono::steady_clock::now();
+    LineReader reader(parts[0]);
+    std::string line;
+    bool need_header = has_header;
+    S.complete = true;
+    while (S.lines.size() < DRY_SAMPLE_ROWS && S.text_bytes < DRY_SAMPLE_BYTES) {
+        if (!reader.getline(line)) break;
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (need_header) {
+            if (line.size() >= 2 && line[0] == '#' && line[1] == '#') { S.meta.push_back(line); continue; }
+            S.header = line;
+            need_header = false;
+            continue;
+        }
+        if (line.empty()) continue;
+        S.text_bytes += line.size() + 1;
+        S.lines.push_back(line);
+    }
+    if (S.lines.size() >= DRY_SAMPLE_ROWS || S.text_bytes >= DRY_SAMPLE_BYTES)
+        S.complete = !reader.getline(line);
+    S.raw_bytes = S.complete ? S.file_bytes : reader.raw_offset();
+    S.read_sec  = seconds_since(t0);
+
+    if (parts.size() > 1) {
+        for (size_t k = 1; k < parts.size(); ++k)
+            if (::stat(parts[k].c_str(), &st) == 0) S.file_bytes += (uint64_t)st.st_size;
+        S.complete = false;
+    }
+    return S;
+}
+
+// =======================================================
+// 试跑
+// =======================================================
+std::string dry_put(const std::string& name, const std::string& text)
+{
+    memio_put(DRY_PREFIX + name, text);
+    return DRY_PREFIX + name;
+}
+
+std::string dry_put(const std::string& name, const InputSample& S)
+{
+    std::string text;
+    text.reserve(S.text_bytes + S.header.size() + 1);
+    for (const auto& m : S.meta) { text += m; text += '\n'; }
+    if (!S.header.empty()) { text += S.header; text += '\n'; }
+    for (const auto& l : S.lines) { text += l; text += '\n'; }
+    return dry_put(name, text);
+}
+
+// 试跑输出目录（mkdtemp）；dry_trial 结束时连同内容删除
+static std::string g_dry_dir;
+
+static void dry_remove_dir()
+{
+    if (g_dry_dir.empty()) return;
+    if (DIR* d = ::opendir(g_dry_dir.c_str())) {
+        while (struct dirent* e = ::readdir(d)) {
+            std::string name = e->d_name;
+            if (name != "." && name != "..") std::remove((g_dry_dir + "/" + name).c_str());
+        }
+        ::closedir(d);
+    }
+    ::rmdir(g_dry_dir.c_str());
+    g_dry_dir.clear();
+}
+
+std::string dry_out_path(const CommonArgs& P, const std::string& out_file)
+{
+    if (g_dry_dir.empty()) {
+        std::string tmpl = spill_prefix(P.tmp_dir, out_file, "dryrun") + "XXXXXX";
+        if (!::mkdtemp(&tmpl[0])) {
+            LOG_ERROR("Cannot create a temporary directory for --dry-run: " + tmpl + " (see --tmp-dir)");
+            die(1);
+        }
+        g_dry_dir = tmpl;
+    }
+    return g_dry_dir + "/out" + std::string(compress_suffix(out_file));
+}
+
+double dry_trial(const std::function<void()>& run)
+{
+    static std::ostream null_out(nullptr);
+
+    std::ostream* console = g_console;
+    std::ostream* log     = g_log;
+    const uint64_t budget = mem_budget();
+    auto restore = [&] {
+        g_console = console;
+        g_log     = log;
+        mem_budget_set(budget);
+        memio_erase_prefix(DRY_PREFIX);
+        dry_remove_dir();
+    };
+
+    g_console = &null_out;
+    g_log     = nullptr;
+    mem_budget_set(0);
+
+    auto t0 = std::chrono::steady_clock::now();
+    try {
+        run();
+    } catch (...) {
+        restore();
+        throw;
+    }
+    double sec = seconds_since(t0);
+    restore();
+    return sec;
+}
+
+uint64_t dry_vector_capacity(uint64_t n, uint64_t reserved)
+{
+    uint64_t cap = std::max<uint64_t>(reserved, 1);
+    while (cap < n) cap <<= 1;
+    return cap;
+}
+
+// =======================================================
+// DryRunReport
+// =======================================================
+void DryRunReport::input(const std::string& what, const InputSample& S)
+{
+    std::string msg = "Dry run: " + what + " " + S.path + ": " + std::to_string(S.lines.size()) + " rows sampled";
+    if (S.complete) msg += " (whole file)";
+    else            msg += ", ~" + human_count(S.est_rows()) + " rows estimated";
+    if (S.raw_bytes > 0 && S.text_bytes > S.raw_bytes * 11 / 10) {
+        char ratio[32];
+        std::snprintf(ratio, sizeof(ratio), "%.1fx", (double)S.text_bytes / S.raw_bytes);
+        msg += ", compressed " + std::string(ratio);
+    }
+    msg += "; read " + human_bytes((double)S.raw_bytes) + " of " + human_bytes((double)S.file_bytes) +
+           " in " + human_sec(S.read_sec) + ".";
+    LOG_INFO(msg);
+}
+
+uint64_t DryRunReport::peak() const
+{
+    uint64_t sum = DRY_BASELINE_BYTES;
+    for (const auto& m : memory_) sum += m.second;
+    return sum;
+}
+
+double DryRunReport::total_sec() const
+{
+    double sum = 0;
+    for (const auto& s : stages_) sum += s.second;
+    return sum;
+}
+
+void DryRunReport::print() const
+{
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    auto row = [](const std::string& name, const std::string& val) {
+        std::string s = "  " + name;
+        if (s.size() < 44) s.resize(44, ' ');
+        return s + val;
+    };
+
+    LOG_INFO("Dry-run estimate for " + cmd_ + " (threads = " + std::to_string(threads) + "):");
+    LOG_INFO(row("rows", "~" + human_count(rows_)));
+    for (const auto& s : stages_) LOG_INFO(row("time   " + s.first, human_sec(s.second)));
+    LOG_INFO(row("time   total", human_sec(total_sec())));
+    LOG_INFO(row("memory process baseline", human_bytes((double)DRY_BASELINE_BYTES)));
+    for (const auto& m : memory_) LOG_INFO(row("memory " + m.first, human_bytes((double)m.second)));
+    LOG_INFO(row("memory peak", human_bytes((double)peak())));
+    for (const auto& n : notes_) LOG_INFO("  note: " + n);
+
+    char buf[160];
+    std::snprintf(buf, sizeof(buf), "DRYRUN rows=%.0f seconds=%.0f peak_bytes=%llu peak_mb=%llu",
+                  rows_, total_sec(), (unsigned long long)peak(),
+                  (unsigned long long)((peak() + (1u << 20) - 1) >> 20));
+    LOG_INFO(buf);
+}
+
+// =======================================================
+// GWAS 单表命令
+// =======================================================
+void dry_run_table_impl(const CommonArgs& P, const std::string& cmd,
+                        const std::function<void(const std::string& in, const std::string& out)>& trial)
+{
+    DryRunReport R(cmd);
+    InputSample S = dry_sample(P.gwas_file);
+    R.input("GWAS", S);
+
+    const std::string in  = dry_put("gwas", S);
+    const std::string out = dry_out_path(P, P.out_file);
+    const double t = dry_trial([&] { trial(in, out); });
+
+    const double k    = S.scale();
+    const double rows = S.est_rows();
+    R.rows(rows);
+
+    R.stage("read + decompress", S.read_sec * k);
+    R.stage("QC, format, write", t * k);
+
+    // read_gwas_table：vector<string> reserve(1 << 20) 后逐行 push_back
+    const uint64_t lines = (uint64_t)(rows * S.line_heap_per_row()) +
+                           dry_vector_capacity((uint64_t)rows, 1 << 20) * sizeof(std::string);
+    R.memory("GWAS lines", lines);
+    R.memory("QC keep mask", (uint64_t)rows / 8 + 1);
+
+    uint64_t dedup = 0;
+    if (P.remove_dup_snp) {
+        dedup = (uint64_t)(rows * (sizeof(std::string) + GWAS_DUP_ENTRY_BYTES));
+        R.memory("duplicate-SNP table", dedup);
+    }
+
+    if (P.memory_limit > 0) {
+        if (lines > P.memory_limit)
+            R.note("the GWAS table alone exceeds --memory-limit; only rsidImpu can spill it to disk.");
+        else if (dedup > P.memory_limit - lines)
+            R.note("--remove-dup-snp will run in hash partitions to stay within --memory-limit.");
+    }
+    R.print();
+}
@@ -0,0 +1,108 @@
+//
+//  dryrun.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_DRYRUN_HPP
+#define TOOLKIT_DRYRUN_HPP
+
+#include "utils/args.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// =======================================================
+// [DRYRUN] --dry-run：只读 header + 前若干行，外推全文件的行数 / 分阶段耗时 / 峰值内存
+//   InputSample ：样本行 + 消耗的原始（压缩）字节；压缩比 = 文本字节 / 原始字节，
+//                 总行数 = 样本行数 × 文件大小 / 原始字节
+//   dry_trial   ：样本放进 mem://，静默跑一遍真实命令（同样的 QC / 去重 / 格式化 / 压缩 / 落盘），
+//                 耗时按行数线性外推
+//   内存按命令实际持有的结构估算（行字符串、GWASRecord、去重 hash 表 ...），由各命令填入报告
+// =======================================================
+
+struct InputSample {
+    std::string path;
+    std::string header;                  // 第一条非 "##" 行（无 header 的 .bim 为空）
+    std::vector<std::string> meta;       // header 之前的 "##" 行
+    std::vector<std::string> lines;      // 样本数据行（去掉空行与 '\r'）
+
+    uint64_t file_bytes = 0;             // 文件大小
+    uint64_t raw_bytes  = 0;             // 样本消耗的原始字节
+    uint64_t text_bytes = 0;             // 样本解压后的字节（含换行）
+    bool complete = false;               // 样本已覆盖整个文件
+    double read_sec = 0;                 // 读样本的耗时
+
+    double scale() const;                // 全文件 / 样本（complete 时为 1）
+    double est_rows() const { return lines.size() * scale(); }
+
+    // 每行 std::string 的平均堆块字节（按 malloc 16 字节对齐；短串 SSO 为 0；对象本身另计）
+    double line_heap_per_row() const;
+};
+
+// has_header = false：.bim 之类没有 header 的表
+InputSample dry_sample(const std::string& path, bool has_header = true);
+
+// 把 text 放进 mem://dryrun/<name>，返回路径
+std::string dry_put(const std::string& name, const InputSample& S);
+std::string dry_put(const std::string& name, const std::string& text);
+
+// 静默（INFO/WARN 不输出，ERROR 照常）、不受 --memory-limit 约束地运行 run，返回秒数；
+// 结束后清空 mem://dryrun/ 与试跑输出目录
+double dry_trial(const std::function<void()>& run);
+
+// 试跑输出：--tmp-dir（默认 out_file 所在目录）下临时目录里的 out + 同压缩后缀，
+// BGZF / zstd 压缩与落盘都计入耗时
+std::string dry_out_path(const CommonArgs& P, const std::string& out_file);
+
+// vector 逐个 push_back 时的容量（reserve 起点之后按 2 倍增长）
+uint64_t dry_vector_capacity(uint64_t n, uint64_t reserved = 0);
+
+class DryRunReport {
+public:
+    explicit DryRunReport(std::string cmd) : cmd_(std::move(cmd)) {}
+
+    void input(const std::string& what, const InputSample& S);    // 立即打印样本与外推行数
+    void rows(double n) { rows_ = n; }                             // 汇总里报告的（GWAS）总行数
+    void stage(const std::string& name, double sec) { stages_.emplace_back(name, sec); }
+    void memory(const std::string& name, uint64_t bytes) { memory_.emplace_back(name, bytes); }
+    void note(const std::string& msg) { notes_.push_back(msg); }
+
+    uint64_t peak() const;
+    double total_sec() const;
+
+    // 分阶段表 + 一行 key=value 汇总（便于脚本生成作业资源请求）
+    void print() const;
+
+private:
+    std::string cmd_;
+    double rows_ = 0;
+    std::vector<std::pair<std::string,double>> stages_;
+    std::vector<std::pair<std::string,uint64_t>> memory_;
+    std::vector<std::string> notes_;
+};
+
+// GWAS 单表命令（convert / or2beta / computeNeff / pipeline）：行存储 + keep + 去重表；
+// run(Q) 以 Q.gwas_file / Q.out_file 指向 mem:// 的参数跑真实命令
+void dry_run_table_impl(const CommonArgs& P, const std::string& cmd,
+                        const std::function<void(const std::string& in, const std::string& out)>& trial);
+
+template <class Args, class Run>
+void dry_run_table(const Args& P, const std::string& cmd, Run run)
+{
+    dry_run_table_impl(P, cmd, [&](const std::string& in, const std::string& out) {
+        Args Q = P;
+        Q.gwas_file = in;
+        Q.out_file  = out;
+        Q.dry_run   = false;
+        Q.cache_dir.clear();
+        Q.build_index = false;
+        run(Q);
+    });
+}
+
+#endif
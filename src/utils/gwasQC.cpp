@@ -8,6 +8,7 @@
 #include "utils/gwasQC.hpp"
 #include "utils/util.hpp"
 #include "utils/log.hpp"
+#include "utils/spill.hpp"
 
 #include <algorithm>
 #include <cmath>
@@ -99,6 +100,65 @@ static inline int scan_to_stop_col(
 // [MOD] Internal templated impl: support deque<string> and vector<string>
 // =======================================================
 
+// =======================================================
+// [QC-LINE] 单行 QC：gwas_basic_qc 与流式处理共用同一套规则
+// =======================================================
+GwasLineQC::GwasLineQC(int idx_beta, int idx_se, int idx_freq, int idx_p, int idx_n,
+                       double maf_threshold)
+    : idx_beta_(idx_beta), idx_se_(idx_se), idx_freq_(idx_freq),
+      idx_p_(idx_p), idx_n_(idx_n), maf_(maf_threshold)
+{
+    // 预计算 stop_col + col2slot，避免每行 split
+    if (idx_beta >= 0) stop_ = std::max(stop_, idx_beta);
+    if (idx_se   >= 0) stop_ = std::max(stop_, idx_se);
+    if (idx_freq >= 0) stop_ = std::max(stop_, idx_freq);
+    if (idx_p    >= 0) stop_ = std::max(stop_, idx_p);
+    if (idx_n    >= 0) stop_ = std::max(stop_, idx_n);
+
+    if (stop_ < 0) return;
+
+    // slot: 0=beta,1=se,2=freq,3=p,4=n
+    col2slot_.assign(stop_ + 1, -1);
+    if (idx_beta >= 0) col2slot_[idx_beta] = 0;
+    if (idx_se   >= 0) col2slot_[idx_se]   = 1;
+    if (idx_freq >= 0) col2slot_[idx_freq] = 2;
+    if (idx_p    >= 0) col2slot_[idx_p]    = 3;
+    if (idx_n    >= 0) col2slot_[idx_n]    = 4;
+}
+
+bool GwasLineQC::pass(std::string_view lv) const
+{
+    if (stop_ < 0) return true;
+
+    std::string_view outs[5] = {};
+    int cols = scan_to_stop_col(lv, stop_, col2slot_, outs, 5);
+
+    // [FIX-1] 行列不足（等价于旧 split 后 idx 越界）：QC fail
+    if (cols < stop_ + 1) return false;
+
+    return pass_fields(outs);
+}
+
+bool GwasLineQC::pass_fields(const std::string_view* f) const
+{
+    double v_beta=0, v_se=0, v_freq=0, v_p=0, v_n=0;
+
+    // [OPT-5] 列不存在(idx<0) → 忽略；列存在 → 严格解析数值
+    if (idx_beta_ >= 0 && !parse_double_strict(f[0], v_beta)) return false;
+    if (idx_se_   >= 0 && !parse_double_strict(f[1], v_se))   return false;
+    if (idx_freq_ >= 0 && !parse_double_strict(f[2], v_freq)) return false;
+    if (idx_p_    >= 0 && !parse_double_strict(f[3], v_p))    return false;
+    if (idx_n_    >= 0 && !parse_double_strict(f[4], v_n))    return false;
+
+    // p ∈ [0,1]
+    if (idx_p_ >= 0 && (v_p < 0.0 || v_p > 1.0)) return false;
+
+    // MAF: freq ∈ [maf, 1-maf]
+    if (idx_freq_ >= 0 && (v_freq < maf_ || v_freq > (1.0 - maf_))) return false;
+
+    return true;
+}
+
 template <class LinesT>
 static void gwas_basic_qc_impl(
     LinesT &lines,
@@ -116,82 +176,54 @@ static void gwas_basic_qc_impl(
     const size_t n = lines.size();
     size_t kept = 0, dropped = 0;
 
-    // 预计算 stop_col + col2slot，避免每行 split
-    int stop = -1;
-    if (idx_beta >= 0) stop = std::max(stop, idx_beta);
-    if (idx_se   >= 0) stop = std::max(stop, idx_se);
-    if (idx_freq >= 0) stop = std::max(stop, idx_freq);
-    if (idx_p    >= 0) stop = std::max(stop, idx_p);
-    if (idx_n    >= 0) stop = std::max(stop, idx_n);
+    GwasLineQC qc(idx_beta, idx_se, idx_freq, idx_p, idx_n, maf_threshold);
 
     // 没有任何可 QC 的列：保持 keep 不变，只统计
-    if (stop < 0){
+    if (!qc.active()){
         for (size_t i=0;i<n;++i) if (keep[i]) kept++;
         LOG_INFO("Basic QC done: " + std::to_string(kept) + " passed, 0 removed.");
         return;
     }
 
-    // slot: 0=beta,1=se,2=freq,3=p,4=n
-    std::vector<int> col2slot(stop + 1, -1);
-    if (idx_beta >= 0) col2slot[idx_beta] = 0;
-    if (idx_se   >= 0) col2slot[idx_se]   = 1;
-    if (idx_freq >= 0) col2slot[idx_freq] = 2;
-    if (idx_p    >= 0) col2slot[idx_p]    = 3;
-    if (idx_n    >= 0) col2slot[idx_n]    = 4;
-
-
     for (size_t i = 0; i < n; i ++) {
         if (!keep[i]) continue;
 
         // 不再拷贝 ln，不再 erase/remove('\r')：直接 string_view + trim
-        std::string_view lv(lines[i]);
-
-        std::string_view outs[5] = {};
-        int cols = scan_to_stop_col(lv, stop, col2slot, outs, 5);
-
-        // [FIX-1] 行列不足（等价于旧 split 后 idx 越界）：QC fail
-        if (cols < stop + 1) {
-            keep[i] = false;
-            dropped++;
-            continue;
-        }
-
-        bool qc_fail = false;
-        double v_beta=0, v_se=0, v_freq=0, v_p=0, v_n=0;
-
-        // [OPT-5] 列不存在(idx<0) → 忽略；列存在 → 严格解析数值
-        if (idx_beta >= 0 && !parse_double_strict(outs[0], v_beta)) qc_fail = true;
-        if (idx_se   >= 0 && !parse_double_strict(outs[1], v_se))   qc_fail = true;
-        if (idx_freq >= 0 && !parse_double_strict(outs[2], v_freq)) qc_fail = true;
-        if (idx_p    >= 0 && !parse_double_strict(outs[3], v_p))    qc_fail = true;
-        if (idx_n    >= 0 && !parse_double_strict(outs[4], v_n))    qc_fail = true;
-
-        if (qc_fail){
+        if (!qc.pass(std::string_view(lines[i]))) {
             keep[i] = false;
             dropped++;
             continue;
         }
-
-        // p ∈ [0,1]
-        if (idx_p >= 0) {
-            if (v_p < 0.0 || v_p > 1.0){
-                keep[i] = false; dropped++; continue;
-            }
-        }
-
-        // MAF: freq ∈ [maf, 1-maf]
-        if (idx_freq >= 0) {
-            if (v_freq < maf_threshold || v_freq > (1.0 - maf_threshold)) {
-                keep[i] = false; dropped++; continue;
-            }
-        }
-
         kept++;
     }
 
     LOG_INFO("Basic QC done: " + std::to_string(kept) + " passed, " + std::to_string(dropped) + " removed.");
 }
 
+// 去重用的 P 值：列不足 / 非数值 / 非有限 → false（该行在去重时删除）
+bool gwas_dup_pvalue(std::string_view line, int idx_p, double& p)
+{
+    // [OPT-7] remove_dup 只需要扫描到 P 列
+    size_t start = 0;
+    for (int c = 0; c < idx_p; ++c) {
+        size_t t = line.find('\t', start);
+        if (t == std::string_view::npos) return false;
+        start = t + 1;
+    }
+    size_t end = line.find('\t', start);
+    if (end == std::string_view::npos) end = line.size();
+    if (!parse_double_strict(line.substr(start, end - start), p)) return false;
+    return std::isfinite(p);
+}
+
+// 分片号：取 hash 高位，避免与 unordered_map 的桶下标（低位取模）相关
+static inline unsigned dup_part(std::string_view snp, unsigned K)
+{
+    if (K == 1) return 0;
+    uint64_t h = std::hash<std::string_view>{}(snp) * 0x9E3779B97F4A7C15ull;
+    return (unsigned)((h >> 32) % K);
+}
+
 template <class LinesT>
 static void gwas_remove_dup_impl(
     LinesT &lines,
@@ -205,96 +237,91 @@ static void gwas_remove_dup_impl(
     const size_t n = lines.size();
     size_t dropped = 0;
 
-    // [FIX-2] idx_p < 0：旧实现会访问 f[-1] 崩溃；这里改为“保留首次出现，后续重复删掉”
-    if (idx_p < 0){
-        struct SVHash { size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); } };
-        struct SVEq   { bool   operator()(std::string_view a, std::string_view b) const noexcept { return a==b; } };
-
-        std::unordered_map<std::string_view, size_t, SVHash, SVEq> seen;
-
-        // [OPT-6] reserve 减少 rehash
-        size_t active = 0;
-        for (size_t i=0;i<n;++i) if (keep[i] && !rsid_vec[i].empty()) ++active;
-        seen.reserve(active * 2 + 1);
-
-        for (size_t i=0;i<n;++i){
-            if (!keep[i]) continue;
-            if (rsid_vec[i].empty()) continue;
-
-            std::string_view snp(rsid_vec[i]);
-            auto [it, inserted] = seen.emplace(snp, i);
-            if (!inserted){
-                keep[i] = false;
-                dropped++;
-            }
-        }
-
-        LOG_INFO("Duplicate SNPs removal done (no P column). Removed = " + std::to_string(dropped));
-        return;
-    }
-
-    // idx_p >= 0：按最小 p 保留
     struct SVHash { size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view>{}(s); } };
     struct SVEq   { bool   operator()(std::string_view a, std::string_view b) const noexcept { return a==b; } };
 
-    std::unordered_map<std::string_view, std::pair<double, size_t>, SVHash, SVEq> best;
-
-    // [OPT-6] reserve：避免频繁 rehash（大量 SNP 时非常重要）
     size_t active = 0;
     for (size_t i=0;i<n;++i) if (keep[i] && !rsid_vec[i].empty()) ++active;
-    best.reserve(active * 2 + 1);
-
-    // [OPT-7] remove_dup 只需要扫描 P 列
-    int stop = idx_p;
-    std::vector<int> col2slot(stop + 1, -1);
-    col2slot[idx_p] = 0;
-
-    for (size_t i=0; i<n; i++){
-        if (!keep[i]) continue;
-        if (rsid_vec[i].empty()) continue;
-
-        std::string_view lv(lines[i]);
 
-        std::string_view outs[1] = {};
-        int cols = scan_to_stop_col(lv, stop, col2slot, outs, 1);
-
-        if (cols < stop + 1){
-            keep[i] = false;
-            dropped++;
+    // [SPILL] hash 表超出 --memory-limit 余量（扣除已驻留的行）：按 SNP 哈希分 K 片，每片扫一遍
+    // 片间键不相交，片内仍按行序处理 → 与一次完成的结果完全相同
+    const uint64_t need = (uint64_t)active * GWAS_DUP_ENTRY_BYTES;
+    uint64_t avail = mem_available();
+    if (mem_budget() > 0) {
+        uint64_t resident = 0;
+        for (size_t i=0;i<n;++i) resident += lines[i].size() + sizeof(std::string) * 2;
+        avail = avail > resident ? avail - resident : 0;
+    }
+    avail = std::max<uint64_t>(avail, 16ull << 20);
+    const unsigned K = need <= avail ? 1u : (unsigned)std::min<uint64_t>((need + avail - 1) / avail, 1024);
+    if (K > 1)
+        LOG_INFO("Duplicate SNPs removal in " + std::to_string(K) + " hash partitions (--memory-limit).");
+    MemCharge charge(need / K);
+
+    for (unsigned part = 0; part < K; ++part) {
+
+        // [FIX-2] idx_p < 0：旧实现会访问 f[-1] 崩溃；这里改为“保留首次出现，后续重复删掉”
+        if (idx_p < 0){
+            std::unordered_map<std::string_view, size_t, SVHash, SVEq> seen;
+
+            // [OPT-6] reserve 减少 rehash
+            seen.reserve(active / K * 2 + 1);
+
+            for (size_t i=0;i<n;++i){
+                if (!keep[i]) continue;
+                if (rsid_vec[i].empty()) continue;
+
+                std::string_view snp(rsid_vec[i]);
+                if (dup_part(snp, K) != part) continue;
+                auto [it, inserted] = seen.emplace(snp, i);
+                if (!inserted){
+                    keep[i] = false;
+                    dropped++;
+                }
+            }
             continue;
         }
 
-        double p = 0.0;
-        if (!parse_double_strict(outs[0], p)){
-            keep[i] = false;
-            dropped++;
-            continue;
-        }
+        // idx_p >= 0：按最小 p 保留
+        std::unordered_map<std::string_view, std::pair<double, size_t>, SVHash, SVEq> best;
 
-        if (!std::isfinite(p)){
-            keep[i] = false;
-            dropped++;
-            continue;
-        }
+        // [OPT-6] reserve：避免频繁 rehash（大量 SNP 时非常重要）
+        best.reserve(active / K * 2 + 1);
 
-        std::string_view snp(rsid_vec[i]);
+        for (size_t i=0; i<n; i++){
+            if (!keep[i]) continue;
+            if (rsid_vec[i].empty()) continue;
 
-        // [OPT-8] 单次查找/插入：避免 best.count + best[snp] 双重哈希
-        auto [it, inserted] = best.emplace(snp, std::make_pair(p, i));
-        if (inserted) continue;
+            std::string_view snp(rsid_vec[i]);
+            if (dup_part(snp, K) != part) continue;
 
-        auto &old = it->second;
-        if (p < old.first) {
-            keep[old.second] = false;
-            old = {p, i};
-            dropped++;
-        } else {
-            keep[i] = false;
-            dropped++;
+            double p = 0.0;
+            if (!gwas_dup_pvalue(std::string_view(lines[i]), idx_p, p)){
+                keep[i] = false;
+                dropped++;
+                continue;
+            }
+
+            // [OPT-8] 单次查找/插入：避免 best.count + best[snp] 双重哈希
+            auto [it, inserted] = best.emplace(snp, std::make_pair(p, i));
+            if (inserted) continue;
+
+            auto &old = it->second;
+            if (p < old.first) {
+                keep[old.second] = false;
+                old = {p, i};
+                dropped++;
+            } else {
+                keep[i] = false;
+                dropped++;
+            }
         }
     }
 
-    LOG_INFO("Duplicate SNPs removal done. Removed = " + std::to_string(dropped));
+    if (idx_p < 0)
+        LOG_INFO("Duplicate SNPs removal done (no P column). Removed = " + std::to_string(dropped));
+    else
+        LOG_INFO("Duplicate SNPs removal done. Removed = " + std::to_string(dropped));
 }
 
 // =======================================================
@@ -10,7 +10,9 @@
 
 #include "utils/util.hpp"
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <deque>
 #include <vector>
 
@@ -21,6 +23,33 @@
 // - freq must pass maf threshold if provided
 // =======================================================
 
+// ---------------------------
+// [QC-LINE] 单行 QC（流式处理逐行调用；规则与 gwas_basic_qc 完全一致）
+// ---------------------------
+class GwasLineQC {
+public:
+    GwasLineQC(int idx_beta, int idx_se, int idx_freq, int idx_p, int idx_n,
+               double maf_threshold);
+
+    bool active() const { return stop_ >= 0; }  // 没有可 QC 的列时恒通过
+    bool pass(std::string_view line) const;
+
+    // 字段已切好时直接 QC：f[0..4] = beta,se,freq,p,n（构造时 idx<0 的字段忽略）
+    bool pass_fields(const std::string_view* f) const;
+
+private:
+    int idx_beta_, idx_se_, idx_freq_, idx_p_, idx_n_;
+    double maf_;
+    int stop_ = -1;
+    std::vector<int> col2slot_;
+};
+
+// [SPILL] 去重 hash 表每个键的估算字节（节点 + 桶 + reserve 余量）；--memory-limit / --dry-run 共用
+constexpr uint64_t GWAS_DUP_ENTRY_BYTES = 96;
+
+// 去重时使用的 P 值（规则同 gwas_remove_dup）：列不足 / 非数值 / 非有限 → false，该行删除
+bool gwas_dup_pvalue(std::string_view line, int idx_p, double& p);
+
 // ---------------------------
 // [API] deque<string> versions (backward compatible)
 // ---------------------------
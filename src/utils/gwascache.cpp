@@ -0,0 +1,294 @@
+//
+//  gwascache.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/gwascache.hpp"
+#include "utils/gwasQC.hpp"
+#include "utils/gwasparts.hpp"
+#include "utils/linereader.hpp"
+#include "utils/mmapfile.hpp"
+#include "utils/parallel.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// =======================================================
+// 文件指纹
+// =======================================================
+struct FileStamp {
+    string   path;      // 绝对路径
+    uint64_t size  = 0;
+    int64_t  mtime = 0; // ns
+};
+
+static bool stamp_file(const string& file, FileStamp& fs)
+{
+    if (file == "-") return false;   // stdin：无 size/mtime，不缓存
+    struct stat sb;
+    if (stat(file.c_str(), &sb) != 0 || !S_ISREG(sb.st_mode)) return false;
+
+    char buf[PATH_MAX];
+    fs.path  = realpath(file.c_str(), buf) ? string(buf) : file;
+    fs.size  = (uint64_t)sb.st_size;
+    fs.mtime = (int64_t)sb.st_mtim.tv_sec * 1000000000LL + sb.st_mtim.tv_nsec;
+    return true;
+}
+
+// FNV-1a 64
+static inline uint64_t fnv1a(const void* p, size_t n, uint64_t h = 1469598103934665603ULL)
+{
+    const unsigned char* s = static_cast<const unsigned char*>(p);
+    for (size_t i = 0; i < n; ++i) { h ^= s[i]; h *= 1099511628211ULL; }
+    return h;
+}
+
+static string hex64(uint64_t v)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)v);
+    return buf;
+}
+
+static string cache_base(const string& cache_dir, const FileStamp& fs)
+{
+    uint64_t h = fnv1a(fs.path.data(), fs.path.size());
+    h = fnv1a(&fs.size,  sizeof(fs.size),  h);
+    h = fnv1a(&fs.mtime, sizeof(fs.mtime), h);
+    return cache_dir + "/" + hex64(h);
+}
+
+static bool ensure_dir(const string& dir)
+{
+    struct stat sb;
+    if (stat(dir.c_str(), &sb) == 0) return S_ISDIR(sb.st_mode);
+    return mkdir(dir.c_str(), 0755) == 0;
+}
+
+// 先写临时文件再 rename：并发运行 / 中途被杀都不会留下半个快照
+template <class F>
+static void write_atomic(const string& path, F&& body)
+{
+    string tmp = path + ".tmp." + to_string((long)getpid());
+    {
+        ofstream ofs(tmp, ios::binary);
+        if (!ofs) {
+            LOG_WARN("Cannot write cache file: " + tmp);
+            return;
+        }
+        body(ofs);
+        if (!ofs) {
+            ofs.close();
+            std::remove(tmp.c_str());
+            LOG_WARN("Error writing cache file: " + tmp);
+            return;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        LOG_WARN("Cannot move cache file into place: " + path);
+    }
+}
+
+static inline void put_u64(ofstream& o, uint64_t v) { o.write(reinterpret_cast<const char*>(&v), 8); }
+static inline void put_str(ofstream& o, const string& s) { put_u64(o, s.size()); o.write(s.data(), s.size()); }
+
+// 顺序读 mmap 区域；越界即判为损坏
+struct ByteCursor {
+    const char* p;
+    const char* end;
+
+    bool get_u64(uint64_t& v) {
+        if ((size_t)(end - p) < 8) return false;
+        memcpy(&v, p, 8); p += 8;
+        return true;
+    }
+    bool get_str(string& s) {
+        uint64_t n = 0;
+        if (!get_u64(n) || (uint64_t)(end - p) < n) return false;
+        s.assign(p, n); p += n;
+        return true;
+    }
+};
+
+static inline void strip_cr_inplace(string& s)
+{
+    if (!s.empty() && s.back() == '\r') { s.pop_back(); return; }
+    s.erase(std::remove(s.begin(), s.end(), '\r'), s.end());
+}
+
+static const char GTC_MAGIC[8] = {'G','T','K','G','W','C','0','1'};
+static const char QC_MAGIC[8]  = {'G','T','K','G','Q','C','0','1'};
+
+// =======================================================
+// 快照：header + 数据行
+// 布局：MAGIC | size | mtime | path | header | n | off[n+1] | blob
+// =======================================================
+static bool load_snapshot(const string& snap, const FileStamp& fs,
+                          string& header_line, vector<string>& lines)
+{
+    struct stat sb;
+    if (stat(snap.c_str(), &sb) != 0) return false;
+
+    MappedFile mf(snap);
+    ByteCursor cur{mf.data(), mf.data() + mf.size()};
+
+    uint64_t size = 0, mtime = 0, n = 0;
+    string path;
+    if (mf.size() < 8 || memcmp(mf.data(), GTC_MAGIC, 8) != 0) return false;
+    cur.p += 8;
+    if (!cur.get_u64(size) || !cur.get_u64(mtime) || !cur.get_str(path)) return false;
+    if (size != fs.size || (int64_t)mtime != fs.mtime || path != fs.path) return false;
+    if (!cur.get_str(header_line) || !cur.get_u64(n)) return false;
+
+    if ((uint64_t)(cur.end - cur.p) / 8 < n + 1) return false;
+    const char* offp = cur.p;
+    const char* blob = cur.p + (n + 1) * 8;
+    uint64_t blob_len = (uint64_t)(cur.end - blob);
+
+    vector<uint64_t> off(n + 1);
+    memcpy(off.data(), offp, (n + 1) * 8);
+    if (off[n] != blob_len) return false;
+
+    lines.clear();
+    lines.resize(n);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < (size_t)n; ++i) {
+        lines[i].assign(blob + off[i], off[i+1] - off[i]);
+    }
+    return true;
+}
+
+static void save_snapshot(const string& snap, const FileStamp& fs,
+                          const string& header_line, const vector<string>& lines)
+{
+    write_atomic(snap, [&](ofstream& o){
+        o.write(GTC_MAGIC, 8);
+        put_u64(o, fs.size);
+        put_u64(o, (uint64_t)fs.mtime);
+        put_str(o, fs.path);
+        put_str(o, header_line);
+        put_u64(o, lines.size());
+
+        uint64_t off = 0;
+        put_u64(o, off);
+        for (const auto& l : lines) { off += l.size(); put_u64(o, off); }
+        for (const auto& l : lines) o.write(l.data(), l.size());
+    });
+}
+
+bool read_gwas_table(
+    const string& gwas_file,
+    const string& cache_dir,
+    string& header_line,
+    vector<string>& lines
+){
+    IoSlot io;                           // --batch --io-jobs：读完即交出读盘轮次，下一个文件开始读
+    if (is_gwas_pattern(gwas_file)) {
+        // 多文件输入不做快照（键是单个文件的 stat）
+        if (!cache_dir.empty()) LOG_INFO("--cache-dir is skipped for a multi-file --gwas-summary.");
+        return read_gwas_parts(gwas_input_parts(gwas_file), header_line, lines);
+    }
+
+    FileStamp fs;
+    bool use_cache = !cache_dir.empty() && stamp_file(gwas_file, fs);
+    string snap;
+
+    if (use_cache) {
+        if (!ensure_dir(cache_dir)) {
+            LOG_WARN("Cannot create --cache-dir " + cache_dir + "; reading without cache.");
+            use_cache = false;
+        } else {
+            snap = cache_base(cache_dir, fs) + ".gtc";
+            if (load_snapshot(snap, fs, header_line, lines)) {
+                LOG_INFO("Loaded GWAS from cache: " + snap);
+                return true;
+            }
+        }
+    }
+
+    LineReader reader(gwas_file);
+    string line;
+    if (!reader.getline(line)) return false;
+    strip_cr_inplace(line);
+    header_line = line;
+
+    lines.clear();
+    lines.reserve(1 << 20);
+    while (reader.getline(line)) {
+        if (line.empty()) continue;
+        strip_cr_inplace(line);
+        lines.push_back(line);
+    }
+
+    if (use_cache) {
+        save_snapshot(snap, fs, header_line, lines);
+        LOG_INFO("GWAS cached to " + snap);
+    }
+    return true;
+}
+
+// =======================================================
+// QC 结果：MAGIC | n | keep[n]（uint8）
+// =======================================================
+void gwas_basic_qc_cached(
+    const string& gwas_file,
+    const string& cache_dir,
+    vector<string>& lines,
+    const vector<string>& header,
+    int idx_beta, int idx_se, int idx_freq, int idx_p, int idx_n,
+    vector<bool>& keep,
+    double maf_threshold
+){
+    FileStamp fs;
+    if (cache_dir.empty() || !stamp_file(gwas_file, fs) || !ensure_dir(cache_dir)) {
+        gwas_basic_qc(lines, header, idx_beta, idx_se, idx_freq, idx_p, idx_n, keep, maf_threshold);
+        return;
+    }
+
+    int32_t map[5] = {idx_beta, idx_se, idx_freq, idx_p, idx_n};
+    uint64_t mh = fnv1a(map, sizeof(map));
+    mh = fnv1a(&maf_threshold, sizeof(maf_threshold), mh);
+    string qc_path = cache_base(cache_dir, fs) + ".qc-" + hex64(mh);
+
+    const size_t n = lines.size();
+    struct stat sb;
+    if (stat(qc_path.c_str(), &sb) == 0 && (uint64_t)sb.st_size == 16 + n) {
+        MappedFile mf(qc_path);
+        uint64_t m = 0;
+        memcpy(&m, mf.data() + 8, 8);
+        if (memcmp(mf.data(), QC_MAGIC, 8) == 0 && m == n) {
+            const unsigned char* k = reinterpret_cast<const unsigned char*>(mf.data() + 16);
+            size_t kept = 0;
+            for (size_t i = 0; i < n; ++i) { keep[i] = keep[i] && (k[i] != 0); kept += keep[i]; }
+            LOG_INFO("QC result loaded from cache: " + to_string(kept) + " / " + to_string(n) + " kept.");
+            return;
+        }
+    }
+
+    // keep 已被行过滤（--extract / --region）预置：QC 只跑了部分行，不写缓存
+    bool prefiltered = std::find(keep.begin(), keep.end(), false) != keep.end();
+
+    gwas_basic_qc(lines, header, idx_beta, idx_se, idx_freq, idx_p, idx_n, keep, maf_threshold);
+    if (prefiltered) return;
+
+    write_atomic(qc_path, [&](ofstream& o){
+        o.write(QC_MAGIC, 8);
+        put_u64(o, n);
+        vector<char> k(n);
+        for (size_t i = 0; i < n; ++i) k[i] = keep[i] ? 1 : 0;
+        o.write(k.data(), n);
+    });
+}
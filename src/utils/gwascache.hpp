@@ -0,0 +1,46 @@
+//
+//  gwascache.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_GWASCACHE_HPP
+#define TOOLKIT_GWASCACHE_HPP
+
+#include <string>
+#include <vector>
+
+// =======================================================
+// [CACHE] --cache-dir：已解析 GWAS 的二进制快照
+//   键 = (绝对路径, 文件大小, mtime)；源文件一变即失效
+//   <key>.gtc        header + 数据行（已去 '\r'、跳过空行），mmap 后直接还原，
+//                    不再经过 LineReader / gzip 解压
+//   <key>.qc-<map>   基础 QC 结果（每行 1 字节），<map> = QC 列映射 + maf
+// cache_dir 为空时两者都退化为原来的读取 / QC 流程
+// =======================================================
+
+// 读取 GWAS header 行与全部数据行；文件为空（无 header）返回 false
+bool read_gwas_table(
+    const std::string& gwas_file,
+    const std::string& cache_dir,
+    std::string& header_line,
+    std::vector<std::string>& lines
+);
+
+// 带缓存的 gwas_basic_qc（参数含义与 gwas_basic_qc 相同；keep 预置 false 的行（行过滤）跳过且不写缓存）
+void gwas_basic_qc_cached(
+    const std::string& gwas_file,
+    const std::string& cache_dir,
+    std::vector<std::string>& lines,
+    const std::vector<std::string>& header,
+    int idx_beta,
+    int idx_se,
+    int idx_freq,
+    int idx_p,
+    int idx_n,
+    std::vector<bool>& keep,
+    double maf_threshold
+);
+
+#endif
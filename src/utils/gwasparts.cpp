@@ -0,0 +1,266 @@
+//
+//  gwasparts.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/gwasparts.hpp"
+#include "utils/parallel.hpp"
+#include "utils/memio.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+
+#include <glob.h>
+#include <unistd.h>
+
+static inline void strip_cr_inplace(std::string& s)
+{
+    if (!s.empty() && s.back() == '\r') s.pop_back();
+}
+
+// =======================================================
+// 模式展开
+// =======================================================
+static bool has_brace_group(const std::string& s)
+{
+    size_t lb = s.find('{');
+    while (lb != std::string::npos) {
+        size_t rb = s.find('}', lb);
+        if (rb == std::string::npos) return false;
+        std::string body = s.substr(lb + 1, rb - lb - 1);
+        if (body.find(',') != std::string::npos || body.find("..") != std::string::npos) return true;
+        lb = s.find('{', rb);
+    }
+    return false;
+}
+
+static bool has_glob_chars(const std::string& s)
+{
+    return s.find_first_of("*?[") != std::string::npos;
+}
+
+bool is_gwas_pattern(const std::string& path)
+{
+    if (path.empty() || path == "-" || is_mem_path(path)) return false;
+    if (!has_glob_chars(path) && !has_brace_group(path)) return false;
+    return ::access(path.c_str(), F_OK) != 0;          // 真有这个文件名就按普通文件读
+}
+
+static bool parse_int(const std::string& s, long& v)
+{
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+// 依次展开第一个 {a..b} / {x,y,...}（不支持嵌套），其余部分递归
+static void expand_braces(const std::string& s, std::vector<std::string>& out)
+{
+    size_t lb = s.find('{');
+    size_t rb = lb == std::string::npos ? std::string::npos : s.find('}', lb);
+    if (rb == std::string::npos) { out.push_back(s); return; }
+
+    const std::string pre  = s.substr(0, lb);
+    const std::string body = s.substr(lb + 1, rb - lb - 1);
+    const std::string post = s.substr(rb + 1);
+
+    std::vector<std::string> items;
+    size_t dots = body.find("..");
+    long a = 0, b = 0;
+    if (body.find(',') != std::string::npos) {
+        size_t start = 0;
+        while (start <= body.size()) {
+            size_t comma = body.find(',', start);
+            if (comma == std::string::npos) comma = body.size();
+            items.push_back(body.substr(start, comma - start));
+            start = comma + 1;
+        }
+    } else if (dots != std::string::npos &&
+               parse_int(body.substr(0, dots), a) && parse_int(body.substr(dots + 2), b)) {
+        // {01..22}：任一端带前导 0 时按较长一端的宽度补零
+        const std::string lo = body.substr(0, dots), hi = body.substr(dots + 2);
+        size_t width = 0;
+        if ((lo.size() > 1 && lo[0] == '0') || (hi.size() > 1 && hi[0] == '0'))
+            width = std::max(lo.size(), hi.size());
+        const long step = a <= b ? 1 : -1;
+        for (long v = a; ; v += step) {
+            std::string x = std::to_string(v);
+            if (x.size() < width) x.insert(0, width - x.size(), '0');
+            items.push_back(x);
+            if (v == b) break;
+        }
+    } else {
+        // 不是展开式的花括号：原样保留，只展开后面的部分
+        std::vector<std::string> tails;
+        expand_braces(post, tails);
+        for (const auto& t : tails) out.push_back(pre + "{" + body + "}" + t);
+        return;
+    }
+
+    for (const auto& it : items) expand_braces(pre + it + post, out);
+}
+
+// 自然序：数字段按数值比较（chr2 < chr10），其余逐字符
+static bool natural_less(const std::string& x, const std::string& y)
+{
+    size_t i = 0, j = 0;
+    while (i < x.size() && j < y.size()) {
+        if (std::isdigit((unsigned char)x[i]) && std::isdigit((unsigned char)y[j])) {
+            size_t i1 = i, j1 = j;
+            while (i1 < x.size() && std::isdigit((unsigned char)x[i1])) ++i1;
+            while (j1 < y.size() && std::isdigit((unsigned char)y[j1])) ++j1;
+            size_t zi = i, zj = j;                      // 去掉前导 0 后比位数、再逐位
+            while (zi + 1 < i1 && x[zi] == '0') ++zi;
+            while (zj + 1 < j1 && y[zj] == '0') ++zj;
+            if (i1 - zi != j1 - zj) return i1 - zi < j1 - zj;
+            int c = x.compare(zi, i1 - zi, y, zj, j1 - zj);
+            if (c != 0) return c < 0;
+            i = i1;
+            j = j1;
+            continue;
+        }
+        if (x[i] != y[j]) return (unsigned char)x[i] < (unsigned char)y[j];
+        ++i;
+        ++j;
+    }
+    return x.size() - i < y.size() - j;
+}
+
+std::vector<std::string> gwas_input_parts(const std::string& path)
+{
+    if (!is_gwas_pattern(path)) return {path};
+
+    std::vector<std::string> words, parts;
+    expand_braces(path, words);
+    for (const auto& w : words) {
+        if (!has_glob_chars(w)) {
+            if (::access(w.c_str(), R_OK) != 0) {
+                LOG_ERROR("GWAS file not found: " + w + " (from --gwas-summary " + path + ")");
+                die(1);
+            }
+            parts.push_back(w);
+            continue;
+        }
+        glob_t g;
+        int rc = ::glob(w.c_str(), 0, nullptr, &g);
+        if (rc != 0) {
+            if (rc != GLOB_NOMATCH) globfree(&g);
+            LOG_ERROR("No files match " + w + " (from --gwas-summary " + path + ")");
+            die(1);
+        }
+        std::vector<std::string> m(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+        globfree(&g);
+        std::sort(m.begin(), m.end(), natural_less);
+        parts.insert(parts.end(), m.begin(), m.end());
+    }
+
+    // 同一文件被两个模式选中只读一次
+    std::vector<std::string> uniq;
+    for (const auto& p : parts)
+        if (std::find(uniq.begin(), uniq.end(), p) == uniq.end()) uniq.push_back(p);
+    return uniq;
+}
+
+// =======================================================
+// 整表并发读取
+// =======================================================
+bool read_gwas_parts(const std::vector<std::string>& parts,
+                     std::string& header_line, std::vector<std::string>& lines)
+{
+    const size_t n = parts.size();
+    std::vector<std::string> headers(n);
+    std::vector<uint8_t> has_header(n, 0);
+    std::vector<std::vector<std::string>> chunk(n);
+
+    par_for(n, [&](size_t k) {
+        LineReader reader(parts[k]);
+        std::string line;
+        if (!reader.getline(line)) return;
+        strip_cr_inplace(line);
+        headers[k] = line;
+        has_header[k] = 1;
+        while (reader.getline(line)) {
+            if (line.empty()) continue;
+            strip_cr_inplace(line);
+            chunk[k].push_back(line);
+        }
+    });
+
+    if (!has_header[0]) return false;
+    for (size_t k = 1; k < n; ++k) {
+        if (!has_header[k]) {
+            LOG_ERROR("Empty GWAS file: " + parts[k]);
+            die(1);
+        }
+        if (headers[k] != headers[0]) {
+            LOG_ERROR("Header of " + parts[k] + " differs from " + parts[0] +
+                      "; the files of one --gwas-summary pattern must share the same columns.");
+            die(1);
+        }
+    }
+
+    size_t total = 0;
+    for (const auto& c : chunk) total += c.size();
+    header_line = headers[0];
+    lines.clear();
+    lines.reserve(total);
+    for (auto& c : chunk) {
+        for (auto& l : c) lines.push_back(std::move(l));
+        std::vector<std::string>().swap(c);
+    }
+    LOG_INFO("Read " + std::to_string(n) + " GWAS files concurrently (" + parts.front() + " ... " +
+             parts.back() + "): " + std::to_string(total) + " data lines.");
+    return true;
+}
+
+// =======================================================
+// GwasPartsReader
+// =======================================================
+GwasPartsReader::GwasPartsReader(const std::string& path)
+    : parts_(gwas_input_parts(path))
+{
+    open_next();
+}
+
+bool GwasPartsReader::open_next()
+{
+    cur_.reset();
+    if (next_ == parts_.size()) return false;
+    cur_.reset(new LineReader(parts_[next_++]));
+    at_start_ = true;
+    return true;
+}
+
+bool GwasPartsReader::getline(std::string& line)
+{
+    while (cur_) {
+        if (!cur_->getline(line)) {
+            if (at_start_ && next_ > 1) {
+                LOG_ERROR("Empty GWAS file: " + parts_[next_ - 1]);
+                die(1);
+            }
+            if (at_start_) return false;             // 第一个文件为空：与单文件一致，由调用方报错
+            open_next();
+            continue;
+        }
+        if (!at_start_) return true;
+
+        at_start_ = false;
+        std::string h = line;
+        strip_cr_inplace(h);
+        if (next_ == 1) {
+            header_ = h;
+            return true;
+        }
+        if (h != header_) {
+            LOG_ERROR("Header of " + parts_[next_ - 1] + " differs from " + parts_[0] +
+                      "; the files of one --gwas-summary pattern must share the same columns.");
+            die(1);
+        }
+    }
+    return false;
+}
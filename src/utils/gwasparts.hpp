@@ -0,0 +1,53 @@
+//
+//  gwasparts.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_GWASPARTS_HPP
+#define TOOLKIT_GWASPARTS_HPP
+
+#include "utils/linereader.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// =======================================================
+// [PARTS] --gwas-summary 给通配 / 花括号模式：按染色体拆开的文件当作一个输入
+//   trait.chr{1..22}.txt.gz   花括号：a..b 数字区间（{01..22} 补零）或逗号列表，按书写顺序
+//   trait.chr*.txt.gz         glob（* ? [...]），按自然序（chr2 < chr10 < chrX）
+//   各文件 header 必须逐字相同；数据行按上面的文件顺序拼接
+//   read_gwas_parts ：整表读入时各文件并发读取 + 解压（par_for）
+//   GwasPartsReader ：流式路径（rsidImpu --gwas-sorted / --memory-limit、sort）顺序读
+// =======================================================
+
+// 含 * ? [ 或 {..}/{,} 且不是已存在的文件名
+bool is_gwas_pattern(const std::string& path);
+
+// 展开为文件列表；无匹配 / 文件不存在 → LOG_ERROR + die。非模式原样返回 {path}
+std::vector<std::string> gwas_input_parts(const std::string& path);
+
+// 并发读取各文件：header_line 为共同的 header，lines 为拼接后的数据行（跳过空行、去 '\r'）
+// 第一个文件为空返回 false；其余文件 header 不一致或为空 → LOG_ERROR + die
+bool read_gwas_parts(const std::vector<std::string>& parts,
+                     std::string& header_line, std::vector<std::string>& lines);
+
+// 与 LineReader 相同的逐行接口：第一行是 header，之后各文件的 header 校验后跳过
+class GwasPartsReader {
+public:
+    explicit GwasPartsReader(const std::string& path);
+    bool getline(std::string& line);
+
+private:
+    bool open_next();
+
+    std::vector<std::string> parts_;
+    size_t next_ = 0;
+    std::unique_ptr<LineReader> cur_;
+    std::string header_;
+    bool at_start_ = true;               // 下一行是当前文件的 header
+};
+
+#endif
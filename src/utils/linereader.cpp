@@ -6,21 +6,256 @@
 //
 
 #include "linereader.hpp"
+#include "utils/arrowipc.hpp"
+#include "utils/memio.hpp"
 #include <zlib.h>
 #include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
 
 using namespace std;
 
+enum class Codec { PLAIN, GZ, ZST, ARROW };
+
+static Codec sniff_codec(const unsigned char* p, size_t n)
+{
+    if (n >= 2 && p[0] == 0x1f && p[1] == 0x8b) return Codec::GZ;
+    if (n >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd) return Codec::ZST;
+    // Arrow IPC file（"ARROW1"）或 IPC stream（continuation 0xFFFFFFFF）
+    if (n >= 6 && memcmp(p, "ARROW1", 6) == 0) return Codec::ARROW;
+    if (n >= 4 && p[0] == 0xff && p[1] == 0xff && p[2] == 0xff && p[3] == 0xff) return Codec::ARROW;
+    return Codec::PLAIN;
+}
+
+// [STREAM-IN] FILE* 上的分块解码：原始字节 → out 窗口，getline 在窗口里找 '\n'。
+// 用于 stdin（不能 seek 回去重新 gzopen）、zstd 与 Arrow IPC 文件
+struct LineReader::StreamIn {
+    FILE* fp = nullptr;
+    bool own = false;
+    Codec codec = Codec::PLAIN;
+
+    vector<char> in;
+    size_t in_pos = 0, in_len = 0;
+    bool eof = false;
+    uint64_t raw_read = 0;       // 累计 fread 的原始字节
+
+    vector<char> out;
+    size_t beg = 0, end = 0;     // out 中未消费区间 [beg,end)
+
+    z_stream zs{};
+    bool zs_init = false;
+
+    ArrowIpcDecoder* arrow = nullptr;           // Arrow：逐批还原成 tab 文本放进 pending
+    std::string pending;
+    size_t pending_pos = 0;
+#ifdef USE_ZSTD
+    ZSTD_DStream* ds = nullptr;
+#endif
+
+    StreamIn(FILE* f, bool own_fp, const string& name) : fp(f), own(own_fp) {
+        in.resize(1 << 17);
+        out.resize(1 << 19);
+        read_more();
+        codec = sniff_codec((const unsigned char*)in.data(), in_len);
+
+        if (codec == Codec::GZ) {
+            // 15+32：自动识别 gzip/zlib 头；多 member（bgzip）在 Z_STREAM_END 后 reset
+            if (inflateInit2(&zs, 15 + 32) != Z_OK) throw runtime_error("zlib init failed: " + name);
+            zs_init = true;
+        } else if (codec == Codec::ZST) {
+#ifdef USE_ZSTD
+            ds = ZSTD_createDStream();
+            ZSTD_initDStream(ds);
+#else
+            throw runtime_error("Cannot read " + name + ": zstd input, but built without zstd support (rebuild with make USE_ZSTD=1)");
+#endif
+        } else if (codec == Codec::ARROW) {
+            arrow = new ArrowIpcDecoder([this](void* dst, size_t n) { return read_exact(dst, n); });
+        }
+    }
+    ~StreamIn() {
+        delete arrow;
+        if (zs_init) inflateEnd(&zs);
+#ifdef USE_ZSTD
+        if (ds) ZSTD_freeDStream(ds);
+#endif
+        if (own && fp) fclose(fp);
+    }
+
+    bool read_more() {
+        if (eof) return false;
+        in_len = fread(in.data(), 1, in.size(), fp);
+        in_pos = 0;
+        raw_read += in_len;
+        if (in_len == 0) { eof = true; return false; }
+        return true;
+    }
+
+    // 原始字节精确读 n 个（Arrow 按消息长度取）
+    bool read_exact(void* dst, size_t n) {
+        char* d = (char*)dst;
+        while (n > 0) {
+            if (in_pos == in_len && !read_more()) return false;
+            size_t k = std::min(n, in_len - in_pos);
+            memcpy(d, in.data() + in_pos, k);
+            in_pos += k; d += k; n -= k;
+        }
+        return true;
+    }
+
+    size_t decode_arrow(char* dst, size_t cap) {
+        while (pending_pos == pending.size()) {
+            pending.clear();
+            pending_pos = 0;
+            if (!arrow->next_chunk(pending)) return 0;
+        }
+        size_t k = std::min(cap, pending.size() - pending_pos);
+        memcpy(dst, pending.data() + pending_pos, k);
+        pending_pos += k;
+        return k;
+    }
+
+    // 把 in[in_pos..] 解码进 dst，返回产出字节数（0 = 需要更多输入）
+    size_t decode(char* dst, size_t cap) {
+        if (codec == Codec::PLAIN) {
+            size_t k = std::min(cap, in_len - in_pos);
+            memcpy(dst, in.data() + in_pos, k);
+            in_pos += k;
+            return k;
+        }
+        if (codec == Codec::GZ) {
+            zs.next_in   = (Bytef*)in.data() + in_pos;
+            zs.avail_in  = (uInt)(in_len - in_pos);
+            zs.next_out  = (Bytef*)dst;
+            zs.avail_out = (uInt)cap;
+            int r = inflate(&zs, Z_NO_FLUSH);
+            in_pos = in_len - zs.avail_in;
+            size_t made = cap - zs.avail_out;
+            if (r == Z_STREAM_END) inflateReset(&zs);
+            else if (r != Z_OK && r != Z_BUF_ERROR)
+                throw runtime_error(string("gzip decompression error: ") + (zs.msg ? zs.msg : "corrupt input"));
+            return made;
+        }
+#ifdef USE_ZSTD
+        ZSTD_inBuffer  ib{in.data(), in_len, in_pos};
+        ZSTD_outBuffer ob{dst, cap, 0};
+        size_t r = ZSTD_decompressStream(ds, &ob, &ib);
+        if (ZSTD_isError(r))
+            throw runtime_error(string("zstd decompression error: ") + ZSTD_getErrorName(r));
+        in_pos = ib.pos;
+        return ob.pos;
+#else
+        return 0;
+#endif
+    }
+
+    // 往 out 尾部再解码一段；没有更多数据返回 false
+    bool fill() {
+        if (beg > 0) {                           // 未消费部分挪到头部
+            memmove(out.data(), out.data() + beg, end - beg);
+            end -= beg;
+            beg = 0;
+        }
+        if (end == out.size()) out.resize(out.size() * 2);   // 超长行
+
+        if (codec == Codec::ARROW) {
+            size_t made = decode_arrow(out.data() + end, out.size() - end);
+            end += made;
+            return made > 0;
+        }
+
+        while (true) {
+            if (in_pos == in_len && !read_more()) return false;
+            size_t made = decode(out.data() + end, out.size() - end);
+            end += made;
+            if (made > 0) return true;
+        }
+    }
+
+    bool getline(string& line) {
+        size_t scan = beg;
+        while (true) {
+            const char* p = (const char*)memchr(out.data() + scan, '\n', end - scan);
+            if (p) {
+                size_t nl = (size_t)(p - out.data());
+                line.assign(out.data() + beg, nl - beg);
+                beg = nl + 1;
+                break;
+            }
+            size_t done = end - beg;             // 已扫描过的长度（fill 会把 beg 挪到 0）
+            if (!fill()) {
+                if (beg == end) return false;    // 文件尾且无残行
+                line.assign(out.data() + beg, end - beg);
+                beg = end;
+                break;
+            }
+            scan = beg + done;
+        }
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+};
+
 LineReader::LineReader(const string &filename){
     fname = filename;
     gz = false;
     gzfp = nullptr;
     fin = nullptr;
 
-    if (ends_with(fname, ".gz")){
+    if (fname == "-") {
+        sin = new StreamIn(stdin, false, "stdin");
+        return;
+    }
+    if (is_mem_path(fname)) {                    // libgwastoolkit 的内存输入
+        FILE* fp = memio_open_read(fname);
+        if (!fp) throw runtime_error("Cannot open file: " + fname);
+        sin = new StreamIn(fp, true, fname);
+        return;
+    }
+
+    // 先看 magic bytes。只有普通文件可以读完文件头再重新打开；
+    // FIFO / <(...) 进程替换 / 字符设备读过的字节拿不回来 → 单次打开走 StreamIn，在其缓冲里识别
+    Codec codec = Codec::PLAIN;
+    {
+        FILE* fp = fopen(fname.c_str(), "rb");
+        if (!fp) throw runtime_error("Cannot open file: " + fname);
+        struct stat st;
+        if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode)) {
+            try {
+                sin = new StreamIn(fp, true, fname);
+            } catch (...) {
+                fclose(fp);
+                throw;
+            }
+            return;
+        }
+        unsigned char head[8] = {0};
+        size_t k = fread(head, 1, 8, fp);
+        fclose(fp);
+        codec = sniff_codec(head, k);
+    }
+
+    if (codec == Codec::GZ){
         gz = true;
         gzfp = gzopen(fname.c_str(), "rb");
         if (!gzfp) throw runtime_error("Cannot open gz file: " + fname);
+    } else if (codec == Codec::ZST || codec == Codec::ARROW){
+        FILE* fp = fopen(fname.c_str(), "rb");
+        if (!fp) throw runtime_error("Cannot open file: " + fname);
+        try {
+            sin = new StreamIn(fp, true, fname);
+        } catch (...) {
+            fclose(fp);
+            throw;
+        }
     } else {
         fin = new ifstream(fname);
         if (!fin->good()){
@@ -34,6 +269,8 @@ LineReader::LineReader(const string &filename){
 LineReader::~LineReader(){
     if (gz) {
         if (gzfp) gzclose((gzFile)gzfp);
+    } else if (sin) {
+        delete sin;
     } else {
         if (fin) {
             fin->close();
@@ -53,10 +290,33 @@ bool LineReader::getline(string &line){
             line.pop_back();
         return true;
     }
+    if (sin) return sin->getline(line);
     return (bool)std::getline(*fin, line);
 }
 
+uint64_t LineReader::raw_offset(){
+    if (gz) {
+        z_off_t off = gzoffset((gzFile)gzfp);
+        return off > 0 ? (uint64_t)off : 0;
+    }
+    if (sin) return sin->raw_read - (sin->in_len - sin->in_pos);
+    std::streampos off = fin->tellg();
+    return off > 0 ? (uint64_t)off : 0;
+}
+
+bool LineReader::is_plain_file(const string &filename){
+    if (filename == "-") return false;
+    struct stat st;                              // 只认普通文件：FIFO 不能 mmap，也不能先读文件头
+    if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    FILE* fp = fopen(filename.c_str(), "rb");
+    if (!fp) return false;
+    unsigned char head[8] = {0};
+    size_t k = fread(head, 1, 8, fp);
+    fclose(fp);
+    return sniff_codec(head, k) == Codec::PLAIN;
+}
+
 bool LineReader::ends_with(const string &s, const string &suffix){
     if (s.size() < suffix.size()) return false;
     return equal(suffix.rbegin(), suffix.rend(), s.rbegin());
-}
\ No newline at end of file
+}
@@ -9,6 +9,16 @@
 #define RSIDIMPU_LINEREADER_HPP
 
 #include <string>
+#include <fstream>
+#include <cstdint>
+
+// 输入编码按文件头 magic bytes 判断（不看后缀）：
+//   1f 8b       → gzip（zlib gzgets）
+//   28 b5 2f fd → zstd 流式解压（需 make USE_ZSTD=1）
+//   "ARROW1"    → Arrow IPC / Feather v2，逐批还原为 tab 分隔文本（首行为列名）
+//   其他        → ifstream
+// 文件名为 "-" 或非普通文件（FIFO、<(...)）时只打开一次，在读入缓冲里按 magic 识别 gzip / zstd / 纯文本
+// 文件名为 "mem://NAME" 时读进程内缓冲（见 memio.hpp）
 
 class LineReader {
 public:
@@ -16,12 +26,22 @@ public:
     ~LineReader();
     bool getline(std::string &line);
 
+    // 已消耗的原始（压缩）字节数：gzip 为 gzoffset，其余为已读且已解码的输入位置
+    // （--dry-run 据此和文件大小外推总行数）
+    uint64_t raw_offset();
+
+    // 未压缩的普通文件（可 mmap）：S_ISREG（非 "-"、非 FIFO），且文件头不是 gzip / zstd / arrow magic
+    static bool is_plain_file(const std::string& filename);
+
 private:
     std::string fname;
     bool gz;
     void* gzfp;
     std::ifstream* fin;
 
+    struct StreamIn;            // 只在 linereader.cpp 里定义，头文件不依赖 zstd.h
+    StreamIn* sin = nullptr;
+
     static bool ends_with(const std::string&, const std::string&);
 };
 
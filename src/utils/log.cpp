@@ -8,11 +8,27 @@
 
 #include "utils/log.hpp"
 
+#include <cstdlib>
+
 // log 文件指针（默认无）
 std::ostream* g_log = nullptr;
 
 // 终端输出开关
 bool g_log_to_console = true;
 
+// INFO/WARN 的终端流（stdout 承载数据时改为 stderr）
+std::ostream* g_console = &std::cout;
+
 // 日志互斥锁
-std::mutex g_log_mutex;
\ No newline at end of file
+std::mutex g_log_mutex;
+
+// 最近一条错误信息
+thread_local std::string g_last_error;
+
+// 致命错误是否抛异常（仅 libgwastoolkit 打开）
+bool g_exit_throws = false;
+
+void die(int code){
+    if (g_exit_throws) throw GwasExit{code};
+    std::exit(code);
+}
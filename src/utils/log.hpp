@@ -16,14 +16,22 @@
 
 extern std::ostream* g_log;    // 只有在 main.cpp 定义一次
 extern bool g_log_to_console;  // 终端输出开关（默认开启）
+extern std::ostream* g_console; // INFO/WARN 终端流：默认 stdout；--out - 时切到 stderr
 extern std::mutex g_log_mutex; // 为防止多线程乱序打印，用 mutex
+extern thread_local std::string g_last_error; // 本线程最近一条 LOG_ERROR（gt_last_error / serve 的 ERR 回复）
+
+// 致命错误退出：可执行文件里即 exit(code)；libgwastoolkit 置 g_exit_throws 后
+// 改为抛 GwasExit，由 C API 边界捕获并转成返回码（不能让宿主进程退出）
+extern bool g_exit_throws;
+struct GwasExit { int code; };
+[[noreturn]] void die(int code = 1);
 
 // ------------ logging functions ------------
 inline void LOG_INFO(const std::string &msg){
     std::lock_guard<std::mutex> lock(g_log_mutex);
 
     if (g_log_to_console)
-        std::cout << "[INFO] " << msg << std::endl;
+        (*g_console) << "[INFO] " << msg << std::endl;
 
     if (g_log) {
         (*g_log) << "[INFO] " << msg << '\n';
@@ -34,7 +42,7 @@ inline void LOG_WARN(const std::string &msg) {
     std::lock_guard<std::mutex> lock(g_log_mutex);
 
     if (g_log_to_console)
-        std::cout << "[WARN] " << msg << std::endl;
+        (*g_console) << "[WARN] " << msg << std::endl;
 
     if (g_log){
         (*g_log) << "[WARN] " << msg << '\n';
@@ -44,6 +52,7 @@ inline void LOG_WARN(const std::string &msg) {
 inline void LOG_ERROR(const std::string &msg) {
     std::lock_guard<std::mutex> lock(g_log_mutex);
 
+    g_last_error = msg;
     if (g_log_to_console)
         std::cerr << "[ERROR] " << msg << std::endl;
         
@@ -0,0 +1,63 @@
+//
+//  memio.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/memio.hpp"
+
+#include <map>
+#include <mutex>
+
+// std::map 节点地址稳定：Writer 持有的 string* 在其他路径插入/删除后仍有效
+static std::map<std::string, std::string> g_mem;
+static std::mutex g_mem_mutex;
+
+bool is_mem_path(const std::string& path){
+    return path.rfind("mem://", 0) == 0;
+}
+
+void memio_put(const std::string& path, std::string data){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    g_mem[path] = std::move(data);
+}
+
+FILE* memio_open_read(const std::string& path){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    auto it = g_mem.find(path);
+    if (it == g_mem.end()) return nullptr;
+    std::string& s = it->second;
+    if (s.empty()) return fopen("/dev/null", "rb");   // fmemopen 不接受长度 0
+    return fmemopen(&s[0], s.size(), "r");
+}
+
+std::string* memio_open_write(const std::string& path){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    std::string& s = g_mem[path];
+    s.clear();
+    return &s;
+}
+
+bool memio_take(const std::string& path, std::string& data){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    auto it = g_mem.find(path);
+    if (it == g_mem.end()) return false;
+    data = std::move(it->second);
+    g_mem.erase(it);
+    return true;
+}
+
+std::vector<std::string> memio_list(const std::string& prefix){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    std::vector<std::string> out;
+    for (auto it = g_mem.lower_bound(prefix); it != g_mem.end() && it->first.rfind(prefix, 0) == 0; ++it)
+        out.push_back(it->first);
+    return out;
+}
+
+void memio_erase_prefix(const std::string& prefix){
+    std::lock_guard<std::mutex> lock(g_mem_mutex);
+    auto it = g_mem.lower_bound(prefix);
+    while (it != g_mem.end() && it->first.rfind(prefix, 0) == 0) it = g_mem.erase(it);
+}
@@ -0,0 +1,33 @@
+//
+//  memio.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_MEMIO_HPP
+#define TOOLKIT_MEMIO_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// =======================================================
+// [MEMIO] "mem://NAME" 路径：进程内的内存文件（libgwastoolkit 用）
+//   输入：memio_put 放入字节，LineReader 经 fmemopen 读取（同样按 magic 识别 gz/zst/arrow）
+//   输出：Writer 打开时建立（或清空）同名缓冲，sink 直接 append
+// 子命令只看到路径，读写流程与磁盘文件完全一致
+// =======================================================
+
+bool is_mem_path(const std::string& path);
+
+void memio_put(const std::string& path, std::string data);
+FILE* memio_open_read(const std::string& path);        // 不存在返回 nullptr
+std::string* memio_open_write(const std::string& path);
+
+// 取出并删除；prefix 下的所有路径（按名字排序）
+bool memio_take(const std::string& path, std::string& data);
+std::vector<std::string> memio_list(const std::string& prefix);
+void memio_erase_prefix(const std::string& prefix);
+
+#endif
@@ -0,0 +1,46 @@
+//
+//  mmapfile.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/mmapfile.hpp"
+
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+MappedFile::MappedFile(const string &filename)
+{
+    fd_ = ::open(filename.c_str(), O_RDONLY);
+    if (fd_ < 0) throw runtime_error("Cannot open file: " + filename);
+
+    struct stat sb;
+    if (fstat(fd_, &sb) != 0) {
+        ::close(fd_);
+        throw runtime_error("Cannot stat file: " + filename);
+    }
+    size_ = (size_t)sb.st_size;
+    if (size_ == 0) return;   // 空文件：data() == nullptr
+
+    void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (p == MAP_FAILED) {
+        ::close(fd_);
+        throw runtime_error("Cannot mmap file: " + filename);
+    }
+    data_ = static_cast<const char*>(p);
+
+    // 顺序扫描为主：提示内核加大预读
+    madvise(p, size_, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_) munmap((void*)data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+}
@@ -0,0 +1,34 @@
+//
+//  mmapfile.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_MMAPFILE_HPP
+#define TOOLKIT_MMAPFILE_HPP
+
+#include <string>
+#include <cstddef>
+
+// 只读 mmap 整个文件（用于未压缩大文件的随机访问 / 分段并行扫描）
+// 打开失败抛 runtime_error（与 LineReader 一致）
+
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    int fd_ = -1;
+};
+
+#endif
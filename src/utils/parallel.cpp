@@ -0,0 +1,36 @@
+//
+//  parallel.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/parallel.hpp"
+
+static thread_local IoTurn* t_turn = nullptr;
+
+IoTurn::IoTurn(std::function<void()> next)
+    : next_(std::move(next)), prev_(t_turn)
+{
+    t_turn = this;
+}
+
+IoTurn::~IoTurn()
+{
+    hand_over();
+    t_turn = prev_;
+}
+
+// 先清空再回调：回调创建的 task 若当场在本线程执行，看到的轮次已交出
+void IoTurn::hand_over()
+{
+    if (!next_) return;
+    std::function<void()> f = std::move(next_);
+    next_ = nullptr;
+    f();
+}
+
+void IoTurn::release()
+{
+    if (t_turn) t_turn->hand_over();
+}
@@ -0,0 +1,86 @@
+//
+//  parallel.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_PARALLEL_HPP
+#define TOOLKIT_PARALLEL_HPP
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// =======================================================
+// [PARALLEL] 共享线程池上的调度部件
+//   par_for ：body(0..n-1) 动态调度、互不依赖。
+//             不在并行区内 → parallel for schedule(dynamic, 1)；
+//             已在并行区内（--batch 的文件 task、convert / pipeline 的多格式写出循环）
+//             → taskloop：块作为 task 进入当前线程池，空闲线程随时取走。
+//             （嵌套 parallel 在默认 max-active-levels = 1 下只会串行执行）
+//             body 抛出的异常（die → GwasExit）在循环结束后重新抛出
+//   IoTurn  ：--batch --io-jobs 的读盘"轮次"。batch 只为持有轮次的文件创建 task；
+//             文件读完（IoSlot 析构）或 task 结束时交出轮次，回调再创建下一个文件的 task。
+//             排队的文件不占线程，也没有线程在锁上等：空闲线程始终能去取运行中文件的块
+//   IoSlot  ：标记读盘 / 解压阶段（读表函数内），析构时交出当前线程上的轮次；不在 --batch 下无作用
+// =======================================================
+
+template <class F>
+void par_for(size_t n, const F& body)
+{
+    std::exception_ptr err;
+    std::mutex m;
+    auto guarded = [&](size_t i) {
+        try { body(i); }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(m);
+            if (!err) err = std::current_exception();
+        }
+    };
+
+#ifdef _OPENMP
+    if (n > 1 && omp_in_parallel()) {
+        #pragma omp taskloop grainsize(1)
+        for (size_t i = 0; i < n; ++i) guarded(i);
+    } else {
+        #pragma omp parallel for schedule(dynamic, 1) if(n > 1)
+        for (size_t i = 0; i < n; ++i) guarded(i);
+    }
+#else
+    for (size_t i = 0; i < n; ++i) guarded(i);
+#endif
+    if (err) std::rethrow_exception(err);
+}
+
+// 在文件 task 内构造：当前线程持有该轮次（task 是 tied 的，读表与构造在同一线程）
+class IoTurn {
+public:
+    explicit IoTurn(std::function<void()> next);
+    ~IoTurn();                           // 尚未交出则在此交出
+    IoTurn(const IoTurn&) = delete;
+    IoTurn& operator=(const IoTurn&) = delete;
+
+    static void release();               // 交出当前线程上的轮次（没有则不做）
+
+private:
+    void hand_over();
+
+    std::function<void()> next_;
+    IoTurn* prev_;
+};
+
+class IoSlot {
+public:
+    IoSlot() = default;
+    ~IoSlot() { IoTurn::release(); }
+    IoSlot(const IoSlot&) = delete;
+    IoSlot& operator=(const IoSlot&) = delete;
+};
+
+#endif
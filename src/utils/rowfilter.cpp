@@ -0,0 +1,301 @@
+//
+//  rowfilter.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/rowfilter.hpp"
+#include "utils/linereader.hpp"
+#include "utils/util.hpp"
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <functional>
+
+// =======================================================
+// SNP 列表：扁平 hash set
+//   arena_ 连续存放所有 ID，ids_ 记 (offset, len)，slots_ 存 ids_ 下标 + 1（0 = 空）
+//   容量为 2 的幂，负载 ≤ 0.5，线性探测；查询零分配
+// =======================================================
+class FlatSnpSet {
+public:
+    void insert(std::string_view id)
+    {
+        if (id.empty()) return;
+        if ((ids_.size() + 1) * 2 > slots_.size()) grow();
+        size_t h = std::hash<std::string_view>{}(id) & mask_;
+        while (slots_[h]) {
+            if (at(slots_[h] - 1) == id) return;
+            h = (h + 1) & mask_;
+        }
+        ids_.push_back({(uint64_t)arena_.size(), (uint32_t)id.size()});
+        arena_.append(id.data(), id.size());
+        slots_[h] = (uint32_t)ids_.size();
+    }
+
+    bool contains(std::string_view id) const
+    {
+        if (slots_.empty()) return false;
+        size_t h = std::hash<std::string_view>{}(id) & mask_;
+        while (slots_[h]) {
+            if (at(slots_[h] - 1) == id) return true;
+            h = (h + 1) & mask_;
+        }
+        return false;
+    }
+
+    size_t size() const { return ids_.size(); }
+
+private:
+    struct Id { uint64_t off; uint32_t len; };
+
+    std::string_view at(uint32_t k) const { return std::string_view(arena_.data() + ids_[k].off, ids_[k].len); }
+
+    void grow()
+    {
+        size_t cap = slots_.empty() ? 1024 : slots_.size() * 2;
+        slots_.assign(cap, 0);
+        mask_ = cap - 1;
+        for (uint32_t k = 0; k < ids_.size(); ++k) {
+            size_t h = std::hash<std::string_view>{}(at(k)) & mask_;
+            while (slots_[h]) h = (h + 1) & mask_;
+            slots_[h] = k + 1;
+        }
+    }
+
+    std::string arena_;
+    std::vector<Id> ids_;
+    std::vector<uint32_t> slots_;
+    size_t mask_ = 0;
+};
+
+struct RowFilter::Lists {
+    bool has_extract = false, has_exclude = false, has_region = false;
+    FlatSnpSet extract, exclude;
+
+    // chr code (1..25) → 排序、合并后的 1-based 闭区间 [beg, end]
+    std::vector<std::vector<std::pair<int64_t,int64_t>>> iv;
+
+    bool in_region(int chr, int64_t pos) const
+    {
+        if (chr < 0 || chr >= (int)iv.size()) return false;
+        const auto& v = iv[chr];
+        auto it = std::upper_bound(v.begin(), v.end(), pos,
+                                   [](int64_t p, const std::pair<int64_t,int64_t>& r){ return p < r.first; });
+        return it != v.begin() && std::prev(it)->second >= pos;
+    }
+};
+
+// =======================================================
+// 解析工具
+// =======================================================
+static inline std::string_view trim_ws(std::string_view s)
+{
+    while (!s.empty() && (s.front()==' ' || s.front()=='\t' || s.front()=='\r')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() ==' ' || s.back() =='\t' || s.back() =='\r')) s.remove_suffix(1);
+    return s;
+}
+
+static inline bool parse_i64(std::string_view s, int64_t& v)
+{
+    s = trim_ws(s);
+    auto r = std::from_chars(s.data(), s.data() + s.size(), v);
+    return !s.empty() && r.ec == std::errc() && r.ptr == s.data() + s.size();
+}
+
+// 空白分隔的第 k 个字段（0-based）
+static bool ws_field(std::string_view line, int k, std::string_view& out)
+{
+    size_t i = 0;
+    for (int f = 0; ; ++f) {
+        while (i < line.size() && (line[i]==' ' || line[i]=='\t' || line[i]=='\r')) ++i;
+        if (i == line.size()) return false;
+        size_t j = i;
+        while (j < line.size() && line[j]!=' ' && line[j]!='\t' && line[j]!='\r') ++j;
+        if (f == k) { out = line.substr(i, j - i); return true; }
+        i = j;
+    }
+}
+
+// 列表文件：每行第一个字段；.bim 取第 2 列（SNP ID）
+static void load_snp_list(const std::string& path, const std::string& opt, FlatSnpSet& set)
+{
+    const int col = ends_with(path, ".bim") ? 1 : 0;
+    LineReader reader(path);
+    std::string line;
+    while (reader.getline(line)) {
+        std::string_view id;
+        if (line.empty() || line[0] == '#') continue;
+        if (ws_field(line, col, id)) set.insert(id);
+    }
+    LOG_INFO(opt + ": " + std::to_string(set.size()) + " SNPs from " + path);
+}
+
+static void add_interval(RowFilter::Lists& L, const std::string& chr, int64_t beg, int64_t end,
+                         const std::string& what)
+{
+    int code = canonical_chr_code_sv(chr);
+    if (code < 0 || beg < 1 || end < beg) {
+        LOG_ERROR("Invalid region: " + what + " (expected CHR, CHR:POS or CHR:BEG-END)");
+        die(1);
+    }
+    if ((int)L.iv.size() <= code) L.iv.resize(code + 1);
+    L.iv[code].emplace_back(beg, end);
+}
+
+// --region：逗号分隔的 CHR | CHR:POS | CHR:BEG-END（1-based 闭区间）
+static void parse_region_list(RowFilter::Lists& L, const std::string& s)
+{
+    size_t start = 0;
+    while (start <= s.size()) {
+        size_t comma = s.find(',', start);
+        if (comma == std::string::npos) comma = s.size();
+        std::string r = s.substr(start, comma - start);
+        start = comma + 1;
+        if (r.empty()) continue;
+
+        size_t colon = r.rfind(':');
+        std::string chr = r.substr(0, colon);
+        int64_t beg = 1, end = INT64_MAX;
+        bool ok = true;
+        if (colon != std::string::npos) {
+            std::string_view range(r.c_str() + colon + 1);
+            size_t dash = range.find('-');
+            if (dash == std::string_view::npos) {
+                ok = parse_i64(range, beg);
+                end = beg;
+            } else {
+                ok = parse_i64(range.substr(0, dash), beg) &&
+                     (dash + 1 == range.size() || parse_i64(range.substr(dash + 1), end));
+            }
+        }
+        add_interval(L, chr, ok ? beg : 0, end, r);
+    }
+}
+
+// --region-file：BED（CHR START END，0-based 半开）→ [START+1, END]
+static void load_bed(RowFilter::Lists& L, const std::string& path)
+{
+    LineReader reader(path);
+    std::string line;
+    size_t n = 0;
+    while (reader.getline(line)) {
+        if (line.empty() || line[0] == '#' ||
+            line.rfind("track", 0) == 0 || line.rfind("browser", 0) == 0) continue;
+        std::string_view c, b, e;
+        int64_t beg = 0, end = 0;
+        if (!ws_field(line, 0, c) || !ws_field(line, 1, b) || !ws_field(line, 2, e) ||
+            !parse_i64(b, beg) || !parse_i64(e, end)) {
+            LOG_ERROR("Invalid BED line in " + path + ": " + line);
+            die(1);
+        }
+        add_interval(L, std::string(c), beg + 1, end, path + ": " + line);
+        ++n;
+    }
+    LOG_INFO("--region-file: " + std::to_string(n) + " intervals from " + path);
+}
+
+// =======================================================
+// RowFilter
+// =======================================================
+RowFilter::RowFilter(const CommonArgs& P)
+{
+    if (P.extract_file.empty() && P.exclude_file.empty() &&
+        P.regions.empty() && P.region_file.empty()) return;
+
+    auto L = std::make_shared<Lists>();
+    if (!P.extract_file.empty()) { L->has_extract = true; load_snp_list(P.extract_file, "--extract", L->extract); }
+    if (!P.exclude_file.empty()) { L->has_exclude = true; load_snp_list(P.exclude_file, "--exclude", L->exclude); }
+    if (!P.regions.empty())     parse_region_list(*L, P.regions);
+    if (!P.region_file.empty()) load_bed(*L, P.region_file);
+
+    size_t n_iv = 0;
+    for (auto& v : L->iv) {
+        if (v.empty()) continue;
+        L->has_region = true;
+        std::sort(v.begin(), v.end());
+        size_t w = 0;
+        for (size_t k = 1; k < v.size(); ++k) {
+            // 相邻或重叠则合并；整条染色体的 end = INT64_MAX，不能写成 second + 1（溢出）
+            if (v[k].first - 1 <= v[w].second) v[w].second = std::max(v[w].second, v[k].second);
+            else v[++w] = v[k];
+        }
+        v.resize(w + 1);
+        n_iv += v.size();
+    }
+    if (L->has_region) LOG_INFO("Region filter: " + std::to_string(n_iv) + " merged intervals.");
+
+    lists_ = std::move(L);
+}
+
+void RowFilter::bind(const std::vector<std::string>& header, const CommonArgs& P)
+{
+    if (!active()) return;
+
+    idx_snp_ = idx_chr_ = idx_pos_ = -1;
+    if (lists_->has_extract || lists_->has_exclude) {
+        idx_snp_ = find_col(header, P.col_SNP);
+        require(idx_snp_ >= 0, "--extract/--exclude need the SNP column [" + P.col_SNP + "].");
+    }
+    if (lists_->has_region) {
+        idx_chr_ = find_col(header, P.g_chr);
+        idx_pos_ = find_col(header, P.g_pos);
+        require(idx_chr_ >= 0 && idx_pos_ >= 0,
+                "--region/--region-file need the CHR/POS columns [" + P.g_chr + "]/[" + P.g_pos + "].");
+    }
+    stop_ = std::max({idx_snp_, idx_chr_, idx_pos_});
+}
+
+bool RowFilter::pass(std::string_view line) const
+{
+    if (!active()) return true;
+
+    // 只切到最右的所需列为止
+    std::string_view snp, chr, pos;
+    size_t start = 0;
+    for (int c = 0; c <= stop_; ++c) {
+        size_t t = line.find('\t', start);
+        size_t end = (t == std::string_view::npos) ? line.size() : t;
+        std::string_view f = line.substr(start, end - start);
+        if (c == idx_snp_) snp = trim_ws(f);
+        if (c == idx_chr_) chr = trim_ws(f);
+        if (c == idx_pos_) pos = f;
+        if (t == std::string_view::npos) {
+            if (c < stop_) return false;       // 列数不足
+            break;
+        }
+        start = t + 1;
+    }
+
+    const Lists& L = *lists_;
+    if (L.has_extract && !L.extract.contains(snp)) return false;
+    if (L.has_exclude &&  L.exclude.contains(snp)) return false;
+    if (L.has_region) {
+        int64_t p = 0;
+        if (!parse_i64(pos, p)) return false;
+        if (!L.in_region(canonical_chr_code_sv(chr), p)) return false;
+    }
+    return true;
+}
+
+size_t RowFilter::apply(const std::vector<std::string>& lines, std::vector<bool>& keep) const
+{
+    if (!active()) return 0;
+
+    const size_t n = lines.size();
+    std::vector<uint8_t> ok(n, 0);
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < n; ++i)
+        ok[i] = (keep[i] && pass(lines[i])) ? 1 : 0;
+
+    size_t kept = 0, dropped = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (ok[i]) ++kept;
+        else if (keep[i]) { keep[i] = false; ++dropped; }
+    }
+    LOG_INFO("Row filter done: " + std::to_string(kept) + " passed, " +
+             std::to_string(dropped) + " removed.");
+    return dropped;
+}
@@ -0,0 +1,52 @@
+//
+//  rowfilter.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_ROWFILTER_HPP
+#define TOOLKIT_ROWFILTER_HPP
+
+#include "utils/args.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// =======================================================
+// [ROWFILTER] 早期行过滤：--extract / --exclude（SNP 列表）+ --region / --region-file（区间）
+//   只切 SNP / CHR / POS 三列就决定去留，在 QC、去重、格式化之前执行；
+//   被拒的行在 keep 里预置 false，后续 QC / 输出循环直接跳过
+//   SNP 列表：开放寻址的扁平 hash set（ID 连续存放在一块 arena）
+//   区间：按 canonical 染色体编号分组，排序 + 合并后二分查找
+//   多个条件同时给出时取交集（extract ∧ ¬exclude ∧ region）
+// =======================================================
+
+class RowFilter {
+public:
+    RowFilter() = default;
+    explicit RowFilter(const CommonArgs& P);     // 读列表 / 区间；未给任何选项时 inactive
+
+    bool active() const { return lists_ != nullptr; }
+
+    // 按 header 定位 SNP / CHR / POS 列；缺少所需列 → LOG_ERROR + die
+    // （拷贝共享已加载的列表，批量模式每个文件 bind 一份即可）
+    void bind(const std::vector<std::string>& header, const CommonArgs& P);
+
+    bool pass(std::string_view line) const;
+
+    // keep[i] = keep[i] && pass(lines[i])；返回被拒行数
+    size_t apply(const std::vector<std::string>& lines, std::vector<bool>& keep) const;
+
+    struct Lists;
+
+private:
+    std::shared_ptr<const Lists> lists_;
+    int idx_snp_ = -1, idx_chr_ = -1, idx_pos_ = -1;
+    int stop_ = -1;
+};
+
+#endif
@@ -0,0 +1,114 @@
+//
+//  rowtransform.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/rowtransform.hpp"
+#include "utils/StatFunc.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+static inline std::string_view trim_ws(std::string_view sv){
+    while (!sv.empty() && (sv.front()==' ' || sv.front()=='\t')) sv.remove_prefix(1);
+    while (!sv.empty() && (sv.back() ==' ' || sv.back() =='\t' || sv.back()=='\r')) sv.remove_suffix(1);
+    return sv;
+}
+
+// 严格 double 解析：整串消费；view 可能不以 '\0' 结尾（mmap / 缓存快照），先拷到栈上
+static inline bool parse_double_strict(std::string_view sv, double &out){
+    sv = trim_ws(sv);
+    if (sv.empty()) return false;
+
+    char buf[128];
+    if (sv.size() >= sizeof(buf)) return false;
+    std::memcpy(buf, sv.data(), sv.size());
+    buf[sv.size()] = '\0';
+
+    errno = 0;
+    char *end = nullptr;
+    out = std::strtod(buf, &end);
+    if (end == buf || *end != '\0') return false;
+    if (errno == ERANGE) return false;
+    return std::isfinite(out);
+}
+
+namespace RowTransform {
+
+double calc_neff(double cs, double ct){
+    double s = cs + ct;
+    if (s <= 0) return 0;
+    return 4.0 * cs * ct / s;
+}
+
+double neff_from_counts(std::string_view cs, std::string_view ct){
+    double a = 0.0, b = 0.0;
+    if (!parse_double_strict(cs, a)) return NAN;
+    if (!parse_double_strict(ct, b)) return NAN;
+    return calc_neff(a, b);
+}
+
+bool std_effect(double freq, double beta_old, double se_old, double Neff,
+                double &beta_new, double &se_new){
+    if (freq <= 0.0 || freq >= 1.0) return false;
+    if (se_old <= 0.0) return false;
+    if (!std::isfinite(Neff) || Neff <= 0.0) return false;
+
+    double z = beta_old / se_old;
+    double denom = 2.0 * freq * (1.0-freq) * (Neff + z*z);
+    if (denom <= 0.0) return false;
+
+    se_new   = 1.0 / std::sqrt(denom);
+    beta_new = z * se_new;
+    return true;
+}
+
+bool or2beta(std::string_view OR, std::string_view se_col, std::string_view p_col,
+             std::string &beta_out, std::string &se_out){
+    double ORv = NAN;
+    if (!parse_double_strict(OR, ORv)) return false;
+    if (!(ORv > 0.0) || !std::isfinite(ORv)) return false;
+
+    double beta = std::log(ORv);
+    double se = NAN;
+    double sev = NAN;
+    if (parse_double_strict(se_col, sev) && sev > 0.0) se = sev;
+
+    if (!std::isfinite(se)) {
+        double pval = NAN;
+        if (parse_double_strict(p_col, pval) && pval > 0.0 && pval <= 1.0) {
+            double z = StatFunc::p2z_two_tailed(pval);
+            se = (z > 0 ? std::fabs(beta) / z : 999.0);
+        } else {
+            se = 999.0;
+        }
+    }
+
+    beta_out = std::to_string(beta);
+    se_out   = std::to_string(se);
+    return true;
+}
+
+bool neff_std(std::string_view freq, std::string_view beta, std::string_view se, double Neff,
+              std::string &beta_out, std::string &se_out){
+    double freq_old=0, beta_old=0, se_old=0;
+    if (!parse_double_strict(freq, freq_old)) return false;
+    if (!parse_double_strict(beta, beta_old)) return false;
+    if (!parse_double_strict(se,   se_old))   return false;
+
+    double beta_new=0, se_new=0;
+    if (std_effect(freq_old, beta_old, se_old, Neff, beta_new, se_new)) {
+        beta_out = std::to_string(beta_new);
+        se_out   = std::to_string(se_new);
+    } else {
+        beta_out.clear();
+        se_out.clear();
+    }
+    return true;
+}
+
+} // namespace RowTransform
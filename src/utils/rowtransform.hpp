@@ -0,0 +1,42 @@
+//
+//  rowtransform.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_ROWTRANSFORM_HPP
+#define TOOLKIT_ROWTRANSFORM_HPP
+
+#include <string>
+#include <string_view>
+
+// =======================================================
+// [ROWTRANSFORM] or2beta / computeNeff 的逐行数值变换
+//   独立子命令与 pipeline 共用同一份实现，输出才能逐字节一致；
+//   结果按子命令写出的形式格式化（std::to_string）
+// =======================================================
+
+namespace RowTransform {
+    // Neff = 4·case·control / (case + control)；case + control <= 0 时为 0
+    double calc_neff(double cs, double ct);
+
+    // case / control 两列 → Neff；任一列无法解析返回 NaN
+    double neff_from_counts(std::string_view cs, std::string_view ct);
+
+    // 按 Neff 标准化：z = beta/se，se' = 1/sqrt(2f(1-f)(Neff+z²))，beta' = z·se'
+    bool std_effect(double freq, double beta_old, double se_old, double Neff,
+                    double &beta_new, double &se_new);
+
+    // OR → beta = log(OR)；se 取 se 列（> 0），否则由双尾 p 反推 |beta|/z，仍不可用记 999。
+    // se / p 传空 view 表示没有该列。返回 false = OR 无效，该行丢弃
+    bool or2beta(std::string_view OR, std::string_view se, std::string_view p,
+                 std::string &beta_out, std::string &se_out);
+
+    // 用 Neff 标准化 beta/se。freq/beta/se 任一无法解析返回 false（该行丢弃）；
+    // 能解析但无法标准化（freq 越界、se <= 0 ……）时 beta_out/se_out 置空，调用方保留原值
+    bool neff_std(std::string_view freq, std::string_view beta, std::string_view se, double Neff,
+                  std::string &beta_out, std::string &se_out);
+}
+
+#endif
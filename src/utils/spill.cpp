@@ -0,0 +1,96 @@
+//
+//  spill.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#include "utils/spill.hpp"
+#include "utils/memio.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+
+static std::atomic<uint64_t> g_mem_budget{0};
+static std::atomic<uint64_t> g_mem_used{0};
+static std::atomic<uint64_t> g_spill_seq{0};
+
+void mem_budget_set(uint64_t bytes) { g_mem_budget = bytes; }
+uint64_t mem_budget() { return g_mem_budget; }
+
+uint64_t mem_available()
+{
+    uint64_t b = g_mem_budget, u = g_mem_used;
+    if (b == 0) return std::numeric_limits<uint64_t>::max();
+    return u >= b ? 0 : b - u;
+}
+
+void mem_charge(uint64_t bytes)  { g_mem_used += bytes; }
+void mem_release(uint64_t bytes) { g_mem_used -= bytes; }
+
+std::string spill_prefix(const std::string& tmp_dir, const std::string& out_file, const std::string& tag)
+{
+    std::string dir = tmp_dir;
+    if (dir.empty() && (out_file == "-" || is_mem_path(out_file))) {
+        // 输出不落盘（stdout / C API 的 mem://）：没有输出目录可用
+        const char* env = std::getenv("TMPDIR");
+        dir = env && *env ? env : ".";
+    } else if (dir.empty()) {
+        size_t slash = out_file.rfind('/');
+        dir = slash == std::string::npos ? "." : out_file.substr(0, slash);
+    }
+    // 同一进程内多个组件 / serve 的并发请求各用一个序号
+    return dir + "/.gwastoolkit_" + tag + "_" + std::to_string(::getpid()) + "_" +
+           std::to_string(g_spill_seq++) + "_";
+}
+
+FILE* spill_open(const std::string& path, const char* mode)
+{
+    FILE* fp = std::fopen(path.c_str(), mode);
+    if (!fp) {
+        LOG_ERROR(std::string(mode[0] == 'r' ? "Cannot read" : "Cannot create") +
+                  " temporary file: " + path + " (see --tmp-dir)");
+        die(1);
+    }
+    return fp;
+}
+
+void spill_write(FILE* fp, const void* data, size_t bytes, const std::string& path)
+{
+    if (bytes && std::fwrite(data, 1, bytes, fp) != bytes) {
+        LOG_ERROR("Error writing temporary file: " + path + " (disk full?)");
+        die(1);
+    }
+}
+
+// 登记表故意不析构：atexit 钩子运行时（exit 期间）必须仍然可用
+static std::mutex g_tmp_mu;
+static std::set<std::string>* g_tmp_files = nullptr;
+
+static void spill_remove_all()
+{
+    std::lock_guard<std::mutex> lk(g_tmp_mu);
+    for (const auto& p : *g_tmp_files) std::remove(p.c_str());
+    g_tmp_files->clear();
+}
+
+void spill_track(const std::string& path)
+{
+    std::lock_guard<std::mutex> lk(g_tmp_mu);
+    if (!g_tmp_files) {
+        g_tmp_files = new std::set<std::string>;
+        std::atexit(spill_remove_all);
+    }
+    g_tmp_files->insert(path);
+}
+
+void spill_remove(const std::string& path)
+{
+    std::remove(path.c_str());
+    std::lock_guard<std::mutex> lk(g_tmp_mu);
+    if (g_tmp_files) g_tmp_files->erase(path);
+}
@@ -0,0 +1,181 @@
+//
+//  spill.hpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+
+#ifndef TOOLKIT_SPILL_HPP
+#define TOOLKIT_SPILL_HPP
+
+#include "utils/log.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+// =======================================================
+// [SPILL] --memory-limit：进程级内存预算 + 外存算法的公共部件
+//   mem_*        ：预算与记账（0 = 不限）。大块分配（GWAS 行、排序缓冲、去重 hash 表）
+//                  按估算字节 charge / release，组件据 mem_available() 决定是否改走外存
+//   spill_prefix ：临时文件前缀（--tmp-dir，默认输出文件所在目录）
+//   SpillFile    ：临时文件的登记与删除（见下）
+//   ExtSorter<T> ：定长 POD 记录的外排序：缓冲满则排序落盘为一段 run，最后 k 路归并
+//                  Less 须是全序（记录里带行号做最后的比较键），结果与内存排序完全一致
+// =======================================================
+
+void     mem_budget_set(uint64_t bytes);
+uint64_t mem_budget();                    // 0 = 不限
+uint64_t mem_available();                 // 预算 - 已记账；不限时为 UINT64_MAX
+void     mem_charge(uint64_t bytes);
+void     mem_release(uint64_t bytes);
+
+// 作用域内记账
+class MemCharge {
+public:
+    MemCharge() = default;
+    explicit MemCharge(uint64_t bytes) { add(bytes); }
+    ~MemCharge() { mem_release(bytes_); }
+    MemCharge(const MemCharge&) = delete;
+    MemCharge& operator=(const MemCharge&) = delete;
+
+    void add(uint64_t bytes) { mem_charge(bytes); bytes_ += bytes; }
+    void clear() { mem_release(bytes_); bytes_ = 0; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    uint64_t bytes_ = 0;
+};
+
+// tmp_dir 为空 → out_file 所在目录（stdout / mem:// 时为 $TMPDIR，未设置则当前目录）
+std::string spill_prefix(const std::string& tmp_dir, const std::string& out_file, const std::string& tag);
+
+FILE* spill_open(const std::string& path, const char* mode);     // 失败 → LOG_ERROR + die
+void  spill_write(FILE* fp, const void* data, size_t bytes, const std::string& path);
+
+// 临时文件登记：可执行文件里 die() 即 exit()，栈上对象不析构 —— 登记过的文件由 atexit 钩子删除；
+// 抛 GwasExit 的库 / serve 模式照常栈展开，由 SpillFile / ExtSorter 的析构删除
+void spill_track(const std::string& path);
+void spill_remove(const std::string& path);      // 删除并注销
+
+// 作用域内的临时文件：set() 时登记，析构（或 reset()）时删除
+class SpillFile {
+public:
+    SpillFile() = default;
+    explicit SpillFile(std::string path) { set(std::move(path)); }
+    ~SpillFile() { reset(); }
+    SpillFile(SpillFile&& o) noexcept : path_(std::move(o.path_)) { o.path_.clear(); }
+    SpillFile& operator=(SpillFile&& o) noexcept {
+        if (this != &o) { reset(); path_ = std::move(o.path_); o.path_.clear(); }
+        return *this;
+    }
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    void set(std::string path) { reset(); path_ = std::move(path); spill_track(path_); }
+    void reset() { if (!path_.empty()) spill_remove(path_); path_.clear(); }
+    const std::string& path() const { return path_; }
+    bool empty() const { return path_.empty(); }
+
+private:
+    std::string path_;
+};
+
+template <class T, class Less>
+class ExtSorter {
+public:
+    ExtSorter(uint64_t run_bytes, std::string prefix, Less less = Less())
+        : less_(less), prefix_(std::move(prefix)),
+          cap_(std::max<size_t>(run_bytes / sizeof(T), 1024)),
+          charge_(cap_ * sizeof(T))
+    {
+        buf_.reserve(cap_);
+    }
+
+    ~ExtSorter() {
+        readers_.clear();                // 先关句柄再删文件
+        files_.clear();
+    }
+
+    void push(const T& r) {
+        buf_.push_back(r);
+        if (buf_.size() == cap_) spill();
+    }
+
+    // 输入结束：只有一段时留在内存，否则最后一段也落盘并打开归并
+    void finish() {
+        if (files_.empty()) {
+            std::sort(buf_.begin(), buf_.end(), less_);
+            return;
+        }
+        if (!buf_.empty()) spill();
+        std::vector<T>().swap(buf_);
+
+        for (size_t i = 0; i < files_.size(); ++i) {
+            readers_.emplace_back(new Reader(files_[i].path()));
+            if (readers_[i]->next()) pq_.push(i);
+        }
+    }
+
+    bool next(T& out) {
+        if (files_.empty()) {
+            if (pos_ == buf_.size()) return false;
+            out = buf_[pos_++];
+            return true;
+        }
+        if (pq_.empty()) return false;
+        size_t i = pq_.top();
+        pq_.pop();
+        out = readers_[i]->cur;
+        if (readers_[i]->next()) pq_.push(i);
+        return true;
+    }
+
+    size_t runs() const { return files_.size(); }
+
+private:
+    struct Reader {
+        FILE* fp;
+        std::vector<char> vbuf;
+        T cur;
+        explicit Reader(const std::string& path) : fp(spill_open(path, "rb")), vbuf(1u << 18) {
+            setvbuf(fp, vbuf.data(), _IOFBF, vbuf.size());
+        }
+        ~Reader() { std::fclose(fp); }
+        bool next() { return std::fread(&cur, sizeof(T), 1, fp) == 1; }
+    };
+
+    struct ReaderGreater {
+        const ExtSorter* s;
+        bool operator()(size_t a, size_t b) const { return s->less_(s->readers_[b]->cur, s->readers_[a]->cur); }
+    };
+
+    void spill() {
+        std::sort(buf_.begin(), buf_.end(), less_);
+        std::string path = prefix_ + std::to_string(files_.size()) + ".tmp";
+        files_.emplace_back(path);
+        FILE* fp = spill_open(path, "wb");
+        spill_write(fp, buf_.data(), buf_.size() * sizeof(T), path);
+        if (std::fclose(fp) != 0) {
+            LOG_ERROR("Error writing temporary file: " + path + " (disk full?)");
+            die(1);
+        }
+        buf_.clear();
+    }
+
+    Less less_;
+    std::string prefix_;
+    size_t cap_;
+    MemCharge charge_;
+    std::vector<T> buf_;
+    size_t pos_ = 0;
+    std::vector<SpillFile> files_;
+    std::vector<std::unique_ptr<Reader>> readers_;
+    std::priority_queue<size_t, std::vector<size_t>, ReaderGreater> pq_{ReaderGreater{this}};
+};
+
+#endif
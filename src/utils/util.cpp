@@ -68,11 +68,49 @@ int find_col(const vector<string> &header, const string &colname){
     return -1;
 }
 
+// --format 列表：每个格式一个输出文件，格式名插在 .gz 之前
+// out.txt -> out.txt.cojo；out.txt.gz -> out.txt.cojo.gz（.zst 同理）
+std::string format_out_path(const std::string& out, const std::string& fmt){
+    std::string_view z = compress_suffix(out);
+    return out.substr(0, out.size() - z.size()) + "." + fmt + std::string(z);
+}
+
+// ".gz" / ".zst" / ""（决定 Writer / LineReader 的编解码方式）
+std::string_view compress_suffix(const std::string& path){
+    if (ends_with(path, ".gz"))  return ".gz";
+    if (ends_with(path, ".zst")) return ".zst";
+    return "";
+}
+
+std::string chr_code_name(int code){
+    if (code < 1 || code > 25) return "NA";
+    if (code == 23) return "X";
+    if (code == 24) return "Y";
+    if (code == 25) return "MT";
+    return std::to_string(code);
+}
+
+// out.txt.gz -> out.txt.chr1.gz；trait.{chr}.tsv -> trait.1.tsv
+std::string chr_out_path(const std::string& out, int code){
+    const std::string name = chr_code_name(code);
+    size_t k = out.find("{chr}");
+    if (k != std::string::npos) {
+        std::string p = out;
+        while (k != std::string::npos) {
+            p.replace(k, 5, name);
+            k = p.find("{chr}", k + name.size());
+        }
+        return p;
+    }
+    std::string_view z = compress_suffix(out);
+    return out.substr(0, out.size() - z.size()) + ".chr" + name + std::string(z);
+}
+
 //
 void require(bool cond, const std::string& msg){
     if(!cond){
         LOG_ERROR(msg);
-        exit(1);
+        die(1);
     }
 }
 
@@ -128,6 +166,89 @@ std::string canonical_chr(const std::string& raw){
     return x;
 }
 
+// ---------------- string_view 版（热循环用，无分配） ----------------
+static inline std::string_view sv_trim(std::string_view sv){
+    while (!sv.empty() && (sv.front() == ' ' || sv.front() == '\t')) sv.remove_prefix(1);
+    while (!sv.empty() && (sv.back()  == ' ' || sv.back()  == '\t' || sv.back() == '\r')) sv.remove_suffix(1);
+    return sv;
+}
+
+static inline char sv_low(char c){
+    return (char)std::tolower((unsigned char)c);
+}
+
+static inline bool starts_with_ci(std::string_view s, std::string_view p){
+    if (s.size() < p.size()) return false;
+    for (size_t i=0;i<p.size();++i){
+        if (sv_low(s[i]) != sv_low(p[i])) return false;
+    }
+    return true;
+}
+
+static inline bool eq_ci(std::string_view a, std::string_view b){
+    return a.size() == b.size() && starts_with_ci(a, b);
+}
+
+// 严格整数解析：必须整串都是数字（不允许 "1.11" 这种）；负号一律视为非法（chr 编号 > 0）
+static inline bool parse_int_strict(std::string_view sv, int &out) {
+    sv = sv_trim(sv);
+    if (!sv.empty() && sv.front() == '+') sv.remove_prefix(1);
+    if (sv.empty() || sv.size() > 9) return false;
+    int v = 0;
+    for (char c : sv) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + (c - '0');
+    }
+    out = v;
+    return true;
+}
+
+//[OPT-1] 用string_view 快速 canonical_chr （避免 string 分配）
+int canonical_chr_code_sv(std::string_view sv) {
+    sv = sv_trim(sv);
+    if (sv.empty()) return -1;
+
+    // 去掉 CHR 前缀（大小写不敏感）
+    if (starts_with_ci(sv, "CHR")) {
+        sv.remove_prefix(3);
+        sv = sv_trim(sv);
+        if (sv.empty()) return -1;
+    }
+
+    // RefSeq: NC_000001.11 -> 1; NC_000023.11 -> 23; NC_012920.1 -> 25(MT)
+    if (starts_with_ci(sv, "NC_")) {
+        sv.remove_prefix(3);
+        sv = sv_trim(sv);
+
+        // 至少需要 6 位数字
+        if (sv.size() < 6) return -1;
+
+        std::string_view num6 = sv.substr(0, 6);
+
+        int v = 0;
+        // ✅ 必须解析 num6，而不是 sv（sv 里会有 ".11"）
+        if (!parse_int_strict(num6, v)) return -1;
+
+        // ✅ 注意：这里不能先限制 v<=25，因为 12920 需要映射到 MT
+        if (1 <= v && v <= 22) return v;
+        if (v == 23) return 23;
+        if (v == 24) return 24;
+        if (v == 12920) return 25; // NC_012920.* -> MT
+        return -1;
+    }
+
+    // 常用别名：M / MT / MTDNA
+    if (eq_ci(sv, "X")) return 23;
+    if (eq_ci(sv, "Y")) return 24;
+    if (eq_ci(sv, "M") || eq_ci(sv, "MT") || eq_ci(sv, "MTDNA")) return 25;
+
+    // 数字染色体（严格）
+    int v = 0;
+    if (!parse_int_strict(sv, v)) return -1;
+    if (v <= 0 || v > 25) return -1;
+    return v;
+}
+
 int canonical_chr_code(const std::string& raw)
 {
     std::string c = canonical_chr(raw);
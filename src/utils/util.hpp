@@ -9,6 +9,7 @@
 #define RSIDIMPU_UTIL_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 std::vector<std::string> split(const std::string& s);
@@ -17,9 +18,17 @@ std::string upper(const std::string& s);
 std::string norm_chr(const std::string &chr);
 std::string canonical_chr(const std::string& raw);
 int canonical_chr_code(const std::string& raw);
+// 同上，string_view 版（无分配）：1..22, X=23, Y=24, MT=25；无法识别返回 -1
+int canonical_chr_code_sv(std::string_view sv);
 static inline bool starts_with(const std::string& s, const std::string& p);
 bool ends_with(const std::string& s, const std::string& suffix);
 int find_col(const std::vector<std::string>& header, const std::string& colname);
+std::string format_out_path(const std::string& out, const std::string& fmt);
+std::string_view compress_suffix(const std::string& path);
+// canonical_chr_code 的反向：1..22 / X / Y / MT；-1（无法识别）→ "NA"
+std::string chr_code_name(int code);
+// --split-by-chr 的分片文件名：out 含 {chr} 时替换之，否则把 .chrNAME 插在 .gz/.zst 之前
+std::string chr_out_path(const std::string& out, int code);
 void require(bool cond, const std::string& msg);
 
 #endif
@@ -8,20 +8,130 @@
 #include "utils/writer.hpp"
 #include "utils/util.hpp"   // 用里面的 ends_with
 #include "utils/log.hpp"
+#include "utils/arrowipc.hpp"
+#include "utils/memio.hpp"
+#include "utils/bgzf.hpp"
+#include "utils/parallel.hpp"
 
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <charconv>
+#include <memory>
+#include <vector>
 
-Writer::Writer(const std::string &filename, const std::string & /*format*/)
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef USE_ZSTD
+// [ZSTD-OUT] 流式压缩；nbWorkers>0 时 libzstd 内部多线程压缩
+struct Writer::ZstdOut {
+    FILE* fp = nullptr;
+    ZSTD_CCtx* cctx = nullptr;
+    std::vector<char> out;
+
+    explicit ZstdOut(FILE* f) : fp(f) {
+        cctx = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, 3);
+        int workers = 1;
+#ifdef _OPENMP
+        workers = omp_get_max_threads();
+#endif
+        if (workers > 1) ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, workers);
+        out.resize(ZSTD_CStreamOutSize());
+    }
+    ~ZstdOut() {
+        if (cctx) ZSTD_freeCCtx(cctx);
+        if (fp) fclose(fp);
+    }
+
+    void compress(const char* p, size_t n, ZSTD_EndDirective mode) {
+        ZSTD_inBuffer ib{p, n, 0};
+        while (true) {
+            ZSTD_outBuffer ob{out.data(), out.size(), 0};
+            size_t left = ZSTD_compressStream2(cctx, &ob, &ib, mode);
+            if (ZSTD_isError(left)) {
+                LOG_ERROR(std::string("zstd compression error: ") + ZSTD_getErrorName(left));
+                die(1);
+            }
+            fwrite(out.data(), 1, ob.pos, fp);
+            // continue：输入吃完即可；end：还要把内部缓冲全部刷出
+            if (mode == ZSTD_e_continue ? ib.pos == ib.size : left == 0) break;
+        }
+    }
+};
+#else
+struct Writer::ZstdOut {};
+#endif
+
+// [ARROW] 文本行 → ArrowIpcWriter；IPC 字节再走 sink()（因此 .gz/.zst/stdout 照常生效）
+struct Writer::ArrowOut {
+    ArrowIpcWriter w;
+    bool have_header = false;
+    explicit ArrowOut(ArrowIpcWriter::Sink s) : w(std::move(s)) {}
+};
+
+// [INDEX] 逐行喂给 TabixIndex；偏移 = 写入该块前的 bgzf tell() + 行在块内的位置
+struct Writer::IndexOut {
+    std::string chr_col, pos_col;
+    int ichr = -1, ipos = -1;
+    bool have_header = false;
+    bool failed = false;
+    std::unique_ptr<TabixIndex> tbi;
+    std::string name[26];         // 同一染色体的不同写法（chr1 / 1）归入第一次出现的名字
+};
+
+// [SPLIT] 下标 0 = 无法识别的 CHR（.chrNA），1..25 = canonical_chr_code
+struct Writer::Shards {
+    std::string format;
+    std::string header;
+    bool have_header = false;
+    std::string idx_chr, idx_pos;          // enable_index 的列名，新分片沿用
+    int cur = 0;
+    std::unique_ptr<Writer> w[26];
+};
+
+Writer::Writer(const std::string &filename, const std::string &format, bool split_by_chr)
+    : filename_(filename)
 {
+    if (split_by_chr) {
+        shards_ = new Shards;
+        shards_->format = format;
+        ok_ = true;
+        return;
+    }
+    if (filename == "-") {
+        use_stdout_ = true;
+    }
+    else if (is_mem_path(filename)) {
+        mem_ = memio_open_write(filename);
+    }
     // 判断是否 .gz 结尾
-    if (ends_with(filename, ".gz")) {
-        use_gz_ = true;
-        gzfp_ = gzopen(filename.c_str(), "wb");
-        if (!gzfp_) {
-            LOG_ERROR("Error: cannot open gzip file for writing: " + filename);
+    else if (ends_with(filename, ".gz")) {
+        bgzf_ = new BgzfWriter(filename);
+        if (!bgzf_->good()) {
+            ok_ = false;
+            return;
+        }
+    } else if (ends_with(filename, ".zst")) {
+#ifdef USE_ZSTD
+        FILE* fp = fopen(filename.c_str(), "wb");
+        if (!fp) {
+            LOG_ERROR("Error: cannot open zst file for writing: " + filename);
             ok_ = false;
             return;
         }
+        zst_ = new ZstdOut(fp);
+#else
+        LOG_ERROR("Error: cannot write " + filename + ": built without zstd support (rebuild with make USE_ZSTD=1)");
+        ok_ = false;
+        return;
+#endif
     } else {
         ofs_.open(filename);
         if (!ofs_) {
@@ -31,25 +141,315 @@ Writer::Writer(const std::string &filename, const std::string & /*format*/)
         }
     }
 
+    if (format == "arrow")
+        arrow_ = new ArrowOut([this](const char* p, size_t n) { sink(p, n); });
+
+    buf_.reserve(kFlushBytes + 4096);
     ok_ = true;
 }
 
 Writer::~Writer()
 {
-    if (use_gz_) {
-        if (gzfp_) gzclose(gzfp_);
+    if (shards_) {
+        // 各分片最后一批数据的压缩与收尾（BGZF EOF 块、.tbi）并行进行
+        std::string names;
+        int first = 0;
+        for (int c = 1; c <= 26; ++c) {
+            const int code = c == 26 ? -1 : c;            // NA 排最后
+            if (!shards_->w[c % 26]) continue;
+            if (!first) first = code;
+            names += (names.empty() ? "" : ",") + chr_code_name(code);
+        }
+        par_for(26, [&](size_t c) { shards_->w[c].reset(); });
+
+        if (!ok_)
+            ;                                             // discard() 已删除分片
+        else if (!first)
+            LOG_WARN("No rows to write; --split-by-chr created no files for " + filename_);
+        else
+            LOG_INFO("Split output (chr " + names + "): " + chr_out_path(filename_, first) + " ...");
+        delete shards_;
+        return;
+    }
+    flush();
+    if (arrow_) {
+        if (ok_) arrow_->w.finish();
+        delete arrow_;
+    }
+    if (bgzf_) {
+        bgzf_->close();
+        if (idx_) {
+            std::string tbi = filename_ + ".tbi";
+            if (ok_ && !idx_->failed && idx_->have_header) {
+                if (idx_->tbi->save(tbi, *bgzf_)) LOG_INFO("Index written: " + tbi);
+            } else {
+                std::remove(tbi.c_str());     // 旧索引已与新输出不符
+            }
+            delete idx_;
+        }
+        delete bgzf_;
+    } else if (zst_) {
+#ifdef USE_ZSTD
+        zst_->compress(nullptr, 0, ZSTD_e_end);
+#endif
+        delete zst_;
+    } else if (use_stdout_) {
+        fflush(stdout);
     } else {
         if (ofs_.is_open()) ofs_.close();
     }
 }
 
+// [OPT-WR-1] 行先攒进 buf_，满 kFlushBytes 才 gzwrite/ofs.write 一次；
+// 去掉原先 gz 分支的 line + "\n" 临时串
 void Writer::write_line(const std::string &line)
 {
     if (!ok_) return;
+    if (shards_) {
+        if (!shards_->have_header) {
+            shards_->header = line;
+            shards_->have_header = true;
+            return;
+        }
+        std::string& b = cur_shard().buf_;
+        b.append(line);
+        b.push_back('\n');
+        flush_if_full();
+        return;
+    }
+    buf_.append(line);
+    buf_.push_back('\n');
+    flush_if_full();
+}
 
-    if (use_gz_) {
-        gzputs(gzfp_, (line + "\n").c_str());
-    } else {
-        ofs_ << line << '\n';
+void Writer::write_block(std::string_view block)
+{
+    if (!ok_ || block.empty()) return;
+    if (shards_) {
+        if (!shards_->have_header) {                      // 首行是 header
+            size_t nl = block.find('\n');
+            write_line(std::string(block.substr(0, nl)));
+            if (nl == std::string_view::npos) return;
+            block.remove_prefix(nl + 1);
+        }
+        cur_shard().buf_.append(block.data(), block.size());
+        flush_if_full();
+        return;
+    }
+    if (buf_.size() + block.size() < kFlushBytes) {
+        buf_.append(block.data(), block.size());
+        return;
+    }
+    flush();
+    drain(block.data(), block.size());
+}
+
+void Writer::write_block(std::string_view block, const std::vector<int8_t>& line_chr)
+{
+    if (!shards_) { write_block(block); return; }
+    if (!ok_ || block.empty()) return;
+    size_t i = 0, k = 0;
+    while (i < block.size()) {
+        size_t nl = block.find('\n', i);
+        size_t e = nl == std::string_view::npos ? block.size() : nl + 1;
+        if (!shards_->have_header) {
+            write_line(std::string(block.substr(i, e - i - (nl == std::string_view::npos ? 0 : 1))));
+        } else {
+            std::string& b = shard(k < line_chr.size() ? line_chr[k++] : -1).buf_;
+            b.append(block.data() + i, e - i);
+            if (nl == std::string_view::npos) b.push_back('\n');
+        }
+        i = e;
+    }
+    flush_shards(false);
+}
+
+void Writer::flush_if_full()
+{
+    if (shards_) {
+        if (cur_shard().buf_.size() >= kFlushBytes) flush_shards(false);
+        return;
+    }
+    if (buf_.size() >= kFlushBytes) flush();
+}
+
+void Writer::select_chr(int code)
+{
+    if (shards_) shards_->cur = code >= 1 && code <= 25 ? code : 0;
+}
+
+Writer& Writer::cur_shard()
+{
+    return shard(shards_->cur);
+}
+
+Writer& Writer::shard(int code)
+{
+    Shards& S = *shards_;
+    const int c = code >= 1 && code <= 25 ? code : 0;
+    if (S.w[c]) return *S.w[c];
+
+    const std::string path = chr_out_path(filename_, c ? c : -1);
+    S.w[c].reset(new Writer(path, S.format));
+    if (!S.w[c]->good()) {
+        LOG_ERROR("Error: cannot open --split-by-chr output: " + path);
+        die(1);
+    }
+    if (!c) LOG_WARN("Rows with an unrecognised CHR are written to " + path);
+    if (!S.idx_chr.empty()) S.w[c]->enable_index(S.idx_chr, S.idx_pos);
+    if (S.have_header) S.w[c]->write_line(S.header);
+    return *S.w[c];
+}
+
+// 分片各自攒满 kFlushBytes 才落盘；all = true 时全部刷出。
+// 需要落盘的分片一起交给 par_for：每个分片的压缩（BGZF 块）在不同线程上同时进行
+void Writer::flush_shards(bool all)
+{
+    std::vector<Writer*> due;
+    for (auto& w : shards_->w)
+        if (w && !w->buf_.empty() && (all || w->buf_.size() >= kFlushBytes / 2)) due.push_back(w.get());
+    if (due.size() == 1) due[0]->flush();
+    else if (!due.empty()) par_for(due.size(), [&](size_t k) { due[k]->flush(); });
+}
+
+void Writer::discard()
+{
+    if (shards_) {
+        for (auto& w : shards_->w)
+            if (w) { w->discard(); w.reset(); }
+        ok_ = false;
+        return;
+    }
+    ok_ = false;
+    buf_.clear();
+    if (mem_) mem_->clear();
+    else if (!use_stdout_) {
+        std::remove(filename_.c_str());
+        if (idx_) std::remove((filename_ + ".tbi").c_str());
+    }
+}
+
+void Writer::flush()
+{
+    if (shards_) { if (ok_) flush_shards(true); return; }
+    if (!ok_ || buf_.empty()) return;
+    drain(buf_.data(), buf_.size());
+    buf_.clear();
+}
+
+void Writer::enable_index(const std::string& chr_col, const std::string& pos_col)
+{
+    if (!ok_ || idx_) return;
+    if (shards_) {
+        if (!ends_with(filename_, ".gz") || shards_->format == "arrow") {
+            LOG_WARN("--index needs a text .gz output; no index for " + filename_);
+            return;
+        }
+        shards_->idx_chr = chr_col;
+        shards_->idx_pos = pos_col;
+        return;
     }
-}
\ No newline at end of file
+    if (!bgzf_ || arrow_) {
+        LOG_WARN("--index needs a text .gz output; no index for " + filename_);
+        return;
+    }
+    idx_ = new IndexOut;
+    idx_->chr_col = chr_col;
+    idx_->pos_col = pos_col;
+}
+
+static inline bool tab_field(std::string_view line, int col, std::string_view& out)
+{
+    size_t start = 0;
+    for (int c = 0; c < col; ++c) {
+        size_t t = line.find('\t', start);
+        if (t == std::string_view::npos) return false;
+        start = t + 1;
+    }
+    size_t end = line.find('\t', start);
+    if (end == std::string_view::npos) end = line.size();
+    out = line.substr(start, end - start);
+    return true;
+}
+
+void Writer::index_lines(const char* p, size_t n)
+{
+    IndexOut& X = *idx_;
+    const uint64_t u0 = bgzf_->tell();
+    size_t i = 0;
+    while (i < n && !X.failed) {
+        const char* nl = static_cast<const char*>(memchr(p + i, '\n', n - i));
+        size_t e = nl ? (size_t)(nl - p) : n;
+        std::string_view line(p + i, e - i);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        if (!X.have_header) {
+            auto hdr = split(std::string(line));
+            X.ichr = find_col(hdr, X.chr_col);
+            X.ipos = find_col(hdr, X.pos_col);
+            X.have_header = true;
+            if (X.ichr < 0 || X.ipos < 0) {
+                LOG_WARN("No index for " + filename_ + ": output has no [" + X.chr_col + "] / [" + X.pos_col + "] column.");
+                X.failed = true;
+                break;
+            }
+            X.tbi.reset(new TabixIndex(X.ichr, X.ipos, 1));
+        } else {
+            std::string_view vc, vp;
+            int64_t pos = 0;
+            bool ok = tab_field(line, X.ichr, vc) && tab_field(line, X.ipos, vp);
+            if (ok) {
+                while (!vp.empty() && vp.front() == ' ') vp.remove_prefix(1);
+                while (!vp.empty() && vp.back()  == ' ') vp.remove_suffix(1);
+                auto r = std::from_chars(vp.data(), vp.data() + vp.size(), pos);
+                ok = r.ec == std::errc() && r.ptr == vp.data() + vp.size();
+            }
+            std::string_view name = vc;
+            int code = ok ? canonical_chr_code_sv(vc) : -1;
+            if (code > 0) {
+                if (X.name[code].empty()) X.name[code] = std::string(vc);
+                name = X.name[code];
+            }
+            if (!ok || !X.tbi->add(name, pos, u0 + i, u0 + e + 1)) {
+                LOG_WARN("No index for " + filename_ + ": " +
+                         (ok ? X.tbi->error() : "row without a valid CHR/POS") +
+                         " (position-sort it with `GWAStoolkit sort`).");
+                X.failed = true;
+            }
+        }
+        i = e + 1;
+    }
+}
+
+void Writer::drain(const char* p, size_t n)
+{
+    if (!arrow_) {
+        if (idx_ && !idx_->failed) index_lines(p, n);
+        sink(p, n);
+        return;
+    }
+
+    std::string_view rest(p, n);
+    while (!rest.empty()) {
+        size_t nl = rest.find('\n');
+        std::string_view line = rest.substr(0, nl);
+        rest.remove_prefix(nl == std::string_view::npos ? rest.size() : nl + 1);
+        if (!arrow_->have_header) {
+            arrow_->w.set_header(line);
+            arrow_->have_header = true;
+        } else {
+            arrow_->w.add_row(line);
+        }
+    }
+}
+
+void Writer::sink(const char* p, size_t n)
+{
+    if (bgzf_) bgzf_->write(p, n);
+#ifdef USE_ZSTD
+    else if (zst_) zst_->compress(p, n, ZSTD_e_continue);
+#endif
+    else if (use_stdout_) fwrite(p, 1, n, stdout);
+    else if (mem_) mem_->append(p, n);
+    else ofs_.write(p, (std::streamsize)n);
+}
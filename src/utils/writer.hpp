@@ -9,28 +9,83 @@
 #define TOOLKIT_WRITER_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
-#include <zlib.h>
+
+class BgzfWriter;
 
 // 可指定输出格式
-// 如果文件名以 ".gz" 结尾 → 用 gzopen 写 gzip
+// 如果文件名以 ".gz" 结尾 → BGZF（分块 gzip，并行压缩；zcat / gzread 照常读取）
+// 如果文件名以 ".zst" 结尾 → zstd 多线程压缩（需 make USE_ZSTD=1）
+// 文件名为 "-" → 写 stdout（纯文本，压缩交给下游管道）
+// 文件名为 "mem://NAME" → 写进程内缓冲（libgwastoolkit，见 memio.hpp）
+// format == "arrow" → 行（首行为列名）转成带类型的列，写 Arrow IPC file（仍按上面的后缀/stdout 落盘）
 // 否则 → 用 ofstream 写普通文本
+// split_by_chr == true → 不写 filename 本身，按行的染色体分发到 chr_out_path(filename, chr)
+//   的分片 Writer（见下面的 [SPLIT]）
 
 class Writer {
 public:
-    Writer(const std::string &filename, const std::string &format = "gwas");
+    Writer(const std::string &filename, const std::string &format = "gwas", bool split_by_chr = false);
     ~Writer();
 
     void write_line(const std::string &line);
+    // [OPT-WR-1] 整块写入：block 内已含 '\n'（通常来自 FormatEngine::append_line_fast）
+    void write_block(std::string_view block);
+    void flush();
     bool good() const { return ok_; }
 
+    // 出错中止前丢弃已写出的部分输出：删除文件（含分片与 .tbi），之后的写入全部忽略；
+    // mem:// 清空缓冲，stdout 已写出的无法撤回
+    void discard();
+
+    // [INDEX] 写 .gz 时顺带生成 FILENAME.tbi（tabix 兼容）：按表头找 CHR / POS 列，
+    // 须在写第一行之前调用；行未按位置排好或缺列时放弃索引（只警告，输出照常）
+    void enable_index(const std::string& chr_col, const std::string& pos_col);
+
+    // 单线程调用方可直接 append 到内部缓冲，再调 flush_if_full()
+    std::string& buffer() { return shards_ ? cur_shard().buf_ : buf_; }
+    void flush_if_full();
+
+    // [SPLIT] --split-by-chr：第一行（header）写进每个分片；分片在第一次收到数据行时才创建。
+    // select_chr(code) 之后的 write_line / write_block / buffer() 落到该染色体的分片
+    // （code 取 canonical_chr_code：1..25，-1 = 无法识别 → .chrNA）；非分片模式下不起作用。
+    // write_block(block, line_chr)：block 的第 k 行写到 line_chr[k]，攒满的分片一起并行压缩落盘
+    void select_chr(int code);
+    void write_block(std::string_view block, const std::vector<int8_t>& line_chr);
+    bool is_split() const { return shards_ != nullptr; }
+
 private:
-    bool use_gz_ = false;
+    static constexpr size_t kFlushBytes = 1u << 20;   // 1 MiB 一次落盘
+
+    void drain(const char* p, size_t n);   // 完整行：arrow 时转列，否则直接 sink
+    void sink(const char* p, size_t n);
+    void index_lines(const char* p, size_t n);
+
+    std::string filename_;
     bool ok_ = false;
+    std::string buf_;
 
     std::ofstream ofs_;
-    gzFile gzfp_ = nullptr;
+    BgzfWriter* bgzf_ = nullptr;
+    bool use_stdout_ = false;
+    std::string* mem_ = nullptr;
+
+    struct ZstdOut;             // 只在 writer.cpp 里定义
+    ZstdOut* zst_ = nullptr;
+
+    struct ArrowOut;
+    ArrowOut* arrow_ = nullptr;
+
+    struct IndexOut;
+    IndexOut* idx_ = nullptr;
+
+    struct Shards;
+    Shards* shards_ = nullptr;
+    Writer& cur_shard();
+    Writer& shard(int code);
+    void flush_shards(bool all);
 };
 
 #endif
\ No newline at end of file
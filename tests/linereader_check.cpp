@@ -0,0 +1,84 @@
+//
+//  linereader_check.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+//  make check：LineReader 读 FIFO（<(...) 进程替换同理）——只能打开一次，
+//  文件头的 magic bytes 必须从同一个句柄里识别，不能丢
+//
+
+#include "utils/linereader.hpp"
+
+#include <zlib.h>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static int failures = 0;
+
+static void expect(const char* what, bool ok)
+{
+    if (!ok) ++failures;
+    std::printf("%-36s %s\n", what, ok ? "ok" : "FAIL");
+}
+
+static std::string read_all(const std::string& path)
+{
+    LineReader lr(path);
+    std::string line, all;
+    while (lr.getline(line)) all += line + "\n";
+    return all;
+}
+
+// 另一线程往 FIFO 写 bytes，本线程用 LineReader 读回
+static std::string via_fifo(const std::string& fifo, const std::string& bytes)
+{
+    std::thread feeder([&] {
+        FILE* fp = std::fopen(fifo.c_str(), "wb");
+        if (!fp) return;
+        std::fwrite(bytes.data(), 1, bytes.size(), fp);
+        std::fclose(fp);
+    });
+    std::string got = read_all(fifo);
+    feeder.join();
+    return got;
+}
+
+int main()
+{
+    // 旧实现会二次打开 FIFO：写端已关，第二次 open 永远阻塞 → 10 秒后 SIGALRM 判失败
+    std::signal(SIGPIPE, SIG_IGN);
+    alarm(10);
+
+    char dir[] = "/tmp/gtk_lrcheckXXXXXX";
+    if (!mkdtemp(dir)) { std::perror("mkdtemp"); return 1; }
+    const std::string fifo = std::string(dir) + "/in";
+    if (mkfifo(fifo.c_str(), 0600) != 0) { std::perror("mkfifo"); return 1; }
+
+    std::string text = "SNP\tA1\tA2\tb\n";
+    for (int i = 0; i < 5000; ++i) text += "rs" + std::to_string(i) + "\tA\tG\t0.01\n";
+
+    expect("is_plain_file(fifo) == false", !LineReader::is_plain_file(fifo));
+    expect("fifo: plain text, header kept", via_fifo(fifo, text) == text);
+
+    uLongf zlen = compressBound(text.size()) + 32;
+    std::string gz(zlen, '\0');
+    z_stream zs{};
+    deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);   // gzip 头
+    zs.next_in = (Bytef*)text.data();  zs.avail_in = (uInt)text.size();
+    zs.next_out = (Bytef*)&gz[0];      zs.avail_out = (uInt)gz.size();
+    deflate(&zs, Z_FINISH);
+    gz.resize(zs.total_out);
+    deflateEnd(&zs);
+    expect("fifo: gzip detected from magic", via_fifo(fifo, gz) == text);
+
+    unlink(fifo.c_str());
+    rmdir(dir);
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,50 @@
+//
+//  statfunc_check.cpp
+//  GWAStoolkit
+//  Created by Lulu Shi on 18/10/2026.
+//  Copyright © 2026 Lulu Shi. All rights reserved.
+//
+//  make check：StatFunc 反正态 / LDSC Z 与已知分位数对照（回归检查）
+//
+
+#include "utils/StatFunc.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+static int failures = 0;
+
+static void expect(const char* what, double got, double want, double rel = 1e-12)
+{
+    bool ok = std::fabs(got - want) <= rel * std::fmax(1.0, std::fabs(want));
+    if (!ok) ++failures;
+    std::printf("%-28s %-4s got %.15g, want %.15g\n", what, ok ? "ok" : "FAIL", got, want);
+}
+
+int main()
+{
+    // 下尾分位数（参考值：对 erfc 二分求得）
+    expect("qnorm_as241(0.975)",  StatFunc::qnorm_as241(0.975),   1.9599639845400532);
+    expect("qnorm_as241(0.025)",  StatFunc::qnorm_as241(0.025),  -1.9599639845400545);
+    expect("qnorm_as241(1e-4)",   StatFunc::qnorm_as241(1e-4),   -3.719016485455681);
+    expect("qnorm_as241(2.5e-8)", StatFunc::qnorm_as241(2.5e-8), -5.451310437845478);
+    expect("qnorm_as241(5e-13)",  StatFunc::qnorm_as241(5e-13),  -7.130506848171326);
+    expect("qnorm_as241(5e-51)",  StatFunc::qnorm_as241(5e-51),  -14.979477571624336);
+    expect("qnorm_as241(1e-300)", StatFunc::qnorm_as241(1e-300), -37.0470962993612);
+    expect("qnorm_as241(0.5)",    StatFunc::qnorm_as241(0.5),     0.0);
+
+    // LDSC Z 的 p 回退（se 不可用）：双尾 p + beta 符号
+    expect("z_score(+, se=0, p=5e-8)",  StatFunc::z_score( 0.1, 0.0, 5e-8),   5.451310437845478);
+    expect("z_score(-, se=0, p=1e-12)", StatFunc::z_score(-0.1, 0.0, 1e-12), -7.130506848171326);
+    expect("z_score(+, se=0, p=1e-50)", StatFunc::z_score( 0.1, 0.0, 1e-50),  14.979477571624336);
+    expect("z_score(beta/se)",          StatFunc::z_score( 0.2, 0.05, 0.5),   4.0);
+
+    double b[3] = {0.1, -0.1, 0.3}, se[3] = {0.0, -1.0, 0.1}, p[3] = {5e-8, 1e-12, 0.5}, z[3];
+    StatFunc::z_score_batch(b, se, p, z, 3);
+    expect("z_score_batch[0]", z[0],  5.451310437845478);
+    expect("z_score_batch[1]", z[1], -7.130506848171326);
+    expect("z_score_batch[2]", z[2],  3.0);
+
+    if (failures) std::printf("%d check(s) failed\n", failures);
+    return failures ? 1 : 0;
+}